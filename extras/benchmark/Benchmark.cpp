@@ -0,0 +1,556 @@
+// Benchmarks of the hot paths, built on the host with the mocks of the Arduino
+// core. Every benchmark checks its result, runs a batch of operations several
+// times, and reports the fastest batch in cycles per operation.
+//
+//   Benchmark                  print the results
+//   Benchmark --check FILE     fail if a result exceeds its baseline by more than the tolerance
+//   Benchmark --update FILE    write the results as the new baselines
+//   Benchmark --tolerance N    the allowed increase, 0.5 == 50%
+//   Benchmark --smf FILE       add a File::Tracks::run benchmark of a Standard MIDI File
+#include <V2DMX.h>
+#include <V2LED.h>
+#include <V2MIDI.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+  // A deterministic sequence of pseudo-random numbers.
+  class Random {
+  public:
+    uint32_t next() {
+      _state = _state * 1664525 + 1013904223;
+      return _state >> 8;
+    }
+
+  private:
+    uint32_t _state{1};
+  };
+
+  struct Result {
+    std::string name;
+    const char* unit;
+    double      cycles;
+  };
+
+  std::vector<Result> results;
+  bool                failed{};
+
+  void check(bool ok, const char* name, const char* what) {
+    if (ok)
+      return;
+
+    fprintf(stderr, "FAIL %s: %s\n", name, what);
+    failed = true;
+  }
+
+  // Run the batch 'repeats' times with the profiler of the library, the fastest
+  // batch is the least disturbed by the host.
+  template <typename Function> void measure(const std::string& name, const char* unit, uint32_t ops, uint32_t repeats, Function batch) {
+    V2Base::Timer::Profiler<1> profiler;
+    profiler.begin();
+    const uint8_t index = profiler.add(name.c_str());
+    profiler.run(index, repeats, batch);
+    results.push_back({.name{name}, .unit{unit}, .cycles{(double)profiler.getSection(index)->cyclesMin / ops}});
+  }
+
+  class Port : public V2MIDI::Port {
+  public:
+    uint32_t notes{};
+    uint32_t controls{};
+    uint32_t sysex{};
+    uint32_t sysexBytes{};
+
+    Port() : V2MIDI::Port(0, 16 * 1024) {}
+
+  private:
+    void handleNote(uint8_t channel, uint8_t note, uint8_t velocity) override {
+      notes++;
+    }
+
+    void handleNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) override {
+      notes++;
+    }
+
+    void handleControlChange(uint8_t channel, uint8_t controller, uint8_t value) override {
+      controls++;
+    }
+
+    void handleSystemExclusive(const uint8_t* buffer, uint32_t len) override {
+      sysex++;
+      sysexBytes += len;
+    }
+  };
+
+  // Note and control change packets of all channels from the USB endpoint.
+  void benchmarkUSBDispatch() {
+    constexpr uint32_t   count = 1024;
+    std::vector<uint8_t> packets(count * 4);
+    Random               random;
+    for (uint32_t i = 0; i < count; i++) {
+      V2MIDI::Packet packet;
+      const uint8_t  channel = i % 16;
+      switch (i % 4) {
+        case 0:
+          packet.setNote(channel, 36 + (random.next() % 48), 1 + (random.next() % 127));
+          break;
+
+        case 1:
+          packet.setNoteOff(channel, 36 + (random.next() % 48), 64);
+          break;
+
+        default:
+          packet.setControlChange(channel, random.next() % 120, random.next() % 128);
+          break;
+      }
+
+      memcpy(&packets[i * 4], packet.data(), 4);
+    }
+
+    V2MIDI::USBDevice usb;
+    usb.begin();
+    Port port;
+    port.begin();
+
+    const auto batch = [&]() {
+      Adafruit_USBD_MIDI::setInput(packets.data(), count);
+      V2MIDI::Packet buffer[16];
+      for (;;) {
+        const uint32_t n = usb.receive(buffer, V2Base::countof(buffer));
+        if (n == 0)
+          break;
+
+        port.dispatch(&usb, buffer, n);
+      }
+    };
+
+    batch();
+    check(port.notes == count / 2 && port.controls == count / 2, "usb.dispatch", "not all messages were dispatched");
+    measure("usb.dispatch", "packet", count, 2000, batch);
+  }
+
+  // A 4 kB SysEx message split into USB packets of three bytes.
+  void benchmarkUSBSystemExclusive() {
+    constexpr uint32_t   length = 4096;
+    std::vector<uint8_t> message(length);
+    message[0] = 0xf0;
+    for (uint32_t i = 1; i < length - 1; i++)
+      message[i] = i & 0x7f;
+    message[length - 1] = 0xf7;
+
+    std::vector<uint8_t> packets;
+    for (uint32_t i = 0; i < length; i += 3) {
+      const uint32_t n = std::min(length - i, (uint32_t)3);
+      uint8_t        packet[4]{};
+      if (i + n < length)
+        packet[0] = (uint8_t)V2MIDI::Packet::CodeIndex::SystemExclusiveStart;
+
+      else if (n == 1)
+        packet[0] = (uint8_t)V2MIDI::Packet::CodeIndex::SystemExclusiveEnd1;
+
+      else if (n == 2)
+        packet[0] = (uint8_t)V2MIDI::Packet::CodeIndex::SystemExclusiveEnd2;
+
+      else
+        packet[0] = (uint8_t)V2MIDI::Packet::CodeIndex::SystemExclusiveEnd3;
+
+      memcpy(packet + 1, &message[i], n);
+      packets.insert(packets.end(), packet, packet + 4);
+    }
+
+    V2MIDI::USBDevice usb;
+    usb.begin();
+    Port port;
+    port.begin();
+
+    const uint32_t count = packets.size() / 4;
+    const auto     batch = [&]() {
+      Adafruit_USBD_MIDI::setInput(packets.data(), count);
+      V2MIDI::Packet buffer[16];
+      for (;;) {
+        const uint32_t n = usb.receive(buffer, V2Base::countof(buffer));
+        if (n == 0)
+          break;
+
+        port.dispatch(&usb, buffer, n);
+      }
+    };
+
+    batch();
+    check(port.sysex == 1 && port.sysexBytes == length, "usb.sysex", "the message was not reassembled");
+    measure("usb.sysex", "packet", count, 2000, batch);
+  }
+
+  // Notes with running status from the serial port.
+  void benchmarkSerialDispatch() {
+    constexpr uint32_t   count = 1024;
+    std::vector<uint8_t> bytes;
+    Random               random;
+    for (uint32_t i = 0; i < count; i++) {
+      if (i % 64 == 0)
+        bytes.push_back(0x90 | ((i / 64) % 16));
+
+      bytes.push_back(36 + (random.next() % 48));
+      bytes.push_back(random.next() % 128);
+    }
+
+    Uart                 uart;
+    V2MIDI::SerialDevice serial(&uart);
+    serial.begin();
+    Port port;
+    port.begin();
+
+    const auto batch = [&]() {
+      uart.setInput(bytes.data(), bytes.size());
+      V2MIDI::Packet packet;
+      while (serial.receive(&packet))
+        port.dispatch(&serial, &packet);
+    };
+
+    batch();
+    check(port.notes == count, "serial.dispatch", "not all notes were dispatched");
+    measure("serial.dispatch", "message", count, 2000, batch);
+  }
+
+  class SMF {
+  public:
+    void addTrack(const std::vector<uint8_t>& events) {
+      const char signature[]{'M', 'T', 'r', 'k'};
+      _tracks.insert(_tracks.end(), signature, signature + 4);
+      writeBE32(_tracks, events.size());
+      _tracks.insert(_tracks.end(), events.begin(), events.end());
+      _nTracks++;
+    }
+
+    std::vector<uint8_t> getData(uint16_t division) const {
+      std::vector<uint8_t> data{'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1};
+      data.push_back(_nTracks >> 8);
+      data.push_back(_nTracks);
+      data.push_back(division >> 8);
+      data.push_back(division);
+      data.insert(data.end(), _tracks.begin(), _tracks.end());
+      return data;
+    }
+
+    static void writeDelta(std::vector<uint8_t>& events, uint32_t delta) {
+      uint8_t bytes[5];
+      uint8_t n = 0;
+      do {
+        bytes[n++] = delta & 0x7f;
+        delta >>= 7;
+      } while (delta > 0);
+
+      while (n > 1)
+        events.push_back(bytes[--n] | 0x80);
+      events.push_back(bytes[0]);
+    }
+
+  private:
+    std::vector<uint8_t> _tracks;
+    uint16_t             _nTracks{};
+
+    static void writeBE32(std::vector<uint8_t>& data, uint32_t value) {
+      for (int8_t shift = 24; shift >= 0; shift -= 8)
+        data.push_back(value >> shift);
+    }
+  };
+
+  // A type 1 file; a tempo track with tempo changes, and eight tracks of notes with
+  // running status, the sustain pedal and pitch bends.
+  std::vector<uint8_t> generateSMF() {
+    SMF smf;
+
+    std::vector<uint8_t> tempo;
+    for (uint8_t i = 0; i < 8; i++) {
+      SMF::writeDelta(tempo, i == 0 ? 0 : 480 * 32);
+      const uint32_t usec = 500000 - (i * 20000);
+      tempo.insert(tempo.end(), {0xff, 0x51, 0x03, (uint8_t)(usec >> 16), (uint8_t)(usec >> 8), (uint8_t)usec});
+    }
+    tempo.insert(tempo.end(), {0x00, 0xff, 0x2f, 0x00});
+    smf.addTrack(tempo);
+
+    Random random;
+    for (uint8_t channel = 0; channel < 8; channel++) {
+      std::vector<uint8_t> events;
+      bool                 running = false;
+      for (uint32_t i = 0; i < 1000; i++) {
+        const uint8_t note = 36 + (random.next() % 48);
+        SMF::writeDelta(events, 0);
+        if (!running) {
+          events.push_back(0x90 | channel);
+          running = true;
+        }
+
+        events.insert(events.end(), {note, (uint8_t)(1 + (random.next() % 127))});
+        SMF::writeDelta(events, 120);
+        events.insert(events.end(), {note, 0});
+
+        if (i % 16 == 15) {
+          SMF::writeDelta(events, 0);
+          events.insert(events.end(), {(uint8_t)(0xb0 | channel), 64, (uint8_t)(i % 32 == 15 ? 127 : 0)});
+          SMF::writeDelta(events, 0);
+          events.insert(events.end(), {(uint8_t)(0xe0 | channel), 0, (uint8_t)(random.next() % 128)});
+          running = false;
+        }
+      }
+
+      SMF::writeDelta(events, 0);
+      events.insert(events.end(), {0xff, 0x2f, 0x00});
+      smf.addTrack(events);
+    }
+
+    return smf.getData(480);
+  }
+
+  class Player : public V2MIDI::File::Tracks<> {
+  public:
+    uint32_t sent{};
+    bool     playing{};
+
+    Player() : Tracks(nullptr) {}
+
+  private:
+    void handleStateChange(State state) override {
+      playing = state == State::Play;
+    }
+
+    bool handleSend(uint16_t track, V2MIDI::Packet* packet) override {
+      sent++;
+      return true;
+    }
+  };
+
+  // Play the file from the start to the end, run() is called every millisecond.
+  void benchmarkTracks(const std::string& name, const std::vector<uint8_t>& data) {
+    Player player;
+    if (!player.load(data.data())) {
+      check(false, name.c_str(), "the file cannot be loaded");
+      return;
+    }
+
+    const auto batch = [&]() {
+      Mock::setUsec(0);
+      player.sent = 0;
+      player.play();
+      while (player.playing) {
+        Mock::advanceUsec(1000);
+        player.run();
+      }
+    };
+
+    batch();
+    const uint32_t sent = player.sent;
+    check(sent > 0, name.c_str(), "no events were sent");
+    measure(name, "event", sent, 50, batch);
+  }
+
+  // Set all pixels and encode the frame.
+  void benchmarkWS2812() {
+    constexpr uint16_t count = 256;
+    SPIClass           spi(nullptr, 0, 0, 0, SPI_PAD_0_SCK_1, SERCOM_RX_PAD_3);
+    V2LED::WS2812      leds(count, &spi);
+    leds.begin();
+    leds.setMaxBrightness(1);
+
+    uint8_t    value = 0;
+    const auto batch = [&]() {
+      for (uint16_t i = 0; i < count; i++)
+        leds.setRGB(i, value, value + 85, value + 170);
+
+      leds.loop();
+      value++;
+    };
+
+    value = 0xa5;
+    batch();
+    // The red value 0xa5 of the first pixel, after green; MSB first, 0b110 for a
+    // set bit, 0b100 for a cleared bit.
+    const uint8_t  expected[3]{0b11010011, 0b01001001, 0b10100110};
+    const uint8_t* red = spi.getBuffer() ? spi.getBuffer() + 90 + 3 : nullptr;
+    check(red && spi.getCount() == 90 + (count * 9) + 90, "ws2812.encode", "the frame was not sent");
+    check(red && memcmp(red, expected, 3) == 0, "ws2812.encode", "the pixel is not encoded correctly");
+    measure("ws2812.encode", "pixel", count, 2000, batch);
+  }
+
+  // Set all channels and encode the frame.
+  void benchmarkDMX() {
+    SPIClass spi(nullptr, 0, 0, 0, SPI_PAD_0_SCK_1, SERCOM_RX_PAD_3);
+    V2DMX    dmx(&spi);
+    dmx.begin();
+
+    uint8_t    channels[512];
+    uint8_t    value = 0;
+    const auto batch = [&]() {
+      for (uint16_t i = 0; i < 512; i++)
+        channels[i] = value + i;
+
+      dmx.setChannels(0, channels, sizeof(channels));
+      dmx.loop();
+      value++;
+    };
+
+    batch();
+    // The first slot, one start bit and the value 0, LSB first.
+    check(spi.getCount() == 5 + (64 * 11), "dmx.encode", "the frame was not sent");
+    check(spi.getCount() > 5 && spi.getBuffer()[5] == 0, "dmx.encode", "the slot is not encoded correctly");
+    measure("dmx.encode", "channel", 512, 2000, batch);
+  }
+
+  void benchmarkBase64() {
+    constexpr uint32_t   length = 8192;
+    std::vector<uint8_t> data(length);
+    Random               random;
+    for (uint8_t& b : data)
+      b = random.next();
+
+    std::vector<uint8_t> text(((length + 2) / 3 * 4) + 1);
+    const uint32_t       n = V2Base::Text::Base64::encode(data.data(), length, text.data());
+    text[n]                = '\0';
+
+    std::vector<uint8_t> output(length);
+    uint32_t             decoded{};
+    const auto           batch = [&]() {
+      decoded = V2Base::Text::Base64::decode(text.data(), output.data());
+    };
+
+    batch();
+    check(decoded == length && output == data, "base64.decode", "the data does not match");
+    measure("base64.decode", "byte", length, 500, batch);
+  }
+
+  void benchmarkSHA1() {
+    // FIPS 180-1 test vector.
+    {
+      const uint8_t              abc[]{'a', 'b', 'c'};
+      const uint8_t              expected[20]{0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+                                              0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+      V2Base::Cryptography::SHA1 sha;
+      uint8_t                    digest[20];
+      sha.init();
+      sha.update(abc, sizeof(abc));
+      sha.final(digest);
+      check(memcmp(digest, expected, 20) == 0, "sha1.update", "the digest does not match");
+    }
+
+    constexpr uint32_t   length = 64 * 1024;
+    std::vector<uint8_t> data(length);
+    Random               random;
+    for (uint8_t& b : data)
+      b = random.next();
+
+    V2Base::Cryptography::SHA1 sha;
+    const auto                 batch = [&]() {
+      sha.init();
+      sha.update(data.data(), length);
+    };
+
+    measure("sha1.update", "byte", length, 100, batch);
+  }
+
+  std::map<std::string, double> readBaselines(const char* path) {
+    std::map<std::string, double> baselines;
+    std::ifstream                 file(path);
+    std::string                   line;
+    while (std::getline(file, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      char   name[64];
+      double cycles;
+      if (sscanf(line.c_str(), "%63s %lf", name, &cycles) == 2)
+        baselines[name] = cycles;
+    }
+
+    return baselines;
+  }
+
+  bool writeBaselines(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+      return false;
+
+    fprintf(file, "# The cycles per operation of the benchmarks, the fastest of the\n");
+    fprintf(file, "# repeated batches. The cycles of the time stamp counter on x86, nanoseconds\n");
+    fprintf(file, "# on other hosts. Updated with: Benchmark --update baselines.txt\n");
+    for (const Result& result : results)
+      fprintf(file, "%s %.2f\n", result.name.c_str(), result.cycles);
+
+    fclose(file);
+    return true;
+  }
+};
+
+int main(int argc, char* argv[]) {
+  const char*              checkPath{};
+  const char*              updatePath{};
+  double                   tolerance{0.5};
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (i + 1 == argc) {
+      fprintf(stderr, "Missing value of %s\n", arg.c_str());
+      return 2;
+    }
+
+    if (arg == "--check")
+      checkPath = argv[++i];
+
+    else if (arg == "--update")
+      updatePath = argv[++i];
+
+    else if (arg == "--tolerance")
+      tolerance = atof(argv[++i]);
+
+    else if (arg == "--smf")
+      files.push_back(argv[++i]);
+
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  benchmarkUSBDispatch();
+  benchmarkUSBSystemExclusive();
+  benchmarkSerialDispatch();
+  benchmarkTracks("tracks.run", generateSMF());
+  for (const std::string& path : files) {
+    std::ifstream        file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    benchmarkTracks("tracks.run:" + path.substr(path.find_last_of('/') + 1), data);
+  }
+
+  benchmarkWS2812();
+  benchmarkDMX();
+  benchmarkBase64();
+  benchmarkSHA1();
+
+  std::map<std::string, double> baselines;
+  if (checkPath)
+    baselines = readBaselines(checkPath);
+
+  for (const Result& result : results) {
+    printf("%-24s %10.2f cycles/%s", result.name.c_str(), result.cycles, result.unit);
+
+    const auto baseline = baselines.find(result.name);
+    if (baseline != baselines.end()) {
+      const double change = (result.cycles / baseline->second) - 1;
+      printf("  %+6.1f%%", change * 100);
+      if (change > tolerance) {
+        printf("  REGRESSION");
+        failed = true;
+      }
+    }
+
+    printf("\n");
+  }
+
+  if (updatePath && !writeBaselines(updatePath)) {
+    fprintf(stderr, "Cannot write %s\n", updatePath);
+    return 2;
+  }
+
+  return failed ? 1 : 0;
+}
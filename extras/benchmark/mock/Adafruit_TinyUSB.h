@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+
+// The device is always configured by the host.
+class Adafruit_USBD_Device {
+public:
+  void setConfigurationBuffer(uint8_t* buffer, uint16_t size) {}
+  void setID(uint16_t vid, uint16_t pid) {}
+  void setManufacturerDescriptor(const char* name) {}
+  void setProductDescriptor(const char* name) {}
+  void setDeviceVersion(uint16_t bcd) {}
+
+  bool ready() {
+    return true;
+  }
+};
+
+extern Adafruit_USBD_Device TinyUSBDevice;
+
+// The interface is private to V2Base::USBDevice; the scripted input and the output
+// counter are shared by all instances.
+class Adafruit_USBD_MIDI {
+public:
+  bool begin() {
+    return true;
+  }
+
+  void setCables(uint8_t n) {}
+  void setCableName(uint8_t cable, const char* name) {}
+
+  // Returns the packets of the input, four bytes each.
+  bool readPacket(uint8_t packet[4]) {
+    if (_rx.position == _rx.count)
+      return false;
+
+    memcpy(packet, _rx.packets + (_rx.position * 4), 4);
+    _rx.position++;
+    return true;
+  }
+
+  bool writePacket(const uint8_t packet[4]) {
+    _tx++;
+    return true;
+  }
+
+  static void setInput(const uint8_t* packets, size_t count) {
+    _rx = {.packets{packets}, .count{count}};
+  }
+
+  static size_t getOutputCount() {
+    return _tx;
+  }
+
+private:
+  static inline struct {
+    const uint8_t* packets;
+    size_t         count;
+    size_t         position;
+  } _rx{};
+
+  static inline size_t _tx{};
+};
+
+class Adafruit_USBD_WebUSB {
+public:
+  bool begin() {
+    return true;
+  }
+
+  bool setLandingPage(const void* url) {
+    return true;
+  }
+};
+
+void TinyUSB_Port_GetSerialNumber(uint8_t serial[16]);
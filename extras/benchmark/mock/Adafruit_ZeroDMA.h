@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+// Only the types; the DMX receiver, the user of the DMA, is not benchmarked.
+struct DmacDescriptor {
+  uint16_t BTCTRL;
+  uint16_t BTCNT;
+  uint32_t SRCADDR;
+  uint32_t DSTADDR;
+  uint32_t DESCADDR;
+};
+
+class Adafruit_ZeroDMA {};
@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The subset of the SAMD51 Arduino core and CMSIS used by the benchmarked
+// sources. Time is a fake clock advanced by the benchmarks; the cycle counter is
+// the one of the host.
+namespace Mock {
+  // The fake time returned by micros().
+  extern uint32_t usec;
+
+  static inline void setUsec(uint32_t value) {
+    usec = value;
+  }
+
+  static inline void advanceUsec(uint32_t value) {
+    usec += value;
+  }
+
+  uint32_t getCycles();
+};
+
+#define F_CPU 120000000UL
+
+unsigned long micros();
+unsigned long millis();
+void          delay(unsigned long msec);
+void          yield();
+
+// Interrupts do not exist on the host, the main loop is the only context.
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline void __DMB() {}
+static inline void __DSB() {}
+static inline void __WFI() {}
+
+static inline uint32_t __get_PRIMASK() {
+  return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t primask) {}
+
+static inline uint32_t __get_IPSR() {
+  return 0;
+}
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+// The DWT cycle counter of the profiler, reading CYCCNT returns the lower 32 bit of
+// the host cycle counter.
+struct MockDWT {
+  struct {
+    operator uint32_t() const {
+      return Mock::getCycles();
+    }
+
+    auto& operator=(uint32_t value) {
+      return *this;
+    }
+  } CYCCNT;
+  uint32_t CTRL;
+};
+
+struct MockCoreDebug {
+  uint32_t DEMCR;
+};
+
+extern MockDWT       mockDWT;
+extern MockCoreDebug mockCoreDebug;
+#define DWT                        (&mockDWT)
+#define CoreDebug                  (&mockCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+// The PORT registers of V2Base::GPIO.
+struct PortGroup {
+  struct {
+    uint32_t reg;
+  } DIR, DIRCLR, DIRSET, OUT, OUTCLR, OUTSET, OUTTGL, IN;
+};
+
+struct Port {
+  PortGroup Group[4];
+};
+
+extern Port mockPort;
+#define PORT (&mockPort)
+
+struct PinDescription {
+  uint32_t ulPort;
+  uint32_t ulPin;
+};
+
+extern const PinDescription g_APinDescription[];
+
+enum EPioType { PIO_NOT_A_PIN = -1, PIO_DIGITAL, PIO_SERCOM = 3, PIO_SERCOM_ALT = 4 };
+
+// The SERCOM instances only carry their identity, nothing is configured.
+struct Sercom {};
+class SERCOM {};
+
+enum SercomSpiTXPad { SPI_PAD_0_SCK_1, SPI_PAD_2_SCK_3, SPI_PAD_3_SCK_1, SPI_PAD_0_SCK_3 };
+enum SercomRXPad { SERCOM_RX_PAD_0, SERCOM_RX_PAD_1, SERCOM_RX_PAD_2, SERCOM_RX_PAD_3 };
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+// A serial port reading from a scripted input and discarding the output.
+class Uart {
+public:
+  void begin(unsigned long baudrate) {}
+  void setTimeout(unsigned long msec) {}
+
+  int available() {
+    return _rx.length - _rx.position;
+  }
+
+  int read() {
+    if (_rx.position == _rx.length)
+      return -1;
+
+    return _rx.data[_rx.position++];
+  }
+
+  size_t write(uint8_t byte) {
+    _tx++;
+    return 1;
+  }
+
+  size_t write(const uint8_t* buffer, size_t size) {
+    _tx += size;
+    return size;
+  }
+
+  void flush() {}
+
+  // The bytes returned by read().
+  void setInput(const uint8_t* data, size_t length) {
+    _rx = {.data{data}, .length{length}};
+  }
+
+  // The number of written bytes.
+  size_t getOutputCount() const {
+    return _tx;
+  }
+
+private:
+  struct {
+    const uint8_t* data;
+    size_t         length;
+    size_t         position;
+  } _rx{};
+
+  size_t _tx{};
+};
@@ -0,0 +1,44 @@
+#include <Adafruit_TinyUSB.h>
+#include <Arduino.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+uint32_t Mock::usec{};
+
+// The time stamp counter; other hosts count nanoseconds.
+uint32_t Mock::getCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+unsigned long micros() {
+  return Mock::usec;
+}
+
+unsigned long millis() {
+  return Mock::usec / 1000;
+}
+
+void delay(unsigned long msec) {
+  Mock::usec += msec * 1000;
+}
+
+void yield() {}
+
+MockDWT       mockDWT{};
+MockCoreDebug mockCoreDebug{};
+Port          mockPort{};
+
+// All pins are in group 0.
+const PinDescription g_APinDescription[64]{};
+
+Adafruit_USBD_Device TinyUSBDevice{};
+
+void TinyUSB_Port_GetSerialNumber(uint8_t serial[16]) {
+  memset(serial, 0, 16);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+
+#define SPI_MODE0 0x02
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {}
+};
+
+// The transfers complete immediately; the benchmarks only measure the encoding of
+// the buffers.
+class SPIClass {
+public:
+  SPIClass(SERCOM* sercom, uint8_t pinMISO, uint8_t pinSCK, uint8_t pinMOSI, SercomSpiTXPad padTX, SercomRXPad padRX) {}
+
+  void begin() {}
+  void beginTransaction(SPISettings settings) {}
+  void endTransaction() {}
+
+  void transfer(const void* txbuf, void* rxbuf, size_t count, bool block = true) {
+    _transfer = {.buffer{(const uint8_t*)txbuf}, .count{count}, .n{_transfer.n + 1}};
+  }
+
+  bool isBusy() {
+    return false;
+  }
+
+  // The data of the last transfer.
+  const uint8_t* getBuffer() const {
+    return _transfer.buffer;
+  }
+
+  size_t getCount() const {
+    return _transfer.count;
+  }
+
+  // The number of transfers.
+  uint32_t getTransfers() const {
+    return _transfer.n;
+  }
+
+private:
+  struct {
+    const uint8_t* buffer;
+    size_t         count;
+    uint32_t       n;
+  } _transfer{};
+};
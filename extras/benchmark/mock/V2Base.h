@@ -0,0 +1,30 @@
+#pragma once
+// The portable subset of src/V2Base.h; the drivers of the SAMD51 peripherals
+// are left out.
+#include "Base/Cryptography/SHA1.h"
+#include "Base/GPIO/GPIO.h"
+#include "Base/Text/Base64.h"
+#include "Base/Text/Bits7.h"
+#include "Base/Timer/Profiler.h"
+#include "Base/Timer/Scheduler.h"
+#include "Base/Timer/Trace.h"
+#include "Base/USB/Device.h"
+
+namespace V2Base {
+  namespace Timer {
+    class Periodic;
+    class PWM;
+  };
+
+  template <class T, size_t N> constexpr size_t countof(T (&)[N]) {
+    return N;
+  }
+
+  static inline uint32_t getUsec() {
+    return micros();
+  }
+
+  static inline uint32_t getUsecSince(uint32_t since) {
+    return (uint32_t)(micros() - since);
+  }
+};
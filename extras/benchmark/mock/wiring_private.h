@@ -0,0 +1,6 @@
+#pragma once
+#include <Arduino.h>
+
+static inline int pinPeripheral(uint32_t pin, EPioType type) {
+  return 0;
+}
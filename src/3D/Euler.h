@@ -31,5 +31,21 @@ namespace V23D {
 
       return e;
     }
+
+    // The angles of a unit quaternion, with the products shared between the angles
+    // and the pitch from asin().
+    static auto quaternionFast(Quaternion q) -> Euler {
+      const float xx{q.x * q.x}, yy{q.y * q.y}, zz{q.z * q.z};
+      auto        sinp{2.f * (q.w * q.y - q.x * q.z)};
+      if (sinp > 1.f)
+        sinp = 1.f;
+
+      else if (sinp < -1.f)
+        sinp = -1.f;
+
+      return Euler(std::atan2(2.f * (q.w * q.z + q.x * q.y), 1.f - 2.f * (yy + zz)),
+                   std::asin(sinp),
+                   std::atan2(2.f * (q.w * q.x + q.y * q.z), 1.f - 2.f * (xx + yy)));
+    }
   };
 };
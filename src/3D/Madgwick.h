@@ -0,0 +1,62 @@
+#pragma once
+#include "Quaternion.h"
+
+namespace V23D {
+  // Incremental orientation filter of raw gyroscope and accelerometer samples. The
+  // integrated rate of the gyroscope is corrected by a gradient-descent step towards
+  // the gravity of the accelerometer; 'beta' is the gain of the correction. The
+  // magnitude of the accelerometer vector does not matter, the units of the gyroscope
+  // are radians per second. Without a magnetometer, the yaw drifts.
+  //
+  // Madgwick, "An efficient orientation filter for inertial and inertial/magnetic
+  // sensor arrays", 2010.
+  class Madgwick {
+  public:
+    constexpr Madgwick(float beta = 0.1f) : _beta(beta) {}
+
+    auto reset(Quaternion q = {}) -> void {
+      _q = q;
+    }
+
+    auto getQuaternion() const -> Quaternion {
+      return _q;
+    }
+
+    auto update(Vector3 g, Vector3 a, float seconds) -> Quaternion {
+      const float q0{_q.w}, q1{_q.x}, q2{_q.y}, q3{_q.z};
+
+      // The rate of change of the quaternion from the gyroscope.
+      float d0{0.5f * (-q1 * g.x - q2 * g.y - q3 * g.z)};
+      float d1{0.5f * (q0 * g.x + q2 * g.z - q3 * g.y)};
+      float d2{0.5f * (q0 * g.y - q1 * g.z + q3 * g.x)};
+      float d3{0.5f * (q0 * g.z + q1 * g.y - q2 * g.x)};
+
+      // The accelerometer is only used if it measures anything.
+      if (a.x != 0.f || a.y != 0.f || a.z != 0.f) {
+        a.normalizeFast();
+
+        // The gradient of the error between the measured and the estimated gravity.
+        const float q0q0{q0 * q0}, q1q1{q1 * q1}, q2q2{q2 * q2}, q3q3{q3 * q3};
+        const float s0{4.f * q0 * q2q2 + 2.f * q2 * a.x + 4.f * q0 * q1q1 - 2.f * q1 * a.y};
+        const float s1{4.f * q1 * (q3q3 + q0q0 - 1.f + 2.f * q1q1 + 2.f * q2q2 + a.z) - 2.f * q3 * a.x - 2.f * q0 * a.y};
+        const float s2{4.f * q2 * (q0q0 + q3q3 - 1.f + 2.f * q1q1 + 2.f * q2q2 + a.z) + 2.f * q0 * a.x - 2.f * q3 * a.y};
+        const float s3{4.f * q1q1 * q3 - 2.f * q1 * a.x + 4.f * q2q2 * q3 - 2.f * q2 * a.y};
+
+        if (const auto l{s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3}; l > 0.f) {
+          const auto s{invSqrt(l) * _beta};
+          d0 -= s0 * s;
+          d1 -= s1 * s;
+          d2 -= s2 * s;
+          d3 -= s3 * s;
+        }
+      }
+
+      _q = Quaternion(q0 + d0 * seconds, q1 + d1 * seconds, q2 + d2 * seconds, q3 + d3 * seconds);
+      return _q.normalizeFast();
+    }
+
+  private:
+    float      _beta;
+    Quaternion _q{};
+  };
+};
@@ -30,10 +30,46 @@ namespace V23D {
       return Quaternion(w, x, y, z);
     }
 
+    // Normalize with the approximate inverse square root.
+    auto normalizeFast() -> Quaternion {
+      if (auto l{w * w + x * x + y * y + z * z}; l > 0.0001f * 0.0001f) {
+        const auto s{invSqrt(l)};
+        w *= s;
+        x *= s;
+        y *= s;
+        z *= s;
+      }
+
+      return Quaternion(w, x, y, z);
+    }
+
     auto length() const -> float {
       return std::sqrtf(w * w + x * x + y * y + z * z);
     }
 
+    // Rotate the vector by the unit quaternion, q * v * q', without the two
+    // quaternion products: v + 2w(u × v) + 2u × (u × v).
+    auto rotate(const Vector3 v) const -> Vector3 {
+      const Vector3 u{x, y, z};
+      auto          t{u.cross(v)};
+      t.x *= 2.f;
+      t.y *= 2.f;
+      t.z *= 2.f;
+      const auto c{u.cross(t)};
+      return Vector3(v.x + w * t.x + c.x, v.y + w * t.y + c.y, v.z + w * t.z + c.z);
+    }
+
+    // The rotated unit axes, the columns of the rotation matrix; the products are
+    // shared between the axes.
+    auto getAxes(Vector3* ax, Vector3* ay, Vector3* az) const -> void {
+      const float xx{x * x}, yy{y * y}, zz{z * z};
+      const float xy{x * y}, xz{x * z}, yz{y * z};
+      const float wx{w * x}, wy{w * y}, wz{w * z};
+      *ax = Vector3(1.f - 2.f * (yy + zz), 2.f * (xy + wz), 2.f * (xz - wy));
+      *ay = Vector3(2.f * (xy - wz), 1.f - 2.f * (xx + zz), 2.f * (yz + wx));
+      *az = Vector3(2.f * (xz + wy), 2.f * (yz - wx), 1.f - 2.f * (xx + yy));
+    }
+
     auto conjugate() const -> Quaternion {
       return Quaternion(w, -x, -y, -z);
     }
@@ -1,6 +1,16 @@
 #pragma once
+#include <bit>
+#include <cstdint>
 
 namespace V23D {
+  // Approximate 1 / sqrt(v), the bit pattern of the float as the initial guess and
+  // one Newton-Raphson step; the relative error is less than 0.2%.
+  constexpr auto invSqrt(float v) -> float {
+    const float half{v * 0.5f};
+    float       y{std::bit_cast<float>(0x5f3759df - (std::bit_cast<uint32_t>(v) >> 1))};
+    return y * (1.5f - (half * y * y));
+  }
+
   class Vector3 {
   public:
     float x{};
@@ -19,6 +29,18 @@ namespace V23D {
       return Vector3(x, y, z);
     }
 
+    // Normalize with the approximate inverse square root.
+    auto normalizeFast() -> Vector3 {
+      if (auto l{x * x + y * y + z * z}; l > 0.0001f * 0.0001f) {
+        const auto s{invSqrt(l)};
+        x *= s;
+        y *= s;
+        z *= s;
+      }
+
+      return Vector3(x, y, z);
+    }
+
     auto length() const -> float {
       return std::sqrtf(x * x + y * y + z * z);
     }
@@ -1,13 +1,23 @@
 // Generic I2S Audio Codec, two channels, 48 kHz. The samples sources are
-// registered as V2Audio::Channel, and called from interrupt context.
+// registered as V2Audio::Codec::Channel, and called from interrupt context. The
+// optional input is received into a second double-buffer and handed to a
+// registered V2Audio::Codec::Input, one buffer behind the codec.
+//
+// The size and the number of the output buffers are template parameters of
+// BasicCodec; every buffer beyond the second one adds the duration of one buffer
+// of latency and the same amount of margin for a late fillBuffer(). The default
+// V2Audio::Codec uses two buffers of 64 frames, 1.33 milliseconds each.
 
 #pragma once
 #include <Adafruit_ZeroDMA.h>
 #include <V2Base.h>
 #include <V2Music.h>
+#include <algorithm>
+#include <cstring>
 
 namespace V2Audio {
-  class Codec : public V2Base::I2SInterface {
+  // The interfaces shared by all buffer configurations.
+  class CodecBase : public V2Base::I2SInterface {
   public:
     static constexpr uint8_t nChannels = 2;
 
@@ -16,9 +26,110 @@ namespace V2Audio {
     class Channel {
     public:
       virtual float getSample() = 0;
+
+      // Render a block of 'n' samples. The default calls getSample() for every
+      // sample; sources can override it to keep their state in registers.
+      virtual void fill(float* out, uint32_t n) {
+        for (uint32_t i = 0; i < n; i++)
+          out[i] = getSample();
+      }
+    };
+
+    // One sample per channel, the layout of the transferred data.
+    struct Frame {
+      int32_t channels[nChannels];
+    };
+
+    // The consumer of the received samples. It is called from the DMA interrupt
+    // with the completed buffer, which is valid until the call returns.
+    class Input {
+    public:
+      virtual void handleFrames(const Frame* frames, uint32_t count) = 0;
+    };
+
+    CodecBase(uint8_t pinSCK, uint8_t pinFS, uint8_t pinSD, uint8_t pinMCK, uint8_t pinSDIn) :
+      V2Base::I2SInterface(pinSCK, pinFS, pinSD, pinMCK, pinSDIn) {}
+
+    // Enable / disable the power supply.
+    virtual bool handlePower(bool on = true) = 0;
+
+    // Enable / disable the codec hardware.
+    virtual bool handleEnable(bool on = true) = 0;
+
+    // The upper bounds of the render time buckets in percent of the duration of
+    // a buffer, the last bucket counts all longer render times.
+    static constexpr uint8_t countBuckets{5};
+    static constexpr uint8_t percentBuckets[countBuckets]{25, 50, 75, 90, 100};
+
+    struct Statistics {
+      uint32_t buffers;
+
+      // The DMA engine was already streaming a buffer again when its rendering
+      // finished; the output contained stale samples.
+      uint32_t underruns;
+
+      uint64_t usec;
+      uint32_t usecMin;
+      uint32_t usecMax;
+      uint32_t histogram[countBuckets + 1];
     };
 
-    Codec(uint8_t pinSCK, uint8_t pinFS, uint8_t pinSD, uint8_t pinMCK) : V2Base::I2SInterface(pinSCK, pinFS, pinSD, pinMCK) {}
+    // Returns the statistics since the previous call and resets them.
+    Statistics takeStatistics() {
+      noInterrupts();
+      const Statistics statistics = _statistics;
+      _statistics                 = {.usecMin = UINT32_MAX};
+      interrupts();
+      return statistics;
+    }
+
+    // The upper bound in percent of the bucket which contains the 'fraction' of
+    // the render times, 0xff if the fraction reaches into the last bucket.
+    static uint8_t getPercentile(const Statistics* statistics, float fraction) {
+      const uint32_t count = fraction * statistics->buffers;
+      uint32_t       sum   = 0;
+      for (uint8_t i = 0; i < countBuckets; i++) {
+        sum += statistics->histogram[i];
+        if (sum >= count)
+          return percentBuckets[i];
+      }
+
+      return 0xff;
+    }
+
+  protected:
+    void record(uint32_t usec, uint32_t usecBuffer) {
+      _statistics.buffers++;
+      _statistics.usec += usec;
+      if (usec < _statistics.usecMin)
+        _statistics.usecMin = usec;
+
+      if (usec > _statistics.usecMax)
+        _statistics.usecMax = usec;
+
+      const uint32_t percent = usec * 100 / usecBuffer;
+      uint8_t        i       = 0;
+      while (i < countBuckets && percent >= percentBuckets[i])
+        i++;
+
+      _statistics.histogram[i]++;
+    }
+
+    void recordUnderrun() {
+      _statistics.underruns++;
+    }
+
+  private:
+    Statistics _statistics{.usecMin = UINT32_MAX};
+  };
+
+  template <uint16_t nFrames = 64, uint8_t nBuffers = 2> class BasicCodec : public CodecBase {
+  public:
+    static_assert(nFrames % 4 == 0);
+    static_assert(nBuffers >= 2);
+
+    BasicCodec(uint8_t pinSCK, uint8_t pinFS, uint8_t pinSD, uint8_t pinMCK, uint8_t pinSDIn = 0xff) :
+      CodecBase(pinSCK, pinFS, pinSD, pinMCK, pinSDIn) {}
 
     // The instance needs to be registered with the DMA engine to update the sample data:
     //   Codec.begin([](Adafruit_ZeroDMA *dma) { Codec.fillNextBuffer(); });
@@ -31,7 +142,7 @@ namespace V2Audio {
       _dma.loop(true);
       _dma.setCallback(dmaCallback);
 
-      // Allocate a DMA descriptor for every one of the two buffers. The DMA engine
+      // Allocate a DMA descriptor for every one of the buffers. The DMA engine
       // will cycle through the buffers until the request is aborted.
       for (uint8_t i = 0; i < V2Base::countof(_buffers); i++) {
         DmacDescriptor* desc = _dma.addDescriptor((void*)_buffers[i].samples,
@@ -48,11 +159,28 @@ namespace V2Audio {
       adjustSamplerate(0);
     }
 
-    // Enable / disable the power supply.
-    virtual bool handlePower(bool on = true) = 0;
-
-    // Enable / disable the codec hardware.
-    virtual bool handleEnable(bool on = true) = 0;
+    // The input needs to be registered with the DMA engine to receive the sample data:
+    //   Codec.beginInput([](Adafruit_ZeroDMA *dma) { Codec.readNextBuffer(); });
+    void beginInput(void (*dmaCallback)(Adafruit_ZeroDMA* dma)) {
+      if (!hasInput())
+        return;
+
+      _input.dma.setTrigger(I2S_DMAC_ID_RX_0);
+      _input.dma.setAction(DMA_TRIGGER_ACTON_BEAT);
+      _input.dma.allocate();
+      _input.dma.loop(true);
+      _input.dma.setCallback(dmaCallback);
+
+      for (uint8_t i = 0; i < V2Base::countof(_input.buffers); i++) {
+        DmacDescriptor* desc = _input.dma.addDescriptor((void*)(&I2S->RXDATA.reg),
+                                                        (void*)_input.buffers[i].frames,
+                                                        _nSamples * nChannels,
+                                                        DMA_BEAT_SIZE_WORD,
+                                                        false,
+                                                        true);
+        desc->BTCTRL.bit.BLOCKACT = DMA_BLOCK_ACTION_INT;
+      }
+    }
 
     void registerChannel(uint8_t ch, Channel* channel) {
       _channels[ch] = channel;
@@ -60,6 +188,8 @@ namespace V2Audio {
 
     void reset() {
       _dma.abort();
+      if (_input.running)
+        _input.dma.abort();
       V2Base::I2SInterface::reset();
 
       handleEnable(false);
@@ -74,6 +204,9 @@ namespace V2Audio {
 
       for (uint8_t i = 0; i < V2Base::countof(_buffers); i++)
         _buffers[i] = {};
+
+      _input.running = false;
+      _input.index   = 0;
     }
 
     void adjustSamplerate(float cents) {
@@ -84,6 +217,52 @@ namespace V2Audio {
       return _frequency;
     }
 
+    // Track an external clock, e.g. the USB start-of-frame or a word clock. Called
+    // for every event of the reference with the local time of the event and the
+    // nominal interval between the events. The ratio is measured over windows of
+    // one second.
+    void updateReference(uint32_t usec, float usecPeriod) {
+      const uint32_t elapsed = usec - _reference.start;
+
+      // The first event, or the reference was lost.
+      if (_reference.count == 0 || usec - _reference.usec > 10.f * usecPeriod) {
+        _reference.start = usec;
+        _reference.usec  = usec;
+        _reference.count = 1;
+        return;
+      }
+
+      _reference.usec = usec;
+      if (elapsed < 1000 * 1000) {
+        _reference.count++;
+        return;
+      }
+
+      // The number of reference samples per local sample.
+      const float expected = (float)_reference.count * usecPeriod;
+      const float ratio    = std::clamp(expected / (float)elapsed, 1.f - _maxDrift, 1.f + _maxDrift);
+      _resampler.ratio += (ratio - _resampler.ratio) / 8.f;
+
+      _reference.start = usec;
+      _reference.count = 1;
+    }
+
+    // Render the channels at the samplerate of the reference and resample them to
+    // the samplerate of the codec.
+    void enableResampler(bool enable = true) {
+      noInterrupts();
+      _resampler.enabled = enable;
+      _resampler.phase   = 0;
+      for (uint8_t ch = 0; ch < nChannels; ch++)
+        _resampler.channels[ch].count = 0;
+      interrupts();
+    }
+
+    // The deviation of the reference clock from the local clock in parts per million.
+    float getDrift() const {
+      return (_resampler.ratio - 1.f) * 1000.f * 1000.f;
+    }
+
     bool isChannelEnabled(uint8_t channel) const {
       return _enabled[channel];
     }
@@ -107,13 +286,17 @@ namespace V2Audio {
         fillBuffer();
         _dma.startJob();
 
-        // Fill the second buffer. It will be transmitted by the DMA engine cycling through
+        // Fill the other buffers. They will be transmitted by the DMA engine cycling through
         // the descriptors. The interrupt for the completed first buffer will fill the first
         // buffer again, and so on.
-        fillNextBuffer();
+        for (uint8_t i = 1; i < nBuffers; i++)
+          fillNextBuffer();
         _running = true;
       }
 
+      if (!_enabled[channel])
+        _resampler.channels[channel].count = 0;
+
       _enabled[channel] = true;
       return true;
     }
@@ -127,6 +310,55 @@ namespace V2Audio {
           _buffers[i].samples[sample].channels[channel] = 0;
     }
 
+    // Start receiving; the consumer is called for every completed buffer.
+    bool enableInput(Input* input) {
+      if (!hasInput() || !input)
+        return false;
+
+      if (!handlePower()) {
+        reset();
+        return false;
+      }
+
+      if (!_running && !handleEnable())
+        return false;
+
+      _input.consumer = input;
+      if (!_input.running) {
+        _input.index = 0;
+        _input.dma.startJob();
+        _input.running = true;
+      }
+
+      return true;
+    }
+
+    void disableInput() {
+      if (_input.running)
+        _input.dma.abort();
+
+      _input.running  = false;
+      _input.consumer = nullptr;
+    }
+
+    bool isInputEnabled() const {
+      return _input.running;
+    }
+
+    // Hand the completed buffer to the consumer and switch to the next one. The
+    // DMA engine fills the other buffer in the meantime.
+    void readNextBuffer() {
+      const uint8_t index = _input.index;
+      _input.index++;
+      if (_input.index == V2Base::countof(_input.buffers))
+        _input.index = 0;
+
+      __enable_irq();
+
+      if (_input.consumer)
+        _input.consumer->handleFrames(_input.buffers[index].frames, _nSamples);
+    }
+
     // Fill the current buffer.
     void fillBuffer() {
       const uint32_t usec = V2Base::getUsec();
@@ -138,11 +370,33 @@ namespace V2Audio {
         if (!isChannelEnabled(ch))
           continue;
 
-        for (uint32_t i = 0; i < _nSamples; i++)
-          _buffers[_index].samples[i].channels[ch] = _channels[ch]->getSample() * (float)INT32_MAX;
+        if (_resampler.enabled)
+          resample(ch);
+
+        else
+          _channels[ch]->fill(_block, _nSamples);
+
+        convert(_block, _buffers[_index].samples, ch);
+      }
+
+      if (_resampler.enabled) {
+        const float    end      = _resampler.phase + _nSamples * _resampler.ratio;
+        const uint32_t consumed = (uint32_t)end;
+        _resampler.phase        = end - (float)consumed;
+        for (uint8_t ch = 0; ch < nChannels; ch++) {
+          auto* channel = &_resampler.channels[ch];
+          if (channel->count < consumed) {
+            channel->count = 0;
+            continue;
+          }
+
+          channel->count -= consumed;
+          memmove(channel->samples, channel->samples + consumed, channel->count * sizeof(float));
+        }
       }
 
       _runUsec = V2Base::getUsecSince(usec);
+      record(_runUsec, _nSamples * 1000 * 1000 / getSamplerate());
     }
 
     // Switch to the next buffer and fill it.
@@ -156,9 +410,14 @@ namespace V2Audio {
       __enable_irq();
 
       fillBuffer();
+
+      // The DMA engine has cycled through all other buffers and is already
+      // streaming this one again.
+      if (isStreaming(_index))
+        recordUnderrun();
     }
 
-    // Return the fraction of the time used to calculate the samples. Multiplied by
+    // Return the fraction of the time used to calculate the last buffer. Multiplied by
     // 100 it is an estimate in percent of the CPU usage.
     float getLoad() {
       const float runSec    = _runUsec / (1000.f * 1000.f);
@@ -167,31 +426,116 @@ namespace V2Audio {
     }
 
   protected:
-    static constexpr uint16_t _nSamples = 64;
+    static constexpr uint16_t _nSamples = nFrames;
+
+    // Scale the block to 32 bit integers and store it interleaved into the frames.
+    // The samples are clipped to the range of -1..1, a larger value would overflow.
+    static void convert(const float* in, Frame* frames, uint8_t ch) {
+      // The largest float below 1.0, it scales to INT32_MAX - 127.
+      constexpr float max   = 1.f - 1.f / (float)(1 << 24);
+      constexpr float scale = 2147483648.f;
+
+      for (uint32_t i = 0; i < _nSamples; i += 4) {
+        const float a = std::clamp(in[i + 0], -1.f, max);
+        const float b = std::clamp(in[i + 1], -1.f, max);
+        const float c = std::clamp(in[i + 2], -1.f, max);
+        const float d = std::clamp(in[i + 3], -1.f, max);
+
+        frames[i + 0].channels[ch] = (int32_t)(a * scale);
+        frames[i + 1].channels[ch] = (int32_t)(b * scale);
+        frames[i + 2].channels[ch] = (int32_t)(c * scale);
+        frames[i + 3].channels[ch] = (int32_t)(d * scale);
+      }
+    }
 
   private:
+    // The maximum deviation of the reference clock, about 17 cents.
+    static constexpr float _maxDrift = 0.01f;
+
     bool _running{};
 
+    struct {
+      uint32_t start;
+      uint32_t usec;
+      uint32_t count;
+    } _reference{};
+
+    // Cubic interpolation of the source samples at the fractional positions of the
+    // output samples. The source samples not consumed by this block are kept for
+    // the next one.
+    struct {
+      bool  enabled;
+      float ratio{1};
+      float phase;
+
+      struct {
+        float    samples[_nSamples + (uint32_t)(_nSamples * _maxDrift) + 8];
+        uint32_t count;
+      } channels[nChannels];
+    } _resampler{};
+
+    void resample(uint8_t ch) {
+      auto* channel = &_resampler.channels[ch];
+
+      // The four points around the last output sample.
+      const uint32_t needed = (uint32_t)(_resampler.phase + (_nSamples - 1) * _resampler.ratio) + 4;
+      if (channel->count < needed) {
+        _channels[ch]->fill(channel->samples + channel->count, needed - channel->count);
+        channel->count = needed;
+      }
+
+      for (uint32_t i = 0; i < _nSamples; i++) {
+        const float    position = _resampler.phase + i * _resampler.ratio;
+        const uint32_t index    = (uint32_t)position;
+        const float    f        = position - (float)index;
+        const float*   x        = channel->samples + index;
+
+        // Catmull-Rom spline between x[1] and x[2].
+        _block[i] = x[1] + 0.5f * f * (x[2] - x[0] + f * (2.f * x[0] - 5.f * x[1] + 4.f * x[2] - x[3] + f * (3.f * (x[1] - x[2]) + x[3] - x[0])));
+      }
+    }
+
+    // The source address of the active descriptor points to the end of its buffer.
+    bool isStreaming(uint8_t index) {
+      const DmacDescriptor* wrb = &((DmacDescriptor*)DMAC->WRBADDR.reg)[_dma.getChannel()];
+      return wrb->SRCADDR.reg == (uint32_t)(_buffers[index].samples + _nSamples);
+    }
+
     // Cent-adjusted samplerate of the codec.
     float _frequency{};
 
-    // Double-buffer of sample data, streamed by the DMA engine.
+    // The buffers of sample data, streamed by the DMA engine.
     struct {
-      struct {
-        int32_t channels[nChannels];
-      } samples[_nSamples];
-    } _buffers[2]{};
+      Frame samples[_nSamples];
+    } _buffers[nBuffers]{};
 
     // Currently used buffer.
     uint8_t _index{};
 
+    // The samples of one channel, rendered in one call.
+    float _block[_nSamples]{};
+
     // Registered callbacks to provide samples.
     Channel* _channels[nChannels]{};
     bool     _enabled[nChannels]{};
 
     Adafruit_ZeroDMA _dma;
 
+    // Double-buffer of received sample data.
+    struct {
+      struct {
+        Frame frames[_nSamples];
+      } buffers[2]{};
+
+      uint8_t          index{};
+      bool             running{};
+      Input*           consumer{};
+      Adafruit_ZeroDMA dma;
+    } _input;
+
     // Runtime of sample interrupt.
     uint32_t _runUsec{};
   };
+
+  using Codec = BasicCodec<>;
 };
@@ -1,4 +1,6 @@
 #pragma once
+#include <cmath>
+#include <cstdint>
 
 namespace V2Audio {
   class Fader {
@@ -39,6 +41,43 @@ namespace V2Audio {
       _delta = range / steps;
     }
 
+    // No fade is active, the value does not change with step().
+    bool isSteady() const {
+      return !_adjusting;
+    }
+
+    // Write the values of the next 'n' steps into 'out' and advance the fader; the
+    // same values as calling get() and step() 'n' times.
+    void render(float* out, uint32_t n) {
+      if (!_adjusting || _delta == 0.f) {
+        for (uint32_t i = 0; i < n; i++)
+          out[i] = _now;
+        return;
+      }
+
+      const float distance = _target - _now;
+      const float delta    = copysignf(_delta, distance);
+      const float steps    = fabsf(distance / _delta);
+      if (steps >= (float)n) {
+        for (uint32_t i = 0; i < n; i++)
+          out[i] = _now + delta * (float)i;
+
+        _now += delta * (float)n;
+        return;
+      }
+
+      // The target is reached within the block.
+      const uint32_t ramp = (uint32_t)steps + 1;
+      for (uint32_t i = 0; i < ramp; i++)
+        out[i] = _now + delta * (float)i;
+
+      for (uint32_t i = ramp; i < n; i++)
+        out[i] = _target;
+
+      _now       = _target;
+      _adjusting = false;
+    }
+
     // Adjust the current value one delta towards the target value. Return if an adjustment was made.
     bool step() {
       if (!_adjusting)
@@ -44,6 +44,11 @@ namespace V2Audio {
       _increment.set(1.f / nSamples);
     }
 
+    // The phase advance per sample, the frequency as a fraction of the clock.
+    float getIncrement() const {
+      return _increment;
+    }
+
     bool step() {
       bool wrap{};
 
@@ -0,0 +1,236 @@
+#pragma once
+#include "Codec.h"
+#include "Fader.h"
+#include <V2Music.h>
+#include <algorithm>
+#include <type_traits>
+
+namespace V2Audio {
+  // A sound generator played by the VoicePool. It renders the raw signal, the
+  // pool applies the envelope.
+  class Voice {
+  public:
+    // Start a new note; called with the interrupts disabled.
+    virtual void handleStart(uint8_t note, uint8_t velocity) = 0;
+
+    // Render a block of samples, called from the codec interrupt.
+    virtual void fill(float* out, uint32_t n) = 0;
+  };
+
+  // A fixed number of voices, mixed into one codec channel. Every voice has its
+  // own amplitude envelope; only the sounding voices are rendered. If all voices
+  // are in use, a released voice is reused first, otherwise the oldest or the
+  // quietest one is stolen.
+  //
+  // noteOn() / noteOff() are called from the main loop, they briefly disable the
+  // interrupts to update the voices.
+  template <class T, uint8_t N> class VoicePool : public CodecBase::Channel {
+  public:
+    static_assert(std::is_base_of_v<Voice, T>);
+
+    enum class Steal { Oldest, Quietest };
+
+    void reset() {
+      noInterrupts();
+      for (uint8_t i = 0; i < N; i++) {
+        _states[i].active = false;
+        _states[i].held   = false;
+        _states[i].level.set(0);
+      }
+
+      _playing.reset();
+      _sequence = 0;
+      interrupts();
+    }
+
+    void setSteal(Steal steal) {
+      _steal = steal;
+    }
+
+    // The attack and release durations of the envelope.
+    void setEnvelope(float samplerate, float attackSec, float releaseSec) {
+      _envelope.attack  = std::max(attackSec * samplerate, 1.f);
+      _envelope.release = std::max(releaseSec * samplerate, 1.f);
+    }
+
+    // The level of a voice with the maximum velocity.
+    void setGain(float gain) {
+      _gain = gain;
+    }
+
+    T* getVoice(uint8_t index) {
+      return &_voices[index];
+    }
+
+    // The number of sounding voices, including the released ones.
+    uint8_t count() const {
+      uint8_t n = 0;
+      for (uint8_t i = 0; i < N; i++)
+        if (_states[i].active)
+          n++;
+
+      return n;
+    }
+
+    // The most recently started note which is still held.
+    bool getLast(uint8_t& note, uint8_t& velocity) {
+      return _playing.getLast(note, velocity);
+    }
+
+    void noteOn(uint8_t note, uint8_t velocity) {
+      if (velocity == 0) {
+        noteOff(note);
+        return;
+      }
+
+      _playing.update(note, velocity);
+
+      noInterrupts();
+      const uint8_t index = allocate(note);
+      State* state        = &_states[index];
+
+      // The envelope continues from the current level of a reused voice.
+      state->active   = true;
+      state->held     = true;
+      state->note     = note;
+      state->sequence = ++_sequence;
+      state->level.setStepsRange(_envelope.attack, _gain);
+      state->level.setTarget(_gain * (float)velocity / 127.f);
+      _voices[index].handleStart(note, velocity);
+      interrupts();
+    }
+
+    void noteOff(uint8_t note) {
+      _playing.update(note, 0);
+
+      noInterrupts();
+      for (uint8_t i = 0; i < N; i++) {
+        State* state = &_states[i];
+        if (!state->active || !state->held || state->note != note)
+          continue;
+
+        state->held = false;
+        state->level.setStepsRange(_envelope.release, _gain);
+        state->level.setTarget(0);
+      }
+      interrupts();
+    }
+
+    void allNotesOff() {
+      for (uint8_t i = 0; i < N; i++)
+        if (_states[i].active && _states[i].held)
+          noteOff(_states[i].note);
+    }
+
+    // Mix the active voices into the block.
+    void fill(float* out, uint32_t n) override {
+      for (uint32_t i = 0; i < n; i++)
+        out[i] = 0;
+
+      for (uint8_t v = 0; v < N; v++) {
+        State* state = &_states[v];
+        if (!state->active)
+          continue;
+
+        for (uint32_t offset = 0; offset < n; offset += _nBlock) {
+          const uint32_t count = std::min(n - offset, (uint32_t)_nBlock);
+          _voices[v].fill(_block, count);
+
+          if (state->level.isSteady()) {
+            const float level = state->level;
+            for (uint32_t i = 0; i < count; i++)
+              out[offset + i] += _block[i] * level;
+
+          } else {
+            state->level.render(_ramp, count);
+            for (uint32_t i = 0; i < count; i++)
+              out[offset + i] += _block[i] * _ramp[i];
+          }
+        }
+
+        // The release has finished.
+        if (!state->held && state->level <= 0.f)
+          state->active = false;
+      }
+    }
+
+    float getSample() override {
+      float sample;
+      fill(&sample, 1);
+      return sample;
+    }
+
+  private:
+    static constexpr uint8_t _nBlock = 64;
+
+    T _voices[N]{};
+
+    struct State {
+      bool     active;
+      bool     held;
+      uint8_t  note;
+      uint32_t sequence;
+      Fader    level;
+    } _states[N]{};
+
+    // The held notes; every note is listed once.
+    V2Music::Playing<128> _playing;
+
+    uint32_t _sequence{};
+    Steal    _steal{Steal::Oldest};
+    float    _gain{1};
+
+    // The durations in samples.
+    struct {
+      float attack{1};
+      float release{1};
+    } _envelope;
+
+    float _block[_nBlock]{};
+    float _ramp[_nBlock]{};
+
+    // The voice playing the same note, an idle voice, a released voice, or the
+    // voice to steal.
+    uint8_t allocate(uint8_t note) {
+      for (uint8_t i = 0; i < N; i++)
+        if (_states[i].active && _states[i].note == note)
+          return i;
+
+      for (uint8_t i = 0; i < N; i++)
+        if (!_states[i].active)
+          return i;
+
+      uint8_t index    = 0;
+      bool    released = false;
+      for (uint8_t i = 0; i < N; i++) {
+        const State* state = &_states[i];
+
+        // Prefer the quietest of the released voices.
+        if (!state->held) {
+          if (!released || state->level < _states[index].level)
+            index = i;
+
+          released = true;
+          continue;
+        }
+
+        if (released)
+          continue;
+
+        switch (_steal) {
+          case Steal::Oldest:
+            if ((int32_t)(state->sequence - _states[index].sequence) < 0)
+              index = i;
+            break;
+
+          case Steal::Quietest:
+            if (state->level < _states[index].level)
+              index = i;
+            break;
+        }
+      }
+
+      return index;
+    }
+  };
+};
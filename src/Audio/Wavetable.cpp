@@ -0,0 +1,68 @@
+#include "Wavetable.h"
+#include <cmath>
+
+static constexpr uint16_t nSamples{V2Audio::Wavetable::nSamples};
+static constexpr uint8_t  nLevels{V2Audio::Wavetable::nLevels};
+
+static float _sine[nSamples + 1];
+static float _saw[nLevels][nSamples + 1];
+static float _square[nLevels][nSamples + 1];
+
+// Sum the harmonics up to 'count'; the odd ones only for the square wave. The
+// partials are read from the sine table, the index wraps around at the end.
+static void generate(float* table, uint16_t count, bool square) {
+  float peak = 0;
+  for (uint16_t i = 0; i < nSamples; i++) {
+    float sample = 0;
+    for (uint16_t h = 1; h <= count; h++) {
+      if (square) {
+        if (h % 2 == 0)
+          continue;
+
+        sample += _sine[(h * i) % nSamples] / (float)h;
+
+      } else
+        sample += (h % 2 == 0 ? -1.f : 1.f) * _sine[(h * i) % nSamples] / (float)h;
+    }
+
+    table[i] = sample;
+    if (fabsf(sample) > peak)
+      peak = fabsf(sample);
+  }
+
+  // Remove the overshoot at the discontinuity.
+  for (uint16_t i = 0; i < nSamples; i++)
+    table[i] /= peak;
+
+  table[nSamples] = table[0];
+}
+
+void V2Audio::Wavetable::begin() {
+  static bool generated{};
+  if (generated)
+    return;
+
+  for (uint16_t i = 0; i < nSamples; i++)
+    _sine[i] = sinf(2.f * (float)M_PI * (float)i / (float)nSamples);
+  _sine[nSamples] = _sine[0];
+
+  for (uint8_t level = 0; level < nLevels; level++) {
+    const uint16_t count = (nSamples / 2) >> level;
+    generate(_saw[level], count, false);
+    generate(_square[level], count, true);
+  }
+
+  generated = true;
+}
+
+const float* V2Audio::Wavetable::getTable(float increment) const {
+  if (_shape == Shape::Sine)
+    return _sine;
+
+  // The highest harmonic needs to stay below half of the samplerate.
+  uint8_t level = 0;
+  while (level < nLevels - 1 && (float)((nSamples / 2) >> level) * increment > 0.5f)
+    level++;
+
+  return _shape == Shape::Saw ? _saw[level] : _square[level];
+}
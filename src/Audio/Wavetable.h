@@ -0,0 +1,72 @@
+#pragma once
+#include "Phasor.h"
+#include <cstdint>
+
+namespace V2Audio {
+  // Table-lookup oscillator driven by a Phasor, with linear interpolation between
+  // the table samples. The saw and square tables are band-limited; there is one
+  // table per octave, the table for the current frequency contains only the
+  // harmonics below the Nyquist frequency.
+  //
+  // The tables are shared by all oscillators and need to be generated once with
+  // begin().
+  class Wavetable {
+  public:
+    enum class Shape { Sine, Saw, Square };
+
+    // The number of samples in a table; it holds up to half as many harmonics.
+    static constexpr uint16_t nSamples = 256;
+
+    // The number of band-limited tables, the first one contains 128 harmonics,
+    // every following one half of the previous one.
+    static constexpr uint8_t nLevels = 8;
+
+    static void begin();
+
+    constexpr Wavetable(Shape shape = Shape::Sine) : _shape(shape) {}
+
+    void setShape(Shape shape) {
+      _shape = shape;
+    }
+
+    // The sample at the given phase, for a phase increment of 'increment'.
+    float get(float phase, float increment) const {
+      return lookup(getTable(increment), phase);
+    }
+
+    // Render a block of samples and advance the phasor.
+    void fill(Phasor* phasor, float* out, uint32_t n, float gain = 1) const {
+      const float* table = getTable(phasor->getIncrement());
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = lookup(table, phasor->get()) * gain;
+        phasor->step();
+      }
+    }
+
+    // Add a block of samples to 'out' and advance the phasor; to sum partials or voices.
+    void mix(Phasor* phasor, float* out, uint32_t n, float gain = 1) const {
+      const float* table = getTable(phasor->getIncrement());
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] += lookup(table, phasor->get()) * gain;
+        phasor->step();
+      }
+    }
+
+  private:
+    Shape _shape;
+
+    // The table for the given phase increment, the frequency as a fraction of the
+    // samplerate. The lookup is done once per block.
+    const float* getTable(float increment) const;
+
+    // Every table carries a copy of its first sample at the end.
+    static float lookup(const float* table, float phase) {
+      const float    position = phase * nSamples;
+      const uint32_t index    = (uint32_t)position;
+      const float    fraction = position - (float)index;
+      const float    a        = table[index % nSamples];
+      const float    b        = table[(index % nSamples) + 1];
+      return a + (b - a) * fraction;
+    }
+  };
+};
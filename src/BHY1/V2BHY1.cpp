@@ -1,4 +1,5 @@
 #include "V2BHY1.h"
+#include <Adafruit_ZeroDMA.h>
 
 extern "C" {
 #include "bhy/bhy_firmware.h"
@@ -17,12 +18,37 @@ namespace {
     bhy_data_vector_t     gravity;
     bhy_data_vector_t     gyroscope;
 
+    // The time of the sensor, the timestamp packets precede the data packets.
+    uint32_t timestamp;
+
+    // The recent raw values of every virtual sensor, w x y z or x y z.
+    static constexpr uint8_t nSamples{8};
+    struct {
+      struct {
+        uint32_t timestamp;
+        int16_t  values[4];
+      } samples[nSamples];
+      uint8_t next;
+      uint8_t count;
+    } rings[(uint8_t)V2BHY1::Source::_count];
+
     auto reset() {
       state     = {};
       rotation  = {.w{std::numeric_limits<decltype(bhy_data_quaternion_t::w)>::max() / 2}};
       game      = {.w{std::numeric_limits<decltype(bhy_data_quaternion_t::w)>::max() / 2}};
       gravity   = {};
       gyroscope = {};
+      timestamp = 0;
+      for (auto& ring : rings)
+        ring = {};
+    }
+
+    auto record(V2BHY1::Source source, int16_t a, int16_t b, int16_t c, int16_t d = 0) {
+      auto* ring                   = &rings[(uint8_t)source];
+      ring->samples[ring->next]    = {.timestamp{timestamp}, .values{a, b, c, d}};
+      ring->next                   = (ring->next + 1) % nSamples;
+      if (ring->count < nSamples)
+        ring->count++;
     }
   } Sensor;
 
@@ -30,22 +56,165 @@ namespace {
     switch (sensor_id) {
       case VS_ID_ROTATION_VECTOR_WAKEUP:
         Sensor.rotation = data->data_quaternion;
+        Sensor.record(V2BHY1::Source::Rotation, Sensor.rotation.w, Sensor.rotation.x, Sensor.rotation.y, Sensor.rotation.z);
         break;
 
       case VS_ID_GAME_ROTATION_VECTOR_WAKEUP:
         Sensor.game = data->data_quaternion;
+        Sensor.record(V2BHY1::Source::GameRotation, Sensor.game.w, Sensor.game.x, Sensor.game.y, Sensor.game.z);
         break;
 
       case VS_ID_GRAVITY_WAKEUP:
         Sensor.gravity = data->data_vector;
+        Sensor.record(V2BHY1::Source::Gravity, Sensor.gravity.x, Sensor.gravity.y, Sensor.gravity.z);
         break;
 
       case VS_ID_GYROSCOPE_WAKEUP:
         Sensor.gyroscope = data->data_vector;
+        Sensor.record(V2BHY1::Source::Gyroscope, Sensor.gyroscope.x, Sensor.gyroscope.y, Sensor.gyroscope.z);
         break;
     }
   }
 
+  auto timestampHandler(bhy_data_scalar_u16_t* data) {
+    bhy_update_system_timestamp(data, &Sensor.timestamp);
+  }
+
+  auto dmaCallback(Adafruit_ZeroDMA* dma) -> void;
+
+  // Read a register without waiting for the bus. The device address and the register
+  // are written from the SERCOM interrupt, a repeated start with the automatic length
+  // of the SERCOM reads the data with the DMA engine; the SERCOM sends the NACK and
+  // the stop condition after the last byte.
+  class Bus {
+  public:
+    enum class State { Idle, Busy, Done, Error };
+
+    auto begin(Sercom* regs, uint8_t trigger) {
+      _regs = regs;
+
+      _dma.setTrigger(trigger);
+      _dma.setAction(DMA_TRIGGER_ACTON_BEAT);
+      _dma.allocate();
+      _descriptor = _dma.addDescriptor((void*)&_regs->I2CM.DATA.reg, NULL, 0, DMA_BEAT_SIZE_BYTE, false, true);
+      _dma.setCallback(dmaCallback);
+
+      static Sercom* const sercoms[]{
+        SERCOM0,
+        SERCOM1,
+        SERCOM2,
+        SERCOM3,
+        SERCOM4,
+        SERCOM5,
+#if defined(SERCOM6)
+        SERCOM6,
+#endif
+#if defined(SERCOM7)
+        SERCOM7,
+#endif
+      };
+
+      // Four interrupt lines per SERCOM, MB, SB, RXS and ERROR.
+      for (uint8_t i = 0; i < sizeof(sercoms) / sizeof(sercoms[0]); i++) {
+        if (sercoms[i] != _regs)
+          continue;
+
+        for (uint8_t j = 0; j < 4; j++)
+          NVIC_EnableIRQ((IRQn_Type)(SERCOM0_0_IRQn + (i * 4) + j));
+      }
+
+      _state = State::Idle;
+    }
+
+    auto isAvailable() const -> bool {
+      return _regs;
+    }
+
+    auto getState() const -> State {
+      return _state;
+    }
+
+    // Start the transfer; returns false if the bus is not idle.
+    auto read(uint8_t reg, uint8_t* data, uint8_t size) -> bool {
+      if (_state == State::Busy)
+        return false;
+
+      if (_regs->I2CM.STATUS.bit.BUSSTATE != 1)
+        return false;
+
+      _reg   = reg;
+      _data  = data;
+      _size  = size;
+      _step  = Step::Address;
+      _state = State::Busy;
+
+      _regs->I2CM.INTFLAG.reg  = SERCOM_I2CM_INTFLAG_MASK;
+      _regs->I2CM.INTENSET.reg = SERCOM_I2CM_INTENSET_MB | SERCOM_I2CM_INTENSET_SB | SERCOM_I2CM_INTENSET_ERROR;
+      _regs->I2CM.ADDR.reg     = SERCOM_I2CM_ADDR_ADDR(BHY_I2C_ADDR1 << 1);
+      return true;
+    }
+
+    auto handleInterrupt() -> void {
+      const uint8_t flags     = _regs->I2CM.INTFLAG.reg;
+      _regs->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+
+      if ((flags & SERCOM_I2CM_INTFLAG_ERROR) || (_step != Step::Read && _regs->I2CM.STATUS.bit.RXNACK)) {
+        _dma.abort();
+        _regs->I2CM.CTRLB.bit.CMD = 3;
+        finish(State::Error);
+        return;
+      }
+
+      if (!(flags & SERCOM_I2CM_INTFLAG_MB))
+        return;
+
+      switch (_step) {
+        case Step::Address:
+          _step                = Step::Register;
+          _regs->I2CM.DATA.reg = _reg;
+          break;
+
+        case Step::Register:
+          // The DMA engine reads the data, only the errors raise an interrupt.
+          _step                    = Step::Read;
+          _regs->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB;
+          _dma.changeDescriptor(_descriptor, (void*)&_regs->I2CM.DATA.reg, _data, _size);
+          _dma.startJob();
+          _regs->I2CM.ADDR.reg =
+            SERCOM_I2CM_ADDR_ADDR((BHY_I2C_ADDR1 << 1) | 1) | SERCOM_I2CM_ADDR_LENEN | SERCOM_I2CM_ADDR_LEN(_size);
+          break;
+
+        case Step::Read:
+          break;
+      }
+    }
+
+    // Release the bus to the blocking Wire functions.
+    auto finish(State state) -> void {
+      _regs->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MASK;
+      _state                   = state;
+    }
+
+    auto clear() -> void {
+      _state = State::Idle;
+    }
+
+  private:
+    enum class Step { Address, Register, Read };
+    Sercom*          _regs{};
+    Adafruit_ZeroDMA _dma;
+    DmacDescriptor*  _descriptor{};
+    volatile State   _state{};
+    volatile Step    _step{};
+    uint8_t          _reg{};
+    uint8_t*         _data{};
+    uint8_t          _size{};
+  } Bus;
+
+  auto dmaCallback(Adafruit_ZeroDMA* dma) -> void {
+    Bus.finish(Bus::State::Done);
+  }
+
   class {
   public:
     volatile bool pending;
@@ -54,6 +223,7 @@ namespace {
       pending          = false;
       _bytes_left      = 0;
       _bytes_remaining = 0;
+      _transfer        = {};
     }
 
     auto hasData() const -> bool {
@@ -64,6 +234,107 @@ namespace {
       pending = false;
 
       bhy_read_fifo(_data + _bytes_left, sizeof(_data) - _bytes_left, &_bytes_read, &_bytes_remaining);
+      parse();
+    }
+
+    // The steps of bhy_read_fifo() with the asynchronous bus; the number of bytes
+    // in the FIFO, then the data, in chunks of the size of the buffer.
+    auto processTransfer() {
+      switch (Bus.getState()) {
+        case Bus::State::Busy:
+          return;
+
+        case Bus::State::Error:
+          Bus.clear();
+          _bytes_left = 0;
+          _transfer   = {};
+          pending     = true;
+          return;
+
+        case Bus::State::Done:
+          Bus.clear();
+          if (_transfer.step == Step::Remaining) {
+            _transfer.size = _transfer.remaining[0] | (_transfer.remaining[1] << 8);
+            if (_transfer.size == 0) {
+              _transfer = {};
+              return;
+            }
+
+            _bytes_remaining = _transfer.size;
+            _transfer.step   = Step::Idle;
+            readChunk();
+            return;
+          }
+
+          _transfer.index += _bytes_read;
+          _bytes_remaining = _transfer.size - _transfer.index;
+          if (_bytes_remaining == 0)
+            _transfer = {};
+
+          else
+            _transfer.step = Step::Idle;
+
+          parse();
+          return;
+
+        case Bus::State::Idle:
+          if (_bytes_remaining > 0) {
+            readChunk();
+            return;
+          }
+
+          if (!pending)
+            return;
+
+          if (!Bus.read(BHY_I2C_REG_BYTES_REMAINING_LSB_ADDR, _transfer.remaining, 2))
+            return;
+
+          pending        = false;
+          _transfer.step = Step::Remaining;
+          return;
+      }
+    }
+
+  private:
+    enum class Step { Idle, Remaining, Data };
+    uint8_t            _data[300]{};
+    uint8_t*           _pos{};
+    uint8_t            _bytes_left{};
+    uint16_t           _bytes_remaining{};
+    uint16_t           _bytes_read{};
+    bhy_data_generic_t _packet{};
+    bhy_data_type_t    _packet_type{};
+
+    struct {
+      Step     step;
+      uint8_t  remaining[2];
+      uint16_t size;
+      uint16_t index;
+    } _transfer{};
+
+    // Do not turn the last page of the FIFO buffer registers.
+    auto readChunk() -> void {
+      uint16_t space = sizeof(_data) - _bytes_left;
+      if (space > UINT8_MAX)
+        space = UINT8_MAX;
+
+      const uint16_t left = _transfer.size - _transfer.index;
+      if (space >= left)
+        _bytes_read = left;
+
+      else if (left - space <= BHY_I2C_REG_BUFFER_LENGTH)
+        _bytes_read = left - (BHY_I2C_REG_BUFFER_LENGTH + 1);
+
+      else
+        _bytes_read = space;
+
+      if (!Bus.read(_transfer.index % BHY_I2C_REG_BUFFER_LENGTH, _data + _bytes_left, _bytes_read))
+        return;
+
+      _transfer.step = Step::Data;
+    }
+
+    auto parse() -> void {
       _bytes_read += _bytes_left;
       _pos         = _data;
       _packet_type = BHY_DATA_TYPE_PADDING;
@@ -83,15 +354,6 @@ namespace {
       while (_bytes_left < _bytes_read)
         _data[_bytes_left++] = *(_pos++);
     }
-
-  private:
-    uint8_t            _data[300]{};
-    uint8_t*           _pos{};
-    uint8_t            _bytes_left{};
-    uint16_t           _bytes_remaining{};
-    uint16_t           _bytes_read{};
-    bhy_data_generic_t _packet{};
-    bhy_data_type_t    _packet_type{};
   } FIFO;
 
   static auto fifoInterruptHandler(void) {
@@ -108,10 +370,17 @@ namespace {
 
 auto V2BHY1::begin() -> void {
   i2c = _i2c;
+  if (_sercom)
+    Bus.begin(_sercom, _trigger);
+
   attachInterrupt(_pin_interrupt, fifoInterruptHandler, RISING);
   reset();
 }
 
+auto V2BHY1::handleInterrupt() -> void {
+  Bus.handleInterrupt();
+}
+
 auto V2BHY1::reset() -> void {
   Sensor.reset();
 }
@@ -131,23 +400,33 @@ auto V2BHY1::loop() -> void {
       Sensor.state = Sensor::State::Setup;
       break;
 
-    case Sensor::State::Setup:
-      bhy_install_sensor_callback(VS_TYPE_ROTATION_VECTOR, VS_WAKEUP, fifoDataHandler);
-      bhy_enable_virtual_sensor(VS_TYPE_ROTATION_VECTOR, VS_WAKEUP, 100, 0, VS_FLUSH_NONE, 0, 0);
+    case Sensor::State::Setup: {
+      static constexpr bhy_virtual_sensor_t types[]{
+        VS_TYPE_ROTATION_VECTOR,
+        VS_TYPE_GAME_ROTATION_VECTOR,
+        VS_TYPE_GRAVITY,
+        VS_TYPE_GYROSCOPE,
+      };
 
-      bhy_install_sensor_callback(VS_TYPE_GAME_ROTATION_VECTOR, VS_WAKEUP, fifoDataHandler);
-      bhy_enable_virtual_sensor(VS_TYPE_GAME_ROTATION_VECTOR, VS_WAKEUP, 100, 0, VS_FLUSH_NONE, 0, 0);
+      bhy_install_timestamp_callback(VS_WAKEUP, timestampHandler);
 
-      bhy_install_sensor_callback(VS_TYPE_GRAVITY, VS_WAKEUP, fifoDataHandler);
-      bhy_enable_virtual_sensor(VS_TYPE_GRAVITY, VS_WAKEUP, 100, 0, VS_FLUSH_NONE, 0, 0);
+      for (uint8_t i = 0; i < (uint8_t)Source::_count; i++) {
+        if (_rates[i].hz == 0)
+          continue;
 
-      bhy_install_sensor_callback(VS_TYPE_GYROSCOPE, VS_WAKEUP, fifoDataHandler);
-      bhy_enable_virtual_sensor(VS_TYPE_GYROSCOPE, VS_WAKEUP, 100, 0, VS_FLUSH_NONE, 0, 0);
+        bhy_install_sensor_callback(types[i], VS_WAKEUP, fifoDataHandler);
+        bhy_enable_virtual_sensor(types[i], VS_WAKEUP, _rates[i].hz, _rates[i].latencyMsec, VS_FLUSH_NONE, 0, 0);
+      }
 
       Sensor.state = Sensor::State::Running;
-      break;
+    } break;
 
     case Sensor::State::Running:
+      if (Bus.isAvailable()) {
+        FIFO.processTransfer();
+        break;
+      }
+
       if (!FIFO.pending && !FIFO.hasData())
         return;
 
@@ -156,6 +435,31 @@ auto V2BHY1::loop() -> void {
   }
 }
 
+auto V2BHY1::getSampleCount(Source source) -> uint8_t {
+  return Sensor.rings[(uint8_t)source].count;
+}
+
+auto V2BHY1::getSample(Source source, uint8_t index) -> Sample {
+  const auto* ring = &Sensor.rings[(uint8_t)source];
+  if (index >= ring->count)
+    return {};
+
+  const auto& sample = ring->samples[(ring->next + Sensor.nSamples - 1 - index) % Sensor.nSamples];
+  switch (source) {
+    case Source::Rotation:
+    case Source::GameRotation:
+      return {.timestamp{sample.timestamp},
+              .quaternion{V23D::Quaternion(i16scale(sample.values[0], 2),
+                                           i16scale(sample.values[1], 2),
+                                           i16scale(sample.values[2], 2),
+                                           i16scale(sample.values[3], 2))}};
+
+    default:
+      return {.timestamp{sample.timestamp},
+              .vector{V23D::Vector3(i16scale(sample.values[0], 4), i16scale(sample.values[1], 4), i16scale(sample.values[2], 4))}};
+  }
+}
+
 auto V2BHY1::getRAMVersion() -> uint16_t {
   uint16_t version{};
   bhy_get_ram_version(&version);
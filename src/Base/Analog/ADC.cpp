@@ -1,4 +1,5 @@
 #include "ADC.h"
+#include <Adafruit_ZeroDMA.h>
 
 static Adc* const _adcs[] = ADC_INSTS;
 
@@ -7,18 +8,54 @@ static constexpr IRQn_Type _adcIRQS[ADC_INST_NUM] = {
   ADC1_1_IRQn,
 };
 
+// OVERRUN, WINMON interrupts.
+static constexpr IRQn_Type _adcWindowIRQS[ADC_INST_NUM] = {
+  ADC0_0_IRQn,
+  ADC1_0_IRQn,
+};
+
 static constexpr uint8_t _gclkIDs[ADC_INST_NUM] = {
   ADC0_GCLK_ID,
   ADC1_GCLK_ID,
 };
 
+static constexpr uint8_t _resultTriggers[ADC_INST_NUM] = {
+  ADC0_DMAC_ID_RESRDY,
+  ADC1_DMAC_ID_RESRDY,
+};
+
+static constexpr uint8_t _sequenceTriggers[ADC_INST_NUM] = {
+  ADC0_DMAC_ID_SEQ,
+  ADC1_DMAC_ID_SEQ,
+};
+
 static struct {
   bool     ready{};
   uint16_t mask{};
   uint8_t  current{};
   uint16_t results[16];
+  uint32_t sequences[16];
+
+  // The optional capture ring of a channel, indexed by the sequence number.
+  struct {
+    V2Base::Analog::ADC::Sample* samples;
+    uint16_t                     mask;
+  } captures[16];
 } _adcChannels[ADC_INST_NUM]{};
 
+// The AVGCTRL value for the number of samples, and the maximum of the result. The
+// accumulated samples are shifted to add one bit of resolution for every fourfold
+// oversampling.
+static uint32_t getAverageControl(uint8_t samples, uint16_t* max) {
+  uint8_t n = 0;
+  while (n < 4 && (2 << n) <= samples)
+    n++;
+
+  const uint8_t shift = n - n / 2;
+  *max                = (4095 << n) >> shift;
+  return ADC_AVGCTRL_SAMPLENUM(n) | ADC_AVGCTRL_ADJRES(shift);
+}
+
 static void ADCResultHandler(uint8_t id) {
   // Discard the first measurement after enabling the ADC or swiching the channel.
   if (!_adcChannels[id].ready) {
@@ -30,7 +67,16 @@ static void ADCResultHandler(uint8_t id) {
     return;
   }
 
-  _adcChannels[id].results[_adcChannels[id].current] = _adcs[id]->RESULT.reg;
+  const uint8_t  ch    = _adcChannels[id].current;
+  const uint16_t value = _adcs[id]->RESULT.reg;
+
+  _adcChannels[id].results[ch] = value;
+
+  auto* capture = &_adcChannels[id].captures[ch];
+  if (capture->samples)
+    capture->samples[_adcChannels[id].sequences[ch] & capture->mask] = {.usec = micros(), .value = value};
+
+  _adcChannels[id].sequences[ch]++;
 
   // Find the next channel to measure.
   for (;;) {
@@ -51,6 +97,51 @@ static void ADCResultHandler(uint8_t id) {
   _adcChannels[id].ready      = false;
 }
 
+// The DMA sequenced scan; the INPUTCTRL values are written to DSEQDATA, the
+// results are read into two alternating buffers.
+static struct {
+  Adafruit_ZeroDMA sequence;
+  Adafruit_ZeroDMA result;
+  uint32_t         inputs[16][2];
+  uint16_t         results[2][16];
+
+  // The averaging of the channels, written with the INPUTCTRL value.
+  uint8_t  samples[16];
+  uint16_t max[16];
+
+  // The position of the channel in the scan.
+  uint8_t index[16];
+
+  // The number of completed scans, an odd number has completed the first buffer.
+  volatile uint32_t count;
+} _adcScans[ADC_INST_NUM];
+
+static void ADCScanHandler(uint8_t id) {
+  _adcScans[id].count++;
+}
+
+// The window monitor, the handler is called once.
+static struct {
+  void (*handler)(void* context);
+  void* context;
+} _adcWindows[ADC_INST_NUM]{};
+
+static void ADCWindowHandler(uint8_t id) {
+  _adcs[id]->INTENCLR.reg = ADC_INTENCLR_WINMON;
+  _adcs[id]->INTFLAG.reg  = ADC_INTFLAG_WINMON;
+  if (_adcWindows[id].handler)
+    _adcWindows[id].handler(_adcWindows[id].context);
+}
+
+// WINMON interrupts.
+void ADC0_0_Handler() {
+  ADCWindowHandler(0);
+}
+
+void ADC1_0_Handler() {
+  ADCWindowHandler(1);
+}
+
 // RESRDY interrupts.
 void ADC0_1_Handler() {
   ADCResultHandler(0);
@@ -121,5 +212,179 @@ void V2Base::Analog::ADC::addChannel(uint8_t ch) {
 }
 
 float V2Base::Analog::ADC::readChannel(uint8_t ch) {
-  return (float)_adcChannels[_id].results[ch] / 4095.f;
+  return (float)_adcChannels[_id].results[ch] / (float)_max;
+}
+
+float V2Base::Analog::ADC::readChannel(uint8_t ch, uint32_t* sequence) {
+  // The value and its sequence number are updated from interrupt context.
+  __disable_irq();
+  const uint16_t value = _adcChannels[_id].results[ch];
+  *sequence            = _adcChannels[_id].sequences[ch];
+  __enable_irq();
+
+  return (float)value / (float)_max;
+}
+
+void V2Base::Analog::ADC::setCapture(uint8_t ch, Sample* samples, uint16_t count) {
+  __disable_irq();
+  _adcChannels[_id].captures[ch] = {.samples = samples, .mask = (uint16_t)(count - 1)};
+  __enable_irq();
+}
+
+uint16_t V2Base::Analog::ADC::readCapture(uint8_t ch, uint32_t* sequence, Sample* samples, uint16_t count) {
+  const auto* capture = &_adcChannels[_id].captures[ch];
+  if (!capture->samples)
+    return 0;
+
+  __disable_irq();
+  const uint32_t last = _adcChannels[_id].sequences[ch];
+  __enable_irq();
+
+  // Skip the overwritten samples, and the ones which do not fit.
+  uint32_t first = *sequence;
+  if (last - first > (uint32_t)capture->mask + 1)
+    first = last - capture->mask - 1;
+
+  if (last - first > count)
+    first = last - count;
+
+  uint16_t n = 0;
+  for (uint32_t i = first; i != last; i++)
+    samples[n++] = capture->samples[i & capture->mask];
+
+  *sequence = last;
+  return n;
+}
+
+void V2Base::Analog::ADC::setAveraging(uint8_t samples) {
+  _adc->AVGCTRL.reg = getAverageControl(samples, &_max);
+  while (_adc->SYNCBUSY.reg & ADC_SYNCBUSY_AVGCTRL)
+    ;
+
+  _adc->CTRLB.bit.RESSEL = samples > 1 ? ADC_CTRLB_RESSEL_16BIT_Val : ADC_CTRLB_RESSEL_12BIT_Val;
+  while (_adc->SYNCBUSY.bit.CTRLB)
+    ;
+}
+
+void V2Base::Analog::ADC::setAveraging(uint8_t ch, uint8_t samples) {
+  _adcScans[_id].samples[ch] = samples;
+}
+
+void V2Base::Analog::ADC::beginScan(uint16_t mask) {
+  auto* scan = &_adcScans[_id];
+
+  uint8_t n = 0;
+  for (uint8_t ch = 0; ch < 16; ch++) {
+    if (!(mask & (1 << ch)))
+      continue;
+
+    scan->index[ch]    = n;
+    scan->inputs[n][0] = ADC_INPUTCTRL_MUXNEG_GND | ADC_INPUTCTRL_MUXPOS(ch);
+    scan->inputs[n][1] = getAverageControl(scan->samples[ch], &scan->max[ch]);
+    n++;
+  }
+
+  if (n == 0)
+    return;
+
+  // The sequencer updates INPUTCTRL and AVGCTRL and starts the conversion after
+  // the DMA has written the values. The register is enable-protected.
+  _adc->CTRLA.bit.ENABLE = 0;
+  while (_adc->SYNCBUSY.bit.ENABLE)
+    ;
+
+  // The accumulated samples need the 16-bit result.
+  _adc->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_16BIT_Val;
+  while (_adc->SYNCBUSY.bit.CTRLB)
+    ;
+
+  _adc->DSEQCTRL.reg = ADC_DSEQCTRL_INPUTCTRL | ADC_DSEQCTRL_AVGCTRL | ADC_DSEQCTRL_AUTOSTART;
+
+  _adc->CTRLA.bit.ENABLE = 1;
+  while (_adc->SYNCBUSY.bit.ENABLE)
+    ;
+
+  // Every result buffer is a block, the interrupt at the end of the block counts
+  // the completed scans.
+  scan->result.setTrigger(_resultTriggers[_id]);
+  scan->result.setAction(DMA_TRIGGER_ACTON_BEAT);
+  scan->result.allocate();
+  for (uint8_t i = 0; i < 2; i++) {
+    DmacDescriptor* desc = scan->result.addDescriptor((void*)&_adc->RESULT.reg,
+                                                      scan->results[i],
+                                                      n,
+                                                      DMA_BEAT_SIZE_HWORD,
+                                                      false,
+                                                      true);
+    desc->BTCTRL.bit.BLOCKACT = DMA_BLOCK_ACTION_INT;
+  }
+
+  scan->result.loop(true);
+  if (_id == 0)
+    scan->result.setCallback([](Adafruit_ZeroDMA* dma) { ADCScanHandler(0); });
+
+  else
+    scan->result.setCallback([](Adafruit_ZeroDMA* dma) { ADCScanHandler(1); });
+
+  scan->sequence.setTrigger(_sequenceTriggers[_id]);
+  scan->sequence.setAction(DMA_TRIGGER_ACTON_BEAT);
+  scan->sequence.allocate();
+  scan->sequence.addDescriptor(scan->inputs, (void*)&_adc->DSEQDATA.reg, n * 2, DMA_BEAT_SIZE_WORD, true, false);
+  scan->sequence.loop(true);
+
+  // The first request of the sequencer starts the scan.
+  scan->result.startJob();
+  scan->sequence.startJob();
+}
+
+float V2Base::Analog::ADC::readScan(uint8_t ch) {
+  uint32_t sequence;
+  return readScan(ch, &sequence);
+}
+
+float V2Base::Analog::ADC::readScan(uint8_t ch, uint32_t* sequence) {
+  const auto*    scan  = &_adcScans[_id];
+  const uint32_t count = scan->count;
+  *sequence            = count;
+  if (count == 0)
+    return 0;
+
+  return (float)scan->results[(count - 1) & 1][scan->index[ch]] / (float)scan->max[ch];
+}
+
+uint32_t V2Base::Analog::ADC::getScanCount() {
+  return _adcScans[_id].count;
+}
+
+void V2Base::Analog::ADC::setWindow(float low, float high, void (*handler)(void* context), void* context) {
+  _adc->INTENCLR.reg = ADC_INTENCLR_WINMON;
+  _adcWindows[_id]   = {.handler = handler, .context = context};
+
+  _adc->WINLT.reg = low * (float)_max;
+  while (_adc->SYNCBUSY.bit.WINLT)
+    ;
+
+  _adc->WINUT.reg = high * (float)_max;
+  while (_adc->SYNCBUSY.bit.WINUT)
+    ;
+
+  // Match the results outside of the window.
+  _adc->CTRLB.bit.WINMODE = ADC_CTRLB_WINMODE_MODE4_Val;
+  while (_adc->SYNCBUSY.bit.CTRLB)
+    ;
+
+  // A brown-out needs to preempt the result interrupts.
+  NVIC_EnableIRQ(_adcWindowIRQS[_id]);
+  NVIC_SetPriority(_adcWindowIRQS[_id], 2);
+  _adc->INTFLAG.reg  = ADC_INTFLAG_WINMON;
+  _adc->INTENSET.reg = ADC_INTENSET_WINMON;
+}
+
+void V2Base::Analog::ADC::clearWindow() {
+  _adc->INTENCLR.reg = ADC_INTENCLR_WINMON;
+  _adc->INTFLAG.reg  = ADC_INTFLAG_WINMON;
+
+  _adc->CTRLB.bit.WINMODE = ADC_CTRLB_WINMODE_DISABLE_Val;
+  while (_adc->SYNCBUSY.bit.CTRLB)
+    ;
 }
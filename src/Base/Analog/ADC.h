@@ -4,6 +4,12 @@
 namespace V2Base::Analog {
   class ADC {
   public:
+    // A captured result of a channel, the raw value and the time of the conversion.
+    struct Sample {
+      uint32_t usec;
+      uint16_t value;
+    };
+
     constexpr ADC(uint8_t id) : _id{id} {}
 
     void begin();
@@ -30,9 +36,17 @@ namespace V2Base::Analog {
     // Switch ADC to a single channel and sample it contiuously.
     void sampleChannel(uint8_t ch);
 
+    // Accumulate 'samples' conversions into one result, a power of two up to 16.
+    // Every fourfold oversampling adds one bit of resolution, 16 samples deliver 14
+    // bits. The values are always normalized to 0..1.
+    void setAveraging(uint8_t samples);
+
+    // The averaging of a single channel in scan mode, set before beginScan().
+    void setAveraging(uint8_t ch, uint8_t samples);
+
     // Read the result of the selected channel.
     float read() {
-      return (float)_adc->RESULT.reg / 4095.f;
+      return (float)_adc->RESULT.reg / (float)_max;
     }
 
     // Add a channel to the list of channels to continuously read from interrupt context.
@@ -42,8 +56,51 @@ namespace V2Base::Analog {
     // Read the channel's stored value.
     float readChannel(uint8_t ch);
 
+    // The 'sequence' is incremented with every new result of the channel, it tells
+    // if the value has changed since the last read.
+    float readChannel(uint8_t ch, uint32_t* sequence);
+
+    // Record every result of the channel with its timestamp, in interrupt mode. The
+    // ring of 'count' samples needs to be a power of two. The raw values are
+    // normalized by getMaximum().
+    void setCapture(uint8_t ch, Sample* samples, uint16_t count);
+
+    // Copy the captured samples after 'sequence', oldest first, and advance it to
+    // the latest one. Samples which have been overwritten already are skipped.
+    // Returns the number of copied samples.
+    uint16_t readCapture(uint8_t ch, uint32_t* sequence, Sample* samples, uint16_t count);
+
+    // The raw value of the full scale for the current averaging.
+    uint16_t getMaximum() const {
+      return _max;
+    }
+
+    // Scan the channels of the 'mask' continuously with DMA sequencing. The DMA
+    // writes the INPUTCTRL value of the next channel and reads the result of the
+    // conversion, the CPU is not involved. The results of the completed scans are
+    // written into two alternating buffers. Not to be combined with addChannel().
+    void beginScan(uint16_t mask);
+
+    // Read the channel's value of the last completed scan.
+    float readScan(uint8_t ch);
+
+    // The 'sequence' is the number of the completed scan.
+    float readScan(uint8_t ch, uint32_t* sequence);
+
+    // The number of completed scans.
+    uint32_t getScanCount();
+
+    // Compare every result with the window in hardware, the values are normalized
+    // to 0..1. The handler is called from the interrupt when a result is outside of
+    // the window; it fires once, setWindow() re-arms it. The window monitor checks
+    // all conversions of the ADC, the channel needs to be sampled alone with
+    // sampleChannel().
+    void setWindow(float low, float high, void (*handler)(void* context), void* context);
+    void clearWindow();
+
   private:
-    uint8_t _id;
-    Adc*    _adc{};
+    uint8_t  _id;
+    Adc*     _adc{};
+    uint16_t _max{4095};
   };
 };
@@ -1,32 +1,67 @@
 #include "Random.h"
 
-static bool              _init{};
-static volatile uint32_t _data{};
+// The words written by the interrupt and taken by the main loop; the counters
+// run freely.
+static struct {
+  bool             init;
+  uint32_t         words[16];
+  volatile uint8_t write;
+  volatile uint8_t read;
+} _pool{};
+
+static constexpr uint8_t _poolSize{sizeof(_pool.words) / sizeof(_pool.words[0])};
 
 void TRNG_Handler() {
-  _data                     = TRNG->DATA.reg;
-  TRNG->INTFLAG.bit.DATARDY = 1;
-}
+  _pool.words[_pool.write % _poolSize] = TRNG->DATA.reg;
+  _pool.write                          = _pool.write + 1;
+  TRNG->INTFLAG.bit.DATARDY            = 1;
 
-uint32_t V2Base::Cryptography::Random::read() {
-  if (!_init) {
-    _init = true;
-    MCLK->APBCMASK.reg |= MCLK_APBCMASK_TRNG;
+  // Stop until a word is taken.
+  if ((uint8_t)(_pool.write - _pool.read) == _poolSize)
     TRNG->INTENCLR.reg = TRNG_INTENCLR_DATARDY;
-    TRNG->CTRLA.reg    = TRNG_CTRLA_ENABLE;
-    NVIC_SetPriority(TRNG_IRQn, 3);
-    NVIC_EnableIRQ(TRNG_IRQn);
-  }
+}
 
-  // Enable interrupt.
+void V2Base::Cryptography::Random::begin() {
+  if (_pool.init)
+    return;
+
+  _pool.init = true;
+  MCLK->APBCMASK.reg |= MCLK_APBCMASK_TRNG;
+  TRNG->INTENCLR.reg = TRNG_INTENCLR_DATARDY;
+  TRNG->CTRLA.reg    = TRNG_CTRLA_ENABLE;
+  NVIC_SetPriority(TRNG_IRQn, 3);
+  NVIC_EnableIRQ(TRNG_IRQn);
   TRNG->INTENSET.reg = TRNG_INTENSET_DATARDY;
+}
 
-  // Wait for new random data.
-  const uint32_t old = _data;
-  while (old == _data)
+uint32_t V2Base::Cryptography::Random::read() {
+  uint32_t value;
+  while (!tryRead(&value))
     ;
 
-  // Disable interrupt.
-  TRNG->INTENCLR.reg = TRNG_INTENCLR_DATARDY;
-  return _data;
+  return value;
+}
+
+bool V2Base::Cryptography::Random::tryRead(uint32_t* value) {
+  begin();
+
+  if (_pool.read == _pool.write)
+    return false;
+
+  *value     = _pool.words[_pool.read % _poolSize];
+  _pool.read = _pool.read + 1;
+
+  // Refill the pool.
+  TRNG->INTENSET.reg = TRNG_INTENSET_DATARDY;
+  return true;
+}
+
+void V2Base::Cryptography::Random::fill(uint8_t* buffer, uint32_t len) {
+  while (len > 0) {
+    const uint32_t value = read();
+    const uint32_t n     = len < 4 ? len : 4;
+    memcpy(buffer, &value, n);
+    buffer += n;
+    len -= n;
+  }
 }
@@ -2,8 +2,67 @@
 #include <Arduino.h>
 
 namespace V2Base::Cryptography {
+  // The hardware TRNG fills a small pool of words in the background; the words are
+  // read from the main loop. The interrupt stops while the pool is full.
   class Random {
   public:
+    // Start filling the pool; it is called by the first read.
+    static void begin();
+
+    // Wait for a word if the pool is empty.
     static uint32_t read();
+
+    // Returns false if the pool is empty.
+    static bool tryRead(uint32_t* value);
+
+    // Fill the buffer with random bytes, waits for the TRNG if the pool runs empty.
+    static void fill(uint8_t* buffer, uint32_t len);
+
+    // A fast pseudo-random number generator for non-cryptographic use, xoshiro128**,
+    // seeded from the TRNG.
+    class Fast {
+    public:
+      Fast() {
+        seed();
+      }
+
+      void seed() {
+        // The state must not be all zero.
+        do {
+          for (uint8_t i = 0; i < 4; i++)
+            _state[i] = Random::read();
+        } while ((_state[0] | _state[1] | _state[2] | _state[3]) == 0);
+      }
+
+      uint32_t read() {
+        const uint32_t result = rotate(_state[1] * 5, 7) * 9;
+        const uint32_t t      = _state[1] << 9;
+
+        _state[2] ^= _state[0];
+        _state[3] ^= _state[1];
+        _state[1] ^= _state[2];
+        _state[0] ^= _state[3];
+        _state[2] ^= t;
+        _state[3] = rotate(_state[3], 11);
+        return result;
+      }
+
+      // A value from 0 to range - 1.
+      uint32_t read(uint32_t range) {
+        return ((uint64_t)read() * range) >> 32;
+      }
+
+      // A value from 0 to 1, excluding 1.
+      float readFloat() {
+        return (float)(read() >> 8) * (1.f / 16777216.f);
+      }
+
+    private:
+      uint32_t _state[4];
+
+      static uint32_t rotate(uint32_t x, uint8_t n) {
+        return (x << n) | (x >> (32 - n));
+      }
+    };
   };
 };
@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include <initializer_list>
 #include <wiring_private.h>
 
 namespace V2Base {
@@ -15,6 +16,57 @@ namespace V2Base {
       _group->OUTCLR.reg = _mask;
     }
 
+    void toggle() {
+      _group->OUTTGL.reg = _mask;
+    }
+
+    // Several pins of the same PortGroup, they are all switched or read with a single
+    // register access. Pins of other groups than the one of the first pin are ignored.
+    class Group {
+    public:
+      constexpr Group(std::initializer_list<uint8_t> pins) : _group{getGroup(pins)}, _mask{getMask(pins)} {}
+
+      void high() {
+        _group->OUTSET.reg = _mask;
+      }
+
+      void low() {
+        _group->OUTCLR.reg = _mask;
+      }
+
+      void toggle() {
+        _group->OUTTGL.reg = _mask;
+      }
+
+      // The input state of the pins, in their bit positions of the PortGroup.
+      uint32_t read() const {
+        return _group->IN.reg & _mask;
+      }
+
+      uint32_t getMask() const {
+        return _mask;
+      }
+
+    private:
+      PortGroup* const _group{};
+      const uint32_t   _mask{};
+
+      static constexpr PortGroup* getGroup(std::initializer_list<uint8_t> pins) {
+        return &PORT->Group[g_APinDescription[*pins.begin()].ulPort];
+      }
+
+      static constexpr uint32_t getMask(std::initializer_list<uint8_t> pins) {
+        const uint8_t port = g_APinDescription[*pins.begin()].ulPort;
+        uint32_t      mask = 0;
+        for (const uint8_t pin : pins) {
+          if (g_APinDescription[pin].ulPort == port)
+            mask |= (uint32_t)1 << g_APinDescription[pin].ulPin;
+        }
+
+        return mask;
+      }
+    };
+
   private:
     PortGroup* const _group{};
     const uint32_t   _mask{};
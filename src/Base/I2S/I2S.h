@@ -5,14 +5,18 @@ namespace V2Base {
   class I2SInterface {
   public:
     // Append "Interface", CMSIS-Atmel messes with global "#define I2S".
-    constexpr I2SInterface(uint8_t pinSCK, uint8_t pinFS, uint8_t pinSD, uint8_t pinMCK) :
-      _pin{.sck{pinSCK}, .fs{pinFS}, .sd{pinSD}, .mck{pinMCK}} {}
+    // The optional 'pinSDIn' is connected to the second serializer, which receives
+    // the data from the codec; 0xff if there is no input.
+    constexpr I2SInterface(uint8_t pinSCK, uint8_t pinFS, uint8_t pinSD, uint8_t pinMCK, uint8_t pinSDIn = 0xff) :
+      _pin{.sck{pinSCK}, .fs{pinFS}, .sd{pinSD}, .mck{pinMCK}, .sdIn{pinSDIn}} {}
 
     void begin() {
       pinPeripheral(_pin.sck, PIO_I2S);
       pinPeripheral(_pin.fs, PIO_I2S);
       pinPeripheral(_pin.sd, PIO_I2S);
       pinPeripheral(_pin.mck, PIO_I2S);
+      if (hasInput())
+        pinPeripheral(_pin.sdIn, PIO_I2S);
 
       // Use the 48 Mhz generic clock.
       I2S->CTRLA.bit.ENABLE = 0;
@@ -63,6 +67,17 @@ namespace V2Base {
                         I2S_TXCTRL_SLOTADJ_LEFT |                         // Data Slot Formatting Adjust
                         I2S_TXCTRL_TXSAME_ZERO;                           // Transmit Data when Underrun
 
+      // The second serializer receives with the same clock and format.
+      if (hasInput())
+        I2S->RXCTRL.reg = I2S_RXCTRL_DMA_SINGLE |                           // Single DMA channel
+                          I2S_RXCTRL_MONO_STEREO |                          // Normal / Stereo input
+                          I2S_RXCTRL_BITREV_MSBIT |                         // Transfer Data MSB first
+                          I2S_RXCTRL_WORDADJ_LEFT |                         // Data is left adjusted in word
+                          I2S_RXCTRL_DATASIZE(I2S_RXCTRL_DATASIZE_32_Val) | // Data Word Size
+                          I2S_RXCTRL_SLOTADJ_LEFT |                         // Data Slot Formatting Adjust
+                          I2S_RXCTRL_CLKSEL_CLK0 |                          // Use the Clock Unit 0
+                          I2S_RXCTRL_SERMODE_RX;                            // Receive
+
       I2S->CTRLA.bit.ENABLE = 1;
       while (I2S->SYNCBUSY.bit.ENABLE)
         ;
@@ -74,6 +89,16 @@ namespace V2Base {
       I2S->CTRLA.bit.TXEN = 1;
       while (I2S->SYNCBUSY.bit.TXEN)
         ;
+
+      if (hasInput()) {
+        I2S->CTRLA.bit.RXEN = 1;
+        while (I2S->SYNCBUSY.bit.RXEN)
+          ;
+      }
+    }
+
+    constexpr bool hasInput() const {
+      return _pin.sdIn != 0xff;
     }
 
     constexpr float getSamplerate() const {
@@ -102,6 +127,7 @@ namespace V2Base {
       uint8_t fs;
       uint8_t sd;
       uint8_t mck;
+      uint8_t sdIn;
     } _pin;
     float _samplerate{};
   };
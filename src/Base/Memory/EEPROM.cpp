@@ -46,21 +46,79 @@ void V2Base::Memory::EEPROM::flush() {
     ;
 }
 
+bool V2Base::Memory::EEPROM::flushAsync() {
+  if (!NVMCTRL->STATUS.bit.READY)
+    return false;
+
+  NVMCTRL->CTRLB.reg = NVMCTRL_CTRLB_CMD_SEEFLUSH | NVMCTRL_CTRLB_CMDEX_KEY;
+  return true;
+}
+
+bool V2Base::Memory::EEPROM::isBusy() {
+  return !NVMCTRL->STATUS.bit.READY || NVMCTRL->SEESTAT.bit.BUSY;
+}
+
 void V2Base::Memory::EEPROM::write(uint32_t offset, const uint8_t* buffer, uint32_t size) {
   // The EEPROM expects 8, 16, 32 bit writes, memcpy() fails.
   prepareWrite();
 
-  uint8_t* data = (uint8_t*)getStart();
-  for (uint32_t i = 0; i < size; i++)
-    data[offset + i] = buffer[i];
+  volatile uint8_t* data = (volatile uint8_t*)getStart() + offset;
+  uint32_t          i    = 0;
+  for (; i < size && ((offset + i) & 3) != 0; i++)
+    data[i] = buffer[i];
+
+  for (; i + 4 <= size; i += 4) {
+    uint32_t word;
+    memcpy(&word, buffer + i, 4);
+    *(volatile uint32_t*)(data + i) = word;
+  }
+
+  for (; i < size; i++)
+    data[i] = buffer[i];
 
   flush();
 }
 
+bool V2Base::Memory::EEPROM::update(uint32_t offset, const uint8_t* buffer, uint32_t size) {
+  volatile uint8_t* data    = (volatile uint8_t*)getStart() + offset;
+  bool              changed = false;
+
+  for (uint32_t i = 0; i < size;) {
+    if (((offset + i) & 3) == 0 && i + 4 <= size) {
+      uint32_t word;
+      memcpy(&word, buffer + i, 4);
+      if (*(volatile uint32_t*)(data + i) != word) {
+        if (!changed) {
+          prepareWrite();
+          changed = true;
+        }
+
+        *(volatile uint32_t*)(data + i) = word;
+      }
+
+      i += 4;
+      continue;
+    }
+
+    if (data[i] != buffer[i]) {
+      if (!changed) {
+        prepareWrite();
+        changed = true;
+      }
+
+      data[i] = buffer[i];
+    }
+
+    i++;
+  }
+
+  return changed;
+}
+
 void V2Base::Memory::EEPROM::erase() {
-  uint8_t* data = (uint8_t*)getStart();
-  for (uint32_t i = 0; i < getSize(); i++)
-    data[i] = 0xff;
+  volatile uint32_t* data = (volatile uint32_t*)getStart();
+  for (uint32_t i = 0; i < getSize() / 4; i++)
+    data[i] = 0xffffffff;
 
   flush();
 }
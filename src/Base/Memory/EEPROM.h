@@ -25,8 +25,20 @@ namespace V2Base::Memory {
     // Flushes the buffered data (current page) to the flash.
     static void flush();
 
+    // Start the flush without waiting for it to complete. Returns false if the
+    // controller is busy, it needs to be called again.
+    static bool flushAsync();
+
+    // An operation, a prepared write or a flush, is still in progress.
+    static bool isBusy();
+
     static void write(uint32_t offset, const uint8_t* buffer, uint32_t size);
 
+    // Write only the data which differs from the current content, aligned data is
+    // written in 32 bit words. Returns false if nothing has changed. flush() needs
+    // to be called to write the data to the flash.
+    static bool update(uint32_t offset, const uint8_t* buffer, uint32_t size);
+
     // Overwrite the entire flash area with 0xff.
     static void erase();
   };
@@ -15,14 +15,17 @@ void V2Base::Memory::Firmware::calculateHash(uint32_t offset, uint32_t len, char
   V2Base::Cryptography::SHA1 sha;
   sha.init();
 
-  for (uint32_t i = 0; i < len; i++)
-    sha.update((uint8_t*)offset + i, 1);
+  // The complete 64 byte blocks are transformed directly from the flash.
+  sha.update((const uint8_t*)offset, len);
 
   uint8_t digest[20];
   sha.final(digest);
+  formatHash(digest, hash);
+}
 
+void V2Base::Memory::Firmware::formatHash(const uint8_t digest[20], char hash[41]) {
   for (uint8_t i = 0; i < 20; i++)
-    sprintf((char*)hash + (i * 2), "%02x", digest[i]);
+    sprintf(hash + (i * 2), "%02x", digest[i]);
 }
 
 void V2Base::Memory::Firmware::reboot() {
@@ -47,6 +50,15 @@ bool V2Base::Memory::Firmware::Secondary::verify(uint32_t firmwareLen, const cha
   return strcmp(hash, secondary) == 0;
 }
 
+bool V2Base::Memory::Firmware::Secondary::verify(const uint8_t digest[20], const char* hash) {
+  if (memcmp(NULL, (const uint8_t*)getStart(), Firmware::getStart()) != 0)
+    return false;
+
+  char secondary[41];
+  formatHash(digest, secondary);
+  return strcmp(hash, secondary) == 0;
+}
+
 void V2Base::Memory::Firmware::Secondary::copyBootloader() {
   for (uint32_t i = 0; i < Firmware::getStart(); i += Flash::getBlockSize()) {
     if (memcmp((const uint8_t*)i, (const uint8_t*)getStart() + i, Flash::getBlockSize()) == 0)
@@ -56,6 +68,15 @@ void V2Base::Memory::Firmware::Secondary::copyBootloader() {
   }
 }
 
+bool V2Base::Memory::Firmware::Secondary::beginWriteBlock(uint32_t offset, const uint32_t* data) {
+  const uint32_t start = getStart() + Firmware::getStart();
+  return Flash::beginWrite(start + offset, data, Flash::getBlockSize(), true);
+}
+
+bool V2Base::Memory::Firmware::Secondary::beginCopyBootloader() {
+  return Flash::beginWrite(getStart(), (const uint32_t*)0, Firmware::getStart(), true);
+}
+
 void V2Base::Memory::Firmware::Secondary::activate() {
   // Swap the flash banks, reallocate the EEPROM area, reset the system.
   while (!NVMCTRL->STATUS.bit.READY)
@@ -14,6 +14,9 @@ namespace V2Base::Memory {
     // Calculate the hash of the given memory area.
     static void calculateHash(uint32_t offset, uint32_t len, char hash[41]);
 
+    // The hexadecimal string of a SHA1 digest.
+    static void formatHash(const uint8_t digest[20], char hash[41]);
+
     static void reboot();
 
     class Secondary {
@@ -29,9 +32,17 @@ namespace V2Base::Memory {
       // Copy the current bootloader to the secondary flash bank.
       static void copyBootloader();
 
+      // Non-blocking variants, driven by Flash::poll(). Unchanged blocks are skipped.
+      static bool beginWriteBlock(uint32_t offset, const uint32_t* data);
+      static bool beginCopyBootloader();
+
       // Check if the bootloader is identical, and the secondary firmware matches the given hash.
       static bool verify(uint32_t firmwareLen, const char* hash);
 
+      // Check if the bootloader is identical, and the digest of the already hashed
+      // secondary firmware matches the given hash.
+      static bool verify(const uint8_t digest[20], const char* hash);
+
       // Swap the flash banks, reallocate the EEPROM area, reset the system.
       static void activate();
     };
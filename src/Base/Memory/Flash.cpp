@@ -43,6 +43,72 @@ void V2Base::Memory::Flash::writeBlock(uint32_t offset, const uint32_t* data) {
     ;
 }
 
+static struct {
+  bool            active;
+  bool            skipUnchanged;
+  bool            erased;
+  uint32_t        offset;
+  const uint32_t* data;
+  uint32_t        length;
+  uint32_t        position;
+} _write{};
+
+bool V2Base::Memory::Flash::beginWrite(uint32_t offset, const uint32_t* data, uint32_t length, bool skipUnchanged) {
+  if (_write.active)
+    return false;
+
+  _write = {
+    .active        = true,
+    .skipUnchanged = skipUnchanged,
+    .offset        = offset,
+    .data          = data,
+    .length        = length,
+  };
+  return true;
+}
+
+bool V2Base::Memory::Flash::poll() {
+  if (!_write.active)
+    return false;
+
+  if (!NVMCTRL->STATUS.bit.READY)
+    return true;
+
+  for (;;) {
+    if (_write.position == _write.length) {
+      _write.active = false;
+      return false;
+    }
+
+    const uint32_t  address = _write.offset + _write.position;
+    const uint32_t* source  = _write.data + (_write.position / sizeof(uint32_t));
+
+    // The start of a block, erase it.
+    if (!_write.erased) {
+      if (_write.skipUnchanged && memcmp((const uint8_t*)address, source, getBlockSize()) == 0) {
+        _write.position += getBlockSize();
+        continue;
+      }
+
+      NVMCTRL->ADDR.reg  = address;
+      NVMCTRL->CTRLB.reg = NVMCTRL_CTRLB_CMDEX_KEY | NVMCTRL_CTRLB_CMD_EB;
+      _write.erased      = true;
+      return true;
+    }
+
+    writePage(address, source);
+    _write.position += getPageSize();
+    if (_write.position % getBlockSize() == 0)
+      _write.erased = false;
+
+    return true;
+  }
+}
+
+bool V2Base::Memory::Flash::isDone() {
+  return !_write.active;
+}
+
 void V2Base::Memory::Flash::UserPage::read(uint32_t data[128]) {
   memcpy(data, (const void*)NVMCTRL_USER, 512);
 }
@@ -24,6 +24,20 @@ namespace V2Base::Memory {
     static void eraseBlock(uint32_t offset);
     static void writeBlock(uint32_t offset, const uint32_t* data);
 
+    // Non-blocking write of 'length' bytes, a multiple of the block size. Every
+    // poll() issues the next erase or page write as soon as the NVM controller is
+    // ready; the CPU continues to run from the other flash bank. The data needs to
+    // stay valid until the write is done. Blocks with unchanged content are skipped
+    // if requested. Returns false if a write is already in progress.
+    static bool beginWrite(uint32_t offset, const uint32_t* data, uint32_t length, bool skipUnchanged = false);
+    static bool beginWriteBlock(uint32_t offset, const uint32_t* data) {
+      return beginWrite(offset, data, getBlockSize());
+    }
+
+    // Returns true while the write is in progress.
+    static bool poll();
+    static bool isDone();
+
     // "The size of the NVM User Page is 512 Bytes. The first eight 32-bit words (32 Bytes)
     // of the Non Volatile Memory (NVM) User Page contain calibration data that are automatically
     // read at device power on. The remaining 480 Bytes can be used for storing custom parameters."
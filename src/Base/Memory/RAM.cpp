@@ -1,7 +1,37 @@
 #include "RAM.h"
+#include <malloc.h>
 
 extern "C" char* sbrk(int incr);
-uint32_t         V2Base::Memory::RAM::getFree() {
+
+// The end of the RAM, defined by the linker script.
+extern uint32_t __StackTop;
+
+static constexpr uint32_t _stackPattern{0xa5a5a5a5};
+
+uint32_t V2Base::Memory::RAM::getFree() {
   uint8_t top;
   return &top - reinterpret_cast<uint8_t*>(sbrk(0));
 }
+
+void V2Base::Memory::RAM::paintStack() {
+  uint8_t top;
+
+  // Leave space for the current frame.
+  uint32_t* end = reinterpret_cast<uint32_t*>((reinterpret_cast<uintptr_t>(&top) - 64) & ~3);
+  for (uint32_t* p = reinterpret_cast<uint32_t*>((reinterpret_cast<uintptr_t>(sbrk(0)) + 3) & ~3); p < end; p++)
+    *p = _stackPattern;
+}
+
+uint32_t V2Base::Memory::RAM::getStackHighWater() {
+  // The heap might have grown into the painted area.
+  const uint32_t* p = reinterpret_cast<uint32_t*>((reinterpret_cast<uintptr_t>(sbrk(0)) + 3) & ~3);
+  while (p < &__StackTop && *p == _stackPattern)
+    p++;
+
+  return reinterpret_cast<uintptr_t>(&__StackTop) - reinterpret_cast<uintptr_t>(p);
+}
+
+V2Base::Memory::RAM::Heap V2Base::Memory::RAM::getHeap() {
+  const struct mallinfo info = mallinfo();
+  return {.size = (uint32_t)info.arena, .used = (uint32_t)info.uordblks};
+}
@@ -4,9 +4,27 @@
 namespace V2Base::Memory {
   class RAM {
   public:
+    struct Heap {
+      // The memory taken from the system; it does not shrink, it is the peak size
+      // of the heap.
+      uint32_t size;
+
+      // The allocated bytes.
+      uint32_t used;
+    };
+
     static constexpr uint32_t getSize() {
       return HSRAM_SIZE;
     }
     static uint32_t getFree();
+
+    // Fill the free memory between the heap and the stack with a pattern, to
+    // measure the deepest use of the stack. Called early at startup.
+    static void paintStack();
+
+    // The maximum number of bytes used by the stack since paintStack().
+    static uint32_t getStackHighWater();
+
+    static Heap getHeap();
   };
 };
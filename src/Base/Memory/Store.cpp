@@ -0,0 +1,283 @@
+#include "Store.h"
+
+uint32_t V2Base::Memory::Store::getSequence(uint8_t block) const {
+  const Header* header = (const Header*)getBlockAddress(block);
+  return header->magic == _magic ? header->sequence : 0;
+}
+
+// A block without a header has no programmed pages.
+bool V2Base::Memory::Store::isErased(uint8_t block) const {
+  return *(const uint32_t*)getBlockAddress(block) == 0xffffffff;
+}
+
+uint8_t V2Base::Memory::Store::countErased() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < _blocks; i++) {
+    if (isErased(i))
+      n++;
+  }
+
+  return n;
+}
+
+// The not yet programmed records are read from the page buffer.
+const uint8_t* V2Base::Memory::Store::getData(uint32_t address) const {
+  if (_page.dirty && address >= _page.address && address < _page.address + Flash::getPageSize())
+    return (const uint8_t*)_page.buffer + (address - _page.address);
+
+  return (const uint8_t*)address;
+}
+
+// The address of the record at or after 'address', 0 if there is none before 'end'.
+// The records do not cross a page, the erased rest of a page is skipped.
+uint32_t V2Base::Memory::Store::findRecord(uint32_t address, uint32_t end) const {
+  while (address < end) {
+    const uint32_t page = address & ~(Flash::getPageSize() - 1);
+    if (address + sizeof(Record) <= page + Flash::getPageSize()) {
+      const Record* record = (const Record*)getData(address);
+      if (record->key != 0xffff)
+        return address;
+    }
+
+    address = page + Flash::getPageSize();
+  }
+
+  return 0;
+}
+
+uint32_t V2Base::Memory::Store::getRecordSize(const Record* record) {
+  if (record->length == 0xffff)
+    return sizeof(Record);
+
+  return sizeof(Record) + ((record->length + 3) & ~3);
+}
+
+void V2Base::Memory::Store::begin(uint32_t index[], uint16_t count) {
+  _index   = index;
+  _count   = count;
+  _compact = {};
+  memset(index, 0, count * sizeof(uint32_t));
+
+  // Erase the blocks which are not part of the log.
+  for (uint8_t i = 0; i < _blocks; i++) {
+    if (getSequence(i) > 0 || isErased(i))
+      continue;
+
+    Flash::eraseBlock(getBlockAddress(i));
+    while (!NVMCTRL->STATUS.bit.READY)
+      ;
+  }
+
+  // Replay the blocks in the order of their sequence, the later records replace
+  // the earlier ones.
+  uint32_t last = 0;
+  for (;;) {
+    uint8_t  block    = 0;
+    uint32_t sequence = 0;
+    for (uint8_t i = 0; i < _blocks; i++) {
+      const uint32_t s = getSequence(i);
+      if (s > last && (sequence == 0 || s < sequence)) {
+        block    = i;
+        sequence = s;
+      }
+    }
+
+    if (sequence == 0)
+      break;
+
+    last      = sequence;
+    _head     = block;
+    _sequence = sequence;
+
+    const uint32_t end     = getBlockAddress(block) + Flash::getBlockSize();
+    uint32_t       address = getBlockAddress(block) + sizeof(Header);
+    while ((address = findRecord(address, end)) > 0) {
+      const Record* record = (const Record*)address;
+      if (record->key < _count)
+        _index[record->key] = record->length == 0xffff ? 0 : address;
+
+      address += getRecordSize(record);
+    }
+  }
+
+  // Continue at the first unused page of the head block.
+  _page.address = 0;
+  if (_sequence > 0) {
+    for (uint32_t i = 0; i < Flash::getBlockSize(); i += Flash::getPageSize()) {
+      const uint32_t page = getBlockAddress(_head) + i;
+      if (*(const uint32_t*)page != 0xffffffff)
+        continue;
+
+      _page.address  = page;
+      _page.position = 0;
+      memset(_page.buffer, 0xff, sizeof(_page.buffer));
+      break;
+    }
+  }
+}
+
+int32_t V2Base::Memory::Store::read(uint16_t key, uint8_t data[], uint16_t size) {
+  if (key >= _count || _index[key] == 0)
+    return -1;
+
+  const Record* record = (const Record*)getData(_index[key]);
+  memcpy(data, (const uint8_t*)(record + 1), min(record->length, size));
+  return record->length;
+}
+
+bool V2Base::Memory::Store::write(uint16_t key, const uint8_t data[], uint16_t length) {
+  if (key >= _count || length > getMaxLength())
+    return false;
+
+  const uint32_t address = append(key, data, length);
+  if (address == 0)
+    return false;
+
+  _index[key] = address;
+  _statistics.written++;
+  return true;
+}
+
+bool V2Base::Memory::Store::remove(uint16_t key) {
+  if (key >= _count)
+    return false;
+
+  if (_index[key] == 0)
+    return true;
+
+  if (append(key, NULL, 0xffff) == 0)
+    return false;
+
+  _index[key] = 0;
+  return true;
+}
+
+void V2Base::Memory::Store::flush() {
+  if (!_page.dirty)
+    return;
+
+  Flash::writePage(_page.address, _page.buffer);
+  _page.dirty    = false;
+  _page.position = Flash::getPageSize();
+  _statistics.pages++;
+}
+
+void V2Base::Memory::Store::loop() {
+  if (!NVMCTRL->STATUS.bit.READY)
+    return;
+
+  if (!_compact.active) {
+    // Keep one erased block in reserve to open the next block.
+    if (countErased() > 1)
+      return;
+
+    uint8_t  block    = 0;
+    uint32_t sequence = 0;
+    for (uint8_t i = 0; i < _blocks; i++) {
+      const uint32_t s = getSequence(i);
+      if (s > 0 && i != _head && (sequence == 0 || s < sequence)) {
+        block    = i;
+        sequence = s;
+      }
+    }
+
+    if (sequence == 0)
+      return;
+
+    _compact = {.active = true, .block = block, .address = getBlockAddress(block) + sizeof(Header)};
+  }
+
+  // Copy the next current record.
+  const uint32_t end     = getBlockAddress(_compact.block) + Flash::getBlockSize();
+  const uint32_t address = findRecord(_compact.address, end);
+  if (address > 0) {
+    const Record* record = (const Record*)address;
+    if (record->key < _count && _index[record->key] == address) {
+      const uint32_t copy = append(record->key, (const uint8_t*)(record + 1), record->length, true);
+      if (copy == 0)
+        return;
+
+      _index[record->key] = copy;
+      _statistics.copied++;
+    }
+
+    _compact.address = address + getRecordSize(record);
+    return;
+  }
+
+  // The copies need to be programmed before the block is erased.
+  flush();
+  Flash::eraseBlock(getBlockAddress(_compact.block));
+  _compact.active = false;
+  _statistics.erased++;
+}
+
+// Add the record to the page buffer. Returns its address, 0 if the log is full. The
+// last erased block is reserved for the copies of the compaction.
+uint32_t V2Base::Memory::Store::append(uint16_t key, const uint8_t data[], uint16_t length, bool reserve) {
+  const Record   header{.key = key, .length = length};
+  const uint32_t size = getRecordSize(&header);
+
+  // The compaction has opened the reserved block.
+  if (!reserve && _compact.active && countErased() == 0)
+    return 0;
+
+  if (_page.address == 0 || _page.position + size > Flash::getPageSize()) {
+    if (!nextPage(reserve))
+      return 0;
+  }
+
+  uint8_t* buffer = (uint8_t*)_page.buffer + _page.position;
+  memcpy(buffer, &header, sizeof(header));
+  if (length != 0xffff)
+    memcpy(buffer + sizeof(header), data, length);
+
+  const uint32_t address = _page.address + _page.position;
+  _page.position += size;
+  _page.dirty = true;
+  return address;
+}
+
+bool V2Base::Memory::Store::nextPage(bool reserve) {
+  flush();
+
+  if (_page.address > 0) {
+    const uint32_t next = _page.address + Flash::getPageSize();
+    if (next < getBlockAddress(_head) + Flash::getBlockSize()) {
+      _page.address  = next;
+      _page.position = 0;
+      memset(_page.buffer, 0xff, sizeof(_page.buffer));
+      return true;
+    }
+  }
+
+  return openBlock(reserve);
+}
+
+// Continue the log in the next erased block.
+bool V2Base::Memory::Store::openBlock(bool reserve) {
+  if (countErased() < (reserve ? 1 : 2)) {
+    _page.address = 0;
+    return false;
+  }
+
+  for (uint8_t i = 1; i <= _blocks; i++) {
+    const uint8_t block = (_head + i) % _blocks;
+    if (!isErased(block) || (_compact.active && block == _compact.block))
+      continue;
+
+    _head = block;
+    _sequence++;
+
+    _page.address = getBlockAddress(block);
+    memset(_page.buffer, 0xff, sizeof(_page.buffer));
+    const Header header{.magic = _magic, .sequence = _sequence};
+    memcpy(_page.buffer, &header, sizeof(header));
+    _page.position = sizeof(header);
+    _page.dirty    = true;
+    return true;
+  }
+
+  _page.address = 0;
+  return false;
+}
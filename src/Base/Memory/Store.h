@@ -0,0 +1,104 @@
+#pragma once
+#include "Flash.h"
+#include <Arduino.h>
+
+namespace V2Base::Memory {
+  // Log-structured key-value store in a flash area of at least three blocks. The
+  // records are appended to a log; a RAM index points to the latest record of
+  // every key. The records are collected in a page buffer and programmed as full
+  // pages. loop() compacts the oldest block in the background, it copies the
+  // still current records to the head of the log and erases the block.
+  //
+  // The area needs to be outside of the firmware image. It is part of the current
+  // flash bank, a bank swap does not carry it over.
+  class Store {
+  public:
+    struct Counter {
+      uint32_t written;
+      uint32_t pages;
+      uint32_t copied;
+      uint32_t erased;
+    };
+
+    constexpr Store(uint32_t offset, uint8_t blocks) : _offset{offset}, _blocks{blocks} {}
+
+    // Rebuild the 'index' from the log, one entry per key; the keys are 0 to 'count' - 1.
+    void begin(uint32_t index[], uint16_t count);
+
+    // Copy up to 'size' bytes of the value. Returns the length of the value, -1 if
+    // the key does not exist.
+    int32_t read(uint16_t key, uint8_t data[], uint16_t size);
+
+    // Returns false if the log is full, or the value does not fit into a page.
+    bool write(uint16_t key, const uint8_t data[], uint16_t length);
+    bool remove(uint16_t key);
+
+    // Program the page buffer, the remaining space of the page is not used.
+    void flush();
+
+    // Compact the oldest block, one record per call.
+    void loop();
+
+    static constexpr uint16_t getMaxLength() {
+      return Flash::getPageSize() - sizeof(Header) - sizeof(Record);
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  private:
+    static constexpr uint32_t _magic{0x53324c56};
+
+    struct Header {
+      uint32_t magic;
+      uint32_t sequence;
+    };
+
+    // A removed key carries the length 0xffff, erased flash the key 0xffff.
+    struct Record {
+      uint16_t key;
+      uint16_t length;
+    };
+
+    const uint32_t _offset;
+    const uint8_t  _blocks;
+    uint32_t*      _index{};
+    uint16_t       _count{};
+
+    // The block at the head of the log and its sequence number.
+    uint8_t  _head{};
+    uint32_t _sequence{};
+
+    struct {
+      uint32_t address;
+      uint16_t position;
+      bool     dirty;
+      uint32_t buffer[Flash::getPageSize() / sizeof(uint32_t)];
+    } _page{};
+
+    struct {
+      bool     active;
+      uint8_t  block;
+      uint32_t address;
+    } _compact{};
+
+    Counter _statistics{};
+
+    uint32_t getBlockAddress(uint8_t block) const {
+      return _offset + block * Flash::getBlockSize();
+    }
+
+    uint32_t getSequence(uint8_t block) const;
+    bool     isErased(uint8_t block) const;
+    uint8_t  countErased() const;
+
+    const uint8_t* getData(uint32_t address) const;
+    uint32_t       findRecord(uint32_t address, uint32_t end) const;
+    static uint32_t getRecordSize(const Record* record);
+
+    uint32_t append(uint16_t key, const uint8_t data[], uint16_t length, bool reserve = false);
+    bool     nextPage(bool reserve);
+    bool     openBlock(bool reserve);
+  };
+};
@@ -0,0 +1,90 @@
+#include "Power.h"
+
+// The handler of the Arduino core which counts the milliseconds.
+extern "C" void SysTick_DefaultHandler(void);
+
+// RTC, 32 bit counter, 32.768 kHz. The crystal oscillator is used if the board
+// has enabled it; the internal OSCULP32K is accurate to only a few percent, the
+// millis() of a crystal-less board drift by that amount while sleeping.
+static void beginRTC() {
+  static bool initialized{};
+  if (initialized)
+    return;
+
+  initialized             = true;
+  MCLK->APBAMASK.bit.RTC_ = 1;
+  if (OSC32KCTRL->STATUS.bit.XOSC32KRDY && OSC32KCTRL->XOSC32K.bit.EN32K)
+    OSC32KCTRL->RTCCTRL.reg = OSC32KCTRL_RTCCTRL_RTCSEL_XOSC32K;
+
+  else
+    OSC32KCTRL->RTCCTRL.reg = OSC32KCTRL_RTCCTRL_RTCSEL_ULP32K;
+
+  RTC->MODE0.CTRLA.bit.ENABLE = 0;
+  while (RTC->MODE0.SYNCBUSY.bit.ENABLE)
+    ;
+
+  RTC->MODE0.CTRLA.reg = RTC_MODE0_CTRLA_MODE_COUNT32 | RTC_MODE0_CTRLA_PRESCALER_DIV1 | RTC_MODE0_CTRLA_COUNTSYNC;
+  RTC->MODE0.CTRLA.bit.ENABLE = 1;
+  while (RTC->MODE0.SYNCBUSY.bit.ENABLE)
+    ;
+}
+
+static uint32_t readRTC() {
+  while (RTC->MODE0.SYNCBUSY.bit.COUNT)
+    ;
+
+  return RTC->MODE0.COUNT.reg;
+}
+
+void V2Base::Power::sleep(uint32_t usec) {
+  // Not worth suspending the tick.
+  if (usec < 2000) {
+    __WFI();
+    return;
+  }
+
+  // Stay within the range of the calculation.
+  if (usec > 1000 * 1000)
+    usec = 1000 * 1000;
+
+  beginRTC();
+
+  // The pending interrupts wake up the CPU with PRIMASK set, their handlers run
+  // after the ticks are restored.
+  __disable_irq();
+
+  const uint32_t load  = SysTick->LOAD + 1;
+  const uint32_t phase = load - SysTick->VAL;
+  const uint32_t start = readRTC();
+
+  RTC->MODE0.COMP[0].reg = start + (uint64_t)usec * 32768 / 1000000;
+  while (RTC->MODE0.SYNCBUSY.bit.COMP0)
+    ;
+
+  RTC->MODE0.INTFLAG.reg  = RTC_MODE0_INTFLAG_CMP0;
+  RTC->MODE0.INTENSET.reg = RTC_MODE0_INTENSET_CMP0;
+  NVIC_ClearPendingIRQ(RTC_IRQn);
+  NVIC_EnableIRQ(RTC_IRQn);
+
+  SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+  __WFI();
+
+  // The number of elapsed ticks from the RTC; the phase of the still running
+  // system tick corrects the low resolution of the RTC.
+  const uint32_t rtc    = readRTC() - start;
+  const uint32_t now    = load - SysTick->VAL;
+  const int64_t  cycles = (int64_t)phase + (uint64_t)rtc * F_CPU / 32768 - now;
+  const uint32_t ticks  = cycles > 0 ? (cycles + load / 2) / load : 0;
+
+  RTC->MODE0.INTENCLR.reg = RTC_MODE0_INTENCLR_CMP0;
+  RTC->MODE0.INTFLAG.reg  = RTC_MODE0_INTFLAG_CMP0;
+  NVIC_DisableIRQ(RTC_IRQn);
+  NVIC_ClearPendingIRQ(RTC_IRQn);
+
+  for (uint32_t i = 0; i < ticks; i++)
+    SysTick_DefaultHandler();
+
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+  SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+  __enable_irq();
+}
@@ -20,5 +20,13 @@ namespace V2Base {
     static void sleep() {
       __WFI();
     }
+
+    // Tickless sleep, the system tick interrupt is suspended and the RTC wakes
+    // the CPU after 'usec', any other interrupt wakes it earlier. The missed
+    // ticks are added to millis() after the wake-up. Short intervals use
+    // the regular sleep(). Without a 32 kHz crystal, the RTC runs from the
+    // internal low-power oscillator; millis() drifts by its inaccuracy of a few
+    // percent of the slept time.
+    static void sleep(uint32_t usec);
   };
 };
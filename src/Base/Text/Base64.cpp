@@ -55,67 +55,180 @@ uint32_t V2Base::Text::Base64::encode(const uint8_t input[], uint32_t length, ui
   return (length + 2) / 3 * 4;
 }
 
-static uint8_t decodeB64(uint8_t c) {
-  if ('A' <= c && c <= 'Z')
-    return c - 'A';
+// The values of the characters, 0xff for characters outside of the alphabet.
+static constexpr struct DecodeTable {
+  uint8_t values[256];
 
-  if ('a' <= c && c <= 'z')
-    return c - 71;
+  constexpr DecodeTable() : values{} {
+    for (uint16_t i = 0; i < 256; i++)
+      values[i] = 0xff;
 
-  if ('0' <= c && c <= '9')
-    return c + 4;
+    for (uint8_t i = 0; i < 26; i++) {
+      values['A' + i] = i;
+      values['a' + i] = 26 + i;
+    }
 
-  if (c == '+')
-    return 62;
+    for (uint8_t i = 0; i < 10; i++)
+      values['0' + i] = 52 + i;
 
-  if (c == '/')
-    return 63;
-
-  return 255;
-}
+    values['+'] = 62;
+    values['/'] = 63;
+  }
+} decodeTable;
 
-static uint32_t decodeLength(const uint8_t input[]) {
-  const uint8_t* start = input;
+uint32_t V2Base::Text::Base64::decode(const uint8_t input[], uint8_t output[]) {
+  uint8_t* start = output;
 
-  while (decodeB64(input[0]) < 64)
-    input++;
+  // All four characters are read before the three bytes are written.
+  for (;;) {
+    const uint8_t a = decodeTable.values[input[0]];
+    if (a & 0x80)
+      break;
 
-  uint32_t inputLength  = input - start;
-  uint32_t outputLength = inputLength / 4 * 3;
+    const uint8_t b = decodeTable.values[input[1]];
+    if (b & 0x80)
+      break;
 
-  switch (inputLength % 4) {
-    case 2:
-      return outputLength + 1;
+    const uint8_t c = decodeTable.values[input[2]];
+    if (c & 0x80) {
+      output[0] = a << 2 | b >> 4;
+      output += 1;
+      break;
+    }
 
-    case 3:
-      return outputLength + 2;
+    const uint8_t d = decodeTable.values[input[3]];
+    if (d & 0x80) {
+      output[0] = a << 2 | b >> 4;
+      output[1] = b << 4 | c >> 2;
+      output += 2;
+      break;
+    }
 
-    default:
-      return outputLength;
+    output[0] = a << 2 | b >> 4;
+    output[1] = b << 4 | c >> 2;
+    output[2] = c << 6 | d;
+    input += 4;
+    output += 3;
   }
+
+  return output - start;
 }
 
-uint32_t V2Base::Text::Base64::decode(const uint8_t input[], uint8_t output[]) {
-  uint32_t length = decodeLength(input);
+void V2Base::Text::Base64::Decoder::begin(uint8_t output[], uint32_t size) {
+  _output  = output;
+  _size    = size;
+  _length  = 0;
+  _bits    = 0;
+  _count   = 0;
+  _padding = 0;
+  _final   = false;
+  _valid   = true;
+}
 
-  for (uint32_t i = 2; i < length; i += 3) {
-    output[0] = decodeB64(input[0]) << 2 | decodeB64(input[1]) >> 4;
-    output[1] = decodeB64(input[1]) << 4 | decodeB64(input[2]) >> 2;
-    output[2] = decodeB64(input[2]) << 6 | decodeB64(input[3]);
-    input += 4;
-    output += 3;
+bool V2Base::Text::Base64::Decoder::feed(const uint8_t input[], uint32_t length) {
+  if (!_valid)
+    return false;
+
+  uint32_t i = 0;
+  while (i < length) {
+    // Complete groups of four characters.
+    if (_count == 0 && !_final) {
+      while (i + 4 <= length && _length + 3 <= _size) {
+        const uint8_t a = decodeTable.values[input[i]];
+        const uint8_t b = decodeTable.values[input[i + 1]];
+        const uint8_t c = decodeTable.values[input[i + 2]];
+        const uint8_t d = decodeTable.values[input[i + 3]];
+        if ((a | b | c | d) & 0x80)
+          break;
+
+        _output[_length++] = a << 2 | b >> 4;
+        _output[_length++] = b << 4 | c >> 2;
+        _output[_length++] = c << 6 | d;
+        i += 4;
+      }
+
+      if (i == length)
+        break;
+    }
+
+    const uint8_t c = input[i++];
+    if (c == '=') {
+      if (!_final) {
+        // A group needs at least two characters before the padding.
+        if (_count < 2) {
+          _valid = false;
+          return false;
+        }
+
+        _final   = true;
+        _padding = 4 - _count;
+        if (!store(_count - 1)) {
+          _valid = false;
+          return false;
+        }
+      }
+
+      if (_padding == 0) {
+        _valid = false;
+        return false;
+      }
+
+      _padding--;
+      continue;
+    }
+
+    const uint8_t v = decodeTable.values[c];
+    if ((v & 0x80) || _final) {
+      _valid = false;
+      return false;
+    }
+
+    _bits = _bits << 6 | v;
+    _count++;
+    if (_count < 4)
+      continue;
+
+    if (!store(3)) {
+      _valid = false;
+      return false;
+    }
   }
 
-  switch (length % 3) {
+  return true;
+}
+
+bool V2Base::Text::Base64::Decoder::end() {
+  if (!_valid)
+    return false;
+
+  _valid = false;
+  if (_final)
+    return _padding == 0;
+
+  // Unpadded input.
+  switch (_count) {
+    case 0:
+      return true;
+
     case 1:
-      output[0] = decodeB64(input[0]) << 2 | decodeB64(input[1]) >> 4;
-      break;
+      return false;
 
-    case 2:
-      output[0] = decodeB64(input[0]) << 2 | decodeB64(input[1]) >> 4;
-      output[1] = decodeB64(input[1]) << 4 | decodeB64(input[2]) >> 2;
-      break;
+    default:
+      return store(_count - 1);
   }
+}
+
+// Write the 'count' bytes of the pending group.
+bool V2Base::Text::Base64::Decoder::store(uint8_t count) {
+  if (_length + count > _size)
+    return false;
+
+  // Align the pending bits to a complete group of 24 bits.
+  const uint32_t bits = _bits << (6 * (4 - _count));
+  for (uint8_t i = 0; i < count; i++)
+    _output[_length++] = bits >> (16 - i * 8);
 
-  return length;
+  _bits  = 0;
+  _count = 0;
+  return true;
 }
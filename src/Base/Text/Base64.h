@@ -5,6 +5,44 @@ namespace V2Base::Text {
   class Base64 {
   public:
     static uint32_t encode(const uint8_t input[], uint32_t length, uint8_t output[]);
+
+    // Decode until the first character outside of the alphabet, usually the
+    // terminating NUL or the padding. The output can be the input itself, the
+    // data is decoded in-place.
     static uint32_t decode(const uint8_t input[], uint8_t output[]);
+
+    // Streaming decoder with validation; the input can be split at any position.
+    // The output can be the start of the input buffer, the data is decoded in-place.
+    class Decoder {
+    public:
+      void begin(uint8_t output[], uint32_t size);
+
+      // Returns false if the input is not valid or the output is full. All
+      // later calls fail until the next begin().
+      bool feed(const uint8_t input[], uint32_t length);
+
+      // Flush the remaining bits. Returns false if the input is incomplete.
+      bool end();
+
+      uint32_t getLength() const {
+        return _length;
+      }
+
+    private:
+      uint8_t* _output{};
+      uint32_t _size{};
+      uint32_t _length{};
+
+      // The pending 6-bit values of the current group of four characters.
+      uint32_t _bits{};
+      uint8_t  _count{};
+
+      // The number of still expected '=' characters.
+      uint8_t _padding{};
+      bool    _final{};
+      bool    _valid{};
+
+      bool store(uint8_t count);
+    };
   };
 };
@@ -0,0 +1,30 @@
+#include "Bits7.h"
+
+uint32_t V2Base::Text::Bits7::encode(const uint8_t input[], uint32_t length, uint8_t output[]) {
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < length; i += 7) {
+    uint8_t& msb = output[n++];
+    msb          = 0;
+
+    for (uint8_t k = 0; k < 7 && i + k < length; k++) {
+      msb |= (input[i + k] >> 7) << k;
+      output[n++] = input[i + k] & 0x7f;
+    }
+  }
+
+  return n;
+}
+
+uint32_t V2Base::Text::Bits7::decode(const uint8_t input[], uint32_t length, uint8_t output[]) {
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < length; i += 8) {
+    const uint8_t msb = input[i];
+
+    for (uint8_t k = 0; k < 7 && i + 1 + k < length; k++)
+      output[n++] = input[i + 1 + k] | ((msb >> k) & 1) << 7;
+  }
+
+  return n;
+}
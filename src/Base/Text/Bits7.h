@@ -0,0 +1,17 @@
+#pragma once
+#include <Arduino.h>
+
+namespace V2Base::Text {
+  // Pack 8 bit data into a 7 bit byte stream, e.g. a MIDI SystemExclusive message.
+  // Every group of up to seven bytes is preceded by a byte which carries their
+  // most significant bits; bit 0 belongs to the first byte of the group.
+  class Bits7 {
+  public:
+    static constexpr uint32_t getEncodedLength(uint32_t length) {
+      return length + (length + 6) / 7;
+    }
+
+    static uint32_t encode(const uint8_t input[], uint32_t length, uint8_t output[]);
+    static uint32_t decode(const uint8_t input[], uint32_t length, uint8_t output[]);
+  };
+};
@@ -1,4 +1,5 @@
 #include "PWM.h"
+#include <Adafruit_ZeroDMA.h>
 
 static Tcc* const _tccs[TCC_INST_NUM] = TCC_INSTS;
 
@@ -12,6 +13,22 @@ static constexpr uint8_t _gclkIDs[TCC_INST_NUM] = {
 #endif
 };
 
+static constexpr uint8_t _overflowTriggers[TCC_INST_NUM] = {
+  TCC0_DMAC_ID_OVF,
+  TCC1_DMAC_ID_OVF,
+  TCC2_DMAC_ID_OVF,
+#if (TCC_INST_NUM > 3)
+  TCC3_DMAC_ID_OVF,
+  TCC4_DMAC_ID_OVF,
+#endif
+};
+
+// The DMA channels of the streamed duty tables, allocated with the first stream.
+static struct {
+  Adafruit_ZeroDMA dma;
+  DmacDescriptor*  descriptor;
+} _tccStreams[TCC_INST_NUM];
+
 void V2Base::Timer::PWM::begin() {
   _tcc = _tccs[_id];
 
@@ -78,3 +95,26 @@ void V2Base::Timer::PWM::begin() {
   while (_tcc->SYNCBUSY.bit.ENABLE)
     ;
 }
+
+void V2Base::Timer::PWM::beginStream(uint8_t pin, const uint32_t table[], uint16_t count, bool loop) {
+  auto*              stream = &_tccStreams[_id];
+  volatile uint32_t* ccbuf  = &_tcc->CCBUF[getChannel(pin)].reg;
+
+  if (!stream->descriptor) {
+    stream->dma.setTrigger(_overflowTriggers[_id]);
+    stream->dma.setAction(DMA_TRIGGER_ACTON_BEAT);
+    stream->dma.allocate();
+    stream->descriptor = stream->dma.addDescriptor((void*)table, (void*)ccbuf, count, DMA_BEAT_SIZE_WORD, true, false);
+
+  } else {
+    stream->dma.abort();
+    stream->dma.changeDescriptor(stream->descriptor, (void*)table, (void*)ccbuf, count);
+  }
+
+  stream->dma.loop(loop);
+  stream->dma.startJob();
+}
+
+void V2Base::Timer::PWM::endStream() {
+  _tccStreams[_id].dma.abort();
+}
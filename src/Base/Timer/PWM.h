@@ -25,6 +25,38 @@ namespace V2Base::Timer {
       _tcc->CCBUF[getChannel(pin)].reg = (float)_period * duty;
     }
 
+    // Update the channels of the 'mask' at once, 'duty' is indexed by the channel
+    // number. All values are copied to CC with the same transition.
+    void setDuties(const float duty[], uint8_t mask) {
+      while (_tcc->SYNCBUSY.reg & TCC_SYNCBUSY_CC(mask))
+        ;
+
+      // Lock the update while the buffers are written.
+      _tcc->CTRLBSET.reg = TCC_CTRLBSET_LUPD;
+      while (_tcc->SYNCBUSY.bit.CTRLB)
+        ;
+
+      for (uint8_t i = 0; i < 6; i++) {
+        if (mask & (1 << i))
+          _tcc->CCBUF[i].reg = (float)_period * duty[i];
+      }
+
+      _tcc->CTRLBCLR.reg = TCC_CTRLBCLR_LUPD;
+      while (_tcc->SYNCBUSY.bit.CTRLB)
+        ;
+    }
+
+    // The CC value for the duty cycle, the entries of a streamed table.
+    uint32_t getDutyValue(float duty) const {
+      return (float)_period * duty;
+    }
+
+    // Stream the 'table' of CC values into the duty of the pin with DMA, one value
+    // per PWM period. A looped table repeats until endStream(), otherwise the last
+    // value stays.
+    void beginStream(uint8_t pin, const uint32_t table[], uint16_t count, bool loop = false);
+    void endStream();
+
     static constexpr uint8_t getID(uint8_t pin) {
       return GetTCNumber(g_APinDescription[pin].ulTCChannel);
     }
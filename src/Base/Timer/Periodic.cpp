@@ -1,4 +1,5 @@
 #include "Periodic.h"
+#include "Wheel.h"
 
 static Tc* const _tcs[TC_INST_NUM] = TC_INSTS;
 
@@ -26,8 +27,30 @@ static constexpr uint8_t _gclkIDs[TC_INST_NUM] = {
 
 static std::function<void()> _tcHandlers[TC_INST_NUM]{};
 
+static struct {
+  void (*function)(void* context);
+  void* context;
+} _tcCalls[TC_INST_NUM]{};
+
+// The TC interrupt handlers are shared with Wheel.
+static V2Base::Timer::Wheel* _tcWheels[TC_INST_NUM]{};
+
+void V2Base::Timer::Wheel::attach(uint8_t id, Wheel* wheel) {
+  _tcWheels[id] = wheel;
+}
+
 static void TCHandler(uint8_t id) {
-  _tcHandlers[id]();
+  if (_tcWheels[id]) {
+    _tcWheels[id]->handleInterrupt();
+    return;
+  }
+
+  if (_tcCalls[id].function)
+    _tcCalls[id].function(_tcCalls[id].context);
+
+  else
+    _tcHandlers[id]();
+
   _tcs[id]->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0 | TC_INTFLAG_MC1;
 }
 
@@ -41,7 +64,17 @@ void TC3_Handler() {
 
 void V2Base::Timer::Periodic::begin(std::function<void()> handler) {
   _tcHandlers[_id] = handler;
-  _tc              = _tcs[_id];
+  _tcCalls[_id]    = {};
+  setup();
+}
+
+void V2Base::Timer::Periodic::begin(void (*handler)(void* context), void* context) {
+  _tcCalls[_id] = {.function = handler, .context = context};
+  setup();
+}
+
+void V2Base::Timer::Periodic::setup() {
+  _tc = _tcs[_id];
 
   // Clock generator 0 == 120MHz.
   GCLK->PCHCTRL[_gclkIDs[_id]].reg = GCLK_PCHCTRL_GEN_GCLK0_Val | (1 << GCLK_PCHCTRL_CHEN_Pos);
@@ -59,28 +92,27 @@ void V2Base::Timer::Periodic::begin(std::function<void()> handler) {
 
   // Example:
   // 120MHz/8 == 15Mhz, 500Hz timer == 30000 ticks / period.
+  // The smallest prescaler which fits the period into the 16 bit counter.
+  static constexpr struct {
+    uint32_t prescaler;
+    uint16_t divider;
+  } prescalers[]{
+    {TC_CTRLA_PRESCALER_DIV1, 1},
+    {TC_CTRLA_PRESCALER_DIV8, 8},
+    {TC_CTRLA_PRESCALER_DIV16, 16},
+    {TC_CTRLA_PRESCALER_DIV64, 64},
+    {TC_CTRLA_PRESCALER_DIV256, 256},
+    {TC_CTRLA_PRESCALER_DIV1024, 1024},
+  };
+
   const uint32_t clock     = 120000000;
-  uint32_t       prescaler = TC_CTRLA_PRESCALER_DIV1;
-  _period                  = (clock / 1) / _frequency;
-  if (_period > 0xffff) {
-    prescaler = TC_CTRLA_PRESCALER_DIV8;
-    _period   = (clock / 8) / _frequency;
-
-  } else if (_period > 0xffff) {
-    prescaler = TC_CTRLA_PRESCALER_DIV16;
-    _period   = (clock / 16) / _frequency;
-
-  } else if (_period > 0xffff) {
-    prescaler = TC_CTRLA_PRESCALER_DIV64;
-    _period   = (clock / 64) / _frequency;
-
-  } else if (_period > 0xffff) {
-    prescaler = TC_CTRLA_PRESCALER_DIV256;
-    _period   = (clock / 256) / _frequency;
-
-  } else if (_period > 0xffff) {
-    prescaler = TC_CTRLA_PRESCALER_DIV1024;
-    _period   = (clock / 1024) / _frequency;
+  uint32_t       prescaler = 0;
+  for (const auto& p : prescalers) {
+    prescaler = p.prescaler;
+    _clock    = clock / p.divider;
+    _period   = _clock / _frequency;
+    if (_period <= 0xffff)
+      break;
   }
 
   _tc->COUNT16.CTRLA.reg |= prescaler | TCC_CTRLA_PRESCSYNC_GCLK;
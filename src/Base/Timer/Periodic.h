@@ -8,6 +8,9 @@
 //
 // Timer.begin([]() { LEDBuiltin.tick(); });
 // Timer.begin(std::bind(&V2LED::Basic::tick, &LEDBuiltin));
+//
+// // Direct call from the interrupt handler, without std::function.
+// Timer.begin<&V2LED::Basic::tick>(&LEDBuiltin);
 
 namespace V2Base::Timer {
   class Periodic {
@@ -15,6 +18,13 @@ namespace V2Base::Timer {
     constexpr Periodic(uint8_t id, uint32_t frequency) : _id{id}, _frequency{frequency} {}
     void begin(std::function<void()> handler);
 
+    // Plain function pointer with a context, called directly from the interrupt.
+    void begin(void (*handler)(void* context), void* context);
+
+    template <auto method, class T> void begin(T* object) {
+      begin([](void* context) { (static_cast<T*>(context)->*method)(); }, object);
+    }
+
     // Provide a PWM/duty-cycle-like interrupt pattern; use the second channel to fire
     // at a fraction of the period.
     bool isFraction() {
@@ -35,6 +45,29 @@ namespace V2Base::Timer {
       _tc->COUNT16.INTENSET.reg = TC_INTENSET_MC1;
     }
 
+    // Change the frequency of the running timer, usually from its interrupt handler,
+    // the next interrupt fires after the new period. The prescaler is not changed, the
+    // frequency cannot be lower than the one the timer was created with.
+    void setFrequency(float frequency) {
+      setPeriod((float)_clock / frequency);
+    }
+
+    // The period in ticks of getClock().
+    void setPeriod(uint32_t period) {
+      if (period > 0xffff)
+        period = 0xffff;
+
+      _period                = period;
+      _tc->COUNT16.CC[0].reg = period;
+      while (_tc->COUNT16.SYNCBUSY.bit.CC0)
+        ;
+    }
+
+    // The frequency of the counter, the resolution of the period.
+    uint32_t getClock() {
+      return _clock;
+    }
+
     void enable();
     void disable();
 
@@ -49,5 +82,8 @@ namespace V2Base::Timer {
     Tc*            _tc{};
     const uint32_t _frequency;
     uint32_t       _period{};
+    uint32_t       _clock{};
+
+    void setup();
   };
 };
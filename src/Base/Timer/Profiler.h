@@ -0,0 +1,149 @@
+#pragma once
+#include <Arduino.h>
+
+// V2Base::Timer::Profiler<8> Profiler;
+//
+// const uint8_t solenoids = Profiler.add("solenoids");
+//
+// {
+//   const auto measure = Profiler.measure(solenoids);
+//   Solenoids.loop();
+// }
+//
+// const uint8_t decode = Profiler.add("base64");
+// Profiler.run(decode, 1000, [&]() { V2Base::Text::Base64::decode(text, data); });
+namespace V2Base::Timer {
+  // Measure named sections of the main loop with the cycle counter, and the
+  // interval between the iterations of the main loop.
+  template <uint8_t N> class Profiler {
+  public:
+    struct Section {
+      const char* name;
+      uint32_t    count;
+      uint64_t    cycles;
+      uint32_t    cyclesMin;
+      uint32_t    cyclesMax;
+    };
+
+    // The upper bounds of the loop interval buckets, the last bucket counts all
+    // longer intervals.
+    static constexpr uint8_t  countBuckets{6};
+    static constexpr uint32_t usecBuckets[countBuckets]{10, 50, 100, 500, 1000, 5000};
+
+    class Scope {
+    public:
+      Scope(Profiler* profiler, uint8_t index) : _profiler(profiler), _index(index), _cycles(getCycles()) {}
+      ~Scope() {
+        _profiler->record(_index, getCycles() - _cycles);
+      }
+
+    private:
+      Profiler* const _profiler;
+      const uint8_t   _index;
+      const uint32_t  _cycles;
+    };
+
+    // Enable the DWT cycle counter.
+    void begin() {
+      CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+      DWT->CYCCNT = 0;
+      DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    // Returns the index of the new section, or 0xff if there is no space left.
+    uint8_t add(const char* name) {
+      if (_count == N)
+        return 0xff;
+
+      _sections[_count] = {.name = name, .cyclesMin = UINT32_MAX};
+      return _count++;
+    }
+
+    Scope measure(uint8_t index) {
+      return Scope(this, index);
+    }
+
+    // Benchmark a function; call it the given number of times and record every
+    // call into the section. Interrupts stay enabled, cyclesMin is the most
+    // reliable value.
+    template <typename Function> void run(uint8_t index, uint32_t iterations, Function function) {
+      for (uint32_t i = 0; i < iterations; i++) {
+        const uint32_t cycles = getCycles();
+        function();
+        record(index, getCycles() - cycles);
+      }
+    }
+
+    void record(uint8_t index, uint32_t cycles) {
+      if (index >= _count)
+        return;
+
+      Section* section = &_sections[index];
+      section->count++;
+      section->cycles += cycles;
+      if (cycles < section->cyclesMin)
+        section->cyclesMin = cycles;
+
+      if (cycles > section->cyclesMax)
+        section->cyclesMax = cycles;
+    }
+
+    // Called once per iteration of the main loop.
+    void tick() {
+      const uint32_t cycles = getCycles();
+      if (_loop.cycles != 0) {
+        const uint32_t usec = cyclesToUsec(cycles - _loop.cycles);
+        uint8_t        i    = 0;
+        while (i < countBuckets && usec >= usecBuckets[i])
+          i++;
+
+        _loop.histogram[i]++;
+        if (usec > _loop.usecMax)
+          _loop.usecMax = usec;
+      }
+
+      _loop.cycles = cycles;
+    }
+
+    void reset() {
+      for (uint8_t i = 0; i < _count; i++)
+        _sections[i] = {.name = _sections[i].name, .cyclesMin = UINT32_MAX};
+
+      _loop = {.cycles = _loop.cycles};
+    }
+
+    uint8_t count() const {
+      return _count;
+    }
+
+    const Section* getSection(uint8_t index) const {
+      return &_sections[index];
+    }
+
+    const uint32_t* getHistogram() const {
+      return _loop.histogram;
+    }
+
+    uint32_t getUsecMax() const {
+      return _loop.usecMax;
+    }
+
+    static uint32_t getCycles() {
+      return DWT->CYCCNT;
+    }
+
+    static uint32_t cyclesToUsec(uint32_t cycles) {
+      return cycles / (F_CPU / 1000000);
+    }
+
+  private:
+    Section _sections[N]{};
+    uint8_t _count{};
+
+    struct {
+      uint32_t cycles;
+      uint32_t usecMax;
+      uint32_t histogram[countBuckets + 1];
+    } _loop{};
+  };
+};
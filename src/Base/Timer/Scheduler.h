@@ -0,0 +1,128 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+
+// V2Base::Timer::Scheduler<8> Scheduler;
+//
+// Scheduler.add(10 * 1000, []() { Buttons.loop(); });
+// Scheduler.add(1000, std::bind(&V2Drum::loop, &Drum));
+//
+// void loop() {
+//   Scheduler.loop();
+// }
+namespace V2Base::Timer {
+  // Cooperative scheduler for the main loop. Tasks run at a period, or once at a
+  // deadline; loop() only calls the due tasks and measures how late they are.
+  template <uint8_t N> class Scheduler {
+  public:
+    struct Counter {
+      uint32_t count;
+      uint32_t usecLate;
+      uint32_t usecLateMax;
+    };
+
+    // Returns the index of the task, or 0xff if there is no space left. The first
+    // call happens after one period; a period of 0 runs the task once.
+    uint8_t add(uint32_t usecPeriod, std::function<void()> handler) {
+      if (_count == N)
+        return 0xff;
+
+      _tasks[_count] = {.handler    = handler,
+                        .usecPeriod = usecPeriod,
+                        .usec       = micros() + usecPeriod,
+                        .active     = true};
+      return _count++;
+    }
+
+    // Run the task once at the absolute time 'usec', a periodic task continues
+    // with its period from there.
+    void setDeadline(uint8_t index, uint32_t usec) {
+      _tasks[index].usec   = usec;
+      _tasks[index].active = true;
+    }
+
+    void setPeriod(uint8_t index, uint32_t usecPeriod) {
+      _tasks[index].usecPeriod = usecPeriod;
+    }
+
+    void disable(uint8_t index) {
+      _tasks[index].active = false;
+    }
+
+    // Call the due tasks. Returns the number of called tasks.
+    uint8_t loop() {
+      uint8_t n = 0;
+
+      for (uint8_t i = 0; i < _count; i++) {
+        Task* task = &_tasks[i];
+        if (!task->active)
+          continue;
+
+        const uint32_t now = micros();
+        if ((int32_t)(now - task->usec) < 0)
+          continue;
+
+        const uint32_t late = now - task->usec;
+        task->statistics.count++;
+        task->statistics.usecLate += late;
+        if (late > task->statistics.usecLateMax)
+          task->statistics.usecLateMax = late;
+
+        // Keep the phase of the period; skip the missed periods.
+        if (task->usecPeriod > 0) {
+          task->usec += task->usecPeriod;
+          if ((int32_t)(now - task->usec) >= 0)
+            task->usec = now + task->usecPeriod;
+
+        } else {
+          task->active = false;
+        }
+
+        task->handler();
+        n++;
+      }
+
+      return n;
+    }
+
+    // The time until the next task is due, 0 if a task is already due, UINT32_MAX
+    // if there is no active task.
+    uint32_t getUsecUntilNext() const {
+      const uint32_t now  = micros();
+      uint32_t       next = UINT32_MAX;
+
+      for (uint8_t i = 0; i < _count; i++) {
+        if (!_tasks[i].active)
+          continue;
+
+        const int32_t usec = _tasks[i].usec - now;
+        if (usec <= 0)
+          return 0;
+
+        if ((uint32_t)usec < next)
+          next = usec;
+      }
+
+      return next;
+    }
+
+    uint8_t count() const {
+      return _count;
+    }
+
+    const Counter& getStatistics(uint8_t index) const {
+      return _tasks[index].statistics;
+    }
+
+  private:
+    struct Task {
+      std::function<void()> handler;
+      uint32_t              usecPeriod;
+      uint32_t              usec;
+      bool                  active;
+      Counter               statistics;
+    } _tasks[N]{};
+
+    uint8_t _count{};
+  };
+};
@@ -0,0 +1,19 @@
+#include "Trace.h"
+
+V2Base::Timer::Trace::Record V2Base::Timer::Trace::_records[V2Base::Timer::Trace::size]{};
+volatile uint32_t            V2Base::Timer::Trace::_count{};
+
+uint16_t V2Base::Timer::Trace::copy(Record* records) {
+  if constexpr (!enabled)
+    return 0;
+
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const uint32_t count = _count;
+  const uint16_t n     = count < size ? count : size;
+  for (uint16_t i = 0; i < n; i++)
+    records[i] = _records[(count - n + i) % size];
+  __set_PRIMASK(primask);
+
+  return n;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+
+// Build with -DV2BASE_TRACE to record the events, otherwise record() compiles
+// to nothing.
+//
+// V2Base::Timer::Trace::record(V2Base::Timer::Trace::Event::Dispatched, packet->data());
+namespace V2Base::Timer {
+  // A system-wide ring of timestamped events along the path of a MIDI packet. The
+  // records of several devices can be merged into a latency timeline; the packet
+  // bytes identify the same message across the devices.
+  class Trace {
+  public:
+    enum class Event : uint8_t {
+      // A transport received a packet.
+      Received,
+
+      // V2MIDI::Port::dispatch() decodes the packet.
+      Dispatched,
+
+      // V2Link sent the packet to the next device.
+      Forwarded,
+
+      // V2Solenoids switched on a port; the bytes carry the port and the duration
+      // in milliseconds.
+      Pulse,
+    };
+
+    struct Record {
+      uint32_t usec;
+      Event    event;
+      uint8_t  data[3];
+    };
+    static_assert(sizeof(Record) == 8);
+
+    static constexpr bool     enabled{
+#if defined(V2BASE_TRACE)
+      true
+#endif
+    };
+    static constexpr uint16_t size{enabled ? 256 : 1};
+
+    // Called from the main loop and from interrupt handlers. The bytes are usually
+    // the data of a MIDI packet: the cable and code index, the status and the first
+    // data byte.
+    static void record(Event event, const uint8_t data[3]) {
+      if constexpr (enabled) {
+        const uint32_t usec    = micros();
+        const uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        const uint32_t index   = _count;
+        _records[index % size] = {.usec{usec}, .event{event}, .data{data[0], data[1], data[2]}};
+        _count                 = index + 1;
+        __set_PRIMASK(primask);
+      }
+    }
+
+    static void record(Event event, uint8_t a, uint8_t b, uint8_t c) {
+      const uint8_t data[3]{a, b, c};
+      record(event, data);
+    }
+
+    // The number of recorded events since startup.
+    static uint32_t getCount() {
+      return _count;
+    }
+
+    // Copy the records, the oldest first. Returns the number of records.
+    static uint16_t copy(Record* records);
+
+  private:
+    static Record            _records[size];
+    static volatile uint32_t _count;
+  };
+};
@@ -0,0 +1,201 @@
+#include "Wheel.h"
+
+static Tc* const _tcs[TC_INST_NUM] = TC_INSTS;
+
+static constexpr IRQn_Type _tcIRQs[TC_INST_NUM] = {
+  TC0_IRQn,
+  TC1_IRQn,
+  TC2_IRQn,
+  TC3_IRQn,
+#if (TC_INST_NUM > 4)
+  TC4_IRQn,
+  TC5_IRQn,
+#endif
+};
+
+static constexpr uint8_t _gclkIDs[TC_INST_NUM] = {
+  TC0_GCLK_ID,
+  TC1_GCLK_ID,
+  TC2_GCLK_ID,
+  TC3_GCLK_ID,
+#if (TC_INST_NUM > 4)
+  TC4_GCLK_ID,
+  TC5_GCLK_ID,
+#endif
+};
+
+void V2Base::Timer::Wheel::begin() {
+  _tc = _tcs[_id];
+  attach(_id, this);
+
+  // Clock generator 0 == 120MHz.
+  GCLK->PCHCTRL[_gclkIDs[_id]].reg = GCLK_PCHCTRL_GEN_GCLK0_Val | (1 << GCLK_PCHCTRL_CHEN_Pos);
+
+  _tc->COUNT16.CTRLA.bit.SWRST = 1;
+  while (_tc->COUNT16.SYNCBUSY.bit.SWRST)
+    ;
+
+  // Free-running counter, the compare match of channel 0 fires the interrupt.
+  _tc->COUNT16.WAVE.bit.WAVEGEN = TC_WAVE_WAVEGEN_NFRQ;
+  _tc->COUNT16.CTRLA.reg |= TC_CTRLA_PRESCALER_DIV8 | TC_CTRLA_PRESCSYNC_GCLK;
+
+  // The entries which were started before.
+  uint32_t next = 0x8000;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_entries[i].active && _entries[i].remain < next)
+      next = _entries[i].remain;
+  }
+
+  _time = 0;
+  setCompare(next);
+
+  _tc->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+
+  _tc->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (_tc->COUNT16.SYNCBUSY.bit.ENABLE)
+    ;
+
+  NVIC_EnableIRQ(_tcIRQs[_id]);
+}
+
+int8_t V2Base::Timer::Wheel::add(uint32_t frequency, std::function<void()> handler, uint8_t priority) {
+  const int8_t index = insert(_clock / frequency, handler, priority);
+  if (index < 0)
+    return -1;
+
+  start(index, 1000000 / frequency);
+  return index;
+}
+
+int8_t V2Base::Timer::Wheel::addOneShot(std::function<void()> handler, uint8_t priority) {
+  return insert(0, handler, priority);
+}
+
+void V2Base::Timer::Wheel::start(uint8_t index, uint32_t usec) {
+  Entry*   entry = &_entries[index];
+  uint32_t ticks = (uint64_t)usec * _clock / 1000000;
+  if (ticks == 0)
+    ticks = 1;
+
+  __disable_irq();
+  if (!_tc) {
+    entry->remain = ticks;
+    entry->active = true;
+    __enable_irq();
+    return;
+  }
+
+  // Relative to the last evaluation.
+  const uint16_t count = readCount();
+  entry->remain        = ticks + (uint16_t)(count - _time);
+  entry->active        = true;
+
+  // Started by a handler; it is already relative to the time of the current pass,
+  // the remaining entries of the pass must not count the elapsed time again.
+  if (_running)
+    _started |= 1 << index;
+
+  // Evaluate the entries from the interrupt; while the handlers are running, the
+  // next compare match is calculated afterwards.
+  if (!_running && (int16_t)(_compare - count) > (int32_t)ticks + _lead)
+    setCompare(count + _lead);
+
+  __enable_irq();
+}
+
+void V2Base::Timer::Wheel::stop(uint8_t index) {
+  _entries[index].active = false;
+}
+
+void V2Base::Timer::Wheel::setPriority(uint8_t level) {
+  NVIC_SetPriority(_tcIRQs[_id], level);
+}
+
+void V2Base::Timer::Wheel::handleInterrupt() {
+  _tc->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  _running                 = true;
+
+  for (;;) {
+    const uint16_t elapsed = _compare - _time;
+    _time                  = _compare;
+    _started               = 0;
+
+    for (uint8_t i = 0; i < _count; i++) {
+      Entry* entry = &_entries[_order[i]];
+      if (!entry->active || (_started & (1 << _order[i])))
+        continue;
+
+      if (entry->remain > elapsed) {
+        entry->remain -= elapsed;
+        continue;
+      }
+
+      // Keep the phase of a late periodic handler, skip the missed periods.
+      const uint32_t late = elapsed - entry->remain;
+      if (entry->period == 0)
+        entry->active = false;
+
+      else
+        entry->remain = entry->period - late % entry->period;
+
+      entry->handler();
+    }
+
+    // The handlers might have started other entries.
+    uint32_t next = 0x8000;
+    for (uint8_t i = 0; i < _count; i++) {
+      const Entry* entry = &_entries[i];
+      if (entry->active && entry->remain < next)
+        next = entry->remain;
+    }
+
+    setCompare(_time + next);
+
+    // The handlers took longer than the next deadline, evaluate them again
+    // without waiting for the compare match.
+    const uint16_t count = readCount();
+    if ((int16_t)(_compare - count) > (int16_t)_lead)
+      break;
+
+    _compare = count;
+  }
+
+  _running = false;
+}
+
+int8_t V2Base::Timer::Wheel::insert(uint32_t period, std::function<void()> handler, uint8_t priority) {
+  if (_count == 16)
+    return -1;
+
+  const uint8_t index = _count;
+  _entries[index]     = {.handler = handler, .period = period, .priority = priority};
+
+  // Keep the order sorted, the entries of the same priority in the order of
+  // their addition.
+  __disable_irq();
+  uint8_t i = _count++;
+  while (i > 0 && _entries[_order[i - 1]].priority < priority) {
+    _order[i] = _order[i - 1];
+    i--;
+  }
+
+  _order[i] = index;
+  __enable_irq();
+
+  return index;
+}
+
+uint16_t V2Base::Timer::Wheel::readCount() {
+  _tc->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_READSYNC;
+  while (_tc->COUNT16.CTRLBSET.bit.CMD)
+    ;
+
+  return _tc->COUNT16.COUNT.reg;
+}
+
+void V2Base::Timer::Wheel::setCompare(uint16_t compare) {
+  _compare               = compare;
+  _tc->COUNT16.CC[0].reg = compare;
+  while (_tc->COUNT16.SYNCBUSY.bit.CC0)
+    ;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+
+// // TC2, shared by the handlers.
+// V2Base::Timer::Wheel Wheel(2);
+//
+// Wheel.begin();
+// Wheel.add(1000, []() { LEDBuiltin.tick(); });
+// const int8_t timeout = Wheel.addOneShot([]() { Motor.stop(); }, 1);
+// Wheel.start(timeout, 50 * 1000);
+
+namespace V2Base::Timer {
+  // Multiplex periodic and one-shot handlers onto a single TC. The counter runs
+  // freely at 15 MHz, the compare match is moved to the next due handler. Handlers
+  // which are due at the same time are called in the order of their priority.
+  //
+  // The handlers are called from interrupt context. The interrupt is shared with
+  // Periodic, only TC2 and TC3 are supported.
+  class Wheel {
+  public:
+    Wheel(uint8_t id) : _id{id} {}
+    void begin();
+
+    // Call the handler at the 'frequency'. Returns the index of the entry, -1 if all
+    // entries are in use.
+    int8_t add(uint32_t frequency, std::function<void()> handler, uint8_t priority = 0);
+
+    // Add a one-shot handler, it is fired with start().
+    int8_t addOneShot(std::function<void()> handler, uint8_t priority = 0);
+
+    // Call the handler 'usec' from now, a periodic entry restarts its period.
+    void start(uint8_t index, uint32_t usec);
+    void stop(uint8_t index);
+
+    void setPriority(uint8_t level);
+
+    // Called from the TC interrupt.
+    void handleInterrupt();
+
+  private:
+    static constexpr uint32_t _clock{120000000 / 8};
+
+    // The minimum distance of the compare match to the current count, ~2µs.
+    static constexpr uint16_t _lead{32};
+
+    const uint8_t _id;
+    Tc*           _tc{};
+
+    struct Entry {
+      std::function<void()> handler;
+      uint32_t              period;
+      uint32_t              remain;
+      uint8_t               priority;
+      bool                  active;
+    } _entries[16]{};
+
+    // The indices of the entries, sorted by their priority.
+    uint8_t _order[16]{};
+    uint8_t _count{};
+
+    // The counter value of the last evaluation, the 'remain' of the entries is
+    // relative to it.
+    uint16_t _time{};
+    uint16_t _compare{};
+    bool     _running{};
+
+    // The entries started by the handlers during the current pass.
+    uint16_t _started{};
+
+    int8_t   insert(uint32_t period, std::function<void()> handler, uint8_t priority);
+    uint16_t readCount();
+    void     setCompare(uint16_t compare);
+
+    static void attach(uint8_t id, Wheel* wheel);
+  };
+};
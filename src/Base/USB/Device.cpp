@@ -25,7 +25,57 @@ bool V2Base::USBDevice::send(uint8_t packet[4]) {
   if (!connected())
     return false;
 
-  return _midi.interface.writePacket(packet);
+  // The staging buffer is shared with interrupt handlers.
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  // Staging is only used by the main loop with an open batch. Everything else
+  // writes the staged packets first, to keep the order of the packets.
+  const bool staging = _tx.batch && __get_IPSR() == 0;
+  if (_tx.count > 0 && (!staging || _tx.count == sizeof(_tx.packets) / 4))
+    writeStaged();
+
+  bool sent;
+  if (staging) {
+    sent = _tx.count < sizeof(_tx.packets) / 4;
+    if (sent) {
+      memcpy(_tx.packets + (_tx.count * 4), packet, 4);
+      _tx.count++;
+    }
+
+  } else
+    sent = _tx.count == 0 && _midi.interface.writePacket(packet);
+
+  __set_PRIMASK(primask);
+  return sent;
+}
+
+bool V2Base::USBDevice::flush() {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  _tx.batch = false;
+
+  if (!connected())
+    _tx.count = 0;
+
+  else
+    writeStaged();
+
+  const bool flushed = _tx.count == 0;
+  __set_PRIMASK(primask);
+  return flushed;
+}
+
+void V2Base::USBDevice::writeStaged() {
+  // Writing the packets back-to-back fills the tinyUSB FIFO, the pending transfer
+  // picks them up as one endpoint packet.
+  uint8_t n = 0;
+  while (n < _tx.count && _midi.interface.writePacket(_tx.packets + (n * 4)))
+    n++;
+
+  _tx.count -= n;
+  if (_tx.count > 0)
+    memmove(_tx.packets, _tx.packets + (n * 4), _tx.count * 4);
 }
 
 bool V2Base::USBDevice::receive(uint8_t packet[4]) {
@@ -38,3 +88,17 @@ bool V2Base::USBDevice::receive(uint8_t packet[4]) {
   _device.usec = micros();
   return true;
 }
+
+uint32_t V2Base::USBDevice::receive(uint8_t* packets, uint32_t max) {
+  if (!connected())
+    return 0;
+
+  uint32_t n = 0;
+  while (n < max && _midi.interface.readPacket(packets + (n * 4)))
+    n++;
+
+  if (n > 0)
+    _device.usec = micros();
+
+  return n;
+}
@@ -63,10 +63,35 @@ namespace V2Base {
       _midi.interface.setCableName(port, name);
     }
 
+    // Packets are written immediately, or, between beginBatch() and flush(), staged
+    // and written in bursts of a full 64 byte endpoint packet. Packets sent from an
+    // interrupt handler are never staged, the staged packets are written first.
+    // Returns false if the packet was not accepted.
     bool send(uint8_t packet[4]);
     bool receive(uint8_t packet[4]);
 
+    // Stage the packets of the main loop until the next flush().
+    void beginBatch() {
+      _tx.batch = true;
+    }
+
+    // Write the staged packets and end the batch. Returns false if not all of them
+    // were accepted, the remaining packets stay staged and are written first by
+    // the next send() or flush().
+    bool flush();
+
+    // The number of packets which can be sent before the staging buffer is full.
+    uint8_t getTxSpace() const {
+      return sizeof(_tx.packets) / 4 - _tx.count;
+    }
+
+    // Read up to 'max' packets into 'packets', a buffer of 'max' * 4 bytes.
+    // Returns the number of packets read.
+    uint32_t receive(uint8_t* packets, uint32_t max);
+
   private:
+    void writeStaged();
+
     struct {
       // The large descriptor is needed to carry the data for more than 3 MIDI ports.
       uint8_t descriptor[1024];
@@ -82,6 +107,13 @@ namespace V2Base {
       Adafruit_USBD_MIDI interface;
     } _midi;
 
+    // The packets staged for the next flush().
+    struct {
+      uint8_t packets[64];
+      uint8_t count;
+      bool    batch;
+    } _tx{};
+
     // The WebUSB interface to annouce the configuration URL to the browser.
     struct {
       struct {
@@ -11,8 +11,20 @@ static struct {
   V2Buttons::Button* list;
 
   volatile bool busy{true};
+
+  // Read the port registers instead of waiting for interrupts.
+  bool scan;
 } _buttons{};
 
+// The debounced state of the pins of all ports, and the bits of their vertical
+// counters. The counters count the consecutive reads which differ from the state.
+static struct {
+  bool     init;
+  uint32_t state[PORT_GROUPS];
+  uint32_t count0[PORT_GROUPS];
+  uint32_t count1[PORT_GROUPS];
+} _scan{};
+
 static void pinInterrupt() {
   _buttons.busy = true;
 }
@@ -23,14 +35,52 @@ void V2Buttons::Button::begin() {
   else
     pinMode(_pin, INPUT);
 
-  attachInterrupt(digitalPinToInterrupt(_pin), pinInterrupt, CHANGE);
+  _port = g_APinDescription[_pin].ulPort;
+  _mask = 1UL << g_APinDescription[_pin].ulPin;
+
+  if (!_buttons.scan)
+    attachInterrupt(digitalPinToInterrupt(_pin), pinInterrupt, CHANGE);
 
   this->_next   = _buttons.list;
   _buttons.list = this;
 }
 
+void V2Buttons::beginScan() {
+  _buttons.scan = true;
+}
+
+// Read all ports, call the buttons which are busy or have changed.
+void V2Buttons::scan() {
+  uint32_t changed[PORT_GROUPS];
+  for (uint8_t i = 0; i < PORT_GROUPS; i++) {
+    const uint32_t in = PORT->Group[i].IN.reg;
+    if (!_scan.init) {
+      _scan.state[i]  = in;
+      _scan.count0[i] = UINT32_MAX;
+      _scan.count1[i] = UINT32_MAX;
+    }
+
+    uint32_t delta  = _scan.state[i] ^ in;
+    _scan.count0[i] = ~(_scan.count0[i] & delta);
+    _scan.count1[i] = _scan.count0[i] ^ (_scan.count1[i] & delta);
+    delta &= _scan.count0[i] & _scan.count1[i];
+    _scan.state[i] ^= delta;
+    changed[i] = delta;
+  }
+
+  _scan.init = true;
+
+  for (Button* button = _buttons.list; button; button = button->_next) {
+    if (!button->_busy && !(changed[button->_port] & button->_mask))
+      continue;
+
+    const bool high = _scan.state[button->_port] & button->_mask;
+    button->update(high == button->_high);
+  }
+}
+
 void V2Buttons::loop() {
-  if (!_buttons.busy)
+  if (!_buttons.scan && !_buttons.busy)
     return;
 
   // Limit the frequency of port checks during state transitions.
@@ -39,6 +89,11 @@ void V2Buttons::loop() {
 
   _buttons.usec = micros();
 
+  if (_buttons.scan) {
+    scan();
+    return;
+  }
+
   _buttons.busy = false;
   for (Button* button = _buttons.list; button; button = button->_next)
     if (button->loop())
@@ -46,8 +101,10 @@ void V2Buttons::loop() {
 }
 
 bool V2Buttons::Button::loop() {
-  const bool down = digitalRead(_pin) == _high ? HIGH : LOW;
+  return update(digitalRead(_pin) == _high ? HIGH : LOW);
+}
 
+bool V2Buttons::Button::update(bool down) {
   switch (_state) {
     case Button::State::Idle:
       if (down) {
@@ -0,0 +1,132 @@
+#include "V2DMX.h"
+#include <V2Base.h>
+#include <wiring_private.h>
+
+void V2DMX::Receiver::begin() {
+  // The UART runs at 250 kBit/s, 8N2. A break, the line held low for at least
+  // 88 microseconds, is received as a '0' byte with a framing error.
+  _sercom.sercom->initUART(UART_INT_CLOCK, SAMPLE_RATE_x16, 250000);
+  _sercom.sercom->initFrame(UART_CHAR_SIZE_8_BITS, LSB_FIRST, SERCOM_NO_PARITY, SERCOM_STOP_BITS_2);
+  _sercom.sercom->initPads(UART_TX_PAD_0, _sercom.padRx);
+  _sercom.sercom->enableUART();
+  pinPeripheral(_sercom.pin, _sercom.pinFunc);
+
+  // The data register is read by the DMA engine, only the errors raise an interrupt.
+  _sercom.regs->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_MASK;
+  _sercom.regs->USART.INTENSET.reg = SERCOM_USART_INTENSET_ERROR;
+
+  _dma.setTrigger(_sercom.trigger);
+  _dma.setAction(DMA_TRIGGER_ACTON_BEAT);
+  _dma.allocate();
+  _descriptor = _dma.addDescriptor((void*)&_sercom.regs->USART.DATA.reg,
+                                   _rx.buffers[0],
+                                   sizeof(_rx.buffers[0]),
+                                   DMA_BEAT_SIZE_BYTE,
+                                   false,
+                                   true);
+
+  reset();
+}
+
+void V2DMX::Receiver::reset() {
+  noInterrupts();
+  _dma.abort();
+  _rx.index   = 0;
+  _rx.pending = false;
+  interrupts();
+
+  _frame      = {};
+  _statistics = {};
+  start();
+}
+
+void V2DMX::Receiver::start() {
+  _dma.changeDescriptor(_descriptor, NULL, _rx.buffers[_rx.index], sizeof(_rx.buffers[0]));
+  _dma.startJob();
+}
+
+void V2DMX::Receiver::handleInterrupt() {
+  Sercom* regs = _sercom.regs;
+  if (!regs->USART.STATUS.bit.FERR) {
+    regs->USART.STATUS.reg  = SERCOM_USART_STATUS_MASK;
+    regs->USART.INTFLAG.reg = SERCOM_USART_INTFLAG_ERROR;
+    return;
+  }
+
+  // The number of bytes the DMA engine has written.
+  const uint8_t channel = _dma.getChannel();
+  uint16_t      remain;
+  if (DMAC->ACTIVE.bit.ABUSY && DMAC->ACTIVE.bit.ID == channel)
+    remain = DMAC->ACTIVE.bit.BTCNT;
+
+  else
+    remain = ((DmacDescriptor*)DMAC->WRBADDR.reg)[channel].BTCNT.reg;
+
+  _dma.abort();
+
+  // The '0' byte of the break; it is either still in the data register, or it was
+  // already copied to the end of the frame.
+  uint16_t count = sizeof(_rx.buffers[0]) - remain;
+  if (regs->USART.INTFLAG.bit.RXC)
+    (void)regs->USART.DATA.reg;
+
+  else if (count > 0)
+    count--;
+
+  regs->USART.STATUS.reg  = SERCOM_USART_STATUS_MASK;
+  regs->USART.INTFLAG.reg = SERCOM_USART_INTFLAG_ERROR;
+
+  // Hand the frame to loop() and receive the next one into the other buffer. If the
+  // previous frame was not processed, the buffer is overwritten.
+  if (count > 0) {
+    if (_rx.pending)
+      _statistics.dropped++;
+
+    else {
+      _rx.count   = count;
+      _rx.usec    = V2Base::getUsec();
+      _rx.pending = true;
+      _rx.index ^= 1;
+    }
+  }
+
+  start();
+}
+
+void V2DMX::Receiver::loop() {
+  if (!_rx.pending)
+    return;
+
+  const uint8_t* buffer = _rx.buffers[_rx.index ^ 1];
+  const uint16_t count  = _rx.count;
+
+  // The number of slots, without the start code.
+  const uint16_t slots = count - 1;
+
+  // Only the start code '0' carries slot data.
+  if (buffer[0] != 0) {
+    _statistics.ignored++;
+    _rx.pending = false;
+    return;
+  }
+
+  _statistics.frames++;
+
+  bool changed = slots != _frame.count;
+  memset(_changed, 0, sizeof(_changed));
+  for (uint16_t i = 1; i < count; i++) {
+    if (buffer[i] == _frame.slots[i])
+      continue;
+
+    _changed[i / 32] |= 1UL << (i % 32);
+    changed = true;
+  }
+
+  memcpy(_frame.slots, buffer, count);
+  _frame.count = slots;
+  _frame.usec  = _rx.usec;
+  _rx.pending  = false;
+
+  if (changed)
+    handleFrame(_frame.slots, slots, _changed);
+}
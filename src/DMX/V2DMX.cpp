@@ -70,7 +70,8 @@ void V2DMX::reset() {
   _nChannels = 0;
 
   _transferUsec = 0;
-  _updateDMA    = true;
+  _dirty        = 0;
+  _transfer     = true;
 }
 
 static void updateDMABlock(uint8_t block[11], uint8_t channel[8]) {
@@ -88,20 +89,33 @@ static void updateDMABlock(uint8_t block[11], uint8_t channel[8]) {
 }
 
 void V2DMX::loop() {
-  if (_updateDMA) {
-    // Refresh the DMA data.
-    for (uint8_t i = 0; i < 64; i++) {
-      // Do not needlessly update the untouched higher channels.
-      if (i * 8 > _nChannels)
-        break;
-
-      updateDMABlock(_dmaBuffer->blocks[i], _channels.blocks[i]);
-    }
-
-    _updateDMA = false;
-    _transfer  = true;
+  encode();
+  if (!isDue())
+    return;
+
+  if (_spi->isBusy())
+    return;
+
+  send();
+}
+
+void V2DMX::encode() {
+  if (_dirty == 0)
+    return;
+
+  // Refresh the DMA data of the changed blocks.
+  for (uint8_t i = 0; i < 64; i++) {
+    if (!(_dirty & ((uint64_t)1 << i)))
+      continue;
+
+    updateDMABlock(_dmaBuffer->blocks[i], _channels.blocks[i]);
   }
 
+  _dirty    = 0;
+  _transfer = true;
+}
+
+bool V2DMX::isDue() {
   // Regularly send the DMX data regardless if something has changed; some
   // devices switch themselves off after a timeout.
   //
@@ -109,27 +123,37 @@ void V2DMX::loop() {
   // send new incoming updates as fast as possible (sync an incoming update with
   // the start of a new DMX data frame), and not needlessly wait for an unchanged
   // frame to finish transmitting.
-  if (!_transfer && (unsigned long)(micros() - _transferUsec) < 400 * 1000)
-    return;
+  return _transfer || (unsigned long)(micros() - _transferUsec) >= _keepAliveUsec;
+}
 
-  if (_spi->isBusy())
-    return;
+void V2DMX::send() {
+  // Send only the blocks in use. The duration between breaks should be at least
+  // 1200 microseconds; the header and 3 blocks take 1216 microseconds.
+  uint16_t blocks = ((_nSlots > 0 ? _nSlots : _nChannels) + 7) / 8;
+  if (blocks < 3)
+    blocks = 3;
 
-  _spi->transfer(_dmaBuffer, NULL, sizeof(DMABuffer), false);
+  else if (blocks > 64)
+    blocks = 64;
+
+  _spi->transfer(_dmaBuffer, NULL, sizeof(_dmaBuffer->header) + (blocks * 11), false);
   _transfer     = false;
   _transferUsec = micros();
 }
 
 void V2DMX::setChannels(uint16_t i, const uint8_t* data, uint16_t size) {
-  if (i + size >= 512)
+  if (size == 0 || i + size > 512)
     return;
 
-  // Remember the largest channel number in use to limit the DMA data update.
+  // Remember the largest channel number in use.
   if (_nChannels < i + size)
     _nChannels = i + size;
 
   memcpy(_channels.values + i, data, size);
-  _updateDMA = true;
+
+  // Mark the blocks of 8 channels which need to be encoded.
+  for (uint8_t block = i / 8; block <= (i + size - 1) / 8; block++)
+    _dirty |= (uint64_t)1 << block;
 }
 
 void V2DMX::setChannel(uint16_t i, uint8_t value) {
@@ -1,5 +1,8 @@
 #include "V2Device.h"
 #include <V2Base.h>
+#if defined(I2S)
+#include <V2Audio.h>
+#endif
 
 // This is only initialized after a cold startup when the memory is undefined.
 // A reset/reboot will not overwrite the data; it is retained across reset/reboot
@@ -67,11 +70,19 @@ bool V2Device::readEEPROM(bool dryrun) {
 }
 
 void V2Device::begin() {
+  V2Base::Memory::RAM::paintStack();
+
+  profiler.begin();
+  _profile.led             = profiler.add("led");
+  _profile.systemExclusive = profiler.add("systemExclusive");
+  _profile.scheduler       = profiler.add("scheduler");
+  _profile.handleLoop      = profiler.add("handleLoop");
+
   V2MIDI::Port::begin();
   usb.midi.begin();
 
   // The priority needs to be lower than the SERCOM priorities.
-  _ledTimer.begin(std::bind(&V2LED::Basic::tick, &led));
+  _ledTimer.begin<&V2LED::Basic::tick>(&led);
   _ledTimer.setPriority(3);
 
   if (V2Base::Memory::Flash::UserPage::update()) {
@@ -82,8 +93,10 @@ void V2Device::begin() {
 
   _boot.id = V2Base::Cryptography::Random::read();
 
-  // Do not block in GetAll(), it takes ~80ms.
-  V2Base::Memory::Firmware::calculateHash(V2Base::Memory::Firmware::getStart(), V2Base::Memory::Firmware::getSize(), _firmware.hash);
+  // The hash of the firmware image takes ~80ms, it is calculated in slices by loop().
+  _firmware.hashing.sha.init();
+  _firmware.hashing.position = 0;
+  _firmware.hashing.active   = true;
 
   // Read a possible config from the previous boot cycle.
   if (bootData.usb.ports.enableAccess)
@@ -131,8 +144,10 @@ void V2Device::begin() {
   else if (usb.ports.standard > 0)
     usb.ports.current = usb.ports.standard;
 
-  if (usb.ports.current > 1)
+  if (usb.ports.current > 1) {
     usb.midi.setPorts(usb.ports.current);
+    setCables(_cables, usb.ports.current - 1, &_cablePool);
+  }
 
   // Operating systems/services/apps get confused if the number
   // of ports changes between device connections; some hang, some
@@ -148,6 +163,8 @@ void V2Device::begin() {
 
   // Sleep mode IDLE, wait for interrupts.
   V2Base::Power::setSleepMode(V2Base::Power::Mode::Idle);
+
+  cacheReply();
 }
 
 void V2Device::reset() {
@@ -157,15 +174,62 @@ void V2Device::reset() {
 }
 
 void V2Device::loop() {
-  led.loop();
-  loopSystemExclusive();
-  handleLoop();
+  profiler.tick();
+
+  // Collect the packets sent during this loop, flush() writes them in full
+  // endpoint packets.
+  usb.midi.beginBatch();
+
+  {
+    const auto measure = profiler.measure(_profile.led);
+    led.loop();
+  }
+
+  {
+    const auto measure = profiler.measure(_profile.systemExclusive);
+    loopSystemExclusive();
+  }
+
+  if (_firmware.hashing.active)
+    hashFirmware();
+
+  if (_firmware.manifest.transport)
+    hashFirmwareManifest();
+
+  // The NVM controller is busy with a firmware block.
+  if (_eepromFlush && !_firmware.queue.writing && V2Base::Memory::EEPROM::flushAsync())
+    _eepromFlush = false;
+
+  if (_subscription.transport)
+    sendTelemetry();
+
+  if (_firmware.queue.writing) {
+    if (!V2Base::Memory::Flash::poll())
+      finishQueuedFirmwareBlock();
+
+  } else if (_firmware.queue.count > 0)
+    beginQueuedFirmwareBlock();
+
+  {
+    const auto measure = profiler.measure(_profile.scheduler);
+    scheduler.loop();
+  }
+
+  {
+    const auto measure = profiler.measure(_profile.handleLoop);
+    handleLoop();
+  }
+
+  usb.midi.flush();
 }
 
 // Reply with message to indicate that we are ready for the next packet.
 void V2Device::sendFirmwareStatus(V2MIDI::Transport* transport, const char* status) {
   uint8_t* reply = getSystemExclusiveBuffer();
-  uint32_t len   = 0;
+  if (!reply)
+    return;
+
+  uint32_t len = 0;
 
   // 0x7d == SysEx research/private ID
   reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
@@ -182,24 +246,197 @@ void V2Device::sendFirmwareStatus(V2MIDI::Transport* transport, const char* stat
   sendSystemExclusive(transport, len);
 }
 
-static int8_t utf8Codepoint(const uint8_t* utf8, uint32_t* codepointp) {
-  uint32_t codepoint;
-  int8_t   len;
-
-  if (utf8[0] < 0x80)
-    len = 1;
-  else if ((utf8[0] & 0xe0) == 0xc0)
-    len = 2;
-  else if ((utf8[0] & 0xf0) == 0xe0)
-    len = 3;
-  else if ((utf8[0] & 0xf8) == 0xf0)
-    len = 4;
-  else if ((utf8[0] & 0xfc) == 0xf8)
-    len = 5;
-  else if ((utf8[0] & 0xfe) == 0xfc)
-    len = 6;
+// Hash the firmware blocks of both flash banks, ~1 MB, in slices from loop(); the
+// manifest is sent when all blocks are hashed.
+void V2Device::beginFirmwareManifest(V2MIDI::Transport* transport) {
+  if (!_firmware.manifest.digests) {
+    const uint32_t size = V2Base::Memory::Firmware::Secondary::getStart() - V2Base::Memory::Firmware::getStart();
+    _firmware.manifest.digests = (uint8_t(*)[20])malloc(2 * (size / V2Base::Memory::Flash::getBlockSize()) * 20);
+    if (!_firmware.manifest.digests) {
+      sendFirmwareStatus(transport, "outOfMemory");
+      return;
+    }
+  }
+
+  // A running calculation continues, the manifest is sent to the last requester.
+  if (!_firmware.manifest.transport)
+    _firmware.manifest.position = 0;
+
+  _firmware.manifest.transport = transport;
+}
+
+// Reply with the hashes of the firmware blocks of both flash banks. The updater
+// only needs to send the blocks which differ from the secondary bank.
+void V2Device::sendFirmwareManifest(V2MIDI::Transport* transport) {
+  uint8_t* reply = getSystemExclusiveBuffer();
+  if (!reply)
+    return;
+
+  uint32_t len = 0;
+
+  // 0x7d == SysEx research/private ID
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
+  reply[len++] = 0x7d;
+
+  JsonDocument json;
+  JsonObject   jsonDevice   = json["com.versioduo.device"].to<JsonObject>();
+  jsonDevice["token"]       = _boot.id;
+  JsonObject jsonManifest   = jsonDevice["firmware"]["manifest"].to<JsonObject>();
+  jsonManifest["blockSize"] = V2Base::Memory::Flash::getBlockSize();
+
+  // The firmware area of a bank, after the bootloader.
+  const uint32_t start = V2Base::Memory::Firmware::getStart();
+  const uint32_t size  = V2Base::Memory::Firmware::Secondary::getStart() - start;
+
+  // The digests of the active bank, followed by the ones of the secondary bank.
+  const uint32_t blocks = size / V2Base::Memory::Flash::getBlockSize();
+
+  JsonArray jsonActive    = jsonManifest["active"].to<JsonArray>();
+  JsonArray jsonSecondary = jsonManifest["secondary"].to<JsonArray>();
+  for (uint32_t i = 0; i < blocks; i++) {
+    char hash[41];
+    V2Base::Memory::Firmware::formatHash(_firmware.manifest.digests[i], hash);
+    jsonActive.add(hash);
+
+    V2Base::Memory::Firmware::formatHash(_firmware.manifest.digests[blocks + i], hash);
+    jsonSecondary.add(hash);
+  }
+
+  len += serializeJson(json, (char*)reply + len, _sysexSize - len - 1);
+
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusiveEnd;
+  sendSystemExclusive(transport, len);
+}
+
+// The counters of a telemetry subscription.
+static constexpr struct {
+  uint8_t     field;
+  const char* section;
+  const char* group;
+  const char* name;
+} telemetryCounters[]{
+  {1 << 0, "midi", "input", "packet"},
+  {1 << 0, "midi", "output", "packet"},
+  {1 << 1, "link", "plug", "input"},
+  {1 << 1, "link", "plug", "output"},
+  {1 << 1, "link", "plug", "dropped"},
+  {1 << 1, "link", "plug", "error"},
+  {1 << 1, "link", "socket", "input"},
+  {1 << 1, "link", "socket", "output"},
+  {1 << 1, "link", "socket", "dropped"},
+  {1 << 1, "link", "socket", "error"},
+  {1 << 2, "serial", NULL, "input"},
+  {1 << 2, "serial", NULL, "output"},
+};
+
+// The existing member object, or a new one.
+static JsonObject getObject(JsonObject json, const char* key) {
+  if (json[key].is<JsonObject>())
+    return json[key];
+
+  return json[key].to<JsonObject>();
+}
+
+// Send the counters which have changed since the previous message.
+void V2Device::sendTelemetry() {
+  if (usb.midi.getConnectionSequence() != _subscription.sequence) {
+    _subscription.transport = nullptr;
+    return;
+  }
+
+  if (V2Base::getUsecSince(_subscription.usec) < _subscription.usecPeriod)
+    return;
+
+  // Another reply is in flight, try again with the next loop().
+  if (isSendingSystemExclusive())
+    return;
+
+  _subscription.usec = V2Base::getUsec();
+
+  static_assert(V2Base::countof(telemetryCounters) <= V2Base::countof(_subscription.values));
+  const V2Link::Port* plug   = link ? link->plug : nullptr;
+  const V2Link::Port* socket = link ? link->socket : nullptr;
+  const uint32_t      values[]{
+    _statistics.input.packet,
+    _statistics.output.packet,
+    plug ? plug->statistics.input : 0,
+    plug ? plug->statistics.output : 0,
+    plug ? plug->statistics.dropped : 0,
+    plug ? plug->statistics.error : 0,
+    socket ? socket->statistics.input : 0,
+    socket ? socket->statistics.output : 0,
+    socket ? socket->statistics.dropped : 0,
+    socket ? socket->statistics.error : 0,
+    serial ? serial->statistics.input : 0,
+    serial ? serial->statistics.output : 0,
+  };
+
+  JsonDocument json;
+  JsonObject   jsonTelemetry;
+  for (uint8_t i = 0; i < V2Base::countof(telemetryCounters); i++) {
+    if (!(_subscription.fields & telemetryCounters[i].field))
+      continue;
+
+    if (values[i] == _subscription.values[i])
+      continue;
+
+    if (!jsonTelemetry) {
+      JsonObject jsonDevice = json["com.versioduo.device"].to<JsonObject>();
+      jsonDevice["token"]   = _boot.id;
+      jsonTelemetry         = jsonDevice["telemetry"].to<JsonObject>();
+    }
+
+    JsonObject jsonSection = getObject(jsonTelemetry, telemetryCounters[i].section);
+    if (telemetryCounters[i].group)
+      jsonSection = getObject(jsonSection, telemetryCounters[i].group);
+
+    jsonSection[telemetryCounters[i].name] = values[i];
+  }
+
+  if (!jsonTelemetry)
+    return;
+
+  uint8_t* reply = getSystemExclusiveBuffer();
+  if (!reply)
+    return;
+
+  // The values are only marked as sent when the message is sent.
+  memcpy(_subscription.values, values, sizeof(values));
+
+  uint32_t len = 0;
+
+  // 0x7d == SysEx research/private ID
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
+  reply[len++] = 0x7d;
+  len += serializeJson(json, (char*)reply + len, _sysexSize - len - 1);
+
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusiveEnd;
+  sendSystemExclusive(_subscription.transport, len);
+}
+
+// The number of bytes of the UTF8 sequence starting with the given byte.
+static int8_t utf8Length(uint8_t lead) {
+  if (lead < 0x80)
+    return 1;
+  else if ((lead & 0xe0) == 0xc0)
+    return 2;
+  else if ((lead & 0xf0) == 0xe0)
+    return 3;
+  else if ((lead & 0xf8) == 0xf0)
+    return 4;
+  else if ((lead & 0xfc) == 0xf8)
+    return 5;
+  else if ((lead & 0xfe) == 0xfc)
+    return 6;
   else
     return -1;
+}
+
+static int8_t utf8Codepoint(const uint8_t* utf8, uint32_t* codepointp) {
+  uint32_t     codepoint;
+  const int8_t len = utf8Length(utf8[0]);
+  if (len < 0)
+    return -1;
 
   switch (len) {
     case 1:
@@ -239,48 +476,128 @@ static int8_t utf8Codepoint(const uint8_t* utf8, uint32_t* codepointp) {
   return len;
 }
 
-// Escape unicode to fit into a 7 bit byte stream.
-static uint32_t escapeJSON(const uint8_t* jsonBuffer, uint32_t jsonLen, uint8_t* buffer, uint32_t size) {
-  uint32_t bufferLen = 0;
+// ArduinoJson writer, escapes unicode to fit into a 7 bit byte stream while the
+// document is serialized straight into the SystemExclusive buffer. An already
+// serialized fragment, followed by a comma, can be inserted at a given offset
+// of the output.
+class SysExWriter {
+public:
+  SysExWriter(uint8_t* buffer, uint32_t size) : _buffer(buffer), _size(size) {}
 
-  for (uint32_t i = 0; i < jsonLen; i++) {
-    if (jsonBuffer[i] > 0x7f) {
-      uint32_t codepoint;
-      uint8_t  len = utf8Codepoint(jsonBuffer + i, &codepoint);
-      if (len < 0)
-        continue;
+  void insert(uint32_t offset, const char* fragment, uint32_t length) {
+    _insert = {.offset = offset, .fragment = fragment, .length = length};
+  }
 
-      // Advance the additional UTF8 characters for this codepoint.
-      i += len - 1;
+  size_t write(uint8_t c) {
+    if (_input == _insert.offset && _insert.fragment) {
+      const char* fragment = _insert.fragment;
+      _insert.fragment     = nullptr;
+      for (uint32_t i = 0; i < _insert.length; i++)
+        escape(fragment[i]);
 
-      if (codepoint < 0xffff) {
-        if (bufferLen + 7 > size)
-          return 0;
+      escape(',');
+    }
 
-        bufferLen += sprintf((char*)buffer + bufferLen, "\\u%04x", codepoint);
+    _input++;
+    escape(c);
+    return 1;
+  }
 
-      } else {
-        if (bufferLen + 13 > size)
-          return 0;
+  size_t write(const uint8_t* s, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      write(s[i]);
 
-        codepoint -= 0x10000;
-        uint16_t surrogate1 = (codepoint >> 10) + 0xd800;
-        uint16_t surrogate2 = (codepoint & 0x3ff) + 0xdc00;
-        bufferLen += sprintf((char*)buffer + bufferLen, "\\u%04x\\u%04x", surrogate1, surrogate2);
-      }
+    return n;
+  }
+
+  // The number of bytes in the buffer, 0 if the output did not fit.
+  uint32_t getLength() const {
+    return _overflow ? 0 : _length;
+  }
+
+private:
+  uint8_t* const _buffer;
+  const uint32_t _size;
+  uint32_t       _length{};
+  uint32_t       _input{};
+  bool           _overflow{};
+
+  struct {
+    uint32_t    offset;
+    const char* fragment;
+    uint32_t    length;
+  } _insert{};
+
+  // The bytes of an incomplete UTF8 sequence.
+  struct {
+    uint8_t data[6];
+    uint8_t length;
+  } _utf8{};
+
+  void escape(uint8_t c) {
+    if (_utf8.length == 0 && c < 0x80) {
+      put((const char*)&c, 1);
+      return;
+    }
+
+    _utf8.data[_utf8.length++] = c;
+    const int8_t len           = utf8Length(_utf8.data[0]);
+    if (len < 0) {
+      _utf8.length = 0;
+      return;
+    }
+
+    if (_utf8.length < len)
+      return;
+
+    _utf8.length = 0;
+    uint32_t codepoint;
+    if (utf8Codepoint(_utf8.data, &codepoint) < 0)
+      return;
+
+    char text[13];
+    if (codepoint < 0xffff) {
+      put(text, sprintf(text, "\\u%04x", (unsigned)codepoint));
 
     } else {
-      if (bufferLen >= size)
-        return 0;
+      codepoint -= 0x10000;
+      uint16_t surrogate1 = (codepoint >> 10) + 0xd800;
+      uint16_t surrogate2 = (codepoint & 0x3ff) + 0xdc00;
+      put(text, sprintf(text, "\\u%04x\\u%04x", surrogate1, surrogate2));
+    }
+  }
 
-      buffer[bufferLen++] = jsonBuffer[i];
+  void put(const char* data, uint8_t length) {
+    if (_length + length > _size) {
+      _overflow = true;
+      return;
     }
+
+    memcpy(_buffer + _length, data, length);
+    _length += length;
   }
+};
+
+static void addLinkStatistics(JsonObject json, V2Link::Port* port) {
+  json["input"]  = port->statistics.input;
+  json["output"] = port->statistics.output;
+
+  if (port->statistics.burst > 0)
+    json["burst"] = port->statistics.burst;
+
+  if (port->statistics.dropped > 0)
+    json["dropped"] = port->statistics.dropped;
+
+  json["highWater"] = port->statistics.highWater;
 
-  return bufferLen;
+  if (port->statistics.error > 0)
+    json["error"] = port->statistics.error;
+
+  if (port->statistics.resync > 0)
+    json["resync"] = port->statistics.resync;
 }
 
-void addStatistics(JsonObject json, V2MIDI::Port::Counter* counter) {
+void addStatistics(JsonObject json, V2MIDI::Port::Counter* counter, const V2MIDI::Port::Timing* timing) {
   json["packet"] = counter->packet;
 
   if (counter->note > 0)
@@ -304,6 +621,9 @@ void addStatistics(JsonObject json, V2MIDI::Port::Counter* counter) {
   if (counter->pitchbend > 0)
     json["pitchbend"] = counter->pitchbend;
 
+  if (counter->filtered > 0)
+    json["filtered"] = counter->filtered;
+
   if (counter->system.exclusive > 0 || counter->system.reset > 0 || counter->system.clock.tick > 0) {
     JsonObject system = json["system"].to<JsonObject>();
     if (counter->system.exclusive > 0)
@@ -317,25 +637,48 @@ void addStatistics(JsonObject json, V2MIDI::Port::Counter* counter) {
       clock["tick"]    = counter->system.clock.tick;
     }
   }
-}
 
-// Send the current data as a SystemExclusive, JSON message.
-void V2Device::sendReply(V2MIDI::Transport* transport) {
-  uint8_t* reply = getSystemExclusiveBuffer();
-  uint32_t len   = 0;
+  if (!timing)
+    return;
 
-  // 0x7d == SysEx research/private ID
-  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
-  reply[len++] = 0x7d;
+  // Indexed by the status byte.
+  static constexpr const char* types[]{
+    "noteOff", "note", "aftertouch", "control", "program", "aftertouchChannel", "pitchbend", "system",
+  };
+
+  JsonObject jsonTiming = json["timing"].to<JsonObject>();
+  jsonTiming["peak"]    = timing->peak;
+  for (uint8_t i = 0; i < V2Base::countof(types); i++) {
+    if (timing->type[i].count == 0)
+      continue;
+
+    JsonObject jsonType = jsonTiming[types[i]].to<JsonObject>();
+    jsonType["min"]     = timing->type[i].usecMin;
+    jsonType["avg"]     = (uint32_t)(timing->type[i].usec / timing->type[i].count);
+    jsonType["max"]     = timing->type[i].usecMax;
+  }
+}
 
-  JsonDocument json;
-  JsonObject   jsonDevice = json["com.versioduo.device"].to<JsonObject>();
+// Serialize the sections of the reply which do not change between requests.
+void V2Device::cacheReply() {
+  if (!_reply.board[0]) {
+    // The end of the bootloader contains an array of four offsets/pointers.
+    const uint32_t* info = (uint32_t*)V2Base::Memory::Firmware::getStart() - 4;
+
+    // The first entry is the location of our metadata.
+    const char*  metadata = (const char*)info[0];
+    JsonDocument jsonMetadata;
+    if (!deserializeJson(jsonMetadata, metadata)) {
+      const char* board = jsonMetadata["com.versioduo.bootloader"]["board"];
+      if (board)
+        strlcpy(_reply.board, board, sizeof(_reply.board));
+    }
+  }
 
-  // Requests and replies contain the device's current bootID.
-  jsonDevice["token"] = _boot.id;
+  JsonDocument json;
 
   {
-    JsonObject jsonMeta = jsonDevice["metadata"].to<JsonObject>();
+    JsonObject jsonMeta = json["metadata"].to<JsonObject>();
     if (metadata.product)
       jsonMeta["product"] = metadata.product;
 
@@ -359,12 +702,12 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
   }
 
   {
-    JsonArray jsonLinks = jsonDevice["links"].to<JsonArray>();
+    JsonArray jsonLinks = json["links"].to<JsonArray>();
     exportLinks(jsonLinks);
   }
 
   {
-    JsonObject jsonHelp = jsonDevice["help"].to<JsonObject>();
+    JsonObject jsonHelp = json["help"].to<JsonObject>();
     if (help.device)
       jsonHelp["device"] = help.device;
 
@@ -372,6 +715,52 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
       jsonHelp["configuration"] = help.configuration;
   }
 
+  {
+    JsonArray jsonSettings = json["settings"].to<JsonArray>();
+    exportSettings(jsonSettings);
+  }
+
+  // Store the members without the enclosing braces.
+  const uint32_t size = measureJson(json);
+  if (size + 1 >= _sysexSize)
+    return;
+
+  char* buffer = (char*)realloc(_reply.fragment, size + 1);
+  if (!buffer)
+    return;
+
+  serializeJson(json, buffer, size + 1);
+  memmove(buffer, buffer + 1, size - 2);
+  _reply.fragment = buffer;
+  _reply.length   = size - 2;
+  _reply.dirty    = false;
+}
+
+// Send the current data as a SystemExclusive, JSON message.
+void V2Device::sendReply(V2MIDI::Transport* transport) {
+  if (_reply.dirty)
+    cacheReply();
+
+  // Check before the buffer is borrowed from the pool, there is no reply to send.
+  if (!_reply.fragment)
+    return;
+
+  uint8_t* reply = getSystemExclusiveBuffer();
+  if (!reply)
+    return;
+
+  uint32_t len = 0;
+
+  // 0x7d == SysEx research/private ID
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
+  reply[len++] = 0x7d;
+
+  JsonDocument json;
+  JsonObject   jsonDevice = json["com.versioduo.device"].to<JsonObject>();
+
+  // Requests and replies contain the device's current bootID.
+  jsonDevice["token"] = _boot.id;
+
   {
     JsonObject jsonSystem = jsonDevice["system"].to<JsonObject>();
     if (usb.name)
@@ -393,7 +782,15 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
 
       jsonFirmware["id"]    = V2DeviceMetadata.id;
       jsonFirmware["board"] = V2DeviceMetadata.board;
-      jsonFirmware["hash"]  = _firmware.hash;
+
+      if (_firmware.hashing.active) {
+        jsonFirmware["hash"]    = nullptr;
+        jsonFirmware["hashing"] = true;
+
+      } else {
+        jsonFirmware["hash"] = _firmware.hash;
+      }
+
       jsonFirmware["start"] = V2Base::Memory::Firmware::getStart();
       jsonFirmware["size"]  = V2Base::Memory::Firmware::getSize();
     }
@@ -401,25 +798,8 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
     {
       JsonObject jsonHardware = jsonSystem["hardware"].to<JsonObject>();
 
-      {
-        // The end of the bootloader contains an array of four offsets/pointers.
-        const uint32_t* info = (uint32_t*)V2Base::Memory::Firmware::getStart() - 4;
-
-        // The first entry is the location of our metadata.
-        const char*  metadata = (const char*)info[0];
-        JsonDocument jsonMetadata;
-        if (deserializeJson(jsonMetadata, metadata))
-          return;
-
-        JsonObject jsonBootloader = jsonMetadata["com.versioduo.bootloader"];
-        if (!jsonBootloader)
-          return;
-
-        if (!jsonBootloader["board"])
-          return;
-
-        jsonHardware["board"] = jsonBootloader["board"];
-      }
+      if (_reply.board[0])
+        jsonHardware["board"] = _reply.board;
 
       if (system.revision > 0)
         jsonHardware["revision"] = system.revision;
@@ -428,6 +808,13 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
         JsonObject jsonRam = jsonHardware["ram"].to<JsonObject>();
         jsonRam["size"]    = V2Base::Memory::RAM::getSize();
         jsonRam["free"]    = V2Base::Memory::RAM::getFree();
+        jsonRam["stack"]   = V2Base::Memory::RAM::getStackHighWater();
+
+        const V2Base::Memory::RAM::Heap heap = V2Base::Memory::RAM::getHeap();
+
+        JsonObject jsonHeap = jsonRam["heap"].to<JsonObject>();
+        jsonHeap["size"]    = heap.size;
+        jsonHeap["used"]    = heap.used;
       }
 
       {
@@ -465,24 +852,52 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
     JsonObject jsonMidi = jsonSystem["midi"].to<JsonObject>();
     {
       JsonObject jsonIn = jsonMidi["input"].to<JsonObject>();
-      addStatistics(jsonIn, &_statistics.input);
+      addStatistics(jsonIn, &_statistics.input, getTiming(true));
+
+      // The channels which do not accept all channel messages.
+      for (uint8_t i = 0; i < 16; i++) {
+        if (getInputMask(i) == Accept::All)
+          continue;
+
+        JsonObject jsonMask = getObject(jsonIn, "mask");
+        char       channel[3];
+        sprintf(channel, "%d", i);
+        jsonMask[channel] = getInputMask(i);
+      }
 
       JsonObject jsonOut = jsonMidi["output"].to<JsonObject>();
-      addStatistics(jsonOut, &_statistics.output);
+      addStatistics(jsonOut, &_statistics.output, getTiming(false));
+
+      if (_statistics.stall.packet > 0 || _statistics.stall.rejected > 0) {
+        JsonObject jsonStall  = jsonOut["stall"].to<JsonObject>();
+        jsonStall["packet"]   = _statistics.stall.packet;
+        jsonStall["rejected"] = _statistics.stall.rejected;
+        jsonStall["usec"]     = _statistics.stall.usec;
+        jsonStall["usecMax"]  = _statistics.stall.usecMax;
+      }
     }
 
     if (link) {
       JsonObject jsonLink = jsonSystem["link"].to<JsonObject>();
-      if (link->plug) {
-        JsonObject jsonPlug = jsonLink["plug"].to<JsonObject>();
-        jsonPlug["input"]   = link->plug->statistics.input;
-        jsonPlug["output"]  = link->plug->statistics.output;
-      }
-
-      if (link->socket) {
-        JsonObject jsonSocket = jsonLink["socket"].to<JsonObject>();
-        jsonSocket["input"]   = link->socket->statistics.input;
-        jsonSocket["output"]  = link->socket->statistics.output;
+      if (link->plug)
+        addLinkStatistics(jsonLink["plug"].to<JsonObject>(), link->plug);
+
+      if (link->socket)
+        addLinkStatistics(jsonLink["socket"].to<JsonObject>(), link->socket);
+
+      // The result of the last probe, requested with the method 'probeLink'.
+      if (link->getHopCount() > 0) {
+        JsonArray jsonChain = jsonLink["chain"].to<JsonArray>();
+        uint32_t  usec{};
+        for (uint8_t i = 0; i < link->getHopCount(); i++) {
+          const V2Link::Hop* hop = link->getHop(i);
+          JsonObject jsonHop     = jsonChain.add<JsonObject>();
+          jsonHop["usec"]        = hop->usec;
+          jsonHop["usecHop"]     = hop->usec > usec ? hop->usec - usec : 0;
+          jsonHop["highWater"]   = hop->highWater;
+          jsonHop["errors"]      = hop->errors;
+          usec                   = hop->usec;
+        }
       }
     }
 
@@ -492,12 +907,67 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
       jsonSerial["output"]  = serial->statistics.output;
     }
 
+#if defined(I2S)
+    if (audio) {
+      const auto statistics = audio->takeStatistics();
+      JsonObject jsonAudio  = jsonSystem["audio"].to<JsonObject>();
+
+      jsonAudio["buffers"]   = statistics.buffers;
+      jsonAudio["underruns"] = statistics.underruns;
+      if (statistics.buffers > 0) {
+        jsonAudio["usecMin"] = statistics.usecMin;
+        jsonAudio["usecAvg"] = (uint32_t)(statistics.usec / statistics.buffers);
+        jsonAudio["usecMax"] = statistics.usecMax;
+
+        JsonObject jsonPercentile = jsonAudio["percentile"].to<JsonObject>();
+        jsonPercentile["50"]      = audio->getPercentile(&statistics, 0.5f);
+        jsonPercentile["99"]      = audio->getPercentile(&statistics, 0.99f);
+      }
+
+      JsonArray jsonBuckets = jsonAudio["percentBuckets"].to<JsonArray>();
+      JsonArray jsonCount   = jsonAudio["histogram"].to<JsonArray>();
+      for (uint8_t i = 0; i < audio->countBuckets + 1; i++) {
+        if (i < audio->countBuckets)
+          jsonBuckets.add(audio->percentBuckets[i]);
+
+        jsonCount.add(statistics.histogram[i]);
+      }
+    }
+#endif
+
+    // The measurements since the previous reply.
+    {
+      JsonObject jsonProfile = jsonSystem["profile"].to<JsonObject>();
+      JsonObject jsonLoop    = jsonProfile["loop"].to<JsonObject>();
+      jsonLoop["usecMax"]    = profiler.getUsecMax();
+      JsonArray jsonBuckets  = jsonLoop["usecBuckets"].to<JsonArray>();
+      JsonArray jsonCount    = jsonLoop["histogram"].to<JsonArray>();
+      for (uint8_t i = 0; i < profiler.countBuckets + 1; i++) {
+        if (i < profiler.countBuckets)
+          jsonBuckets.add(profiler.usecBuckets[i]);
+
+        jsonCount.add(profiler.getHistogram()[i]);
+      }
+
+      JsonObject jsonSections = jsonProfile["sections"].to<JsonObject>();
+      for (uint8_t i = 0; i < profiler.count(); i++) {
+        const auto* section = profiler.getSection(i);
+        if (section->count == 0)
+          continue;
+
+        JsonObject jsonSection = jsonSections[section->name].to<JsonObject>();
+        jsonSection["count"]   = section->count;
+        jsonSection["min"]     = profiler.cyclesToUsec(section->cyclesMin);
+        jsonSection["avg"]     = profiler.cyclesToUsec(section->cycles / section->count);
+        jsonSection["max"]     = profiler.cyclesToUsec(section->cyclesMax);
+      }
+
+      profiler.reset();
+    }
+
     exportSystem(jsonSystem);
   }
 
-  JsonArray settings = jsonDevice["settings"].to<JsonArray>();
-  exportSettings(settings);
-
   {
     JsonObject config  = jsonDevice["configuration"].to<JsonObject>();
     config["#usb"]     = "USB Settings";
@@ -530,9 +1000,13 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
     jsonDevice.remove("output");
 
   {
-    uint8_t  jsonBuffer[_sysexSize];
-    uint32_t jsonLen = serializeJson(json, (char*)jsonBuffer, _sysexSize);
-    len += escapeJSON(jsonBuffer, jsonLen, reply + len, _sysexSize - len);
+    // Insert the cached fragment after the opening of the device object; leave
+    // room for the end of the message.
+    static constexpr uint32_t prefixLen{sizeof("{\"com.versioduo.device\":{") - 1};
+    SysExWriter               writer(reply + len, _sysexSize - len - 1);
+    writer.insert(prefixLen, _reply.fragment, _reply.length);
+    serializeJson(json, writer);
+    len += writer.getLength();
   }
 
   reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusiveEnd;
@@ -541,13 +1015,25 @@ void V2Device::sendReply(V2MIDI::Transport* transport) {
 
 // Handle a SystemExclusive, JSON request from the host.
 void V2Device::handleSystemExclusive(V2MIDI::Transport* transport, const uint8_t* buffer, uint32_t len) {
-  if (len < 24)
+  if (len < 4)
     return;
 
   // 0x7d == SysEx prototype/research/private ID
   if (buffer[1] != 0x7d)
     return;
 
+  if (buffer[2] == BinaryVersion) {
+    // The method and the end of the message.
+    if (len < 5)
+      return;
+
+    handleBinary(transport, (Binary)buffer[3], buffer + 4, len - 5);
+    return;
+  }
+
+  if (len < 24)
+    return;
+
   // Handle only JSON messages.
   if (buffer[2] != '{' || buffer[len - 2] != '}')
     return;
@@ -584,18 +1070,21 @@ void V2Device::handleSystemExclusive(V2MIDI::Transport* transport, const uint8_t
   if (jsonDevice["method"] == "switchChannel") {
     if (!jsonDevice["channel"].isNull())
       handleSwitchChannel(jsonDevice["channel"]);
+    _reply.dirty = true;
     json.clear();
     sendReply(transport);
     return;
   }
 
   if (jsonDevice["method"] == "reboot") {
+    flushEEPROM();
     V2Base::Memory::Firmware::reboot();
     return;
   }
 
   if (jsonDevice["method"] == "rebootWithPorts") {
     bootData.usb.ports.enableAccess = true;
+    flushEEPROM();
     V2Base::Memory::Firmware::reboot();
     return;
   }
@@ -605,48 +1094,82 @@ void V2Device::handleSystemExclusive(V2MIDI::Transport* transport, const uint8_t
     // The data in enclosed in an object to prevent name clashes with the
     // calling convention.
     JsonObject config = jsonDevice["configuration"];
-    if (config) {
-      JsonObject jsonUsb = config["usb"];
-      if (jsonUsb) {
-        const char* n = jsonUsb["name"];
-        if (n) {
-          if (strlen(n) > 1 && strlen(n) < 32) {
-            usb.name = n;
-            strcpy(_eeprom.usb.name, n);
-
-          } else {
-            usb.name = NULL;
-            memset(_eeprom.usb.name, 0, sizeof(_eeprom.usb.name));
-          }
-        }
+    if (config)
+      updateConfiguration(config);
 
-        if (!jsonUsb["vid"].isNull()) {
-          uint16_t vid    = jsonUsb["vid"];
-          _eeprom.usb.vid = vid;
-        }
+    // Reply with the updated configuration.
+    json.clear();
+    sendReply(transport);
+    return;
+  }
 
-        if (!jsonUsb["pid"].isNull()) {
-          uint16_t pid    = jsonUsb["pid"];
-          _eeprom.usb.pid = pid;
-        }
+  // Apply a partial configuration, only the changed values are written to the
+  // EEPROM. The reply carries only the status, not the entire configuration.
+  if (jsonDevice["method"] == "updateConfiguration") {
+    JsonObject config = jsonDevice["configuration"];
+    if (config)
+      updateConfiguration(config);
 
-        if (!jsonUsb["ports"].isNull()) {
-          uint8_t p = jsonUsb["ports"];
-          if (p <= 16)
-            _eeprom.usb.ports = p;
-        }
-      }
+    json.clear();
+    sendConfigurationStatus(transport, config ? "success" : "invalidConfiguration");
+    return;
+  }
 
-      // Device-specific section.
-      if (configuration.size > 0)
-        importConfiguration(config);
+  // Periodically send the changed statistics counters, a period of 0 cancels the
+  // subscription. It is cancelled with the next USB connection.
+  if (jsonDevice["method"] == "subscribe") {
+    JsonObject     jsonSubscribe = jsonDevice["subscribe"];
+    const uint32_t period        = jsonSubscribe["period"];
+    if (!jsonSubscribe || period == 0) {
+      _subscription.transport = nullptr;
+      return;
+    }
 
-      writeConfiguration();
+    // The period in milliseconds.
+    _subscription            = {};
+    _subscription.transport  = transport;
+    _subscription.sequence   = usb.midi.getConnectionSequence();
+    _subscription.usecPeriod = (period < 10 ? 10 : period) * 1000;
+    for (const char* field : jsonSubscribe["fields"].as<JsonArray>()) {
+      for (uint8_t i = 0; i < V2Base::countof(telemetryCounters); i++) {
+        if (strcmp(field, telemetryCounters[i].section) == 0)
+          _subscription.fields |= telemetryCounters[i].field;
+      }
     }
 
-    // Reply with the updated configuration.
+    // All values are sent with the first message.
+    memset(_subscription.values, 0xff, sizeof(_subscription.values));
+    return;
+  }
+
+  // Accept only the channel messages of the mask, the bits of Port::Accept; a
+  // missing channel sets the mask of all channels. The mask is not stored.
+  if (jsonDevice["method"] == "setInputMask") {
+    JsonObject jsonMask = jsonDevice["inputMask"];
+    if (!jsonMask || jsonMask["mask"].isNull())
+      return;
+
+    const uint8_t mask = jsonMask["mask"];
+    if (jsonMask["channel"].isNull())
+      setInputMask(mask);
+
+    else
+      setInputMask(jsonMask["channel"].as<uint8_t>(), mask);
+
+    return;
+  }
+
+  // Measure the latency of the devices on the socket side of the link; the
+  // result is part of the next 'getAll' reply.
+  if (jsonDevice["method"] == "probeLink") {
+    if (link && !link->isProbing())
+      link->probe();
+    return;
+  }
+
+  if (jsonDevice["method"] == "getFirmwareManifest") {
     json.clear();
-    sendReply(transport);
+    beginFirmwareManifest(transport);
     return;
   }
 
@@ -655,61 +1178,586 @@ void V2Device::handleSystemExclusive(V2MIDI::Transport* transport, const uint8_t
     // calling convention.
     JsonObject firmware = jsonDevice["firmware"];
     if (firmware) {
-      uint32_t offset = firmware["offset"];
-      if (offset % V2Base::Memory::Flash::getBlockSize() != 0) {
-        sendFirmwareStatus(transport, "invalidOffset");
+      const uint32_t offset = firmware["offset"];
+      const char*    data   = firmware["data"];
+      if (!data) {
+        sendFirmwareStatus(transport, "invalidLength");
         return;
       }
 
-      const char* data = firmware["data"];
-      union {
-        uint32_t block[V2Base::Memory::Flash::getBlockSize() / sizeof(uint32_t)];
-        uint8_t  bytes[V2Base::Memory::Flash::getBlockSize()];
+      // The decoder stops at the size of a block, longer data is rejected.
+      const auto decode = [data](uint8_t* output, uint32_t& length) {
+        V2Base::Text::Base64::Decoder decoder;
+        decoder.begin(output, V2Base::Memory::Flash::getBlockSize());
+        if (!decoder.feed((const uint8_t*)data, strlen(data)) || !decoder.end())
+          return false;
+
+        length = decoder.getLength();
+        return true;
       };
-      uint32_t blockLen = V2Base::Text::Base64::decode((const uint8_t*)data, bytes);
 
-      memset(bytes + blockLen, 0xff, V2Base::Memory::Flash::getBlockSize() - blockLen);
-      led.setBrightness(0.3);
-      V2Base::Memory::Firmware::Secondary::writeBlock(offset, block);
-      led.setBrightness(0.1);
+      // Acknowledge the block before it is written, the host can send the next one.
+      if (firmware["queue"] == true && !firmware["hash"]) {
+        uint32_t* slot = reserveFirmwareBlock();
+        if (slot) {
+          uint32_t blockLen;
+          if (!decode((uint8_t*)slot, blockLen)) {
+            sendFirmwareStatus(transport, "invalidLength");
+            return;
+          }
+
+          switch (queueFirmwareBlock(offset, blockLen)) {
+            case FirmwareStatus::InvalidOffset:
+              sendFirmwareStatus(transport, "invalidOffset");
+              break;
+
+            case FirmwareStatus::WriteFailed:
+              sendFirmwareStatus(transport, "writeFailed");
+              break;
 
-      // The final message contains our hash over the entire image.
-      const char* hash = firmware["hash"];
-      if (hash) {
-        V2Base::Memory::Firmware::Secondary::copyBootloader();
+            default:
+              sendFirmwareStatus(transport, "success");
+              break;
+          }
+
+          return;
+        }
+      }
+
+      flushFirmwareBlocks();
+
+      uint32_t block[V2Base::Memory::Flash::getBlockSize() / sizeof(uint32_t)];
+      uint32_t blockLen;
+      if (!decode((uint8_t*)block, blockLen)) {
+        sendFirmwareStatus(transport, "invalidLength");
+        return;
+      }
 
-        if (V2Base::Memory::Firmware::Secondary::verify(offset + blockLen, hash)) {
+      switch (writeFirmwareBlock(offset, block, blockLen, firmware["hash"])) {
+        case FirmwareStatus::Success:
           sendFirmwareStatus(transport, "success");
+          break;
 
-          // Flush system exclusive message, loop() is no longer called.
-          uint32_t usec = V2Base::getUsec();
-          for (;;) {
-            if (loopSystemExclusive() == 0)
+        case FirmwareStatus::InvalidOffset:
+          sendFirmwareStatus(transport, "invalidOffset");
+          break;
+
+        case FirmwareStatus::InvalidLength:
+          sendFirmwareStatus(transport, "invalidLength");
+          break;
+
+        case FirmwareStatus::HashMismatch:
+          sendFirmwareStatus(transport, "hashMismatch");
+          break;
+
+        case FirmwareStatus::WriteFailed:
+          sendFirmwareStatus(transport, "writeFailed");
+          break;
+
+        case FirmwareStatus::Verified:
+          sendFirmwareStatus(transport, "success");
+          activateFirmware();
+          break;
+      }
+    }
+
+    return;
+  }
+}
+
+// Binary messages, the compact alternative to the JSON interface:
+//   0xf0 0x7d <version> <method> <7 bit packed payload> 0xf7
+//
+// The payload is packed in groups of seven bytes, every group starts with the
+// same 7 byte header:
+//   32 bit: token, little endian, 0 to skip the check
+//   24 bit: method-specific arguments
+//
+// The reply carries the method with bit 6 set:
+//   32 bit: token
+//    8 bit: status
+//   16 bit: padding
+void V2Device::handleBinary(V2MIDI::Transport* transport, Binary method, const uint8_t* buffer, uint32_t len) {
+  if (len < 8)
+    return;
+
+  uint8_t header[7];
+  V2Base::Text::Bits7::decode(buffer, 8, header);
+  buffer += 8;
+  len -= 8;
+
+  const uint32_t token = header[0] | header[1] << 8 | header[2] << 16 | header[3] << 24;
+  if (token != 0 && token != _boot.id)
+    return;
+
+  switch (method) {
+    case Binary::Statistics: {
+      const uint32_t words[]{
+        (uint32_t)(millis() / 1000),
+        _statistics.input.packet,
+        _statistics.output.packet,
+        link && link->plug ? link->plug->statistics.input : 0,
+        link && link->plug ? link->plug->statistics.output : 0,
+        link && link->plug ? link->plug->statistics.dropped : 0,
+        link && link->plug ? link->plug->statistics.error : 0,
+        link && link->socket ? link->socket->statistics.input : 0,
+        link && link->socket ? link->socket->statistics.output : 0,
+        link && link->socket ? link->socket->statistics.dropped : 0,
+        link && link->socket ? link->socket->statistics.error : 0,
+      };
+      sendBinaryReply(transport, method, BinaryStatus::Success, (const uint8_t*)words, sizeof(words));
+    } break;
+
+    // Arguments: 16 bit configuration version. The configuration data follows.
+    case Binary::WriteConfiguration: {
+      const uint16_t version = header[4] | header[5] << 8;
+      if (configuration.size == 0 || version != configuration.version) {
+        sendBinaryReply(transport, method, BinaryStatus::InvalidVersion);
+        break;
+      }
+
+      if (V2Base::Text::Bits7::getEncodedLength(configuration.size) != len) {
+        sendBinaryReply(transport, method, BinaryStatus::InvalidLength);
+        break;
+      }
+
+      V2Base::Text::Bits7::decode(buffer, len, (uint8_t*)configuration.data);
+      writeConfiguration();
+      _reply.dirty = true;
+      sendBinaryReply(transport, method, BinaryStatus::Success);
+    } break;
+
+    // Arguments: 16 bit block index, 8 bit flags; bit 0 marks the final block
+    // which is preceded by six groups carrying the hash as a string, bit 1 queues
+    // the block. The block data follows.
+    case Binary::WriteFirmware: {
+      const uint32_t offset = (header[4] | header[5] << 8) * V2Base::Memory::Flash::getBlockSize();
+      char           hash[42]{};
+      if (header[6] & 1) {
+        if (len < 48) {
+          sendBinaryReply(transport, method, BinaryStatus::InvalidLength);
+          break;
+        }
+
+        V2Base::Text::Bits7::decode(buffer, 48, (uint8_t*)hash);
+        hash[40] = '\0';
+        buffer += 48;
+        len -= 48;
+      }
+
+      if (len > V2Base::Text::Bits7::getEncodedLength(V2Base::Memory::Flash::getBlockSize())) {
+        sendBinaryReply(transport, method, BinaryStatus::InvalidLength);
+        break;
+      }
+
+      // Flag bit 1: acknowledge the block before it is written.
+      if ((header[6] & 3) == 2) {
+        uint32_t* slot = reserveFirmwareBlock();
+        if (slot) {
+          const uint32_t blockLen = V2Base::Text::Bits7::decode(buffer, len, (uint8_t*)slot);
+          switch (queueFirmwareBlock(offset, blockLen)) {
+            case FirmwareStatus::InvalidOffset:
+              sendBinaryReply(transport, method, BinaryStatus::InvalidOffset);
               break;
 
-            if ((uint32_t)(V2Base::getUsec() - usec) > 100 * 1000)
+            case FirmwareStatus::WriteFailed:
+              sendBinaryReply(transport, method, BinaryStatus::WriteFailed);
               break;
 
-            yield();
+            default:
+              sendBinaryReply(transport, method, BinaryStatus::Success);
+              break;
           }
 
-          // Give the host time to process the message before the USB device disconnects.
-          led.setBrightness(1);
-          delay(100);
-
-          // System reset with the new firmware image.
-          V2Base::Memory::Firmware::Secondary::activate();
+          break;
         }
+      }
 
-        sendFirmwareStatus(transport, "hashMismatch");
+      flushFirmwareBlocks();
 
-      } else {
-        sendFirmwareStatus(transport, "success");
+      uint32_t       block[V2Base::Memory::Flash::getBlockSize() / sizeof(uint32_t)];
+      const uint32_t blockLen = V2Base::Text::Bits7::decode(buffer, len, (uint8_t*)block);
+      switch (writeFirmwareBlock(offset, block, blockLen, (header[6] & 1) ? hash : nullptr)) {
+        case FirmwareStatus::Success:
+          sendBinaryReply(transport, method, BinaryStatus::Success);
+          break;
+
+        case FirmwareStatus::InvalidOffset:
+          sendBinaryReply(transport, method, BinaryStatus::InvalidOffset);
+          break;
+
+        case FirmwareStatus::InvalidLength:
+          sendBinaryReply(transport, method, BinaryStatus::InvalidLength);
+          break;
+
+        case FirmwareStatus::HashMismatch:
+          sendBinaryReply(transport, method, BinaryStatus::HashMismatch);
+          break;
+
+        case FirmwareStatus::WriteFailed:
+          sendBinaryReply(transport, method, BinaryStatus::WriteFailed);
+          break;
+
+        case FirmwareStatus::Verified:
+          sendBinaryReply(transport, method, BinaryStatus::Success);
+          activateFirmware();
+          break;
+      }
+    } break;
+
+    // The current time, the number of recorded events and the records of the
+    // event trace, the oldest first. The host aligns the clocks of the devices
+    // with the time of the reply.
+    case Binary::Trace: {
+      if constexpr (!V2Base::Timer::Trace::enabled) {
+        sendBinaryReply(transport, method, BinaryStatus::InvalidMethod);
+        break;
       }
+
+      struct {
+        uint32_t                     usec;
+        uint32_t                     count;
+        V2Base::Timer::Trace::Record records[V2Base::Timer::Trace::size];
+      } trace;
+      trace.count      = V2Base::Timer::Trace::getCount();
+      const uint16_t n = V2Base::Timer::Trace::copy(trace.records);
+      trace.usec       = V2Base::getUsec();
+      sendBinaryReply(transport, method, BinaryStatus::Success, (const uint8_t*)&trace, 8 + n * sizeof(trace.records[0]));
+    } break;
+
+    default:
+      sendBinaryReply(transport, method, BinaryStatus::InvalidMethod);
+      break;
+  }
+}
+
+void V2Device::sendBinaryReply(V2MIDI::Transport* transport,
+                               Binary             method,
+                               BinaryStatus       status,
+                               const uint8_t*     data,
+                               uint32_t           length) {
+  uint8_t* reply = getSystemExclusiveBuffer();
+  if (!reply)
+    return;
+
+  if (4 + 8 + V2Base::Text::Bits7::getEncodedLength(length) + 1 > _sysexSize)
+    return;
+
+  uint32_t len = 0;
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
+  reply[len++] = 0x7d;
+  reply[len++] = BinaryVersion;
+  reply[len++] = (uint8_t)method | 0x40;
+
+  const uint8_t header[7]{
+    (uint8_t)_boot.id, (uint8_t)(_boot.id >> 8), (uint8_t)(_boot.id >> 16), (uint8_t)(_boot.id >> 24), (uint8_t)status};
+  len += V2Base::Text::Bits7::encode(header, sizeof(header), reply + len);
+  len += V2Base::Text::Bits7::encode(data, length, reply + len);
+
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusiveEnd;
+  sendSystemExclusive(transport, len);
+}
+
+// Write a block to the secondary flash bank, 'block' needs to provide the space
+// for an entire flash block. The final block carries our hash over the entire
+// image.
+V2Device::FirmwareStatus V2Device::writeFirmwareBlock(uint32_t offset, uint32_t* block, uint32_t length, const char* hash) {
+  if (offset % V2Base::Memory::Flash::getBlockSize() != 0)
+    return FirmwareStatus::InvalidOffset;
+
+  if (length > V2Base::Memory::Flash::getBlockSize())
+    return FirmwareStatus::InvalidLength;
+
+  // A queued block was not written, the update needs to start again.
+  if (_firmware.queue.failed) {
+    _firmware.queue.failed = false;
+    return FirmwareStatus::WriteFailed;
+  }
+
+  memset((uint8_t*)block + length, 0xff, V2Base::Memory::Flash::getBlockSize() - length);
+  led.setBrightness(0.3);
+  V2Base::Memory::Firmware::Secondary::writeBlock(offset, block);
+  led.setBrightness(0.1);
+  updateFirmwareHash(offset, length);
+
+  if (!hash)
+    return FirmwareStatus::Success;
+
+  V2Base::Memory::Firmware::Secondary::copyBootloader();
+  bool valid;
+  if (_firmware.update.sequential) {
+    uint8_t digest[20];
+    _firmware.update.sha.final(digest);
+    _firmware.update.sequential = false;
+    valid                       = V2Base::Memory::Firmware::Secondary::verify(digest, hash);
+
+  } else {
+    valid = V2Base::Memory::Firmware::Secondary::verify(offset + length, hash);
+  }
+
+  if (!valid)
+    return FirmwareStatus::HashMismatch;
+
+  return FirmwareStatus::Verified;
+}
+
+// Hash the written blocks while they arrive in order, the final block needs
+// only to compare the digest.
+void V2Device::updateFirmwareHash(uint32_t offset, uint32_t length) {
+  if (offset == 0) {
+    _firmware.update.sha.init();
+    _firmware.update.length     = 0;
+    _firmware.update.sequential = true;
+  }
+
+  if (_firmware.update.sequential && offset == _firmware.update.length) {
+    const uint32_t start = V2Base::Memory::Firmware::Secondary::getStart() + V2Base::Memory::Firmware::getStart();
+    _firmware.update.sha.update((const uint8_t*)start + offset, length);
+    _firmware.update.length += length;
+
+  } else {
+    _firmware.update.sequential = false;
+  }
+}
+
+// Hash the next slice of the current firmware image.
+void V2Device::hashFirmware() {
+  const uint32_t size     = V2Base::Memory::Firmware::getSize();
+  uint32_t       position = _firmware.hashing.position;
+  uint32_t       len      = size - position;
+  if (len > 4096)
+    len = 4096;
+
+  _firmware.hashing.sha.update((const uint8_t*)V2Base::Memory::Firmware::getStart() + position, len);
+  _firmware.hashing.position = position + len;
+  if (_firmware.hashing.position < size)
+    return;
+
+  uint8_t digest[20];
+  _firmware.hashing.sha.final(digest);
+  V2Base::Memory::Firmware::formatHash(digest, _firmware.hash);
+
+  _firmware.hashing.active = false;
+}
+
+// Hash the next slice of the blocks of both flash banks.
+void V2Device::hashFirmwareManifest() {
+  constexpr uint32_t slice = 4096;
+  static_assert(V2Base::Memory::Flash::getBlockSize() % slice == 0);
+
+  const uint32_t start    = V2Base::Memory::Firmware::getStart();
+  const uint32_t size     = V2Base::Memory::Firmware::Secondary::getStart() - start;
+  const uint32_t position = _firmware.manifest.position;
+  if (position < 2 * size) {
+    const uint32_t offset = position % size;
+    const uint32_t base   = position < size ? start : V2Base::Memory::Firmware::Secondary::getStart() + start;
+    if (offset % V2Base::Memory::Flash::getBlockSize() == 0)
+      _firmware.manifest.sha.init();
+
+    _firmware.manifest.sha.update((const uint8_t*)base + offset, slice);
+    _firmware.manifest.position = position + slice;
+    if ((offset + slice) % V2Base::Memory::Flash::getBlockSize() == 0)
+      _firmware.manifest.sha.final(_firmware.manifest.digests[position / V2Base::Memory::Flash::getBlockSize()]);
+
+    return;
+  }
+
+  // Another reply is in flight, send the manifest with the next loop().
+  if (isSendingSystemExclusive())
+    return;
+
+  sendFirmwareManifest(_firmware.manifest.transport);
+  _firmware.manifest.transport = nullptr;
+}
+
+// Received firmware blocks are written to the flash from loop(), while the host
+// transfers the next block. The final block, which carries the hash, flushes the
+// queue before it is verified.
+uint32_t* V2Device::reserveFirmwareBlock() {
+  constexpr uint32_t words = V2Base::Memory::Flash::getBlockSize() / sizeof(uint32_t);
+  if (!_firmware.queue.buffer) {
+    _firmware.queue.buffer = (uint32_t*)malloc(V2Base::countof(_firmware.queue.blocks) * words * sizeof(uint32_t));
+    if (!_firmware.queue.buffer)
+      return nullptr;
+  }
+
+  if (_firmware.queue.count == V2Base::countof(_firmware.queue.blocks))
+    writeQueuedFirmwareBlock();
+
+  const uint8_t i = (_firmware.queue.tail + _firmware.queue.count) % V2Base::countof(_firmware.queue.blocks);
+  return _firmware.queue.buffer + i * words;
+}
+
+V2Device::FirmwareStatus V2Device::queueFirmwareBlock(uint32_t offset, uint32_t length) {
+  if (offset % V2Base::Memory::Flash::getBlockSize() != 0)
+    return FirmwareStatus::InvalidOffset;
+
+  // A queued block was not written, the update needs to start again.
+  if (_firmware.queue.failed) {
+    _firmware.queue.failed = false;
+    return FirmwareStatus::WriteFailed;
+  }
+
+  const uint8_t i           = (_firmware.queue.tail + _firmware.queue.count) % V2Base::countof(_firmware.queue.blocks);
+  _firmware.queue.blocks[i] = {.offset = offset, .length = length};
+  _firmware.queue.count++;
+  return FirmwareStatus::Success;
+}
+
+// Write the oldest queued block, wait until it is written.
+void V2Device::writeQueuedFirmwareBlock() {
+  // Another write of the flash needs to finish first.
+  if (!_firmware.queue.writing && !beginQueuedFirmwareBlock()) {
+    while (V2Base::Memory::Flash::poll())
+      ;
+
+    if (!beginQueuedFirmwareBlock()) {
+      _firmware.queue.failed  = true;
+      _firmware.queue.writing = true;
     }
+  }
+
+  while (V2Base::Memory::Flash::poll())
+    ;
 
+  finishQueuedFirmwareBlock();
+}
+
+// Start to write the oldest queued block, loop() polls the flash until it is written.
+// Returns false if the flash is busy with another write.
+bool V2Device::beginQueuedFirmwareBlock() {
+  constexpr uint32_t words  = V2Base::Memory::Flash::getBlockSize() / sizeof(uint32_t);
+  const uint8_t      i      = _firmware.queue.tail;
+  uint32_t*          block  = _firmware.queue.buffer + i * words;
+  const uint32_t     length = _firmware.queue.blocks[i].length;
+
+  if (length > V2Base::Memory::Flash::getBlockSize()) {
+    _firmware.queue.writing = true;
+    return true;
+  }
+
+  memset((uint8_t*)block + length, 0xff, V2Base::Memory::Flash::getBlockSize() - length);
+  if (!V2Base::Memory::Firmware::Secondary::beginWriteBlock(_firmware.queue.blocks[i].offset, block))
+    return false;
+
+  led.setBrightness(0.3);
+  _firmware.queue.writing = true;
+  return true;
+}
+
+void V2Device::finishQueuedFirmwareBlock() {
+  const uint8_t i = _firmware.queue.tail;
+  led.setBrightness(0.1);
+  if (_firmware.queue.failed)
+    _firmware.update.sequential = false;
+
+  else if (_firmware.queue.blocks[i].length <= V2Base::Memory::Flash::getBlockSize())
+    updateFirmwareHash(_firmware.queue.blocks[i].offset, _firmware.queue.blocks[i].length);
+
+  _firmware.queue.writing = false;
+  _firmware.queue.tail    = (i + 1) % V2Base::countof(_firmware.queue.blocks);
+  _firmware.queue.count--;
+}
+
+void V2Device::flushFirmwareBlocks() {
+  while (_firmware.queue.count > 0)
+    writeQueuedFirmwareBlock();
+}
+
+// Reset the system with the new firmware image, after the reply is sent.
+void V2Device::activateFirmware() {
+  // Flush system exclusive message, loop() is no longer called.
+  uint32_t usec = V2Base::getUsec();
+  for (;;) {
+    const bool pending = loopSystemExclusive() > 0;
+    if (usb.midi.flush() && !pending)
+      break;
+
+    if ((uint32_t)(V2Base::getUsec() - usec) > 100 * 1000)
+      break;
+
+    yield();
+  }
+
+  // Give the host time to process the message before the USB device disconnects.
+  led.setBrightness(1);
+  delay(100);
+
+  flushEEPROM();
+  V2Base::Memory::Firmware::Secondary::activate();
+}
+
+// Write a pending configuration to the flash before the system is reset.
+void V2Device::flushEEPROM() {
+  if (!_eepromFlush)
     return;
+
+  V2Base::Memory::EEPROM::flush();
+  _eepromFlush = false;
+}
+
+// Import the common and the device-specific sections of the configuration and
+// store it in the EEPROM.
+void V2Device::updateConfiguration(JsonObject config) {
+  JsonObject jsonUsb = config["usb"];
+  if (jsonUsb) {
+    const char* n = jsonUsb["name"];
+    if (n) {
+      if (strlen(n) > 1 && strlen(n) < 32) {
+        strcpy(_eeprom.usb.name, n);
+        usb.name = _eeprom.usb.name;
+
+      } else {
+        usb.name = NULL;
+        memset(_eeprom.usb.name, 0, sizeof(_eeprom.usb.name));
+      }
+    }
+
+    if (!jsonUsb["vid"].isNull()) {
+      uint16_t vid    = jsonUsb["vid"];
+      _eeprom.usb.vid = vid;
+    }
+
+    if (!jsonUsb["pid"].isNull()) {
+      uint16_t pid    = jsonUsb["pid"];
+      _eeprom.usb.pid = pid;
+    }
+
+    if (!jsonUsb["ports"].isNull()) {
+      uint8_t p = jsonUsb["ports"];
+      if (p <= 16)
+        _eeprom.usb.ports = p;
+    }
   }
+
+  // Device-specific section.
+  if (configuration.size > 0)
+    importConfiguration(config);
+
+  writeConfiguration();
+  _reply.dirty = true;
+}
+
+void V2Device::sendConfigurationStatus(V2MIDI::Transport* transport, const char* status) {
+  uint8_t* reply = getSystemExclusiveBuffer();
+  if (!reply)
+    return;
+
+  uint32_t len = 0;
+
+  // 0x7d == SysEx research/private ID
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusive;
+  reply[len++] = 0x7d;
+
+  JsonDocument json;
+  JsonObject   jsonDevice      = json["com.versioduo.device"].to<JsonObject>();
+  jsonDevice["token"]          = _boot.id;
+  JsonObject jsonConfiguration = jsonDevice["configuration"].to<JsonObject>();
+  jsonConfiguration["status"]  = status;
+  len += serializeJson(json, (char*)reply + len, _sysexSize - len - 1);
+
+  reply[len++] = (uint8_t)V2MIDI::Packet::Status::SystemExclusiveEnd;
+  sendSystemExclusive(transport, len);
 }
 
 void V2Device::writeConfiguration() {
@@ -717,11 +1765,17 @@ void V2Device::writeConfiguration() {
   _eeprom.local.magic   = usb.pid;
   _eeprom.local.version = configuration.version;
   _eeprom.local.size    = configuration.size;
-  V2Base::Memory::EEPROM::write(0, (const uint8_t*)&_eeprom, sizeof(_eeprom));
+
+  // Write only the changed data, the flash is updated once.
+  bool changed = V2Base::Memory::EEPROM::update(0, (const uint8_t*)&_eeprom, sizeof(_eeprom));
 
   // Device-specific section.
   if (configuration.size > 0)
-    V2Base::Memory::EEPROM::write(sizeof(_eeprom), (const uint8_t*)configuration.data, configuration.size);
+    changed |= V2Base::Memory::EEPROM::update(sizeof(_eeprom), (const uint8_t*)configuration.data, configuration.size);
+
+  // The flash is written from loop(), a save does not block the MIDI processing.
+  if (changed)
+    _eepromFlush = true;
 }
 
 bool V2Device::idle() {
@@ -10,6 +10,18 @@ auto V2LED::Basic::tick() -> void {
 }
 
 auto V2LED::Basic::setBrightness(float fraction) -> void {
+  if (_pwm.timer) {
+    if (fraction <= 0) {
+      _flash   = {};
+      fraction = 0;
+
+    } else if (fraction > 1)
+      fraction = 1;
+
+    _pwm.timer->setDuty(_pwm.pin, fraction);
+    return;
+  }
+
   if (fraction <= 0) {
     _flash = {};
     _timer->setFraction(0);
@@ -48,6 +60,11 @@ auto V2LED::Basic::loop() -> void {
 
 auto V2LED::Basic::reset() -> void {
   _flash = {};
+  if (_pwm.timer) {
+    _pwm.timer->setDuty(_pwm.pin, 0);
+    return;
+  }
+
   _timer->setFraction(0);
   _timer->disable();
   _pin.low();
@@ -1,18 +1,21 @@
 #include "V2LED.h"
+#include <algorithm>
 #include <wiring_private.h>
 
 auto V2LED::WS2812::begin() -> void {
   // Lead-in of ~300 usec to settle the signal at logic low + pixel data + ~300
   // usec latch 2.4 MBit SPI clock / 8 == 300 kByte/s == 3.33 usec / Byte.
   _dma.bufferSize = 90 + (sizeof(struct PixelDMA) * _nLEDsMax) + 90;
-  _dma.buffer     = (uint8_t*)calloc(_dma.bufferSize, 1);
-
-  // Pointer to start of encoded pixel data.
-  _pixelDMA = (struct PixelDMA*)(_dma.buffer + 90);
+  _dma.buffers[0] = (uint8_t*)calloc(_dma.bufferSize, 1);
+  if (_dma.doubleBuffer)
+    _dma.buffers[1] = (uint8_t*)calloc(_dma.bufferSize, 1);
 
   // RGB buffer to draw DMA pixel data from.
   _pixelRGB = (struct PixelRGB*)calloc(sizeof(struct PixelRGB), _nLEDsMax);
 
+  _leds.lightness = (uint8_t*)calloc(_nLightness, 1);
+  updateLightness();
+
   // Build SPI bus from SERCOM.
   //
   // SPIClass.begin() applies the board config to all given pins, which might not
@@ -39,14 +42,22 @@ auto V2LED::WS2812::reset() -> void {
 
   _splash  = {};
   _rainbow = {};
+  stopAnimations();
   setBrightness(0);
 }
 
 auto V2LED::WS2812::loop() -> void {
+  draw();
+  if (encode())
+    send();
+}
+
+// Update the pixels of the effects.
+auto V2LED::WS2812::draw() -> void {
   // Remove timed splash.
   if (_splash.startUsec > 0 && (unsigned long)(micros() - _splash.startUsec) > _splash.durationUsec) {
-    _dma.update       = true;
     _splash.startUsec = 0;
+    setDirty(0, _leds.count - 1);
   }
 
   // Draw rainbow.
@@ -74,31 +85,64 @@ auto V2LED::WS2812::loop() -> void {
       _rainbow.color -= 360;
   }
 
+  // Draw the keyframe animations, with the same frame rate as the rainbow.
+  if ((unsigned long)(micros() - _animationUsec) > 25 * 1000) {
+    _animationUsec = micros();
+    drawAnimations();
+  }
+}
+
+// Encode the pending changes. Returns true if the frame can be sent.
+auto V2LED::WS2812::encode() -> bool {
   if (!_dma.update)
-    return;
+    return false;
 
-  if (_spi->isBusy())
-    return;
+  // With a second buffer, the next frame is encoded while the current one is
+  // transmitted. A single buffer cannot be touched during the transfer.
+  const uint8_t back = _dma.buffers[1] ? _dma.front ^ 1 : 0;
+  const bool    busy = _spi->isBusy();
+  if (busy && back == _dma.front)
+    return false;
+
+  PixelDMA* pixels = (PixelDMA*)(_dma.buffers[back] + 90);
 
-  // Draw splash overlay.
+  // Draw splash overlay. It hides the buffered pixels, they are encoded again
+  // when the splash ends.
   if (_splash.startUsec > 0) {
-    PixelRGB pixel;
+    if (!(_splash.dirty & (1 << back))) {
+      _dma.update = false;
+      return false;
+    }
 
+    const PixelRGB pixel{};
     for (uint16_t i = 0; i < _leds.count; i++) {
-      PixelDMA* pixelDMA = _leds.reverse ? &_pixelDMA[_leds.count - 1 - i] : &_pixelDMA[i];
+      PixelDMA* pixelDMA = _leds.reverse ? &pixels[_leds.count - 1 - i] : &pixels[i];
       if (i >= _splash.start && i < (_splash.start + _splash.count))
         encodePixel(&_splash.pixel, pixelDMA);
       else
-        encodePixel(&pixel, _pixelDMA);
+        encodePixel(&pixel, pixelDMA);
     }
+
+    _splash.dirty &= ~(1 << back);
+
   } else {
-    for (uint16_t i = 0; i < _leds.count; i++) {
-      PixelDMA* pixelDMA = _leds.reverse ? &_pixelDMA[_leds.count - 1 - i] : &_pixelDMA[i];
+    // Encode only the pixels which have changed since this buffer was encoded.
+    for (uint16_t i = _dirty[back].first; i <= _dirty[back].last && i < _leds.count; i++) {
+      PixelDMA* pixelDMA = _leds.reverse ? &pixels[_leds.count - 1 - i] : &pixels[i];
       encodePixel(&_pixelRGB[i], pixelDMA);
     }
+
+    _dirty[back] = {};
   }
 
-  _spi->transfer(_dma.buffer, NULL, _dma.bufferSize, false);
+  // Send the encoded frame when the current transfer has finished.
+  return !busy;
+}
+
+auto V2LED::WS2812::send() -> void {
+  const uint8_t back = _dma.buffers[1] ? _dma.front ^ 1 : 0;
+  _spi->transfer(_dma.buffers[back], NULL, _dma.bufferSize, false);
+  _dma.front  = back;
   _dma.update = false;
 }
 
@@ -121,56 +165,64 @@ static auto convertWS2812(float h, float s, float v, uint8_t* rp, uint8_t* gp, u
   *bp = b;
 }
 
-auto V2LED::WS2812::setLED(uint16_t index, float h, float s, float v) -> void {
-  convertWS2812(h, s, v * _leds.maxBrightness, &_pixelRGB[index].r, &_pixelRGB[index].g, &_pixelRGB[index].b);
-  _dma.update = true;
-}
-
-static auto encodeByteFrame(uint8_t b, uint8_t f[3]) {
-  union {
-    uint32_t bits;
-    uint8_t  bytes[4];
-  } frame{.bits{0b100100100100100100100100}};
-
-  // Encode 1 bit into 3 bits frame data, 0b100 == 0, 0b110 == 1
-  if (b & 1)
-    frame.bits |= 1 << 1;
-
-  if (b & 2)
-    frame.bits |= 1 << 4;
+// The CIE 1931 lightness of all table steps, scaled by the maximum brightness.
+auto V2LED::WS2812::updateLightness() -> void {
+  if (!_leds.lightness)
+    return;
 
-  if (b & 4)
-    frame.bits |= 1 << 7;
+  for (uint16_t i = 0; i < _nLightness; i++)
+    _leds.lightness[i] = ceilf(255.f * V2Colour::toCIE1931((float)i / (float)(_nLightness - 1) * _leds.maxBrightness));
+}
 
-  if (b & 8)
-    frame.bits |= 1 << 10;
+auto V2LED::WS2812::setLED(uint16_t index, float h, float s, float v) -> void {
+  PixelRGB* pixel = &_pixelRGB[index];
 
-  if (b & 16)
-    frame.bits |= 1 << 13;
+  uint16_t step = 0;
+  if (v >= 1.f)
+    step = _nLightness - 1;
 
-  if (b & 32)
-    frame.bits |= 1 << 16;
+  else if (v > 0.f)
+    step = (v * (float)(_nLightness - 1)) + 0.5f;
 
-  if (b & 64)
-    frame.bits |= 1 << 19;
+  const uint8_t value = _leds.lightness[step];
+  if (s > 0.f)
+    V2Colour::HSVtoRGB8(h > 0.f ? h : 0, s >= 1.f ? 255 : s * 255.f, value, pixel->r, pixel->g, pixel->b);
 
-  if (b & 128)
-    frame.bits |= 1 << 22;
+  else
+    pixel->r = pixel->g = pixel->b = value;
 
-  f[0] = frame.bytes[2];
-  f[1] = frame.bytes[1];
-  f[2] = frame.bytes[0];
+  setDirty(index, index);
 }
 
+// The SPI frame data of all byte values. Encode 1 bit into 3 bits frame data,
+// 0b100 == 0, 0b110 == 1.
+static constexpr struct ByteFrames {
+  uint8_t bytes[256][3];
+
+  constexpr ByteFrames() : bytes{} {
+    for (uint16_t b = 0; b < 256; b++) {
+      uint32_t bits = 0b100100100100100100100100;
+      for (uint8_t i = 0; i < 8; i++)
+        if (b & (1 << i))
+          bits |= 1 << ((i * 3) + 1);
+
+      bytes[b][0] = bits >> 16;
+      bytes[b][1] = bits >> 8;
+      bytes[b][2] = bits;
+    }
+  }
+} _byteFrames;
+
 auto V2LED::WS2812::encodePixel(const struct PixelRGB* rgb, struct PixelDMA* dma) -> void {
-  encodeByteFrame(rgb->r, dma->r);
-  encodeByteFrame(rgb->g, dma->g);
-  encodeByteFrame(rgb->b, dma->b);
+  memcpy(dma->r, _byteFrames.bytes[rgb->r], 3);
+  memcpy(dma->g, _byteFrames.bytes[rgb->g], 3);
+  memcpy(dma->b, _byteFrames.bytes[rgb->b], 3);
 }
 
 auto V2LED::WS2812::setMaxBrightness(float fraction) -> void {
   _leds.maxBrightness = fraction;
-  _dma.update         = true;
+  updateLightness();
+  setDirty(0, _leds.count - 1);
 }
 
 auto V2LED::WS2812::setRGB(uint16_t index, uint8_t r, uint8_t g, uint8_t b) -> void {
@@ -180,7 +232,7 @@ auto V2LED::WS2812::setRGB(uint16_t index, uint8_t r, uint8_t g, uint8_t b) -> v
   _pixelRGB[index].r = (float)r * _leds.maxBrightness;
   _pixelRGB[index].g = (float)g * _leds.maxBrightness;
   _pixelRGB[index].b = (float)b * _leds.maxBrightness;
-  _dma.update        = true;
+  setDirty(index, index);
 }
 
 auto V2LED::WS2812::splashHSV(float seconds, uint16_t start, uint16_t count, float h, float s, float v) -> void {
@@ -189,6 +241,7 @@ auto V2LED::WS2812::splashHSV(float seconds, uint16_t start, uint16_t count, flo
   _splash.count        = count;
   _splash.durationUsec = seconds * 1000.f * 1000.f;
   _splash.startUsec    = micros();
+  _splash.dirty        = 0b11;
   _dma.update          = true;
 }
 
@@ -198,3 +251,158 @@ auto V2LED::WS2812::rainbow(uint8_t cycles, float seconds, float brightness, boo
   _rainbow.brightness = brightness;
   _rainbow.reverse    = reverse;
 }
+
+auto V2LED::WS2812::animate(uint16_t start, uint16_t count, const Keyframe* frames, uint8_t nFrames, bool loop, uint16_t spreadMsec)
+  -> bool {
+  if (nFrames == 0 || start >= _leds.count)
+    return false;
+
+  Animation* animation = nullptr;
+  for (uint8_t i = 0; i < _nAnimations; i++) {
+    if (_animations[i].frames)
+      continue;
+
+    animation = &_animations[i];
+    break;
+  }
+
+  if (!animation)
+    return false;
+
+  uint32_t duration = loop ? frames[0].msec : 0;
+  for (uint8_t i = 1; i < nFrames; i++)
+    duration += frames[i].msec;
+
+  *animation = {.frames{frames},
+                .nFrames{nFrames},
+                .loop{loop},
+                .start{start},
+                .count{std::min(count, (uint16_t)(_leds.count - start))},
+                .spreadMsec{spreadMsec},
+                .durationMsec{duration},
+                .startUsec{micros()}};
+  return true;
+}
+
+// The eased progress in 16 bit fixed point.
+static auto ease(V2LED::WS2812::Easing easing, uint32_t t) -> uint32_t {
+  switch (easing) {
+    case V2LED::WS2812::Easing::Step:
+      return 1 << 16;
+
+    case V2LED::WS2812::Easing::Linear:
+      return t;
+
+    case V2LED::WS2812::Easing::In:
+      return (t * t) >> 16;
+
+    case V2LED::WS2812::Easing::Out:
+      return (1 << 16) - (((uint64_t)((1 << 16) - t) * ((1 << 16) - t)) >> 16);
+
+    case V2LED::WS2812::Easing::InOut:
+      // Smoothstep, 3t² - 2t³.
+      return ((uint64_t)((t * t) >> 16) * ((3 << 16) - (2 * t))) >> 16;
+  }
+
+  return t;
+}
+
+// The colour at 'msec' into the animation.
+static auto evaluate(const V2LED::WS2812::Keyframe* frames, uint8_t nFrames, bool loop, uint32_t msec, uint16_t& h, uint8_t& s, uint8_t& v) {
+  const V2LED::WS2812::Keyframe* from = &frames[0];
+  const V2LED::WS2812::Keyframe* to   = nullptr;
+  for (uint8_t i = 1; i < nFrames; i++) {
+    if (msec < frames[i].msec) {
+      to = &frames[i];
+      break;
+    }
+
+    msec -= frames[i].msec;
+    from = &frames[i];
+  }
+
+  // Back to the first keyframe.
+  if (!to && loop && msec < frames[0].msec)
+    to = &frames[0];
+
+  if (!to) {
+    h = from->h;
+    s = from->s;
+    v = from->v;
+    return;
+  }
+
+  const uint32_t t = ease(to->easing, (msec << 16) / to->msec);
+
+  // The shorter way around the colour wheel.
+  int32_t hue = (int32_t)to->h - (int32_t)from->h;
+  if (hue > 180)
+    hue -= 360;
+
+  else if (hue < -180)
+    hue += 360;
+
+  hue = from->h + ((hue * (int32_t)t) >> 16);
+  if (hue < 0)
+    hue += 360;
+
+  else if (hue >= 360)
+    hue -= 360;
+
+  h = hue;
+  s = from->s + ((((int32_t)to->s - (int32_t)from->s) * (int32_t)t) >> 16);
+  v = from->v + ((((int32_t)to->v - (int32_t)from->v) * (int32_t)t) >> 16);
+}
+
+auto V2LED::WS2812::drawAnimations() -> void {
+  for (uint8_t a = 0; a < _nAnimations; a++) {
+    Animation* animation = &_animations[a];
+    if (!animation->frames)
+      continue;
+
+    uint32_t msec = (unsigned long)(micros() - animation->startUsec) / 1000;
+
+    // Keep the start close to the current time, after all LEDs have started.
+    const uint32_t spread = animation->count > 1 ? (animation->count - 1) * animation->spreadMsec : 0;
+    if (animation->loop && animation->durationMsec > 0 && msec >= spread + animation->durationMsec) {
+      const uint32_t cycles = (msec - spread) / animation->durationMsec;
+      animation->startUsec += cycles * animation->durationMsec * 1000;
+      msec -= cycles * animation->durationMsec;
+    }
+
+    bool done = !animation->loop;
+    for (uint16_t i = 0; i < animation->count; i++) {
+      const uint32_t delay = i * animation->spreadMsec;
+      uint32_t       t     = msec > delay ? msec - delay : 0;
+      if (t < animation->durationMsec)
+        done = false;
+
+      if (animation->loop && animation->durationMsec > 0)
+        t %= animation->durationMsec;
+
+      uint16_t h;
+      uint8_t  s, v;
+      evaluate(animation->frames, animation->nFrames, animation->loop, t, h, s, v);
+
+      const uint8_t value = _leds.lightness[(v * (_nLightness - 1)) / 255];
+      PixelRGB      pixel{};
+      if (s > 0)
+        V2Colour::HSVtoRGB8(h, s, value, pixel.r, pixel.g, pixel.b);
+
+      else
+        pixel.r = pixel.g = pixel.b = value;
+
+      const uint16_t index = animation->start + i;
+      PixelRGB*      rgb   = &_pixelRGB[index];
+      if (rgb->r == pixel.r && rgb->g == pixel.g && rgb->b == pixel.b)
+        continue;
+
+      *rgb = pixel;
+      setDirty(index, index);
+    }
+
+    // The last keyframe is reached by all LEDs.
+    if (done)
+      *animation = {};
+  }
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <V2Base.h>
+#include <cmath>
 #include <cstdint>
 
 namespace V2MIDI {
@@ -12,9 +14,18 @@ namespace V2MIDI {
       Stop,
     };
 
+    // The intervals between the received ticks.
+    struct Jitter {
+      float    usecMean;
+      float    usecDeviation;
+      uint32_t usecMin;
+      uint32_t usecMax;
+    };
+
     void reset() {
       _run  = false;
       _tick = 0;
+      _pll  = {};
     }
 
     uint32_t getTick() {
@@ -34,9 +45,53 @@ namespace V2MIDI {
       return _tick / 24;
     }
 
+    // The estimated tempo, 0 if the clock is not locked.
+    float getBPM() const {
+      if (!_pll.locked)
+        return 0;
+
+      return 60.f * 1000.f * 1000.f / (_pll.period * 24.f);
+    }
+
+    // The filtered duration of a tick.
+    float getTickUsec() const {
+      return _pll.period;
+    }
+
+    // The position in ticks, interpolated between the received ticks. The fraction
+    // does not run beyond the next expected tick.
+    float getPosition(uint32_t usec) const {
+      if (!_pll.locked)
+        return _tick;
+
+      float fraction = (float)(int32_t)(usec - _pll.usec) / _pll.period;
+      if (fraction < 0)
+        fraction = 0;
+
+      else if (fraction > 1)
+        fraction = 1;
+
+      return _tick + fraction;
+    }
+
+    float getPosition() const {
+      return getPosition(V2Base::getUsec());
+    }
+
+    const Jitter& getJitter() const {
+      return _jitter;
+    }
+
     void update(Event clock) {
+      update(clock, V2Base::getUsec());
+    }
+
+    // The timestamp of the received event.
+    void update(Event clock, uint32_t usec) {
       switch (clock) {
         case Event::Tick:
+          track(usec);
+
           // Sent at a rate of 24 per quarter note.
           if (!_run)
             break;
@@ -68,5 +123,53 @@ namespace V2MIDI {
   private:
     bool     _run{};
     uint32_t _tick{};
+
+    // Second order phase-locked loop. The period follows the tempo, the phase
+    // follows the expected time of the tick.
+    struct {
+      bool     locked;
+      uint8_t  count;
+      float    period;
+      uint32_t usec;
+      uint32_t last;
+    } _pll{};
+
+    Jitter _jitter{};
+
+    void track(uint32_t usec) {
+      const uint32_t interval = usec - _pll.last;
+      _pll.last               = usec;
+
+      // Initial tick, or the clock has paused; 24 ppqn at 20 BPM is 125 milliseconds.
+      if (_pll.count == 0 || interval > 125 * 1000) {
+        _pll.locked = false;
+        _pll.count  = 1;
+        _pll.usec   = usec;
+        return;
+      }
+
+      if (!_pll.locked) {
+        _pll.locked = true;
+        _pll.period = interval;
+        _pll.usec   = usec;
+        _jitter     = {.usecMean = (float)interval, .usecMin = interval, .usecMax = interval};
+        return;
+      }
+
+      const uint32_t expected = _pll.usec + (uint32_t)_pll.period;
+      const float    error    = (float)(int32_t)(usec - expected);
+      _pll.usec               = expected + (int32_t)(error / 4.f);
+      _pll.period += error / 16.f;
+
+      const float deviation = (float)interval - _jitter.usecMean;
+      _jitter.usecMean += deviation / 16.f;
+      const float variance  = _jitter.usecDeviation * _jitter.usecDeviation;
+      _jitter.usecDeviation = sqrtf(variance + (deviation * deviation - variance) / 16.f);
+      if (interval < _jitter.usecMin)
+        _jitter.usecMin = interval;
+
+      if (interval > _jitter.usecMax)
+        _jitter.usecMax = interval;
+    }
   };
 }
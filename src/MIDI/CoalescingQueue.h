@@ -0,0 +1,115 @@
+#pragma once
+#include "Packet.h"
+
+namespace V2MIDI {
+  // Output queue for congested transports. Continuous messages (control change,
+  // aftertouch, pitch bend, program change) replace the queued value of the same
+  // port, channel, type and controller/note in place; only the latest value is sent.
+  // All other messages are queued in order. The packets are flushed in the order
+  // they were first queued when the transport accepts packets again.
+  //
+  // Not interrupt-safe, push() and flush() need to be called from the same context.
+  template <uint8_t N> class CoalescingQueue {
+  public:
+    struct Counter {
+      // The number of packets which replaced a queued value.
+      uint32_t coalesced;
+
+      // The number of packets dropped because the queue was full.
+      uint32_t overflow;
+    };
+
+    void reset() {
+      _first      = 0;
+      _count      = 0;
+      _statistics = {};
+    }
+
+    // Returns false if the queue is full, the packet is dropped.
+    bool push(const Packet* packet) {
+      if (isContinuous(packet)) {
+        for (uint8_t i = 0; i < _count; i++) {
+          Packet* queued = &_packets[(_first + i) % N];
+          if (!isSameKey(queued, packet))
+            continue;
+
+          *queued = *packet;
+          _statistics.coalesced++;
+          return true;
+        }
+      }
+
+      if (_count == N) {
+        _statistics.overflow++;
+        return false;
+      }
+
+      _packets[(_first + _count) % N] = *packet;
+      _count++;
+      return true;
+    }
+
+    // Send the queued packets to a Transport or Port, stops at the first packet the
+    // destination does not accept. Returns the number of sent packets.
+    template <class T> uint8_t flush(T* destination) {
+      uint8_t n = 0;
+      while (_count > 0) {
+        if (!destination->send(&_packets[_first]))
+          break;
+
+        _first = (_first + 1) % N;
+        _count--;
+        n++;
+      }
+
+      return n;
+    }
+
+    uint8_t count() const {
+      return _count;
+    }
+
+    bool empty() const {
+      return _count == 0;
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  private:
+    Packet  _packets[N]{};
+    uint8_t _first{};
+    uint8_t _count{};
+    Counter _statistics{};
+
+    static bool isContinuous(const Packet* packet) {
+      switch (packet->getType()) {
+        case Packet::Status::ControlChange:
+        case Packet::Status::Aftertouch:
+        case Packet::Status::AftertouchChannel:
+        case Packet::Status::PitchBend:
+        case Packet::Status::ProgramChange:
+          return true;
+      }
+
+      return false;
+    }
+
+    // The port, the type and the channel, and the controller or note.
+    static bool isSameKey(const Packet* a, const Packet* b) {
+      if (a->getPort() != b->getPort() || a->getType() != b->getType() || a->getChannel() != b->getChannel())
+        return false;
+
+      switch (a->getType()) {
+        case Packet::Status::ControlChange:
+          return a->getController() == b->getController();
+
+        case Packet::Status::Aftertouch:
+          return a->getAftertouchNote() == b->getAftertouchNote();
+      }
+
+      return true;
+    }
+  };
+};
@@ -1,9 +1,12 @@
 #pragma once
 #include "Packet.h"
 #include <V2Base.h>
+#include <atomic>
 
 namespace V2MIDI::File {
 
+  template <uint8_t maxTracks = 16> class Tracks;
+
   // The event in a MIDI track.
   class Event {
   public:
@@ -46,9 +49,18 @@ namespace V2MIDI::File {
     uint32_t       length;
   };
 
+  // Block reader for files which are not memory-mapped, e.g. in SPI flash or on
+  // an SD card.
+  class Source {
+  public:
+    // Copy 'length' bytes at 'offset' of the file into 'buffer'.
+    virtual bool read(uint32_t offset, uint8_t* buffer, uint32_t length) = 0;
+  };
+
   // The track in a MIDI file, it contains the events.
   class Track {
   public:
+    // Memory-mapped track, NULL if the data is read from a Source.
     const uint8_t* data;
     uint32_t       length;
 
@@ -67,7 +79,7 @@ namespace V2MIDI::File {
         if (e.metaType != meta)
           continue;
 
-        if (e.length + 1 > size)
+        if (!e.data || e.length + 1 > size)
           return -1;
 
         memcpy(text, e.data, e.length);
@@ -87,13 +99,13 @@ namespace V2MIDI::File {
 
       e.delta = readNumber(cursor);
 
-      switch (data[cursor]) {
+      switch (readByte(cursor)) {
         case 0xff:
           cursor++;
           e.type     = Event::Type::Meta;
-          e.metaType = (Event::Meta)data[cursor++];
+          e.metaType = (Event::Meta)readByte(cursor++);
           e.length   = readNumber(cursor);
-          e.data     = data + cursor;
+          e.data     = getData(cursor, e.length);
           cursor += e.length;
           if (e.metaType == Event::Meta::EndOfTrack) {
             e.type = Event::Type::None;
@@ -104,21 +116,22 @@ namespace V2MIDI::File {
         case 0xf0:
         case 0xf7:
           e.type      = Event::Type::SysEx;
-          e.sysExType = data[cursor++];
+          e.sysExType = readByte(cursor++);
           e.length    = readNumber(cursor);
-          e.data      = data + cursor;
+          e.data      = getData(cursor, e.length);
           cursor += e.length;
           return true;
 
-        default:
-          e.type = Event::Type::Message;
-          if (data[cursor] >= 0x80) {
-            if (static_cast<Packet::Status>(data[cursor] & 0xf0) != Packet::Status::System) {
-              e.status  = static_cast<Packet::Status>(data[cursor] & 0xf0);
-              e.channel = data[cursor] & 0x0f;
+        default: {
+          e.type          = Event::Type::Message;
+          const uint8_t b = readByte(cursor);
+          if (b >= 0x80) {
+            if (static_cast<Packet::Status>(b & 0xf0) != Packet::Status::System) {
+              e.status  = static_cast<Packet::Status>(b & 0xf0);
+              e.channel = b & 0x0f;
 
             } else {
-              e.status  = static_cast<Packet::Status>(data[cursor]);
+              e.status  = static_cast<Packet::Status>(b);
               e.channel = 0;
             }
 
@@ -159,13 +172,28 @@ namespace V2MIDI::File {
               break;
           }
 
-          e.data = data + cursor;
+          e.data = getData(cursor, e.length);
           cursor += e.length;
+          if (!e.data) {
+            e.type = Event::Type::None;
+            return false;
+          }
           return true;
+        }
       }
     }
 
+    // The tempo of a tempo meta event, 0 if it is invalid.
+    static uint32_t readTempo(const Event* e) {
+      if (!e->data || e->length < 3)
+        return 0;
+
+      return e->data[0] << 16 | e->data[1] << 8 | e->data[2];
+    }
+
   private:
+    template <uint8_t> friend class Tracks;
+
     // MIDI Running status. Repeated channel messages of the same type and channel might omit
     // the leading status byte.
     struct {
@@ -173,12 +201,62 @@ namespace V2MIDI::File {
       uint8_t        channel;
     } _running;
 
+    // The read-ahead window of a track read from a Source.
+    struct {
+      Source*  source;
+      uint32_t offset;
+      uint8_t* buffer;
+      uint16_t size;
+      uint32_t start;
+      uint16_t length;
+    } _window{};
+
+    uint8_t readByte(uint32_t cursor) {
+      if (!_window.source)
+        return data[cursor];
+
+      if (cursor - _window.start >= _window.length && !fill(cursor))
+        return 0;
+
+      return _window.buffer[cursor - _window.start];
+    }
+
+    // Returns NULL if the data does not fit into the window, or if it cannot be read.
+    const uint8_t* getData(uint32_t cursor, uint32_t n) {
+      if (!_window.source)
+        return data + cursor;
+
+      if (n > _window.size)
+        return NULL;
+
+      if (cursor < _window.start || cursor + n > _window.start + _window.length) {
+        if (!fill(cursor) || n > _window.length)
+          return NULL;
+      }
+
+      return _window.buffer + (cursor - _window.start);
+    }
+
+    bool fill(uint32_t cursor) {
+      _window.start  = cursor;
+      _window.length = 0;
+      if (cursor >= length)
+        return false;
+
+      const uint16_t n = length - cursor < _window.size ? length - cursor : _window.size;
+      if (!_window.source->read(_window.offset + cursor, _window.buffer, n))
+        return false;
+
+      _window.length = n;
+      return true;
+    }
+
     // Read a variable-length encoded number. Big Endian, 7 bit data / byte.
-    uint32_t readNumber(uint32_t& cursor) const {
+    uint32_t readNumber(uint32_t& cursor) {
       uint32_t number = 0;
 
       for (;;) {
-        const uint8_t b = data[cursor++];
+        const uint8_t b = readByte(cursor++);
         number |= b & 0x7f;
         if (b < 0x80)
           break;
@@ -190,11 +268,50 @@ namespace V2MIDI::File {
     }
   };
 
-  // The MIDI file, it contains the tracks.
-  class Tracks {
+  // The MIDI file, it contains the tracks. 'maxTracks' is the number of tracks
+  // which can be played, every track carries a few bytes of playback state.
+  template <uint8_t maxTracks> class Tracks {
   public:
     enum class State { Empty, Loaded, Play, Stop };
 
+    // The playback state of a track at every n-th event, to seek without parsing
+    // the entire track.
+    struct IndexEntry {
+      uint32_t       cursor;
+      uint32_t       tick;
+      Packet::Status status;
+      uint8_t        channel;
+
+      // Track 0, the tempo in microseconds per beat, 0 for the default tempo.
+      uint32_t tempo;
+    };
+
+    // A tempo change in track 0, the start of a section with a constant tempo.
+    struct TempoEntry {
+      uint32_t tick;
+
+      // The time at the tick since the start of the file.
+      uint32_t usec;
+
+      // Microseconds per beat.
+      uint32_t tempo;
+    };
+
+    // A decoded message waiting for its time.
+    struct TimedPacket {
+      uint32_t usec;
+      uint8_t  track;
+      Packet   packet;
+    };
+
+    struct LookaheadCounter {
+      uint32_t sent;
+
+      // The delay between the time of the event and the time it was sent.
+      uint64_t usecLate;
+      uint32_t usecLateMax;
+    };
+
     constexpr Tracks() {}
     constexpr Tracks(const uint8_t* data = NULL) {
       load(data);
@@ -214,48 +331,76 @@ namespace V2MIDI::File {
       _data           = data;
       uint32_t cursor = 0;
 
-      if (!readSignature("MThd", cursor))
+      if (!readHeader(cursor))
         return false;
 
-      if (readBE32(cursor) != 6)
-        return false;
+      for (uint16_t i = 0; i < _header.nTracks; i++) {
+        if (!readSignature("MTrk", cursor))
+          return false;
 
-      // 0: Single multi-channel track
-      // 1: One or more simultaneous tracks/outputs
-      // 2: One or more sequentially independent single-track patterns
-      //
-      // Do not bother with version 3, it is not worth to support tracking
-      // separate a separate tempo for every track; independent tracks are
-      // preferred as separate files.
-      _header.version = readBE16(cursor);
-      if (_header.version > 1)
-        return false;
+        uint32_t length = readBE32(cursor);
+        if (length < 2)
+          return false;
 
-      // The number of tracks in the file.
-      _header.nTracks = readBE16(cursor);
-      if (_header.nTracks > _maxTracks)
-        return false;
+        _tracks[i]        = {};
+        _tracks[i].data   = _data + cursor;
+        _tracks[i].length = length;
+        cursor += length;
+      }
 
-      // The ticks per beat.
-      _header.division = readBE16(cursor);
+      buildIndex();
+      buildTempoMap();
+
+      _state = State::Loaded;
+      handleStateChange(_state);
+      return true;
+    }
+
+    // Read the file in blocks from a 'source'. Every track reads ahead into its own
+    // window of 'windowSize' bytes, 'buffer' needs to carry a window for every
+    // track. Meta and SysEx events which are larger than the window are skipped.
+    bool load(Source* source, uint8_t* buffer, uint16_t windowSize) {
+      if (_state != State::Empty) {
+        _state = State::Empty;
+        handleStateChange(_state);
+      }
+
+      uint8_t chunk[14];
+      if (!source->read(0, chunk, sizeof(chunk)))
+        return false;
 
-      // Bit 15 is SMPTE format.
-      if (_header.division & 0x8000)
+      _data           = chunk;
+      uint32_t cursor = 0;
+      if (!readHeader(cursor)) {
+        _data = NULL;
         return false;
+      }
 
+      uint32_t offset = cursor;
       for (uint16_t i = 0; i < _header.nTracks; i++) {
-        if (!readSignature("MTrk", cursor))
+        cursor = 0;
+        if (!source->read(offset, chunk, 8) || !readSignature("MTrk", cursor)) {
+          _data = NULL;
           return false;
+        }
 
         uint32_t length = readBE32(cursor);
-        if (length < 2)
+        if (length < 2) {
+          _data = NULL;
           return false;
+        }
 
-        _tracks[i].data   = _data + cursor;
-        _tracks[i].length = length;
-        cursor += length;
+        offset += 8;
+        _tracks[i]         = {};
+        _tracks[i].length  = length;
+        _tracks[i]._window = {.source = source, .offset = offset, .buffer = buffer + i * windowSize, .size = windowSize};
+        offset += length;
       }
 
+      _data = NULL;
+      buildIndex();
+      buildTempoMap();
+
       _state = State::Loaded;
       handleStateChange(_state);
       return true;
@@ -293,21 +438,157 @@ namespace V2MIDI::File {
       return _tracks[0].copyTag(meta, text, size);
     }
 
-    bool play() {
+    // Store the index in 'entries', one entry for every 'interval' events of every
+    // track. Needs to be called before load().
+    void setIndex(IndexEntry* entries, uint16_t size, uint16_t interval = 64) {
+      _index.entries  = entries;
+      _index.size     = size;
+      _index.interval = interval;
+    }
+
+    // Store the tempo changes in 'entries'. Needs to be called before load(). Without
+    // a map, or beyond its last entry, the time is calculated with the default tempo
+    // of 120 beats per minute.
+    void setTempoMap(TempoEntry* entries, uint16_t size) {
+      _tempo.entries = entries;
+      _tempo.size    = size;
+    }
+
+    uint16_t getTicksPerBeat() const {
+      return _header.division;
+    }
+
+    // The tick of the last event in the file.
+    uint32_t getDurationTicks() const {
+      return _tempo.ticks;
+    }
+
+    uint32_t getDurationUsec() const {
+      return tickToUsec(_tempo.ticks);
+    }
+
+    // Convert between the position in ticks and the time since the start of the file.
+    uint32_t tickToUsec(uint32_t tick) const {
+      const TempoEntry e = findTempo(tick, false);
+      return e.usec + (uint64_t)(tick - e.tick) * e.tempo / _header.division;
+    }
+
+    uint32_t usecToTick(uint32_t usec) const {
+      const TempoEntry e = findTempo(usec, true);
+      return e.tick + (uint64_t)(usec - e.usec) * _header.division / e.tempo;
+    }
+
+    // The current playback position.
+    uint32_t getTick() const {
+      return _play.tick;
+    }
+
+    uint32_t getUsec() const {
+      return tickToUsec(_play.tick);
+    }
+
+    // Decode the events 'usec' ahead into 'packets', a power of two number of
+    // entries. run() or loop() decodes, tick() sends the packets at their time; it
+    // is usually called from a Timer::Periodic interrupt, handleSend() is called
+    // from the interrupt handler. Needs to be called before play(), the playback
+    // needs to be stopped before seek().
+    //
+    // Player.setLookahead(packets, V2Base::countof(packets), 5000);
+    // Timer.begin([]() { Player.tick(); });
+    void setLookahead(TimedPacket* packets, uint16_t size, uint32_t usec) {
+      _lookahead.packets = packets;
+      _lookahead.size    = size;
+      _lookahead.usec    = usec;
+    }
+
+    // Send the decoded packets which are due.
+    void tick() {
+      if (_state != State::Play)
+        return;
+
+      const uint32_t now  = V2Base::getUsec();
+      uint32_t       tail = _lookahead.tail.load(std::memory_order_relaxed);
+      while (tail != _lookahead.head.load(std::memory_order_acquire)) {
+        TimedPacket* p = &_lookahead.packets[tail & (_lookahead.size - 1)];
+        if ((int32_t)(now - p->usec) < 0)
+          break;
+
+        handleSend(p->track, &p->packet);
+
+        const uint32_t late = now - p->usec;
+        _lookahead.statistics.usecLate += late;
+        if (late > _lookahead.statistics.usecLateMax)
+          _lookahead.statistics.usecLateMax = late;
+
+        _lookahead.statistics.sent++;
+        _lookahead.tail.store(++tail, std::memory_order_release);
+      }
+    }
+
+    const LookaheadCounter& getLookaheadStatistics() const {
+      return _lookahead.statistics;
+    }
+
+    bool play(uint32_t tick = 0) {
+      if (!seek(tick))
+        return false;
+
+      _play.lastUsec      = V2Base::getUsec();
+      _lookahead.decoded  = _play.lastUsec;
+      _lookahead.fraction = 0;
+      _lookahead.head.store(0, std::memory_order_relaxed);
+      _lookahead.tail.store(0, std::memory_order_relaxed);
+      _lookahead.statistics = {};
+
+      _state = State::Play;
+      handleStateChange(_state);
+      return true;
+    }
+
+    // Move the playback position to 'tick'. With an index, every track is parsed
+    // only from the last entry before the position. Tempo changes before the
+    // position are applied, all other skipped events are not sent.
+    bool seek(uint32_t tick) {
       if (_state == State::Empty)
         return false;
 
-      for (uint8_t i = 0; i < _header.nTracks; i++)
+      // The tempo at the position; the tempo events in track 0 before the position
+      // are applied again while the track is parsed.
+      setTempoUsec(findTempo(tick, false).tempo);
+      _play.tick      = tick;
+      _play.remainder = 0;
+
+      for (uint8_t i = 0; i < _header.nTracks; i++) {
         _play.tracks[i] = {};
 
-      // The default tempo, if no tempo events are in track 0.
-      setTempoBPM(120);
+        Track* track    = &_tracks[i];
+        track->_running = {};
 
-      _play.tick     = 0;
-      _play.lastUsec = V2Base::getUsec();
+        const IndexEntry* entry = findIndex(i, tick);
+        if (entry) {
+          _play.tracks[i].cursor = entry->cursor;
+          _play.tracks[i].tick   = entry->tick;
+          track->_running        = {entry->status, entry->channel};
+          if (entry->tempo > 0)
+            setTempoUsec(entry->tempo);
+        }
+
+        // Stop at the first event at or after the position, it is the pending event.
+        while (readNext(i) && _play.tracks[i].tick < tick) {
+          if (_play.tracks[i].next == Next::Tempo)
+            setTempoUsec(_play.tracks[i].value);
+        }
+      }
+
+      _play.heap.count = 0;
+      for (uint8_t i = 0; i < _header.nTracks; i++) {
+        if (_play.tracks[i].next != Next::End)
+          _play.heap.tracks[_play.heap.count++] = i;
+      }
+
+      for (int8_t i = _play.heap.count / 2 - 1; i >= 0; i--)
+        siftDown(i);
 
-      _state = State::Play;
-      handleStateChange(_state);
       return true;
     }
 
@@ -326,74 +607,46 @@ namespace V2MIDI::File {
       if (_state != State::Play)
         return;
 
+      if (_lookahead.packets) {
+        decode();
+        return;
+      }
+
       // Calculate the time since the last run.
       const uint32_t nowUsec    = V2Base::getUsec();
       const uint32_t passedUsec = (uint32_t)(nowUsec - _play.lastUsec);
       _play.lastUsec            = nowUsec;
 
-      // Add the number of ticks which have passed since the last run.
-      _play.tick += passedUsec / _play.tickDurationUsec;
-
-      bool playing{};
-
-      for (uint8_t i = 0; i < _header.nTracks; i++) {
-        if (_play.tracks[i].end)
-          continue;
-
-        playing = true;
+      // Add the number of ticks which have passed since the last run. The time is
+      // counted in units of 1/division microseconds, the duration of a tick is the
+      // tempo in microseconds per beat; the remainder carries over to the next run.
+      // The 32 bit calculation does not overflow for 16 bit times and divisions.
+      if (passedUsec <= 0xffff) {
+        const uint32_t units = passedUsec * _header.division + _play.remainder;
+        _play.tick += units / _play.tempoUsec;
+        _play.remainder = units % _play.tempoUsec;
+
+      } else {
+        const uint64_t units = (uint64_t)passedUsec * _header.division + _play.remainder;
+        _play.tick += units / _play.tempoUsec;
+        _play.remainder = units % _play.tempoUsec;
+      }
 
-        // Check if the current track has pending messages.
+      // Only the tracks with due events are visited, the track with the next
+      // event is at the top of the heap.
+      while (_play.heap.count > 0) {
+        const uint8_t i = _play.heap.tracks[0];
         if (_play.tick < _play.tracks[i].tick)
-          continue;
-
-        const Event* e = &_play.tracks[i].event;
-        for (;;) {
-          // Read a new event, or handle the previous / delayed event.
-          if (e->type == Event::Type::None) {
-            if (!_tracks[i].readEvent(_play.tracks[i].event, _play.tracks[i].cursor)) {
-              _play.tracks[i].end = true;
-              break;
-            }
-
-            if (e->delta > 0) {
-              // Delay event.
-              _play.tracks[i].tick += e->delta;
-              break;
-            }
-          }
-
-          // Track 0 might change the global playback tempo.
-          if (i == 0 && e->type == Event::Type::Meta && e->metaType == Event::Meta::Tempo) {
-            // 24 bit integer, the number of microseconds per beat. Updates the global tempo.
-            setTempoUsec(e->data[0] << 16 | e->data[1] << 8 | e->data[2]);
-            _play.tracks[i].event.type = Event::Type::None;
-            continue;
-          }
+          break;
 
-          if (e->type == Event::Type::Message) {
-            Packet midi;
-
-            switch (e->status) {
-              case Packet::Status::NoteOn:
-              case Packet::Status::NoteOff:
-              case Packet::Status::Aftertouch:
-              case Packet::Status::ControlChange:
-              case Packet::Status::PitchBend:
-                handleSend(i, midi.set(e->status, e->channel, e->data[0], e->data[1]));
-                break;
-
-              case Packet::Status::ProgramChange:
-              case Packet::Status::AftertouchChannel:
-                handleSend(i, midi.set(e->status, e->channel, e->data[0]));
-                break;
-            }
-          }
+        playTrack(i);
+        if (_play.tracks[i].next == Next::End)
+          _play.heap.tracks[0] = _play.heap.tracks[--_play.heap.count];
 
-          _play.tracks[i].event.type = Event::Type::None;
-        }
+        siftDown(0);
       }
 
-      if (!playing) {
+      if (_play.heap.count == 0) {
         _state = State::Stop;
         handleStateChange(_state);
       }
@@ -418,41 +671,136 @@ namespace V2MIDI::File {
       return false;
     }
 
+    // SysEx and meta events, the data points into the file. A SysEx message of the
+    // type 0xf0 does not include the leading 0xf0, an escaped message of the type 0xf7
+    // is sent as is. Events which do not fit into the window of a Source are skipped.
+    // With a lookahead, they are delivered when they are decoded.
+    virtual void handleSystemExclusive(uint16_t track, uint8_t type, const uint8_t* data, uint32_t length) {}
+    virtual void handleMeta(uint16_t track, Event::Meta meta, const uint8_t* data, uint32_t length) {}
+
   private:
-    static constexpr uint16_t _maxTracks{16};
-    State                     _state{};
-    uint32_t                  _usec{};
+    State    _state{};
+    uint32_t _usec{};
+
+    struct {
+      TimedPacket* packets;
+      uint16_t     size;
+      uint32_t     usec;
+
+      // The time of the decoded tick and the fraction of a microsecond in units
+      // of 1/division microseconds.
+      uint32_t decoded;
+      uint32_t fraction;
+
+      // Free-running indices, only decode() writes the head, only tick() writes
+      // the tail.
+      std::atomic<uint32_t> head;
+      std::atomic<uint32_t> tail;
+
+      LookaheadCounter statistics;
+    } _lookahead{};
+
+    // The pending event of a track.
+    enum class Next : uint8_t { None, Message, Tempo, Event, End };
 
     // The loaded MIDI file.
     const uint8_t* _data{};
 
+    struct {
+      IndexEntry* entries;
+      uint16_t    size;
+      uint16_t    interval;
+
+      // The range of entries of every track.
+      struct {
+        uint16_t first;
+        uint16_t count;
+      } tracks[maxTracks];
+    } _index{};
+
+    struct {
+      TempoEntry* entries;
+      uint16_t    size;
+      uint16_t    count;
+
+      // The tick of the last event in the file.
+      uint32_t ticks;
+    } _tempo{};
+
     struct {
       uint16_t version;
       uint16_t nTracks;
       uint16_t division;
     } _header{};
-    Track _tracks[_maxTracks]{};
+    Track _tracks[maxTracks]{};
 
     // The global tempo and track state during playback.
     struct {
-      // The duration of one MIDI tick.
-      float tickDurationUsec{};
+      // The duration of one beat.
+      uint32_t tempoUsec{};
 
-      // The current tick while playing the file.
-      float tick{};
+      // The current tick while playing the file and the time since the tick in
+      // units of 1/division microseconds.
+      uint32_t tick{};
+      uint32_t remainder{};
 
       // The last time the tick handler was called.
       uint32_t lastUsec{};
 
-      // The played tracks.
+      // The played tracks, the pending event is decoded to a message or a tempo.
       struct {
         uint32_t cursor;
-        float    tick;
-        Event    event;
-        bool     end;
-      } tracks[_maxTracks];
+
+        // The tick of the pending event.
+        uint32_t tick;
+
+        // The status, channel and data bytes of a message, the microseconds per beat,
+        // or the cursor of a SysEx or meta event.
+        uint32_t value;
+        Next     next;
+      } tracks[maxTracks];
+
+      // The playing tracks, a min-heap ordered by the tick of their next event.
+      struct {
+        uint8_t tracks[maxTracks];
+        uint8_t count;
+      } heap;
     } _play{};
 
+    // Read and check the file header.
+    bool readHeader(uint32_t& cursor) {
+      if (!readSignature("MThd", cursor))
+        return false;
+
+      if (readBE32(cursor) != 6)
+        return false;
+
+      // 0: Single multi-channel track
+      // 1: One or more simultaneous tracks/outputs
+      // 2: One or more sequentially independent single-track patterns
+      //
+      // Do not bother with version 3, it is not worth to support tracking
+      // separate a separate tempo for every track; independent tracks are
+      // preferred as separate files.
+      _header.version = readBE16(cursor);
+      if (_header.version > 1)
+        return false;
+
+      // The number of tracks in the file.
+      _header.nTracks = readBE16(cursor);
+      if (_header.nTracks > maxTracks)
+        return false;
+
+      // The ticks per beat.
+      _header.division = readBE16(cursor);
+
+      // Bit 15 is SMPTE format. The tick conversions divide by the division.
+      if (_header.division & 0x8000 || _header.division == 0)
+        return false;
+
+      return true;
+    }
+
     // Read a 4 byte section / chunk header.
     bool readSignature(const char signature[4], uint32_t& cursor) const {
       const uint8_t* header = _data + cursor;
@@ -475,13 +823,318 @@ namespace V2MIDI::File {
       return __builtin_bswap16(be16);
     }
 
-    void setTempoBPM(float bpm) {
-      const float usec = (60.f * 1000.f * 1000.f) / bpm;
-      setTempoUsec(usec);
+    // Send the due events of a track, until the next delayed event.
+    void playTrack(uint8_t i) {
+      for (;;) {
+        const uint32_t tick = _play.tracks[i].tick;
+        switch (_play.tracks[i].next) {
+          case Next::Message: {
+            const uint32_t value = _play.tracks[i].value;
+            Packet         midi;
+            if (!send(i, midi.set((Packet::Status)((value >> 16) & 0xf0), (value >> 16) & 0x0f, (value >> 8) & 0x7f, value & 0x7f)))
+              return;
+          } break;
+
+          case Next::Tempo:
+            // Track 0 might change the global playback tempo.
+            setTempoUsec(_play.tracks[i].value);
+            break;
+
+          case Next::Event: {
+            // Parse the event again, the data is only available at the cursor.
+            Event    e;
+            uint32_t cursor = _play.tracks[i].value;
+            if (!_tracks[i].readEvent(e, cursor) || !e.data)
+              break;
+
+            if (e.type == Event::Type::SysEx)
+              handleSystemExclusive(i, e.sysExType, e.data, e.length);
+
+            else
+              handleMeta(i, e.metaType, e.data, e.length);
+          } break;
+
+          default:
+            break;
+        }
+
+        if (!readNext(i))
+          return;
+
+        // Delay event.
+        if (_play.tracks[i].tick > tick)
+          return;
+      }
+    }
+
+    // Send the packet, or store it with the time of the current tick. Returns false
+    // if the lookahead is full.
+    bool send(uint8_t i, Packet* packet) {
+      if (!_lookahead.packets) {
+        handleSend(i, packet);
+        return true;
+      }
+
+      const uint32_t head = _lookahead.head.load(std::memory_order_relaxed);
+      if (head - _lookahead.tail.load(std::memory_order_acquire) == _lookahead.size)
+        return false;
+
+      _lookahead.packets[head & (_lookahead.size - 1)] = {.usec = _lookahead.decoded, .track = i, .packet = *packet};
+      _lookahead.head.store(head + 1, std::memory_order_release);
+      return true;
     }
 
-    void setTempoUsec(float usec) {
-      _play.tickDurationUsec = usec / (float)_header.division;
+    // Decode the events until the lookahead time or until the lookahead is full.
+    // The time of the events follows the tempo changes while decoding.
+    void decode() {
+      const uint32_t now = V2Base::getUsec();
+
+      while (_play.heap.count > 0) {
+        const uint32_t head = _lookahead.head.load(std::memory_order_relaxed);
+        if (head - _lookahead.tail.load(std::memory_order_acquire) == _lookahead.size)
+          return;
+
+        const uint8_t  i     = _play.heap.tracks[0];
+        const uint64_t units = (uint64_t)(_play.tracks[i].tick - _play.tick) * _play.tempoUsec + _lookahead.fraction;
+        const uint32_t usec  = _lookahead.decoded + units / _header.division;
+        if ((int32_t)(usec - now) > (int32_t)_lookahead.usec)
+          return;
+
+        _play.tick          = _play.tracks[i].tick;
+        _lookahead.decoded  = usec;
+        _lookahead.fraction = units % _header.division;
+
+        playTrack(i);
+        if (_play.tracks[i].next == Next::End)
+          _play.heap.tracks[0] = _play.heap.tracks[--_play.heap.count];
+
+        siftDown(0);
+      }
+
+      // Stop after the last packet is sent.
+      if (_lookahead.head.load(std::memory_order_relaxed) != _lookahead.tail.load(std::memory_order_acquire))
+        return;
+
+      _state = State::Stop;
+      handleStateChange(_state);
+    }
+
+    // Read the next playable event of a track; the delta times of skipped
+    // events are added to the tick.
+    bool readNext(uint8_t i) {
+      for (;;) {
+        Event          e;
+        const uint32_t cursor = _play.tracks[i].cursor;
+        if (!_tracks[i].readEvent(e, _play.tracks[i].cursor)) {
+          _play.tracks[i].next = Next::End;
+          return false;
+        }
+
+        _play.tracks[i].tick += e.delta;
+
+        // 24 bit integer, the number of microseconds per beat.
+        if (i == 0 && e.type == Event::Type::Meta && e.metaType == Event::Meta::Tempo) {
+          const uint32_t tempo = Track::readTempo(&e);
+          if (tempo == 0)
+            continue;
+
+          _play.tracks[i].next  = Next::Tempo;
+          _play.tracks[i].value = tempo;
+          return true;
+        }
+
+        if (e.type == Event::Type::SysEx || e.type == Event::Type::Meta) {
+          if (!e.data)
+            continue;
+
+          _play.tracks[i].next  = Next::Event;
+          _play.tracks[i].value = cursor;
+          return true;
+        }
+
+        if (e.type != Event::Type::Message)
+          continue;
+
+        switch (e.status) {
+          case Packet::Status::NoteOn:
+          case Packet::Status::NoteOff:
+          case Packet::Status::Aftertouch:
+          case Packet::Status::ControlChange:
+          case Packet::Status::PitchBend:
+            _play.tracks[i].value = ((uint8_t)e.status | e.channel) << 16 | e.data[0] << 8 | e.data[1];
+            break;
+
+          case Packet::Status::ProgramChange:
+          case Packet::Status::AftertouchChannel:
+            _play.tracks[i].value = ((uint8_t)e.status | e.channel) << 16 | e.data[0] << 8;
+            break;
+
+          default:
+            continue;
+        }
+
+        _play.tracks[i].next = Next::Message;
+        return true;
+      }
+    }
+
+    // Events at the same tick are played in the order of the tracks.
+    bool isBefore(uint8_t a, uint8_t b) const {
+      if (_play.tracks[a].tick != _play.tracks[b].tick)
+        return _play.tracks[a].tick < _play.tracks[b].tick;
+
+      return a < b;
+    }
+
+    void siftDown(uint8_t i) {
+      for (;;) {
+        uint8_t first = i;
+        uint8_t left  = i * 2 + 1;
+        uint8_t right = left + 1;
+        if (left < _play.heap.count && isBefore(_play.heap.tracks[left], _play.heap.tracks[first]))
+          first = left;
+
+        if (right < _play.heap.count && isBefore(_play.heap.tracks[right], _play.heap.tracks[first]))
+          first = right;
+
+        if (first == i)
+          return;
+
+        const uint8_t track      = _play.heap.tracks[i];
+        _play.heap.tracks[i]     = _play.heap.tracks[first];
+        _play.heap.tracks[first] = track;
+        i                        = first;
+      }
+    }
+
+    void buildIndex() {
+      if (!_index.entries || _index.interval == 0)
+        return;
+
+      uint16_t n = 0;
+      for (uint8_t i = 0; i < _header.nTracks; i++) {
+        Track*   track  = &_tracks[i];
+        uint32_t cursor = 0;
+        uint32_t tick   = 0;
+        uint32_t tempo  = 0;
+        track->_running = {};
+
+        _index.tracks[i] = {.first = n};
+        for (uint32_t count = 0;; count++) {
+          if (count % _index.interval == 0) {
+            if (n == _index.size)
+              break;
+
+            _index.entries[n++] = {cursor, tick, track->_running.status, track->_running.channel, tempo};
+            _index.tracks[i].count++;
+          }
+
+          Event e;
+          if (!track->readEvent(e, cursor))
+            break;
+
+          tick += e.delta;
+          if (i == 0 && e.type == Event::Type::Meta && e.metaType == Event::Meta::Tempo && Track::readTempo(&e) > 0)
+            tempo = Track::readTempo(&e);
+        }
+      }
+    }
+
+    // Record the tempo changes of track 0 and the length of the longest track.
+    void buildTempoMap() {
+      _tempo.count = 0;
+      _tempo.ticks = 0;
+
+      for (uint8_t i = 0; i < _header.nTracks; i++) {
+        Track*   track  = &_tracks[i];
+        uint32_t cursor = 0;
+        uint32_t tick   = 0;
+        track->_running = {};
+
+        for (;;) {
+          Event e;
+          if (!track->readEvent(e, cursor))
+            break;
+
+          tick += e.delta;
+          if (i == 0 && e.type == Event::Type::Meta && e.metaType == Event::Meta::Tempo)
+            addTempo(tick, Track::readTempo(&e));
+        }
+
+        if (tick > _tempo.ticks)
+          _tempo.ticks = tick;
+      }
+    }
+
+    void addTempo(uint32_t tick, uint32_t tempo) {
+      if (!_tempo.entries || _tempo.size == 0 || tempo == 0)
+        return;
+
+      if (_tempo.count == 0)
+        _tempo.entries[_tempo.count++] = {.tempo = 500 * 1000};
+
+      TempoEntry* last = &_tempo.entries[_tempo.count - 1];
+      if (tempo == last->tempo)
+        return;
+
+      // Multiple changes at the same tick, the last one wins.
+      if (tick == last->tick) {
+        last->tempo = tempo;
+        return;
+      }
+
+      if (_tempo.count == _tempo.size)
+        return;
+
+      const uint32_t usec            = last->usec + (uint64_t)(tick - last->tick) * last->tempo / _header.division;
+      _tempo.entries[_tempo.count++] = {.tick = tick, .usec = usec, .tempo = tempo};
+    }
+
+    // The last tempo entry at or before the tick or the time.
+    TempoEntry findTempo(uint32_t value, bool usec) const {
+      if (_tempo.count == 0)
+        return {.tempo = 500 * 1000};
+
+      uint16_t low  = 0;
+      uint16_t high = _tempo.count;
+      while (high - low > 1) {
+        const uint16_t mid = (low + high) / 2;
+        if ((usec ? _tempo.entries[mid].usec : _tempo.entries[mid].tick) <= value)
+          low = mid;
+
+        else
+          high = mid;
+      }
+
+      return _tempo.entries[low];
+    }
+
+    // The last entry of the track before the tick.
+    const IndexEntry* findIndex(uint8_t track, uint32_t tick) const {
+      if (!_index.entries || _index.tracks[track].count == 0)
+        return NULL;
+
+      const IndexEntry* entries = _index.entries + _index.tracks[track].first;
+      uint16_t          low     = 0;
+      uint16_t          high    = _index.tracks[track].count;
+      while (high - low > 1) {
+        const uint16_t mid = (low + high) / 2;
+        if (entries[mid].tick < tick)
+          low = mid;
+
+        else
+          high = mid;
+      }
+
+      return &entries[low];
+    }
+
+    void setTempoUsec(uint32_t usec) {
+      // A zero tempo is invalid.
+      if (usec == 0)
+        return;
+
+      _play.tempoUsec = usec;
     }
   };
 }
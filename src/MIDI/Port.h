@@ -1,7 +1,10 @@
 #pragma once
 #include "Clock.h"
 #include "Packet.h"
+#include "Queue.h"
+#include "SysExPool.h"
 #include "Transport.h"
+#include <V2Base.h>
 #include <cstdlib>
 
 namespace V2MIDI {
@@ -18,6 +21,9 @@ namespace V2MIDI {
       uint32_t program;
       uint32_t aftertouchChannel;
       uint32_t pitchbend;
+
+      // Channel messages discarded by the input mask.
+      uint32_t filtered;
       struct {
         struct {
           uint32_t tick;
@@ -27,9 +33,76 @@ namespace V2MIDI {
       } system;
     };
 
+    // Outgoing packets which had to wait for, or were rejected because of, a
+    // running SysEx transfer.
+    struct Stall {
+      uint32_t packet;
+      uint32_t rejected;
+      uint32_t usec;
+      uint32_t usecMax;
+    };
+
+    // Handler durations per message type, and the burst rate of the packets. The
+    // types are indexed by bit 4 to 6 of the status byte, NoteOff == 0 to System == 7.
+    struct Timing {
+      struct Duration {
+        uint32_t count;
+        uint32_t usecMin;
+        uint32_t usecMax;
+        uint64_t usec;
+      } type[8];
+
+      // The maximum number of packets in a window of 10 milliseconds.
+      uint32_t peak;
+
+      struct {
+        uint32_t usec;
+        uint32_t packet;
+      } window;
+    };
+
+    // The bits of the input mask, indexed by bit 4 to 6 of the status byte.
+    struct Accept {
+      enum : uint8_t {
+        NoteOff           = 1 << 0,
+        NoteOn            = 1 << 1,
+        Aftertouch        = 1 << 2,
+        ControlChange     = 1 << 3,
+        ProgramChange     = 1 << 4,
+        AftertouchChannel = 1 << 5,
+        PitchBend         = 1 << 6,
+        Note              = NoteOff | NoteOn,
+        All               = 0x7f,
+      };
+    };
+
+    // The state of the incoming SysEx stream of a USB MIDI cable.
+    struct Cable {
+      uint8_t* buffer;
+      uint32_t length;
+      bool     appending;
+
+      // Streaming mode, a part of the current message was already delivered.
+      bool chunked;
+
+      void reset() {
+        length    = 0;
+        appending = false;
+        chunked   = false;
+      }
+    };
+
     Port() = delete;
     constexpr Port(uint8_t index, uint32_t sysexSize) : _index{index}, _sysexSize{sysexSize} {}
 
+    // Streaming mode for incoming SysEx messages. The message is not buffered, it is
+    // delivered to handleSystemExclusiveChunk() in chunks of up to 'sysexStreamSize'
+    // bytes while it arrives. The outgoing buffer still carries 'sysexSize' bytes.
+    constexpr Port(uint8_t index, uint32_t sysexSize, uint32_t sysexStreamSize) :
+      _index{index},
+      _sysexSize{sysexSize},
+      _sysexStreamSize{sysexStreamSize} {}
+
     void begin() {
       // Buffer to store an incoming and outgoing SysEx messages. The buffer needs
       // to be able to carry a complete message. The message always starts with
@@ -37,15 +110,57 @@ namespace V2MIDI {
       // bytes carry 7-bit only.
       //
       // If no buffer is provided, incoming SysEx messages are discarded.
-      _sysex.in.buffer  = (uint8_t*)malloc(_sysexSize);
+      //
+      // In streaming mode, the incoming buffer is only a small staging window.
+      _sysex.in.buffer  = (uint8_t*)malloc(getSystemExclusiveInputSize());
       _sysex.out.buffer = (uint8_t*)malloc(_sysexSize);
     }
 
+    // Borrow the SysEx buffers from a shared pool instead of allocating them. A buffer
+    // is taken from the pool at the start of a message and returned after the message
+    // is handled or sent. The buffers of the pool need to carry at least 'sysexSize'
+    // bytes.
+    void begin(SysExPool* pool) {
+      _pool = pool;
+    }
+
+    // Reassemble the incoming SysEx messages of every USB MIDI cable separately, the
+    // interleaved messages of different cables do not corrupt each other. The state
+    // of cable n is 'cables[n - 1]', its buffer is borrowed from the 'pool' for the
+    // duration of a message. Cable 0 and the cables beyond 'count' share the buffer
+    // of the port.
+    void setCables(Cable* cables, uint8_t count, SysExPool* pool) {
+      _cables.entries = cables;
+      _cables.count   = count;
+      _cables.pool    = pool;
+      for (uint8_t i = 0; i < count; i++)
+        cables[i] = {};
+    }
+
     // During dispatch(), replies can be sent back to the given 'transport'.
     void dispatch(Transport* transport, Packet* packet) {
+      V2Base::Timer::Trace::record(V2Base::Timer::Trace::Event::Dispatched, packet->_data);
       _statistics.input.packet++;
+      selectCable(packet->getPort());
+
+      // Discard the channel messages which are not accepted, before they are decoded.
+      const uint8_t codeIndex = packet->_data[0] & 0x0f;
+      if (codeIndex >= (uint8_t)Packet::CodeIndex::NoteOff && codeIndex <= (uint8_t)Packet::CodeIndex::PitchBend &&
+          _inputReject[packet->_data[1] & 0x0f] & (1 << (codeIndex - (uint8_t)Packet::CodeIndex::NoteOff))) {
+        _statistics.input.filtered++;
+
+        // A channel message ends any SysEx stream.
+        if (_input->appending)
+          resetSystemExclusiveInput();
 
-      if (!storeSystemExclusive(packet))
+        return;
+      }
+
+      const uint32_t usec = _instrumentation ? V2Base::getUsec() : 0;
+      if (_instrumentation)
+        countRate(&_statistics.timing.input, usec);
+
+      if (!storeSystemExclusive(transport, packet))
         return;
 
       if (packet->getType() != Packet::Status::SystemExclusive)
@@ -114,8 +229,15 @@ namespace V2MIDI {
 
         case Packet::Status::SystemExclusive: {
           _statistics.input.system.exclusive++;
-          handleSystemExclusive(transport, _sysex.in.buffer, _sysex.in.length);
-          handleSystemExclusive(_sysex.in.buffer, _sysex.in.length);
+          if (_sysexStreamSize > 0) {
+            deliverSystemExclusiveChunk(transport, true);
+
+          } else {
+            handleSystemExclusive(transport, _input->buffer, _input->length);
+            handleSystemExclusive(_input->buffer, _input->length);
+          }
+
+          resetSystemExclusiveInput();
         } break;
 
         case Packet::Status::SystemReset:
@@ -123,77 +245,115 @@ namespace V2MIDI {
           handleSystemReset();
           break;
       }
+
+      if (_instrumentation)
+        countDuration(&_statistics.timing.input, packet, usec);
+    }
+
+    // Dispatch a batch of packets, e.g. an entire USB endpoint buffer returned
+    // by Transport::receive(packets, max).
+    void dispatch(Transport* transport, Packet* packets, uint32_t count) {
+      for (uint32_t i = 0; i < count; i++)
+        dispatch(transport, packets + i);
+    }
+
+    // Drain the packets which were queued from interrupt context.
+    template <uint32_t N> void dispatch(Transport* transport, Queue<N>* queue) {
+      Packet packet;
+      while (queue->pop(&packet))
+        dispatch(transport, &packet);
     }
 
     // Set the port's number in the outgoing packet and updates the statistics.
     bool send(Packet* packet) {
-      // Do not interrupt a system exclusive transfer.
-      if (_sysex.out.length > 0)
-        return false;
-
       packet->setPort(_index);
-      if (!handleSend(packet))
-        return false;
 
-      _statistics.output.packet++;
+      if (_sysex.out.length > 0) {
+        // Do not interrupt a system exclusive transfer with anything else than
+        // the messages which can be slotted between the SysEx packets.
+        if (!isInterleaved(packet)) {
+          beginStall();
+          _statistics.stall.rejected++;
+          return false;
+        }
 
-      switch (packet->getType()) {
-        case Packet::Status::NoteOn:
-          _statistics.output.note++;
-          break;
+        if (_sysex.priority.empty() && sendPacket(packet))
+          return true;
 
-        case Packet::Status::NoteOff:
-          _statistics.output.noteOff++;
-          break;
+        // Send it before the next SysEx packet.
+        beginStall();
+        _statistics.stall.packet++;
+        return _sysex.priority.push(packet);
+      }
 
-        case Packet::Status::Aftertouch:
-          _statistics.output.aftertouch++;
-          break;
+      // Preserve the order of the still queued packets.
+      if (!sendPriority())
+        return false;
 
-        case Packet::Status::ControlChange:
-          _statistics.output.control++;
-          break;
+      return sendPacket(packet);
+    }
 
-        case Packet::Status::ProgramChange:
-          _statistics.output.program++;
-          break;
+    // Messages which are sent in between the packets of an outgoing SysEx transfer;
+    // the USB-MIDI code index allows it for every packet. System real-time messages
+    // are always interleaved, notes only if enabled. Interleaved notes abort the
+    // SysEx reception of a MIDI 1.0 receiver, or of a V2MIDI::Port.
+    void setSystemExclusiveInterleave(bool notes) {
+      _sysex.interleaveNotes = notes;
+    }
 
-        case Packet::Status::AftertouchChannel:
-          _statistics.output.aftertouchChannel++;
-          break;
+    const Stall& getStallStatistics() const {
+      return _statistics.stall;
+    }
 
-        case Packet::Status::PitchBend:
-          _statistics.output.pitchbend++;
-          break;
+    // Accept only the channel messages of the 'mask', a combination of Accept bits.
+    // System messages are always accepted.
+    void setInputMask(uint8_t channel, uint8_t mask) {
+      _inputReject[channel & 0x0f] = ~mask & Accept::All;
+    }
 
-        case Packet::Status::SystemClock:
-          _statistics.output.system.clock.tick++;
-          break;
+    void setInputMask(uint8_t mask) {
+      for (uint8_t i = 0; i < 16; i++)
+        setInputMask(i, mask);
+    }
 
-        case Packet::Status::SystemReset:
-          _statistics.output.system.reset++;
-          break;
-      }
+    uint8_t getInputMask(uint8_t channel) const {
+      return ~_inputReject[channel & 0x0f] & Accept::All;
+    }
 
-      return true;
+    // Measure the duration of the handlers and the packet rate. Every packet
+    // reads the timer twice.
+    void setInstrumentation(bool enable) {
+      _instrumentation = enable;
+    }
+
+    // Returns NULL if the instrumentation is not enabled.
+    const Timing* getTiming(bool input) const {
+      if (!_instrumentation)
+        return NULL;
+
+      return input ? &_statistics.timing.input : &_statistics.timing.output;
     }
 
-    // Get the raw buffer to copy the SysEx message into.
+    // Get the raw buffer to copy the SysEx message into. Returns NULL if the shared
+    // pool has no buffer available.
     uint8_t* getSystemExclusiveBuffer() {
+      if (!_sysex.out.buffer && _pool)
+        _sysex.out.buffer = _pool->acquire();
+
       return _sysex.out.buffer;
     }
 
     // Prepare SysEx message to chunk into packets. Send as many packets as possible,
     // the remaining packets will be sent with loopSystemExclusive().
     void sendSystemExclusive(Transport* transport, uint32_t length) {
-      if (length < 2)
-        return;
-
-      if (_sysex.out.buffer[0] != static_cast<uint8_t>(Packet::Status::SystemExclusive))
+      if (!_sysex.out.buffer)
         return;
 
-      if (_sysex.out.buffer[length - 1] != static_cast<uint8_t>(Packet::Status::SystemExclusiveEnd))
+      if (length < 2 || _sysex.out.buffer[0] != static_cast<uint8_t>(Packet::Status::SystemExclusive) ||
+          _sysex.out.buffer[length - 1] != static_cast<uint8_t>(Packet::Status::SystemExclusiveEnd)) {
+        releaseSystemExclusiveOutput();
         return;
+      }
 
       _sysex.out.transport = transport;
       _sysex.out.length    = length;
@@ -205,8 +365,16 @@ namespace V2MIDI {
     }
 
     void resetSystemExclusive() {
-      _sysex.in.reset();
+      for (uint8_t i = 0; i <= _cables.count; i++) {
+        selectCable(i);
+        resetSystemExclusiveInput();
+      }
+
+      selectCable(0);
       _sysex.out.reset();
+      _sysex.priority.reset();
+      endStall();
+      releaseSystemExclusiveOutput();
     }
 
     // Send the next packet over the specified transport. Returns:
@@ -214,6 +382,10 @@ namespace V2MIDI {
     // -1: sending failed,
     //  1: there are remaining packets.
     int8_t loopSystemExclusive() {
+      // Real-time messages before the next SysEx packet.
+      if (!sendPriority())
+        return -1;
+
       if (_sysex.out.length == 0)
         return 0;
 
@@ -268,17 +440,36 @@ namespace V2MIDI {
       _sysex.out.transport = NULL;
       _sysex.out.length    = 0;
       _statistics.output.system.exclusive++;
+      endStall();
+      releaseSystemExclusiveOutput();
       return 0;
     }
 
   protected:
+    // The cable number of the packet currently dispatched.
+    uint8_t getCable() const {
+      return _cable;
+    }
+
+    // A SysEx message is still chunked by loopSystemExclusive(), the output buffer
+    // must not be overwritten.
+    bool isSendingSystemExclusive() const {
+      return _sysex.out.length > 0;
+    }
+
     const uint8_t  _index;
     const uint32_t _sysexSize;
+    const uint32_t _sysexStreamSize{};
 
     friend class Packet;
     struct {
       Counter input;
       Counter output;
+      Stall   stall;
+      struct {
+        Timing input;
+        Timing output;
+      } timing;
     } _statistics{};
 
     virtual void handleNote(uint8_t channel, uint8_t note, uint8_t velocity) {}
@@ -301,22 +492,35 @@ namespace V2MIDI {
     // During dispatch, replies are sent back to the originating transport.
     virtual void handleSystemExclusive(Transport* transport, const uint8_t* buffer, uint32_t len) {}
 
+    // Streaming mode, a part of the incoming SysEx message. The first chunk starts with
+    // 0xf0 (SystemExclusive), the last one ends with 0xf7 (SystemExclusiveEnd). A chunk
+    // with 'first' set discards a previous, incomplete message.
+    virtual void handleSystemExclusiveChunk(const uint8_t* buffer, uint32_t len, bool first, bool last) {}
+    virtual void handleSystemExclusiveChunk(Transport* transport, const uint8_t* buffer, uint32_t len, bool first, bool last) {}
+
     virtual bool handleSend(Packet* packet) {
       return false;
     }
 
   private:
+    SysExPool* _pool{};
+    bool       _instrumentation{};
+
+    // The inverted input mask, the default accepts everything.
+    uint8_t _inputReject[16]{};
+
     struct {
-      struct {
-        uint8_t* buffer;
-        uint32_t length;
-        bool     appending;
+      Cable*     entries;
+      uint8_t    count;
+      SysExPool* pool;
+    } _cables{};
 
-        void reset() {
-          length    = 0;
-          appending = false;
-        }
-      } in;
+    // The SysEx input state of the packet currently dispatched.
+    uint8_t _cable{};
+    Cable*  _input{&_sysex.in};
+
+    struct {
+      Cable in;
 
       struct {
         Transport* transport;
@@ -329,10 +533,232 @@ namespace V2MIDI {
           position = 0;
         }
       } out;
+
+      // Packets waiting to be slotted between the packets of the outgoing
+      // SysEx transfer.
+      Queue<8> priority;
+      bool     interleaveNotes;
+
+      // The start of the current stall.
+      bool     stalled;
+      uint32_t stallUsec;
     } _sysex{};
 
-    bool storeSystemExclusive(Packet* packet) {
-      switch (static_cast<Packet::CodeIndex>(packet->_data[0] & 0x0f)) {
+    bool isInterleaved(const Packet* packet) const {
+      switch (packet->getType()) {
+        case Packet::Status::SystemClock:
+        case Packet::Status::SystemStart:
+        case Packet::Status::SystemContinue:
+        case Packet::Status::SystemStop:
+        case Packet::Status::SystemActiveSensing:
+        case Packet::Status::SystemReset:
+          return true;
+
+        case Packet::Status::NoteOn:
+        case Packet::Status::NoteOff:
+          return _sysex.interleaveNotes;
+      }
+
+      return false;
+    }
+
+    // Returns false if not all queued packets could be sent.
+    bool sendPriority() {
+      Packet packet;
+      while (_sysex.priority.peek(&packet)) {
+        if (!sendPacket(&packet))
+          return false;
+
+        _sysex.priority.pop(&packet);
+      }
+
+      return true;
+    }
+
+    void beginStall() {
+      if (_sysex.stalled)
+        return;
+
+      _sysex.stalled   = true;
+      _sysex.stallUsec = V2Base::getUsec();
+    }
+
+    void endStall() {
+      if (!_sysex.stalled)
+        return;
+
+      const uint32_t usec = V2Base::getUsecSince(_sysex.stallUsec);
+      _sysex.stalled      = false;
+      _statistics.stall.usec += usec;
+      if (usec > _statistics.stall.usecMax)
+        _statistics.stall.usecMax = usec;
+    }
+
+    bool sendPacket(Packet* packet) {
+      const uint32_t usec = _instrumentation ? V2Base::getUsec() : 0;
+      if (!handleSend(packet))
+        return false;
+
+      if (_instrumentation) {
+        countRate(&_statistics.timing.output, usec);
+        countDuration(&_statistics.timing.output, packet, usec);
+      }
+
+      countOutput(packet);
+      return true;
+    }
+
+    static void countRate(Timing* timing, uint32_t usec) {
+      if (usec - timing->window.usec >= 10 * 1000) {
+        timing->window.usec   = usec;
+        timing->window.packet = 0;
+      }
+
+      timing->window.packet++;
+      if (timing->window.packet > timing->peak)
+        timing->peak = timing->window.packet;
+    }
+
+    static void countDuration(Timing* timing, const Packet* packet, uint32_t usec) {
+      const uint32_t duration = V2Base::getUsecSince(usec);
+      auto*          type     = &timing->type[(static_cast<uint8_t>(packet->getType()) >> 4) & 7];
+
+      if (type->count == 0 || duration < type->usecMin)
+        type->usecMin = duration;
+
+      if (duration > type->usecMax)
+        type->usecMax = duration;
+
+      type->usec += duration;
+      type->count++;
+    }
+
+    void countOutput(const Packet* packet) {
+      _statistics.output.packet++;
+
+      switch (packet->getType()) {
+        case Packet::Status::NoteOn:
+          _statistics.output.note++;
+          break;
+
+        case Packet::Status::NoteOff:
+          _statistics.output.noteOff++;
+          break;
+
+        case Packet::Status::Aftertouch:
+          _statistics.output.aftertouch++;
+          break;
+
+        case Packet::Status::ControlChange:
+          _statistics.output.control++;
+          break;
+
+        case Packet::Status::ProgramChange:
+          _statistics.output.program++;
+          break;
+
+        case Packet::Status::AftertouchChannel:
+          _statistics.output.aftertouchChannel++;
+          break;
+
+        case Packet::Status::PitchBend:
+          _statistics.output.pitchbend++;
+          break;
+
+        case Packet::Status::SystemClock:
+          _statistics.output.system.clock.tick++;
+          break;
+
+        case Packet::Status::SystemReset:
+          _statistics.output.system.reset++;
+          break;
+      }
+    }
+
+    void selectCable(uint8_t cable) {
+      _cable = cable;
+      _input = (cable > 0 && cable <= _cables.count) ? &_cables.entries[cable - 1] : &_sysex.in;
+    }
+
+    SysExPool* getInputPool() const {
+      return _input == &_sysex.in ? _pool : _cables.pool;
+    }
+
+    // Discard the incoming message, return a borrowed buffer to the pool.
+    void resetSystemExclusiveInput() {
+      _input->reset();
+
+      SysExPool* pool = getInputPool();
+      if (pool && _input->buffer) {
+        pool->release(_input->buffer);
+        _input->buffer = NULL;
+      }
+    }
+
+    void releaseSystemExclusiveOutput() {
+      if (_pool && _sysex.out.buffer) {
+        _pool->release(_sysex.out.buffer);
+        _sysex.out.buffer = NULL;
+      }
+    }
+
+    uint32_t getSystemExclusiveInputSize() const {
+      return _sysexStreamSize > 0 ? _sysexStreamSize : _sysexSize;
+    }
+
+    // Check if 'n' more bytes fit into the buffer. In streaming mode, the staged
+    // bytes of the current message are delivered to make room.
+    bool reserveSystemExclusive(Transport* transport, uint32_t n) {
+      const uint32_t length = _input->appending ? _input->length : 0;
+      if (length + n <= getSystemExclusiveInputSize())
+        return true;
+
+      if (_sysexStreamSize < 3 || !_input->appending)
+        return false;
+
+      deliverSystemExclusiveChunk(transport, false);
+      return true;
+    }
+
+    void deliverSystemExclusiveChunk(Transport* transport, bool last) {
+      const bool first = !_input->chunked;
+      handleSystemExclusiveChunk(transport, _input->buffer, _input->length, first, last);
+      handleSystemExclusiveChunk(_input->buffer, _input->length, first, last);
+      _input->length  = 0;
+      _input->chunked = !last;
+    }
+
+    bool storeSystemExclusive(Transport* transport, Packet* packet) {
+      const auto codeIndex = static_cast<Packet::CodeIndex>(packet->_data[0] & 0x0f);
+
+      // Borrow a buffer from the pool for the SysEx stream.
+      if (!_input->buffer) {
+        switch (codeIndex) {
+          case Packet::CodeIndex::SystemExclusiveStart:
+          case Packet::CodeIndex::SystemExclusiveEnd1:
+          case Packet::CodeIndex::SystemExclusiveEnd2:
+          case Packet::CodeIndex::SystemExclusiveEnd3:
+            if (SysExPool* pool = getInputPool())
+              _input->buffer = pool->acquire();
+
+            if (!_input->buffer) {
+              _input->reset();
+              return false;
+            }
+            break;
+        }
+      }
+
+      // Return the buffer of discarded or invalid streams to the pool.
+      const bool complete = appendSystemExclusive(transport, packet, codeIndex);
+      if (!complete && !_input->appending)
+        resetSystemExclusiveInput();
+
+      return complete;
+    }
+
+    bool appendSystemExclusive(Transport* transport, Packet* packet, Packet::CodeIndex codeIndex) {
+      switch (codeIndex) {
         case Packet::CodeIndex::SystemCommon2:
         case Packet::CodeIndex::SystemCommon3:
         case Packet::CodeIndex::NoteOff:
@@ -343,132 +769,138 @@ namespace V2MIDI {
         case Packet::CodeIndex::AftertouchChannel:
         case Packet::CodeIndex::PitchBend:
           // Return single packet message, discard any possible SysEx stream.
-          _sysex.in.appending = false;
-          _sysex.in.length    = 0;
+          resetSystemExclusiveInput();
           return true;
 
         case Packet::CodeIndex::SingleByte:
           // Single byte, like a system message.
-          if (!_sysex.in.appending) {
-            _sysex.in.reset();
+          if (!_input->appending) {
+            resetSystemExclusiveInput();
             return true;
           }
 
+          // Real-time message in the middle of a SysEx packet stream.
+          if (packet->_data[1] & 0x80)
+            return true;
+
           // Used in the middle of a SysEx packet stream to transport a single byte instead of three.
-          if (_sysex.in.length + 1 > _sysexSize) {
-            _sysex.in.reset();
+          if (!reserveSystemExclusive(transport, 1)) {
+            resetSystemExclusiveInput();
             return false;
           }
 
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[1];
+          _input->buffer[_input->length++] = packet->_data[1];
           return false;
 
         // Start of a new SysEx stream, or append data to the current stream.
         case Packet::CodeIndex::SystemExclusiveStart:
           // Not enough space to store the stream.
-          if (_sysex.in.length + 3 > _sysexSize) {
-            _sysex.in.reset();
+          if (!reserveSystemExclusive(transport, 3)) {
+            resetSystemExclusiveInput();
             return false;
           }
 
-          if (!_sysex.in.appending) {
-            _sysex.in.length = 0;
+          if (!_input->appending) {
+            _input->length  = 0;
+            _input->chunked = false;
 
             // Must be the start of a SysEx.
             if (packet->_data[1] != static_cast<uint8_t>(Packet::Status::SystemExclusive))
               return false;
 
-            _sysex.in.appending = true;
+            _input->appending = true;
           }
 
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[1];
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[2];
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[3];
+          _input->buffer[_input->length++] = packet->_data[1];
+          _input->buffer[_input->length++] = packet->_data[2];
+          _input->buffer[_input->length++] = packet->_data[3];
           return false;
 
         // End of SysEx stream with various lengths.
         case Packet::CodeIndex::SystemExclusiveEnd1:
           // Invalid 'End' packet
           if (packet->_data[1] != static_cast<uint8_t>(Packet::Status::SystemExclusiveEnd)) {
-            _sysex.in.reset();
+            resetSystemExclusiveInput();
             return false;
           }
 
           // 'End' packet without previous data, discarding.
-          if (!_sysex.in.appending) {
-            _sysex.in.length = 0;
+          if (!_input->appending) {
+            _input->length = 0;
             return false;
           }
 
           // Not enough space to store the stream.
-          if (_sysex.in.length + 1 > _sysexSize) {
-            _sysex.in.reset();
+          if (!reserveSystemExclusive(transport, 1)) {
+            resetSystemExclusiveInput();
             return false;
           }
 
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[1];
+          _input->buffer[_input->length++] = packet->_data[1];
           break;
 
         case Packet::CodeIndex::SystemExclusiveEnd2:
           // Invalid 'End' packet.
           if (packet->_data[2] != static_cast<uint8_t>(Packet::Status::SystemExclusiveEnd)) {
-            _sysex.in.reset();
+            resetSystemExclusiveInput();
             return false;
           }
 
           // Not enough space to store the stream.
-          if (_sysex.in.length + 2 > _sysexSize) {
-            _sysex.in.reset();
+          if (!reserveSystemExclusive(transport, 2)) {
+            resetSystemExclusiveInput();
             return false;
           }
 
           // Single 'End' packet.
-          if (!_sysex.in.appending) {
-            _sysex.in.length = 0;
+          if (!_input->appending) {
+            _input->length  = 0;
+            _input->chunked = false;
 
             // Must be an 'empty' SysEx.
             if (packet->_data[1] != static_cast<uint8_t>(Packet::Status::SystemExclusive))
               return false;
           }
 
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[1];
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[2];
+          _input->buffer[_input->length++] = packet->_data[1];
+          _input->buffer[_input->length++] = packet->_data[2];
           break;
 
         case Packet::CodeIndex::SystemExclusiveEnd3:
           // Invalid 'End' packet.
           if (packet->_data[3] != static_cast<uint8_t>(Packet::Status::SystemExclusiveEnd)) {
-            _sysex.in.reset();
+            resetSystemExclusiveInput();
             return false;
           }
 
           // Not enough space to store the stream.
-          if (_sysex.in.length + 3 > _sysexSize) {
-            _sysex.in.reset();
+          if (!reserveSystemExclusive(transport, 3)) {
+            resetSystemExclusiveInput();
             return false;
           }
 
           // Single 'End' packet.
-          if (!_sysex.in.appending) {
-            _sysex.in.length = 0;
+          if (!_input->appending) {
+            _input->length  = 0;
+            _input->chunked = false;
 
             // Must be a 'one byte' SysEx.
             if (packet->_data[1] != static_cast<uint8_t>(Packet::Status::SystemExclusive))
               return false;
           }
 
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[1];
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[2];
-          _sysex.in.buffer[_sysex.in.length++] = packet->_data[3];
+          _input->buffer[_input->length++] = packet->_data[1];
+          _input->buffer[_input->length++] = packet->_data[2];
+          _input->buffer[_input->length++] = packet->_data[3];
           break;
 
         default:
-          _sysex.in.reset();
+          resetSystemExclusiveInput();
           return false;
       }
 
       // Always return 'SystemExclusive' as type.
-      _sysex.in.appending = false;
+      _input->appending = false;
       packet->_data[1]    = static_cast<uint8_t>(Packet::Status::SystemExclusive);
       return true;
     }
@@ -0,0 +1,105 @@
+#pragma once
+#include "Packet.h"
+#include <atomic>
+
+namespace V2MIDI {
+  // Single-producer/single-consumer ring of packets. One side, usually an interrupt
+  // handler (UART RXC, USB callback), pushes packets; the other side, usually loop(),
+  // pops them and hands them to Port::dispatch(). No locks are needed as long as
+  // there is only one producer and one consumer.
+  template <uint32_t N> class Queue {
+  public:
+    static_assert(N > 0 && (N & (N - 1)) == 0, "The size needs to be a power of two");
+
+    struct Counter {
+      // The maximum number of packets waiting in the queue.
+      uint32_t highWater;
+
+      // The number of packets dropped because the queue was full.
+      uint32_t overflow;
+    };
+
+    // Discard all packets. Must not race against push().
+    void reset() {
+      _head.store(0, std::memory_order_relaxed);
+      _tail.store(0, std::memory_order_relaxed);
+      _statistics = {};
+    }
+
+    // Called by the producer. Returns false if the queue is full, the packet is dropped.
+    bool push(const Packet* packet) {
+      const uint32_t head = _head.load(std::memory_order_relaxed);
+      const uint32_t used = head - _tail.load(std::memory_order_acquire);
+      if (used == N) {
+        _statistics.overflow++;
+        return false;
+      }
+
+      _packets[head & (N - 1)] = *packet;
+      _head.store(head + 1, std::memory_order_release);
+
+      if (used + 1 > _statistics.highWater)
+        _statistics.highWater = used + 1;
+
+      return true;
+    }
+
+    // Called by the consumer. Returns false if the queue is empty.
+    bool pop(Packet* packet) {
+      const uint32_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail == _head.load(std::memory_order_acquire))
+        return false;
+
+      *packet = _packets[tail & (N - 1)];
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Called by the consumer. Copy the next packet without removing it.
+    bool peek(Packet* packet) const {
+      const uint32_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail == _head.load(std::memory_order_acquire))
+        return false;
+
+      *packet = _packets[tail & (N - 1)];
+      return true;
+    }
+
+    // Pop up to 'max' packets, returns the number of packets stored in 'packets'.
+    uint32_t pop(Packet* packets, uint32_t max) {
+      const uint32_t tail = _tail.load(std::memory_order_relaxed);
+      uint32_t       n    = _head.load(std::memory_order_acquire) - tail;
+      if (n > max)
+        n = max;
+
+      for (uint32_t i = 0; i < n; i++)
+        packets[i] = _packets[(tail + i) & (N - 1)];
+
+      _tail.store(tail + n, std::memory_order_release);
+      return n;
+    }
+
+    uint32_t count() const {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+      return count() == 0;
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  private:
+    Packet _packets[N]{};
+
+    // Free-running indices, only the producer writes the head, only the consumer
+    // writes the tail.
+    std::atomic<uint32_t> _head{};
+    std::atomic<uint32_t> _tail{};
+
+    // Updated by the producer only.
+    Counter _statistics{};
+  };
+}
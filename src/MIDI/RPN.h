@@ -1,4 +1,6 @@
 #pragma once
+#include "CC.h"
+#include <cstdint>
 
 // Registered Parameter Numbers.
 namespace V2MIDI::RPN {
@@ -14,3 +16,118 @@ namespace V2MIDI::RPN {
     Null                  = ((0x7f << 7) | 0x7f) // De-select current NRPN, RPN.
   };
 }
+
+namespace V2MIDI::RPN {
+  // Track the RPN/NRPN selection and the data entry controllers of 'nChannels'
+  // channels, and call handleParameter() for every updated parameter value.
+  //
+  // The data entry follows the CC::HighResolution rules: the very first MSB updates
+  // the value; after an LSB was seen, the update of an MSB is deferred until its LSB
+  // arrives. All other controllers are not consumed and can be passed on to
+  // a CC::HighResolution instance.
+  template <uint8_t nChannels = 16> class Decoder {
+  public:
+    void reset() {
+      for (uint8_t i = 0; i < nChannels; i++)
+        _channels[i] = {};
+    }
+
+    // Returns false if the controller is not an RPN/NRPN controller.
+    bool handleControlChange(uint8_t channel, uint8_t controller, uint8_t value) {
+      if (channel >= nChannels)
+        return false;
+
+      auto* c = &_channels[channel];
+      switch (controller) {
+        case CC::RPNMSB:
+        case CC::NRPNMSB:
+          select(c, controller == CC::RPNMSB, (value << 7) | (c->number & 0x7f));
+          return true;
+
+        case CC::RPNLSB:
+        case CC::NRPNLSB:
+          select(c, controller == CC::RPNLSB, (c->number & (0x7f << 7)) | value);
+          return true;
+
+        case CC::DataEntry:
+          if (c->number == Null)
+            return true;
+
+          c->msb = value;
+
+          // We've seen an LSB before, defer the update.
+          if (c->highResolution && !c->waiting) {
+            c->waiting = true;
+            return true;
+          }
+
+          // Two MSBs in a row, reset the high-resolution mode.
+          c->highResolution = false;
+          c->waiting        = false;
+          update(channel, c, value << 7);
+          return true;
+
+        case CC::DataEntryLSB:
+          if (c->number == Null)
+            return true;
+
+          c->highResolution = true;
+          c->waiting        = false;
+          update(channel, c, (c->msb << 7) | value);
+          return true;
+
+        case CC::DataIncrement:
+          if (c->number == Null)
+            return true;
+
+          if (c->value < 16383)
+            update(channel, c, c->value + 1);
+          return true;
+
+        case CC::DataDecrement:
+          if (c->number == Null)
+            return true;
+
+          if (c->value > 0)
+            update(channel, c, c->value - 1);
+          return true;
+      }
+
+      return false;
+    }
+
+    // The current value of the selected parameter, the base for increment/decrement.
+    // A newly selected parameter starts at 0.
+    void setValue(uint8_t channel, uint16_t value) {
+      _channels[channel].value = value;
+    }
+
+  protected:
+    virtual void handleParameter(uint8_t channel, bool registered, uint16_t number, uint16_t value) {}
+
+  private:
+    struct Channel {
+      uint16_t number{Null};
+      bool     registered{};
+      uint8_t  msb{};
+      bool     highResolution{};
+      bool     waiting{};
+      uint16_t value{};
+    } _channels[nChannels]{};
+
+    // The RPN and NRPN numbers share the selection, the last selected type wins.
+    static void select(Channel* c, bool registered, uint16_t number) {
+      c->registered     = registered;
+      c->number         = number;
+      c->msb            = 0;
+      c->highResolution = false;
+      c->waiting        = false;
+      c->value          = 0;
+    }
+
+    void update(uint8_t channel, Channel* c, uint16_t value) {
+      c->value = value;
+      handleParameter(channel, c->registered, c->number, value);
+    }
+  };
+}
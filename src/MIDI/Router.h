@@ -0,0 +1,119 @@
+#pragma once
+#include "Packet.h"
+#include "Transport.h"
+
+namespace V2MIDI {
+  // Forward packets between transports according to a constant route table. The
+  // packets are only classified by their code index, they are not decoded. SysEx
+  // streams are forwarded packet by packet, the route needs to carry 'System'.
+  //
+  // static constexpr V2MIDI::Router<3, 2>::Route routes[]{
+  //   {.source = 0, .types = V2MIDI::Router<3, 2>::Note, .destinations = 1 << 1},
+  //   {.source = 1, .port = 0, .types = V2MIDI::Router<3, 2>::All, .destinations = 1 << 0 | 1 << 2},
+  // };
+  // V2MIDI::Router<3, 2> router(routes);
+  template <uint8_t nTransports, uint8_t nRoutes> class Router {
+  public:
+    static_assert(nTransports <= 8, "The destinations are a bitmask of 8 transports");
+
+    // The message types, the bits of Route::types.
+    enum : uint8_t {
+      NoteOff           = 1 << 0,
+      NoteOn            = 1 << 1,
+      Aftertouch        = 1 << 2,
+      ControlChange     = 1 << 3,
+      ProgramChange     = 1 << 4,
+      AftertouchChannel = 1 << 5,
+      PitchBend         = 1 << 6,
+      System            = 1 << 7,
+      Note              = NoteOff | NoteOn,
+      All               = 0xff,
+    };
+
+    static constexpr uint8_t AnyPort = 0xff;
+
+    struct Route {
+      // The index of the transport the packet was received from.
+      uint8_t source;
+
+      // The virtual port/wire of the packet, or AnyPort.
+      uint8_t port{AnyPort};
+
+      uint8_t types;
+
+      // Bitmask of the transport indices to forward to.
+      uint8_t destinations;
+    };
+
+    struct Counter {
+      uint32_t forwarded;
+
+      // The number of packets a destination did not accept.
+      uint32_t dropped;
+    };
+
+    constexpr Router(const Route (&routes)[nRoutes]) : _routes{routes} {}
+
+    void setTransport(uint8_t index, Transport* transport) {
+      _transports[index] = transport;
+    }
+
+    // Forward a packet received from the transport with the index 'source'. Returns
+    // false if no route matched.
+    bool route(uint8_t source, Packet* packet) {
+      const uint8_t type = getType(packet);
+      if (type == 0)
+        return false;
+
+      bool matched = false;
+      for (uint8_t i = 0; i < nRoutes; i++) {
+        const Route& r = _routes[i];
+        if (r.source != source || !(r.types & type))
+          continue;
+
+        if (r.port != AnyPort && r.port != packet->getPort())
+          continue;
+
+        matched = true;
+        for (uint8_t d = 0; d < nTransports; d++) {
+          if (!(r.destinations & (1 << d)) || !_transports[d])
+            continue;
+
+          if (_transports[d]->send(packet))
+            _statistics[i].forwarded++;
+
+          else
+            _statistics[i].dropped++;
+        }
+      }
+
+      return matched;
+    }
+
+    const Counter& getStatistics(uint8_t route) const {
+      return _statistics[route];
+    }
+
+    void reset() {
+      for (uint8_t i = 0; i < nRoutes; i++)
+        _statistics[i] = {};
+    }
+
+  private:
+    const Route (&_routes)[nRoutes];
+    Transport* _transports[nTransports]{};
+    Counter    _statistics[nRoutes]{};
+
+    // The type bit of the code index.
+    static uint8_t getType(Packet* packet) {
+      const uint8_t codeIndex = packet->data()[0] & 0x0f;
+      if (codeIndex < (uint8_t)Packet::CodeIndex::SystemCommon2)
+        return 0;
+
+      if (codeIndex >= (uint8_t)Packet::CodeIndex::NoteOff && codeIndex <= (uint8_t)Packet::CodeIndex::PitchBend)
+        return 1 << (codeIndex - (uint8_t)Packet::CodeIndex::NoteOff);
+
+      return System;
+    }
+  };
+};
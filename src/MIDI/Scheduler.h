@@ -0,0 +1,154 @@
+#pragma once
+#include "Packet.h"
+#include "Transport.h"
+#include <V2Base.h>
+
+namespace V2MIDI {
+  // Send packets at a given time. The entries are kept in a min-heap ordered by
+  // their time, packets with the same time in the order they were scheduled;
+  // loop() sends all due packets. A packet which the transport does not accept
+  // is retried with the next loop().
+  //
+  // The times need to be less than 35 minutes in the future. Not interrupt-safe,
+  // schedule() and loop() need to be called from the same context, usually a
+  // device's handleLoop().
+  template <uint8_t N> class Scheduler {
+  public:
+    struct Counter {
+      uint32_t scheduled;
+      uint32_t sent;
+
+      // The number of packets dropped because the queue was full.
+      uint32_t overflow;
+
+      // The delay between the scheduled and the actual time.
+      uint32_t usecLate;
+      uint32_t usecLateMax;
+    };
+
+    void reset() {
+      _count      = 0;
+      _sequence   = 0;
+      _statistics = {};
+    }
+
+    // Send the packet at the absolute time 'usec'. Returns false if the queue is full.
+    bool schedule(uint32_t usec, Transport* transport, const Packet* packet) {
+      if (_count == N) {
+        _statistics.overflow++;
+        return false;
+      }
+
+      const Entry entry{.usec = usec, .sequence = _sequence++, .transport = transport, .packet = *packet};
+      uint16_t    i = _count++;
+      while (i > 0) {
+        const uint16_t parent = (i - 1) / 2;
+        if (!isBefore(entry, _entries[parent]))
+          break;
+
+        _entries[i] = _entries[parent];
+        i           = parent;
+      }
+
+      _entries[i] = entry;
+      _statistics.scheduled++;
+      return true;
+    }
+
+    // Send the packet 'usec' microseconds from now.
+    bool scheduleIn(uint32_t usec, Transport* transport, const Packet* packet) {
+      return schedule(V2Base::getUsec() + usec, transport, packet);
+    }
+
+    // Send the due packets. Returns the number of sent packets.
+    uint8_t loop() {
+      const uint32_t now = V2Base::getUsec();
+      uint8_t        n   = 0;
+
+      while (_count > 0 && !isBefore(now, _entries[0].usec)) {
+        if (!_entries[0].transport->send(&_entries[0].packet))
+          break;
+
+        const uint32_t late = now - _entries[0].usec;
+        _statistics.usecLate += late;
+        if (late > _statistics.usecLateMax)
+          _statistics.usecLateMax = late;
+
+        _statistics.sent++;
+        pop();
+        n++;
+      }
+
+      return n;
+    }
+
+    // The time until the next packet is due, 0 if it is already due or if there
+    // is no packet.
+    uint32_t getUsecUntilNext() const {
+      if (_count == 0)
+        return 0;
+
+      const int32_t usec = _entries[0].usec - V2Base::getUsec();
+      return usec > 0 ? usec : 0;
+    }
+
+    uint8_t count() const {
+      return _count;
+    }
+
+    bool empty() const {
+      return _count == 0;
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  private:
+    struct Entry {
+      uint32_t   usec;
+      uint32_t   sequence;
+      Transport* transport;
+      Packet     packet;
+    } _entries[N]{};
+
+    uint8_t  _count{};
+    uint32_t _sequence{};
+    Counter  _statistics{};
+
+    // Wrap-around safe comparison.
+    static bool isBefore(uint32_t a, uint32_t b) {
+      return (int32_t)(a - b) < 0;
+    }
+
+    // The insertion order breaks the tie of packets with the same time, a NoteOff
+    // cannot overtake its NoteOn.
+    static bool isBefore(const Entry& a, const Entry& b) {
+      if (a.usec != b.usec)
+        return isBefore(a.usec, b.usec);
+
+      return isBefore(a.sequence, b.sequence);
+    }
+
+    void pop() {
+      const Entry last = _entries[--_count];
+      uint16_t    i    = 0;
+      for (;;) {
+        uint16_t child = i * 2 + 1;
+        if (child >= _count)
+          break;
+
+        if (child + 1 < _count && isBefore(_entries[child + 1], _entries[child]))
+          child++;
+
+        if (!isBefore(_entries[child], last))
+          break;
+
+        _entries[i] = _entries[child];
+        i           = child;
+      }
+
+      _entries[i] = last;
+    }
+  };
+};
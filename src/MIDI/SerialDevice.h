@@ -19,32 +19,56 @@ namespace V2MIDI {
     }
 
     auto reset() {
-      _state     = {};
-      statistics = {};
-      _channel   = {};
-      _status    = {};
-      _data1     = {};
+      _state          = {};
+      statistics      = {};
+      _channel        = {};
+      _status         = {};
+      _data1          = {};
+      _sysex          = {};
+      _running.status = 0;
+    }
+
+    // Omit the status byte of a channel message if it is the same as the one of the
+    // previous message. The status byte is repeated at least every 'resyncMsec'
+    // milliseconds, to allow receivers to synchronize to the stream.
+    auto setRunningStatus(bool enable, uint32_t resyncMsec = 250) {
+      _running.enabled    = enable;
+      _running.resyncUsec = resyncMsec * 1000;
+      _running.status     = 0;
     }
 
     auto send(Packet* midi) -> bool {
+      // SysEx is sent as it arrives, the packets carry the raw bytes.
+      switch (static_cast<Packet::CodeIndex>(midi->_data[0] & 0x0f)) {
+        case Packet::CodeIndex::SystemExclusiveStart:
+        case Packet::CodeIndex::SystemExclusiveEnd3:
+          return write(midi, 3);
+
+        case Packet::CodeIndex::SystemExclusiveEnd2:
+          return write(midi, 2);
+
+        case Packet::CodeIndex::SystemExclusiveEnd1:
+          return write(midi, 1);
+      }
+
       switch (midi->getType()) {
         case Packet::Status::NoteOn:
         case Packet::Status::NoteOff:
         case Packet::Status::Aftertouch:
         case Packet::Status::ControlChange:
         case Packet::Status::PitchBend:
-        case Packet::Status::SystemSongPosition:
-          return _uart->write(midi->_data + 1, 3);
-          statistics.output++;
-          return true;
+          return writeChannel(midi, 3);
 
         case Packet::Status::ProgramChange:
         case Packet::Status::AftertouchChannel:
+          return writeChannel(midi, 2);
+
+        case Packet::Status::SystemSongPosition:
+          return write(midi, 3);
+
         case Packet::Status::SystemTimeCodeQuarterFrame:
         case Packet::Status::SystemSongSelect:
-          return _uart->write(midi->_data + 1, 2);
-          statistics.output++;
-          return true;
+          return write(midi, 2);
 
         case Packet::Status::SystemTuneRequest:
         case Packet::Status::SystemClock:
@@ -53,24 +77,70 @@ namespace V2MIDI {
         case Packet::Status::SystemStop:
         case Packet::Status::SystemActiveSensing:
         case Packet::Status::SystemReset:
-          return _uart->write(midi->_data[1]);
-          statistics.output++;
-          return true;
-
-        // System Exclusive is only handled right now.
-        case Packet::Status::SystemExclusive:
-          return false;
+          return write(midi, 1);
       }
 
       return false;
     }
 
+    // Parse the buffered bytes until a packet is complete. The UART's receive
+    // interrupt fills the ring buffer, the bytes are not polled from the hardware.
+    //
+    // The receive stays interrupt-driven, there is no DMA path: the core's Uart
+    // owns the SERCOM interrupt and reads DATA itself, a DMA channel would compete
+    // with it for the received bytes. At 31250 baud it is at most ~3000 short
+    // interrupts per second.
     auto receive(Packet* midi) -> bool {
-      if (_uart->available() == 0)
+      while (_uart->available() > 0) {
+        if (parse(_uart->read(), midi))
+          return true;
+      }
+
+      return false;
+    }
+
+    // Drain all buffered bytes into packets.
+    using Transport::receive;
+
+  private:
+    auto write(Packet* midi, uint8_t length) -> bool {
+      if (_uart->write(midi->_data + 1, length) != length)
+        return false;
+
+      // Real-Time messages do not cancel the Running Status, all other system
+      // messages do.
+      if (midi->_data[1] < (uint8_t)Packet::Status::SystemClock)
+        _running.status = 0;
+
+      statistics.output++;
+      return true;
+    }
+
+    auto writeChannel(Packet* midi, uint8_t length) -> bool {
+      if (!_running.enabled)
+        return write(midi, length);
+
+      const uint32_t usec = V2Base::getUsec();
+      if (midi->_data[1] == _running.status && usec - _running.usec < _running.resyncUsec) {
+        if (_uart->write(midi->_data + 2, length - 1) != length - 1u)
+          return false;
+
+        statistics.output++;
+        return true;
+      }
+
+      if (_uart->write(midi->_data + 1, length) != length)
         return false;
 
-      uint8_t b = _uart->read();
+      _running.status = midi->_data[1];
+      _running.usec   = usec;
+      statistics.output++;
+      return true;
+    }
 
+    // SysEx bytes are collected and returned as USB MIDI SysEx packets, the
+    // Port reassembles the message.
+    auto parse(uint8_t b, Packet* midi) -> bool {
       if (b & 0x80) {
         switch (b) {
           // Real-Time messages do not update the current Running Status. Do not process,
@@ -84,6 +154,16 @@ namespace V2MIDI {
             midi->setSystem(Packet::Status(b), 0, 0);
             statistics.input++;
             return true;
+
+          case (uint8_t)Packet::Status::SystemExclusiveEnd:
+            if (_state != State::SysEx)
+              return false;
+
+            _sysex.data[_sysex.length++] = b;
+            setSystemExclusive(midi, Packet::CodeIndex(uint8_t(Packet::CodeIndex::SystemExclusiveStart) + _sysex.length));
+            _state = State::Idle;
+            statistics.input++;
+            return true;
         }
 
         _state = State::Status;
@@ -99,7 +179,7 @@ namespace V2MIDI {
           switch (_status) {
             // Single byte message, the Real-Time messages are already handled.
             case Packet::Status::SystemTuneRequest:
-              midi->set(_status, 0, 0, 0);
+              midi->setSystem(_status);
               _state = State::Idle;
               statistics.input++;
               return true;
@@ -111,6 +191,7 @@ namespace V2MIDI {
             case Packet::Status::SystemSongSelect:
             case Packet::Status::NoteOn:
             case Packet::Status::NoteOff:
+            case Packet::Status::Aftertouch:
             case Packet::Status::ControlChange:
             case Packet::Status::PitchBend:
             case Packet::Status::SystemSongPosition:
@@ -118,20 +199,29 @@ namespace V2MIDI {
               return false;
 
             case Packet::Status::SystemExclusive:
-              _state = State::SysEx;
+              _sysex.data[0] = b;
+              _sysex.length  = 1;
+              _state         = State::SysEx;
               return false;
           }
 
+          // Undefined status.
+          _state = State::Idle;
         } break;
 
         case State::Data1:
           switch (_status) {
-            // Two bytes message.
+            // Two bytes message, the following data bytes use the Running Status.
             case Packet::Status::ProgramChange:
             case Packet::Status::AftertouchChannel:
+              midi->set(_status, _channel, b, 0);
+              statistics.input++;
+              return true;
+
+            // Two bytes system message.
             case Packet::Status::SystemTimeCodeQuarterFrame:
             case Packet::Status::SystemSongSelect:
-              midi->set(_status, _channel, b, 0);
+              midi->setSystem(_status, b);
               _state = State::Idle;
               statistics.input++;
               return true;
@@ -150,21 +240,39 @@ namespace V2MIDI {
           break;
 
         case State::Data2:
-          midi->set(_status, _channel, _data1, b);
-          _state = State::Idle;
+          if (_status == Packet::Status::SystemSongPosition) {
+            midi->setSystem(_status, _data1, b);
+            _state = State::Idle;
+
+          } else {
+            // The following data bytes use the Running Status.
+            midi->set(_status, _channel, _data1, b);
+            _state = State::Data1;
+          }
+
           statistics.input++;
           return true;
 
         case State::SysEx:
-          // System Exclusive is not processed right now. Just discard  the bytes
-          // until the next status byte arrives.
-          return false;
+          _sysex.data[_sysex.length++] = b;
+          if (_sysex.length < 3)
+            return false;
+
+          setSystemExclusive(midi, Packet::CodeIndex::SystemExclusiveStart);
+          return true;
       }
 
       return false;
     }
 
-  private:
+    auto setSystemExclusive(Packet* midi, Packet::CodeIndex codeIndex) -> void {
+      midi->_data[0] = uint8_t(codeIndex);
+      midi->_data[1] = _sysex.data[0];
+      midi->_data[2] = _sysex.length > 1 ? _sysex.data[1] : 0;
+      midi->_data[3] = _sysex.length > 2 ? _sysex.data[2] : 0;
+      _sysex.length  = 0;
+    }
+
     enum class State {
       Idle,
       Status,
@@ -177,6 +285,18 @@ namespace V2MIDI {
     Packet::Status _status{};
     uint8_t        _data1{};
 
+    struct {
+      uint8_t data[3];
+      uint8_t length;
+    } _sysex{};
+
+    struct {
+      bool     enabled;
+      uint32_t resyncUsec;
+      uint8_t  status;
+      uint32_t usec;
+    } _running{};
+
     Uart* _uart;
   };
 };
@@ -0,0 +1,220 @@
+#pragma once
+#include "Clock.h"
+#include "Packet.h"
+#include "Port.h"
+#include "Transport.h"
+
+namespace V2MIDI {
+  // Compile-time variant of Port for high-rate devices without SystemExclusive
+  // support. The handlers are resolved statically; the derived class only defines
+  // the handlers it needs, all others are empty and compiled away:
+  //
+  //   class Device : public V2MIDI::StaticPort<Device> {
+  //   public:
+  //     void handleNote(uint8_t channel, uint8_t note, uint8_t velocity) { ... }
+  //   };
+  //
+  // The packet is decoded by its code index through a 16-entry table. Packet statistics
+  // can be disabled to drop the per-packet counter updates.
+  template <class Derived, bool withStatistics = true> class StaticPort {
+  public:
+    constexpr StaticPort(uint8_t index = 0) : _index{index} {}
+
+    // During dispatch(), replies can be sent back to the given 'transport'.
+    void dispatch(Transport* transport, Packet* packet) {
+      Derived* derived = static_cast<Derived*>(this);
+
+      const Kind kind = _kinds[packet->data()[0] & 0x0f];
+      if (kind == Kind::Ignore)
+        return;
+
+      count(&_statistics.input, kind, packet);
+      derived->handlePacket(packet);
+
+      switch (kind) {
+        case Kind::NoteOff:
+          derived->handleNoteOff(packet->getChannel(), packet->getNote(), packet->getNoteVelocity());
+          break;
+
+        case Kind::NoteOn:
+          derived->handleNote(packet->getChannel(), packet->getNote(), packet->getNoteVelocity());
+          break;
+
+        case Kind::Aftertouch:
+          derived->handleAftertouch(packet->getChannel(), packet->getAftertouchNote(), packet->getAftertouch());
+          break;
+
+        case Kind::ControlChange:
+          derived->handleControlChange(packet->getChannel(), packet->getController(), packet->getControllerValue());
+          break;
+
+        case Kind::ProgramChange:
+          derived->handleProgramChange(packet->getChannel(), packet->getProgram());
+          break;
+
+        case Kind::AftertouchChannel:
+          derived->handleAftertouchChannel(packet->getChannel(), packet->getAftertouchChannel());
+          break;
+
+        case Kind::PitchBend:
+          derived->handlePitchBend(packet->getChannel(), packet->getPitchBend());
+          break;
+
+        case Kind::System:
+          switch (packet->getType()) {
+            case Packet::Status::SystemSongPosition:
+              derived->handleSongPosition(packet->getSongPosition());
+              break;
+
+            case Packet::Status::SystemSongSelect:
+              derived->handleSongSelect(packet->getSongSelect());
+              break;
+
+            case Packet::Status::SystemClock:
+              derived->handleClock(Clock::Event::Tick);
+              break;
+
+            case Packet::Status::SystemStart:
+              derived->handleClock(Clock::Event::Start);
+              break;
+
+            case Packet::Status::SystemContinue:
+              derived->handleClock(Clock::Event::Continue);
+              break;
+
+            case Packet::Status::SystemStop:
+              derived->handleClock(Clock::Event::Stop);
+              break;
+
+            case Packet::Status::SystemReset:
+              derived->handleSystemReset();
+              break;
+          }
+          break;
+      }
+    }
+
+    // Set the port's number in the outgoing packet and updates the statistics.
+    bool send(Packet* packet) {
+      packet->setPort(_index);
+      if (!static_cast<Derived*>(this)->handleSend(packet))
+        return false;
+
+      count(&_statistics.output, _kinds[packet->data()[0] & 0x0f], packet);
+      return true;
+    }
+
+    const Port::Counter& getStatistics(bool input) const {
+      return input ? _statistics.input : _statistics.output;
+    }
+
+  protected:
+    const uint8_t _index;
+
+    struct {
+      Port::Counter input;
+      Port::Counter output;
+    } _statistics{};
+
+    void handleNote(uint8_t channel, uint8_t note, uint8_t velocity) {}
+    void handleNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {}
+    void handleAftertouch(uint8_t channel, uint8_t note, uint8_t pressure) {}
+    void handleControlChange(uint8_t channel, uint8_t controller, uint8_t value) {}
+    void handleProgramChange(uint8_t channel, uint8_t value) {}
+    void handleAftertouchChannel(uint8_t channel, uint8_t pressure) {}
+    void handlePitchBend(uint8_t channel, int16_t value) {}
+    void handleSongPosition(uint16_t beats) {}
+    void handleSongSelect(uint8_t number) {}
+    void handleClock(Clock::Event clock) {}
+    void handleSystemReset() {}
+
+    // All messages.
+    void handlePacket(Packet* packet) {}
+
+    bool handleSend(Packet* packet) {
+      return false;
+    }
+
+  private:
+    enum class Kind : uint8_t {
+      Ignore,
+      NoteOff,
+      NoteOn,
+      Aftertouch,
+      ControlChange,
+      ProgramChange,
+      AftertouchChannel,
+      PitchBend,
+      System,
+    };
+
+    // Indexed by the USB MIDI code index number. SystemExclusive streams are ignored.
+    static constexpr Kind _kinds[16]{
+      Kind::Ignore,            // Reserved
+      Kind::Ignore,            // Cable
+      Kind::System,            // SystemCommon2
+      Kind::System,            // SystemCommon3
+      Kind::Ignore,            // SystemExclusiveStart
+      Kind::Ignore,            // SystemExclusiveEnd1
+      Kind::Ignore,            // SystemExclusiveEnd2
+      Kind::Ignore,            // SystemExclusiveEnd3
+      Kind::NoteOff,           // NoteOff
+      Kind::NoteOn,            // NoteOn
+      Kind::Aftertouch,        // Aftertouch
+      Kind::ControlChange,     // ControlChange
+      Kind::ProgramChange,     // ProgramChange
+      Kind::AftertouchChannel, // AftertouchChannel
+      Kind::PitchBend,         // PitchBend
+      Kind::System,            // SingleByte
+    };
+
+    static void count(Port::Counter* counter, Kind kind, const Packet* packet) {
+      if constexpr (!withStatistics)
+        return;
+
+      counter->packet++;
+
+      switch (kind) {
+        case Kind::NoteOff:
+          counter->noteOff++;
+          break;
+
+        case Kind::NoteOn:
+          counter->note++;
+          break;
+
+        case Kind::Aftertouch:
+          counter->aftertouch++;
+          break;
+
+        case Kind::ControlChange:
+          counter->control++;
+          break;
+
+        case Kind::ProgramChange:
+          counter->program++;
+          break;
+
+        case Kind::AftertouchChannel:
+          counter->aftertouchChannel++;
+          break;
+
+        case Kind::PitchBend:
+          counter->pitchbend++;
+          break;
+
+        case Kind::System:
+          switch (packet->getType()) {
+            case Packet::Status::SystemClock:
+              counter->system.clock.tick++;
+              break;
+
+            case Packet::Status::SystemReset:
+              counter->system.reset++;
+              break;
+          }
+          break;
+      }
+    }
+  };
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+
+namespace V2MIDI {
+  // A pool of SysEx buffers shared between several Port instances. SysEx messages
+  // are rare and almost never concurrent; instead of every port allocating its own
+  // incoming and outgoing buffers, the ports borrow a buffer from the pool for the
+  // duration of a message.
+  //
+  // The buffers are allocated on their first use, and kept for later reuse.
+  class SysExPool {
+  public:
+    struct Counter {
+      // The number of buffers currently handed out.
+      uint8_t used;
+
+      // The maximum number of buffers handed out at the same time.
+      uint8_t highWater;
+
+      // The number of requests which could not be served.
+      uint32_t exhausted;
+    };
+
+    // Up to 32 buffers of 'size' bytes each.
+    constexpr SysExPool(uint8_t count, uint32_t size) : _count{count > 32 ? (uint8_t)32 : count}, _size{size} {}
+
+    uint32_t getSize() const {
+      return _size;
+    }
+
+    // Returns NULL if all buffers are in use or the allocation fails.
+    uint8_t* acquire() {
+      if (!_buffers) {
+        _buffers = (uint8_t**)calloc(_count, sizeof(uint8_t*));
+        if (!_buffers)
+          return NULL;
+      }
+
+      for (uint8_t i = 0; i < _count; i++) {
+        if (_mask & (1 << i))
+          continue;
+
+        if (!_buffers[i]) {
+          _buffers[i] = (uint8_t*)malloc(_size);
+          if (!_buffers[i])
+            break;
+        }
+
+        _mask |= 1 << i;
+        _statistics.used++;
+        if (_statistics.used > _statistics.highWater)
+          _statistics.highWater = _statistics.used;
+
+        return _buffers[i];
+      }
+
+      _statistics.exhausted++;
+      return NULL;
+    }
+
+    void release(uint8_t* buffer) {
+      for (uint8_t i = 0; i < _count; i++) {
+        if (_buffers[i] != buffer)
+          continue;
+
+        if (!(_mask & (1 << i)))
+          return;
+
+        _mask &= ~(1 << i);
+        _statistics.used--;
+        return;
+      }
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  private:
+    const uint8_t  _count;
+    const uint32_t _size;
+    uint8_t**      _buffers{};
+
+    // The buffers currently handed out.
+    uint32_t _mask{};
+    Counter  _statistics{};
+  };
+}
@@ -1,9 +1,21 @@
 #pragma once
+#include "Packet.h"
 
 namespace V2MIDI {
   class Transport {
   public:
     virtual bool receive(Packet* midi) = 0;
     virtual bool send(Packet* midi)    = 0;
+
+    // Receive up to 'max' packets in one call, returns the number of packets
+    // stored in 'packets'. Transports with a native packet buffer, like USB,
+    // drain it without paying for the single-packet path.
+    virtual uint32_t receive(Packet* packets, uint32_t max) {
+      uint32_t n = 0;
+      while (n < max && receive(packets + n))
+        n++;
+
+      return n;
+    }
   };
 }
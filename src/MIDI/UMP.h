@@ -0,0 +1,223 @@
+#pragma once
+#include "Packet.h"
+
+namespace V2MIDI {
+  // Universal MIDI Packet, MIDI 2.0. Only the channel voice messages are supported:
+  // MIDI 1.0 messages (32 bit) and MIDI 2.0 messages (64 bit), with high-resolution
+  // velocities and controller values.
+  //
+  // The group of the packet maps to the virtual port/wire of the MIDI 1.0 packet.
+  class UMP {
+  public:
+    enum class Type : uint8_t {
+      Utility      = 0,
+      System       = 1,
+      ChannelVoice = 2, // MIDI 1.0
+      Data64       = 3,
+      Midi2        = 4, // MIDI 2.0 channel voice
+    };
+
+    auto getType() const -> Type {
+      return Type(_words[0] >> 28);
+    }
+
+    auto getGroup() const -> uint8_t {
+      return (_words[0] >> 24) & 0x0f;
+    }
+
+    auto getStatus() const -> Packet::Status {
+      return Packet::Status(0x80 | ((_words[0] >> 16) & 0x70));
+    }
+
+    auto getChannel() const -> uint8_t {
+      return (_words[0] >> 16) & 0x0f;
+    }
+
+    // The note number or the controller number.
+    auto getIndex() const -> uint8_t {
+      return (_words[0] >> 8) & 0x7f;
+    }
+
+    // MIDI 2.0, the 16 bit velocity or the 32 bit controller/pressure value.
+    auto getValue() const -> uint32_t {
+      if (getStatus() == Packet::Status::NoteOn || getStatus() == Packet::Status::NoteOff)
+        return _words[1] >> 16;
+
+      return _words[1];
+    }
+
+    auto words() -> uint32_t* {
+      return _words;
+    }
+
+    auto setNote(uint8_t group, uint8_t channel, uint8_t note, uint16_t velocity) -> UMP* {
+      return setMidi2(group, Packet::Status::NoteOn, channel, note, (uint32_t)velocity << 16);
+    }
+
+    auto setNoteOff(uint8_t group, uint8_t channel, uint8_t note, uint16_t velocity) -> UMP* {
+      return setMidi2(group, Packet::Status::NoteOff, channel, note, (uint32_t)velocity << 16);
+    }
+
+    auto setAftertouch(uint8_t group, uint8_t channel, uint8_t note, uint32_t pressure) -> UMP* {
+      return setMidi2(group, Packet::Status::Aftertouch, channel, note, pressure);
+    }
+
+    auto setControlChange(uint8_t group, uint8_t channel, uint8_t controller, uint32_t value) -> UMP* {
+      return setMidi2(group, Packet::Status::ControlChange, channel, controller, value);
+    }
+
+    auto setAftertouchChannel(uint8_t group, uint8_t channel, uint32_t pressure) -> UMP* {
+      return setMidi2(group, Packet::Status::AftertouchChannel, channel, 0, pressure);
+    }
+
+    // Unsigned, 0x80000000 is the center.
+    auto setPitchBend(uint8_t group, uint8_t channel, uint32_t value) -> UMP* {
+      return setMidi2(group, Packet::Status::PitchBend, channel, 0, value);
+    }
+
+    // Wrap a MIDI 1.0 channel voice message, the MIDI 2.0 values are scaled up. Returns
+    // false for all other messages.
+    bool fromPacket(Packet* packet) {
+      const uint8_t* data = packet->data();
+      if ((data[0] & 0x0f) < (uint8_t)Packet::CodeIndex::NoteOff || (data[0] & 0x0f) > (uint8_t)Packet::CodeIndex::PitchBend)
+        return false;
+
+      const uint8_t group   = packet->getPort();
+      const uint8_t channel = packet->getChannel();
+      switch (packet->getType()) {
+        case Packet::Status::NoteOn:
+          // A MIDI 1.0 velocity of 0 is a note off.
+          if (data[3] == 0) {
+            setNoteOff(group, channel, data[2], scaleUp(64, 7, 16));
+            return true;
+          }
+
+          setNote(group, channel, data[2], scaleUp(data[3], 7, 16));
+          return true;
+
+        case Packet::Status::NoteOff:
+          setNoteOff(group, channel, data[2], scaleUp(data[3], 7, 16));
+          return true;
+
+        case Packet::Status::Aftertouch:
+          setAftertouch(group, channel, data[2], scaleUp(data[3], 7, 32));
+          return true;
+
+        case Packet::Status::ControlChange:
+          setControlChange(group, channel, data[2], scaleUp(data[3], 7, 32));
+          return true;
+
+        case Packet::Status::AftertouchChannel:
+          setAftertouchChannel(group, channel, scaleUp(data[2], 7, 32));
+          return true;
+
+        case Packet::Status::PitchBend:
+          setPitchBend(group, channel, scaleUp(data[2] | (data[3] << 7), 14, 32));
+          return true;
+
+        // Program change carries bank select in MIDI 2.0, keep the MIDI 1.0 message.
+        case Packet::Status::ProgramChange:
+          _words[0] = (uint32_t)Type::ChannelVoice << 28 | (uint32_t)group << 24 | data[1] << 16 | data[2] << 8 | data[3];
+          _words[1] = 0;
+          return true;
+
+        default:
+          return false;
+      }
+    }
+
+    // Translate to MIDI 1.0 packets. A controller 0-31 is sent as MSB and LSB with
+    // the controller 32-63. Returns the number of packets stored in 'packets'.
+    uint8_t toPackets(Packet packets[2]) const {
+      if (getType() == Type::ChannelVoice) {
+        uint8_t* data = packets[0].data();
+        data[1]       = _words[0] >> 16;
+        data[2]       = (_words[0] >> 8) & 0x7f;
+        data[3]       = _words[0] & 0x7f;
+        data[0]       = getGroup() << 4 | data[1] >> 4;
+        return 1;
+      }
+
+      if (getType() != Type::Midi2)
+        return 0;
+
+      const uint8_t  channel = getChannel();
+      const uint32_t value   = getValue();
+      Packet*        packet  = &packets[0];
+      switch (getStatus()) {
+        case Packet::Status::NoteOn: {
+          // MIDI 1.0 velocity 0 is a note off.
+          const uint8_t velocity = value >> 9;
+          packet->setNote(channel, getIndex(), velocity > 0 ? velocity : 1);
+        } break;
+
+        case Packet::Status::NoteOff:
+          packet->setNoteOff(channel, getIndex(), value >> 9);
+          break;
+
+        case Packet::Status::Aftertouch:
+          packet->setAftertouch(channel, getIndex(), value >> 25);
+          break;
+
+        case Packet::Status::ControlChange:
+          packet->setControlChange(channel, getIndex(), value >> 25);
+          if (getIndex() < 32) {
+            packet->setPort(getGroup());
+            packet = &packets[1];
+            packet->setControlChange(channel, getIndex() + 32, (value >> 18) & 0x7f);
+            packet->setPort(getGroup());
+            return 2;
+          }
+          break;
+
+        case Packet::Status::AftertouchChannel:
+          packet->setAftertouchChannel(channel, value >> 25);
+          break;
+
+        case Packet::Status::PitchBend:
+          packet->setPitchBend(channel, (int16_t)(value >> 18) - 8192);
+          break;
+
+        default:
+          return 0;
+      }
+
+      packet->setPort(getGroup());
+      return 1;
+    }
+
+    // Min-center-max scaling of the MIDI 2.0 specification; the center value is
+    // preserved, the maximum maps to the maximum.
+    static constexpr uint32_t scaleUp(uint32_t value, uint8_t fromBits, uint8_t toBits) {
+      const uint8_t  shift  = toBits - fromBits;
+      uint32_t       result = value << shift;
+      const uint32_t center = 1 << (fromBits - 1);
+      if (value <= center)
+        return result;
+
+      const uint8_t repeatBits = fromBits - 1;
+      uint32_t      repeat     = value & ((1 << repeatBits) - 1);
+      if (shift > repeatBits)
+        repeat <<= shift - repeatBits;
+
+      else
+        repeat >>= repeatBits - shift;
+
+      while (repeat != 0) {
+        result |= repeat;
+        repeat >>= repeatBits;
+      }
+
+      return result;
+    }
+
+  private:
+    uint32_t _words[2]{};
+
+    auto setMidi2(uint8_t group, Packet::Status status, uint8_t channel, uint8_t index, uint32_t value) -> UMP* {
+      _words[0] = (uint32_t)Type::Midi2 << 28 | (uint32_t)group << 24 | ((uint8_t)status | channel) << 16 | index << 8;
+      _words[1] = value;
+      return this;
+    }
+  };
+};
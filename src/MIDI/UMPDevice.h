@@ -0,0 +1,80 @@
+#pragma once
+#include "Packet.h"
+#include "Transport.h"
+#include "UMP.h"
+
+namespace V2MIDI {
+  // MIDI 2.0 interface on top of a MIDI 1.0 transport. The USB stack provides only
+  // the USB MIDI 1.0 class, the packets are translated at the transport boundary;
+  // a high-resolution controller update is a single call. The values are reduced
+  // to the MIDI 1.0 resolution, 14 bits for the controllers 0-31.
+  //
+  // The MSB of the controllers 0-31 is sent only when it changes; the fine
+  // adjustments of a fader are a single LSB packet. A receiver resets its LSB
+  // with a new MSB, an LSB of 0 is not sent. The controllers 0-31 need to be
+  // sent only through this device, or reset() forgets the sent values.
+  class UMPDevice {
+  public:
+    constexpr UMPDevice(Transport* transport) : _transport(transport) {}
+
+    void reset() {
+      memset(_msb, 0, sizeof(_msb));
+    }
+
+    // Returns false if not all packets could be sent.
+    bool send(const UMP* ump) {
+      Packet  packets[2];
+      uint8_t n = ump->toPackets(packets);
+      if (n == 0)
+        return false;
+
+      if (n == 2)
+        return sendController(ump, packets);
+
+      for (uint8_t i = 0; i < n; i++) {
+        if (!_transport->send(&packets[i]))
+          return false;
+      }
+
+      return true;
+    }
+
+    // Channel voice messages only, the other packets are discarded.
+    bool receive(UMP* ump) {
+      Packet packet;
+      while (_transport->receive(&packet)) {
+        if (ump->fromPacket(&packet))
+          return true;
+      }
+
+      return false;
+    }
+
+  private:
+    Transport* _transport;
+
+    // The group and the MSB of the last sent controller value, plus one; 0 is
+    // not sent yet.
+    uint16_t _msb[16][32]{};
+
+    // The MSB and LSB packets of a controller 0-31.
+    bool sendController(const UMP* ump, Packet packets[2]) {
+      uint16_t*      sent = &_msb[ump->getChannel()][ump->getIndex()];
+      const uint16_t msb  = (ump->getGroup() << 7 | packets[0].data()[3]) + 1;
+      const uint8_t  lsb  = packets[1].data()[3];
+
+      if (*sent != msb) {
+        if (!_transport->send(&packets[0])) {
+          *sent = 0;
+          return false;
+        }
+
+        *sent = msb;
+        if (lsb == 0)
+          return true;
+      }
+
+      return _transport->send(&packets[1]);
+    }
+  };
+};
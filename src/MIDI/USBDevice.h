@@ -11,8 +11,29 @@ namespace V2MIDI {
       return V2Base::USBDevice::send(midi->_data);
     }
 
+    // Write the packets staged by send() since beginBatch(); called at the end of
+    // the device loop.
+    bool flush() {
+      return V2Base::USBDevice::flush();
+    }
+
     bool receive(Packet* midi) {
-      return V2Base::USBDevice::receive(midi->_data);
+      if (!V2Base::USBDevice::receive(midi->_data))
+        return false;
+
+      V2Base::Timer::Trace::record(V2Base::Timer::Trace::Event::Received, midi->_data);
+      return true;
+    }
+
+    // Drain the endpoint buffer, the packets are stored back-to-back.
+    uint32_t receive(Packet* packets, uint32_t max) {
+      static_assert(sizeof(Packet) == 4);
+      const uint32_t n = V2Base::USBDevice::receive(packets->_data, max);
+      if constexpr (V2Base::Timer::Trace::enabled)
+        for (uint32_t i = 0; i < n; i++)
+          V2Base::Timer::Trace::record(V2Base::Timer::Trace::Event::Received, packets[i]._data);
+
+      return n;
     }
   };
 }
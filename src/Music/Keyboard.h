@@ -16,7 +16,9 @@ namespace V2Music {
 
     // Return if the given note is a black piano key.
     static bool isBlackKey(uint8_t note) {
-      return !Scale::isUsed(Scale::Major, getKey(note));
+      // The black keys of an octave, starting at C.
+      constexpr uint16_t black = 0b010101001010;
+      return black & (1 << getKey(note));
     }
 
     // Get the number of octaves and the fraction of the last octave where the key is located.
@@ -70,3 +70,32 @@ uint8_t V2Music::Scale::getNote(V2Music::Scale::Type type, uint8_t index) {
 bool V2Music::Scale::isUsed(V2Music::Scale::Type type, uint8_t index) {
   return _notes[type].used[index];
 }
+
+void V2Music::Scale::Map::set(V2Music::Scale::Type type, uint8_t root) {
+  _type     = type;
+  _root     = root % 12;
+  _nDegrees = 0;
+
+  for (uint8_t i = 0; i < 128; i++) {
+    _note[i] = 0xff;
+    if (!isUsed(type, (i + 12 - _root) % 12))
+      continue;
+
+    _note[_nDegrees++] = i;
+  }
+
+  // Walk the notes between two neighbouring degrees.
+  uint8_t degree = 0;
+  for (uint8_t i = 0; i < 128; i++) {
+    if (degree + 1 < _nDegrees && i >= _note[degree + 1])
+      degree++;
+
+    // Below the first degree, or closer to the next one.
+    uint8_t nearest = degree;
+    if (i > _note[degree] && degree + 1 < _nDegrees && _note[degree + 1] - i < i - _note[degree])
+      nearest = degree + 1;
+
+    _nearest[i] = _note[nearest];
+    _degree[i]  = nearest;
+  }
+}
@@ -31,5 +31,57 @@ namespace V2Music {
 
     // Return if the given index of the note is used in this scale.
     static bool isUsed(Type type, uint8_t index);
+
+    // Lookup tables of a scale at a root note, covering all MIDI notes. Quantizing
+    // or mapping a note is a single load; the tables are rebuilt with set().
+    class Map {
+    public:
+      using Table = uint8_t[128];
+
+      Map(Type type = Chromatic, uint8_t root = 0) {
+        set(type, root);
+      }
+
+      void set(Type type, uint8_t root);
+
+      Type getType() const {
+        return _type;
+      }
+
+      uint8_t getRoot() const {
+        return _root;
+      }
+
+      // The nearest note of the scale; a note in-between two notes of the
+      // scale resolves to the lower one.
+      const Table& getNearest() const {
+        return _nearest;
+      }
+
+      // The degree of the nearest note of the scale, counted from the lowest
+      // note of the scale in the MIDI range.
+      const Table& getDegree() const {
+        return _degree;
+      }
+
+      // The note of the degree; the entries beyond the number of degrees
+      // are 0xff.
+      const Table& getNote() const {
+        return _note;
+      }
+
+      // The number of notes of the scale in the MIDI range.
+      uint8_t getDegreeCount() const {
+        return _nDegrees;
+      }
+
+    private:
+      Type    _type{};
+      uint8_t _root{};
+      uint8_t _nDegrees{};
+      Table   _nearest{};
+      Table   _degree{};
+      Table   _note{};
+    };
   };
 }
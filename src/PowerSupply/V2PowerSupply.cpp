@@ -25,6 +25,21 @@ void V2PowerSupply::off() {
 }
 
 void V2PowerSupply::loop() {
+  // The monitor has already switched off the power.
+  if (_tripped) {
+    _tripped = false;
+    if (_state == State::On) {
+      _usec    = micros();
+      _voltage = handleMeasurement();
+      _state   = State::Off;
+      handleWindow(false);
+      handleNotify(_voltage);
+      _n_disconnects++;
+      _continuous = false;
+      return;
+    }
+  }
+
   if ((unsigned long)(micros() - _usec) < 100 * 1000)
     return;
 
@@ -50,12 +65,14 @@ void V2PowerSupply::loop() {
 
       _state      = State::On;
       _on_voltage = _voltage;
+      handleWindow(true);
       handleNotify(_voltage);
       break;
 
     case State::On:
       if (_voltage < config.min || _voltage > config.max) {
         _state = State::Off;
+        handleWindow(false);
         handleOff();
         handleNotify(_voltage);
         _n_disconnects++;
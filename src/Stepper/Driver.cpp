@@ -24,11 +24,79 @@ void V2Stepper::Driver::begin() {
 }
 
 void V2Stepper::Driver::reset() {
+  _statusRequested = false;
   tmc2130_reset(&_tmc2130);
   while (tmc2130_periodicJob(&_tmc2130, 0))
     ;
 }
 
+void V2Stepper::Driver::writeField(RegisterField field, int32_t value) {
+  // The registers are only changed by us, the shadow copy is valid after reset();
+  // only the read-only flags are never read from the shadow.
+  const uint8_t address = TMC_ADDRESS(field.address);
+  const int32_t data    = FIELD_SET(_tmc2130.config.shadowRegister[address], field.mask, field.shift, value);
+
+  if (!_write.active) {
+    _statusRequested = false;
+    tmc2130_writeInt(&_tmc2130, address, data);
+    return;
+  }
+
+  _tmc2130.config.shadowRegister[address] = data;
+  _write.dirty[address / 32] |= 1UL << (address % 32);
+}
+
+void V2Stepper::Driver::beginWrite() {
+  _write.active = true;
+}
+
+void V2Stepper::Driver::endWrite() {
+  _write.active = false;
+  _statusRequested = false;
+
+  _bus.spi->beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE3));
+  for (uint8_t address = 0; address < TMC2130_REGISTER_COUNT; address++) {
+    if (!(_write.dirty[address / 32] & (1UL << (address % 32))))
+      continue;
+
+    // Every datagram needs its own chip select cycle, the device latches the last
+    // 40 bits when the chip select is released.
+    const int32_t value = _tmc2130.config.shadowRegister[address];
+    uint8_t       data[5]{
+      (uint8_t)(address | TMC2130_WRITE_BIT),
+      (uint8_t)(value >> 24),
+      (uint8_t)(value >> 16),
+      (uint8_t)(value >> 8),
+      (uint8_t)value,
+    };
+    digitalWrite(_bus.pin, LOW);
+    _bus.spi->transfer(data, sizeof(data));
+    digitalWrite(_bus.pin, HIGH);
+
+    _tmc2130.registerAccess[address] |= TMC_ACCESS_DIRTY;
+  }
+  _bus.spi->endTransaction();
+
+  memset(_write.dirty, 0, sizeof(_write.dirty));
+}
+
+uint32_t V2Stepper::Driver::readStatus() {
+  uint8_t data[5]{TMC2130_DRV_STATUS};
+
+  // Request the status, the reply to a different previous datagram is not needed.
+  if (!_statusRequested) {
+    tmc2130_readWriteArray(data, sizeof(data), (void*)&_bus);
+    data[0]          = TMC2130_DRV_STATUS;
+    _statusRequested = true;
+  }
+
+  tmc2130_readWriteArray(data, sizeof(data), (void*)&_bus);
+
+  const uint32_t value = ((uint32_t)data[1] << 24) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 8) | data[4];
+  _tmc2130.config.shadowRegister[TMC2130_DRV_STATUS] = value;
+  return value;
+}
+
 // Motor coil current / velocity.
 void V2Stepper::Driver::setCurrentScale(float ampere) {
   const float Rsense  = 0.11;
@@ -40,6 +108,6 @@ void V2Stepper::Driver::setCurrentScale(float ampere) {
     _currentScale      = 32.f * sqrtf(2) * ampere * (Rsense + 0.02f) / VfsLow - 1.f;
 
     // High sensitivity, low sense resistor voltage.
-    tmc2130_writeField(&_tmc2130, TMC2130_VSENSE_FIELD, 1);
+    writeField(TMC2130_VSENSE_FIELD, 1);
   }
 }
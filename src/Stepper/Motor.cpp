@@ -8,90 +8,116 @@ void V2Stepper::Motor::begin() {
 void V2Stepper::Motor::reset() {
   Driver::reset();
 
-  _mode     = Mode::Idle;
-  _high     = false;
-  _reverse  = false;
-  _position = {};
-  _speed    = {};
-  _queue    = {};
-
+  _mode      = Mode::Idle;
+  _high      = false;
+  _reverse   = false;
+  _position  = {};
+  _speed     = {};
+  _ramp      = {};
+  _queue     = {};
+  _lookahead = 0;
+  _passed    = {};
+  _status    = {};
+  resetTelemetry();
+
+  beginWrite();
   setCurrentScale(config.ampere);
 
   // Motor run current.
-  tmc2130_writeField(&_tmc2130, TMC2130_IRUN_FIELD, _currentScale);
+  writeField(TMC2130_IRUN_FIELD, _currentScale);
 
   // Motor standstill to motor current power down period.
-  tmc2130_writeField(&_tmc2130, TMC2130_TPOWERDOWN_FIELD, 10);
+  writeField(TMC2130_TPOWERDOWN_FIELD, 10);
 
   // Motor standstill current.
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLD_FIELD, 0);
+  writeField(TMC2130_IHOLD_FIELD, 0);
 
   // Motor standstill to powerdown period, after TPOWERDOWN.
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLDDELAY_FIELD, 6);
+  writeField(TMC2130_IHOLDDELAY_FIELD, 6);
 
   // Stand-still option: Freewheeling, applies if IHOLD == 0.
-  tmc2130_writeField(&_tmc2130, TMC2130_FREEWHEEL_FIELD, 2);
+  writeField(TMC2130_FREEWHEEL_FIELD, 2);
 
   // Number of microsteps.
-  tmc2130_writeField(&_tmc2130, TMC2130_MRES_FIELD, 8 - config.microstepsShift);
+  writeField(TMC2130_MRES_FIELD, 8 - config.microstepsShift);
 
   // Interpolate to 256 microsteps.
-  tmc2130_writeField(&_tmc2130, TMC2130_INTPOL_FIELD, 1);
+  writeField(TMC2130_INTPOL_FIELD, 1);
 
   // Off time and driver enable.
-  tmc2130_writeField(&_tmc2130, TMC2130_TOFF_FIELD, 3);
+  writeField(TMC2130_TOFF_FIELD, 3);
 
   // Hysteresis start value.
-  tmc2130_writeField(&_tmc2130, TMC2130_HSTRT_FIELD, 4);
+  writeField(TMC2130_HSTRT_FIELD, 4);
 
   // Hysteresis low value.
-  tmc2130_writeField(&_tmc2130, TMC2130_HEND_FIELD, 1);
+  writeField(TMC2130_HEND_FIELD, 1);
 
   // Blank time select.
-  tmc2130_writeField(&_tmc2130, TMC2130_TBL_FIELD, 2);
+  writeField(TMC2130_TBL_FIELD, 2);
 
   // Chopper mode.
-  tmc2130_writeField(&_tmc2130, TMC2130_CHM_FIELD, 0);
+  writeField(TMC2130_CHM_FIELD, 0);
 
   // PWM frequency selection.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_FREQ_FIELD, 0);
+  writeField(TMC2130_PWM_FREQ_FIELD, 0);
 
   // User defined amplitude.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_GRAD_FIELD, 1);
+  writeField(TMC2130_PWM_GRAD_FIELD, 1);
 
   // PWM automatic amplitude scaling.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_AUTOSCALE_FIELD, 1);
+  writeField(TMC2130_PWM_AUTOSCALE_FIELD, 1);
 
   // User defined PWM amplitude offset.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_AMPL_FIELD, 200);
+  writeField(TMC2130_PWM_AMPL_FIELD, 200);
 
   // Upper velocity for stealthChop voltage PWM mode.
-  tmc2130_writeField(&_tmc2130, TMC2130_TPWMTHRS_FIELD, 500);
+  writeField(TMC2130_TPWMTHRS_FIELD, 500);
 
   // StealthChop voltage PWM mode enabled.
-  tmc2130_writeField(&_tmc2130, TMC2130_EN_PWM_MODE_FIELD, 1);
+  writeField(TMC2130_EN_PWM_MODE_FIELD, 1);
+
+  // Every edge of the step signal is a step.
+  writeField(TMC2130_DEDGE_FIELD, config.stepTimer);
 
   // Stall guard threshold.
   auto threshold{int8_t((float)INT8_MAX * config.home.stall)};
-  tmc2130_writeField(&_tmc2130, TMC2130_SGT_FIELD, threshold >> 1);
+  writeField(TMC2130_SGT_FIELD, threshold >> 1);
+  endWrite();
 }
 
 void V2Stepper::Motor::freewheel() {
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLD_FIELD, 0);
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLDDELAY_FIELD, 0);
-  tmc2130_writeField(&_tmc2130, TMC2130_FREEWHEEL_FIELD, 1);
+  beginWrite();
+  writeField(TMC2130_IHOLD_FIELD, 0);
+  writeField(TMC2130_IHOLDDELAY_FIELD, 0);
+  writeField(TMC2130_FREEWHEEL_FIELD, 1);
+  endWrite();
 }
 
 void V2Stepper::Motor::hold(float fraction) {
   auto cs{float(_currentScale) * fraction};
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLD_FIELD, ceilf(cs));
+  writeField(TMC2130_IHOLD_FIELD, ceilf(cs));
 }
 
 void V2Stepper::Motor::setDirection(bool reverse) {
-  tmc2130_writeField(&_tmc2130, TMC2130_SHAFT_FIELD, reverse ^ config.inverse);
+  writeField(TMC2130_SHAFT_FIELD, reverse ^ config.inverse);
 }
 
 void V2Stepper::Motor::loop() {
+  while (_passed.count > 0) {
+    _timer->disable();
+    void (*handler)() = _passed.handlers[_passed.first];
+    _passed.first     = (_passed.first + 1) % _nCommands;
+    _passed.count--;
+    _timer->enable();
+    handler();
+  }
+
+  if (config.statusUsec > 0 && (unsigned long)(micros() - _status.usec) >= config.statusUsec) {
+    _status.usec = micros();
+    sampleStatus();
+  }
+
   switch (_mode) {
     case Mode::HomeStall:
       if ((unsigned long)(micros() - _usec) < 100)
@@ -100,7 +126,8 @@ void V2Stepper::Motor::loop() {
       _usec = micros();
 
       // Always move a few steps before checking the 'stall' flag.
-      if (_position.now >= (uint8_t)(1 << config.microstepsShift) * 8 && tmc2130_readField(&_tmc2130, TMC2130_STALLGUARD_FIELD)) {
+      if (_position.now >= (uint8_t)(1 << config.microstepsShift) * 8 &&
+          FIELD_GET(readStatus(), TMC2130_STALLGUARD_MASK, TMC2130_STALLGUARD_SHIFT)) {
         _timer->disable();
         _position.now    = _position.start;
         _position.target = 0;
@@ -115,34 +142,88 @@ void V2Stepper::Motor::loop() {
       }
       break;
 
-    case Mode::Done:
+    case Mode::Done: {
       _mode = Mode::Idle;
       handleMovement(Move::Stop);
 
-      switch (_queue.mode) {
-        case Mode::Position:
-          setPosition(_queue.position.target, _queue.position.speedFraction, _queue.position.handler);
-          _queue = {};
-          break;
-
-        case Mode::HomeStall:
-          home(_queue.home.steps, _queue.home.start, _queue.home.handler);
-          _queue = {};
-          break;
-
-        case Mode::Rotate:
-          rotate(_queue.rotate.speedFraction);
-          _queue = {};
-          break;
+      // Start the next command, it might replace the handler.
+      void (*handler)() = _position.handler;
+      _position.handler = NULL;
+
+      Command command;
+      if (popCommand(&command)) {
+        switch (command.mode) {
+          case Mode::Position:
+            setPosition(command.position.target, command.position.speedFraction, command.position.handler);
+            _timer->disable();
+            updateLookahead();
+            if (_lookahead > 0) {
+              _ramp.count = 0;
+              calculateDecelerationSteps();
+            }
+            _timer->enable();
+            break;
+
+          case Mode::HomeStall:
+            home(command.home.steps, command.home.start, command.home.handler);
+            break;
+
+          case Mode::Rotate:
+            rotate(command.rotate.speedFraction);
+            break;
+        }
       }
 
-      if (_position.handler)
-        _position.handler();
-      break;
+      if (handler)
+        handler();
+    } break;
   }
 }
 
+void V2Stepper::Motor::sampleStatus() {
+  const uint32_t value = readStatus();
+  const Status   status{
+      .load{(uint16_t)FIELD_GET(value, TMC2130_SG_RESULT_MASK, TMC2130_SG_RESULT_SHIFT)},
+      .current{(uint8_t)FIELD_GET(value, TMC2130_CS_ACTUAL_MASK, TMC2130_CS_ACTUAL_SHIFT)},
+      .stall{FIELD_GET(value, TMC2130_STALLGUARD_MASK, TMC2130_STALLGUARD_SHIFT) != 0},
+      .overTemperatureWarning{FIELD_GET(value, TMC2130_OTPW_MASK, TMC2130_OTPW_SHIFT) != 0},
+      .overTemperature{FIELD_GET(value, TMC2130_OT_MASK, TMC2130_OT_SHIFT) != 0},
+  };
+
+  _status.entries[_status.next] = status;
+  _status.next                  = (_status.next + 1) % _nStatus;
+  if (_status.count < _nStatus)
+    _status.count++;
+
+  // The load value is only meaningful while the motor is moving.
+  Telemetry& telemetry = _status.telemetry;
+  if (_mode != Mode::Idle) {
+    if (status.load < telemetry.loadMin)
+      telemetry.loadMin = status.load;
+
+    if (status.load > telemetry.loadMax)
+      telemetry.loadMax = status.load;
+
+    telemetry.loadSum += status.load;
+    telemetry.currentSum += status.current;
+    telemetry.samples++;
+  }
+
+  if (status.overTemperatureWarning)
+    telemetry.overTemperatureWarning++;
+
+  if (status.overTemperature)
+    telemetry.overTemperature++;
+
+  handleStatus(status);
+}
+
 void V2Stepper::Motor::tick() {
+  if (config.stepTimer) {
+    tickStep();
+    return;
+  }
+
   // Reset step signal back to logical low.
   if (_high) {
     _high = false;
@@ -155,88 +236,186 @@ void V2Stepper::Motor::tick() {
   // Speed calculation, modulates the pulse frequency.
   if (_adjustCounter == 0) {
     _adjustCounter = _tickFrequency / _adjustmentFrequency;
+    adjustSpeed();
+    _pulse.period = _speed.now > 0 ? (_tickFrequency << _speedShift) / _speed.now : UINT32_MAX;
+  }
+  _adjustCounter--;
+
+  // Pulse / stepping signal frequency.
+  if (_pulse.counter == 0) {
+    _pulse.counter = _pulse.period;
+    if (!advance())
+      return;
+
+    // Switch step signal to logical high.
+    _high = true;
+    _pinStep.high();
+  }
+
+  _pulse.counter--;
+}
+
+void V2Stepper::Motor::tickStep() {
+  if (_mode == Mode::Idle || _mode == Mode::Done) {
+    // Fall back to the slow frequency of the timer.
+    if (_pulse.period > 0) {
+      _pulse.period = 0;
+      _timer->setFrequency(_timer->getFrequency());
+    }
+    return;
+  }
+
+  // Speed calculation; the counter accumulates the duration of the steps in
+  // timer clock ticks.
+  const uint32_t clock = _timer->getClock();
+  _adjustCounter += _pulse.period;
+  while (_adjustCounter >= clock / _adjustmentFrequency) {
+    _adjustCounter -= clock / _adjustmentFrequency;
+    adjustSpeed();
+  }
+
+  if (!advance())
+    return;
+
+  // The STEP pins of the drivers are not routed to a waveform output of the TC,
+  // the interrupt toggles the GPIO; with DEDGE every edge is a step.
+  _pinStep.toggle();
 
+  // Fire at the time of the next step.
+  const uint32_t speed = _speed.now >> _speedShift;
+  _pulse.period        = clock / (speed > 0 ? speed : 1);
+  _timer->setPeriod(_pulse.period);
+}
+
+void V2Stepper::Motor::adjustSpeed() {
+  if (_ramp.count > 0) {
     if (_speed.now < _speed.target) {
-      _speed.now += _speedAdjust;
-      if (_speed.now > _speed.target)
-        _speed.now = _speed.target;
+      if (_ramp.position < (_ramp.count - 1) * _ramp.divider)
+        _ramp.position++;
 
     } else if (_speed.now > _speed.target) {
-      _speed.now -= _speedAdjust;
-      if (_speed.now < _speed.target)
-        _speed.now = _speed.target;
+      if (_ramp.position > 0)
+        _ramp.position--;
     }
 
-    _pulse.period = _tickFrequency / _speed.now;
+    const uint8_t index    = _ramp.position / _ramp.divider;
+    const uint8_t fraction = _ramp.position % _ramp.divider;
+    _speed.now             = _ramp.speeds[index];
+    if (fraction > 0)
+      _speed.now += (int32_t)(_ramp.speeds[index + 1] - _ramp.speeds[index]) / _ramp.divider * fraction;
+    return;
   }
-  _adjustCounter--;
 
-  // Pulse / stepping signal frequency.
-  if (_pulse.counter == 0) {
-    _pulse.counter = _pulse.period;
+  // Unsigned, clamp before the update.
+  if (_speed.now < _speed.target) {
+    if (_speed.target - _speed.now > _speedAdjust)
+      _speed.now += _speedAdjust;
 
-    switch (_mode) {
-      case Mode::HomeStall:
-      case Mode::Home:
-      case Mode::Position:
-        if (_position.getDistance() == _position.decel)
-          _speed.target = config.speed.min * (1 << config.microstepsShift);
+    else
+      _speed.now = _speed.target;
 
-        if (_position.now == _position.target) {
-          _mode = Mode::Done;
-          return;
-        }
+  } else if (_speed.now > _speed.target) {
+    if (_speed.now - _speed.target > _speedAdjust)
+      _speed.now -= _speedAdjust;
 
-        if (_reverse)
-          _position.now--;
+    else
+      _speed.now = _speed.target;
+  }
+}
 
-        else
-          _position.now++;
-        break;
+// Move one step, returns false if the movement has ended.
+bool V2Stepper::Motor::advance() {
+  switch (_mode) {
+    case Mode::HomeStall:
+    case Mode::Home:
+    case Mode::Position:
+      if (_position.getDistance() + _lookahead <= _position.decel)
+        _speed.target = _speedMin;
 
-      case Mode::Rotate:
-        if ((uint32_t)_speed.now < config.speed.min * (uint8_t)(1 << config.microstepsShift)) {
+      if (_position.now == _position.target) {
+        // Continue with the next queued position in the same direction.
+        if (_lookahead == 0) {
           _mode = Mode::Done;
-          return;
+          return false;
         }
-        break;
-    }
 
-    // Switch step signal to logical high.
-    _high = true;
-    _pinStep.high();
+        Command command;
+        popCommand(&command);
+        _position.target = command.position.steps;
+        _lookahead -= _position.getDistance();
+
+        // The queued position might be faster, plan the braking distance from its
+        // speed; brake right away if the remaining distance is already too short.
+        _speed.target = command.position.speed;
+        calculateDecelerationSteps();
+        if (_position.getDistance() + _lookahead <= _position.decel)
+          _speed.target = _speedMin;
+
+        // At most one handler per queued command, the ring holds all of them.
+        if (_position.handler && _passed.count < _nCommands) {
+          _passed.handlers[(_passed.first + _passed.count) % _nCommands] = _position.handler;
+          _passed.count++;
+        }
+
+        _position.handler = command.position.handler;
+      }
+
+      if (_reverse)
+        _position.now--;
+
+      else
+        _position.now++;
+      break;
+
+    case Mode::Rotate:
+      if (_speed.now < _speedMin) {
+        _mode = Mode::Done;
+        return false;
+      }
+      break;
   }
 
-  _pulse.counter--;
+  return true;
 }
 
 void V2Stepper::Motor::init(Mode mode) {
   _mode          = mode;
-  _speed.now     = config.speed.min * (1 << config.microstepsShift);
+  _speed.now     = _speedMin;
   _pulse.counter = 0;
+  _pulse.period  = 0;
   _adjustCounter = 0;
+
+  // Only positioning moves from stand-still follow the S-curve.
+  if (mode != Mode::Position)
+    _ramp.count = 0;
 }
 
 uint32_t V2Stepper::Motor::getMaxSpeed(float speedFraction) {
   auto range{float(config.speed.max - config.speed.min)};
   auto speed{config.speed.min + uint32_t(range * speedFraction)};
-  return speed * (1 << config.microstepsShift);
+  return toSpeed(speed);
+}
+
+// The fixed-point speed of fullsteps per second.
+uint32_t V2Stepper::Motor::toSpeed(uint32_t fullsteps) {
+  return fullsteps << (config.microstepsShift + _speedShift);
 }
 
 uint32_t V2Stepper::Motor::getAccelerationSteps(uint32_t speedFrom, uint32_t speedTo) {
-  auto from{int32_t(speedFrom * speedFrom)};
-  auto to{int32_t(speedTo * speedTo)};
-  auto accel{uint32_t(abs(to - from))};
-  return accel / (config.speed.accel * (1 << config.microstepsShift) * 2);
+  const uint64_t from  = (uint64_t)speedFrom * speedFrom;
+  const uint64_t to    = (uint64_t)speedTo * speedTo;
+  const uint64_t accel = (to > from ? to - from : from - to) >> (2 * _speedShift);
+  return accel / (((uint64_t)config.speed.accel << config.microstepsShift) * 2);
 }
 
 void V2Stepper::Motor::calculateDecelerationSteps() {
   auto accel{getAccelerationSteps(_speed.now, _speed.target)};
-  auto decel{getAccelerationSteps(_speed.target, getMaxSpeed(0))};
+  auto decel{getAccelerationSteps(_speed.target, _speedMin)};
 
   // Are we able to reach the full speed?
-  if (accel + decel > _position.getDistance()) {
-    const uint32_t delta = (accel + decel) - _position.getDistance();
+  const uint32_t distance = _position.getDistance() + _lookahead;
+  if (accel + decel > distance) {
+    const uint32_t delta = (accel + decel) - distance;
     _position.decel      = decel - (delta / 2);
 
   } else {
@@ -244,14 +423,87 @@ void V2Stepper::Motor::calculateDecelerationSteps() {
   }
 }
 
+// Calculate the S-curve from the current to the maximum speed; the acceleration
+// rises with the jerk limit to the configured acceleration, and falls again when
+// approaching the maximum speed. Short moves end the curve at half the distance.
+// Returns the number of steps needed to decelerate.
+uint32_t V2Stepper::Motor::planRamp(uint32_t speedFrom, uint32_t speedTo, uint32_t distance) {
+  const float scale = 1 << config.microstepsShift;
+  const float accel = config.speed.accel * scale;
+  const float jerk  = config.speed.jerk * scale;
+  const float from  = (float)speedFrom / (float)(1 << _speedShift);
+  const float to    = (float)speedTo / (float)(1 << _speedShift);
+  const float delta = to > from ? to - from : 0;
+
+  // The duration of the jerk and the constant acceleration phases.
+  float secJerk  = accel / jerk;
+  float secAccel = 0;
+  if (delta >= accel * secJerk)
+    secAccel = (delta / accel) - secJerk;
+
+  else
+    secJerk = sqrtf(delta / jerk);
+
+  const float duration = (2.f * secJerk) + secAccel;
+  _ramp.divider        = (uint32_t)ceilf(duration * _adjustmentFrequency) / _rampSize + 1;
+  _ramp.position       = 0;
+  _ramp.count          = 0;
+
+  const float period = (float)_ramp.divider / _adjustmentFrequency;
+  float       steps  = 0;
+  for (uint8_t i = 0; i < _rampSize; i++) {
+    const float t = i * period;
+    float       speed;
+    if (t < secJerk)
+      speed = from + (jerk * t * t / 2.f);
+
+    else if (t < secJerk + secAccel)
+      speed = from + (jerk * secJerk * secJerk / 2.f) + (accel * (t - secJerk));
+
+    else if (t < duration)
+      speed = to - (jerk * (duration - t) * (duration - t) / 2.f);
+
+    else
+      speed = to;
+
+    // Leave the same distance for the deceleration.
+    if (i > 0 && 2.f * (steps + (speed * period)) > distance)
+      break;
+
+    _ramp.speeds[i] = speed * (float)(1 << _speedShift);
+    _ramp.count++;
+    steps += speed * period;
+
+    if (t >= duration)
+      break;
+  }
+
+  return steps;
+}
+
+// The steps needed to decelerate from the current position in the ramp.
+uint32_t V2Stepper::Motor::getRampSteps() {
+  const float period = (float)_ramp.divider / _adjustmentFrequency;
+  float       steps  = 0;
+  for (uint8_t i = 0; i <= _ramp.position / _ramp.divider; i++)
+    steps += (float)_ramp.speeds[i] / (float)(1 << _speedShift) * period;
+
+  return steps;
+}
+
 void V2Stepper::Motor::setPosition(float position, float speedFraction, void (*handler)()) {
   switch (_mode) {
     case Mode::HomeStall:
     case Mode::Home:
-      _queue = {
+      clearCommands();
+      pushCommand({
         .mode{Mode::Position},
-        .position{.target{position}, .speedFraction{speedFraction}, .handler{handler}},
-      };
+        .position{.target{position},
+                  .speedFraction{speedFraction},
+                  .handler{handler},
+                  .steps{uint32_t(position * (float)(1 << config.microstepsShift))},
+                  .speed{getMaxSpeed(speedFraction)}},
+      });
       break;
 
     case Mode::Idle: {
@@ -262,11 +514,17 @@ void V2Stepper::Motor::setPosition(float position, float speedFraction, void (*h
         break;
       }
 
-      _speed.now        = config.speed.min * (1 << config.microstepsShift);
+      _speed.now        = _speedMin;
       _position.target  = target;
       _position.handler = handler;
       _speed.target     = getMaxSpeed(speedFraction);
-      calculateDecelerationSteps();
+      if (config.speed.jerk > 0)
+        _position.decel = planRamp(_speed.now, _speed.target, _position.getDistance());
+
+      else {
+        _ramp.count = 0;
+        calculateDecelerationSteps();
+      }
 
       _reverse = _position.getReverse(target);
       setDirection(_reverse);
@@ -279,17 +537,26 @@ void V2Stepper::Motor::setPosition(float position, float speedFraction, void (*h
       auto target{uint32_t(position * (float)(1 << config.microstepsShift))};
       _timer->disable();
 
+      // The new position replaces the queued ones.
+      clearCommands();
+
       // Do we need to reverse the direction?
       if (_mode == Mode::Position && _reverse != _position.getReverse(target)) {
         stopPositioning();
-        _queue = {
+        pushCommand({
           .mode{Mode::Position},
-          .position{.target{position}, .speedFraction{speedFraction}},
-        };
+          .position{.target{position},
+                    .speedFraction{speedFraction},
+                    .handler{handler},
+                    .steps{target},
+                    .speed{getMaxSpeed(speedFraction)}},
+        });
         _timer->enable();
         break;
       }
 
+      // Leave the S-curve, continue with a constant acceleration.
+      _ramp.count      = 0;
       _position.target = target;
       _speed.target    = getMaxSpeed(speedFraction);
       calculateDecelerationSteps();
@@ -297,10 +564,14 @@ void V2Stepper::Motor::setPosition(float position, float speedFraction, void (*h
       // If we are already too fast to stop at the target, overshoot and move back.
       if (_position.getDistance() < _position.decel) {
         stopPositioning();
-        _queue = {
+        pushCommand({
           .mode{Mode::Position},
-          .position{.target{position}, .speedFraction{speedFraction}},
-        };
+          .position{.target{position},
+                    .speedFraction{speedFraction},
+                    .handler{handler},
+                    .steps{target},
+                    .speed{getMaxSpeed(speedFraction)}},
+        });
       }
 
       _timer->enable();
@@ -310,8 +581,8 @@ void V2Stepper::Motor::setPosition(float position, float speedFraction, void (*h
 }
 
 void V2Stepper::Motor::stopPositioning() {
-  _speed.target = config.speed.min * (1 << config.microstepsShift);
-  auto decel{getAccelerationSteps(_speed.now, getMaxSpeed(0))};
+  _speed.target = _speedMin;
+  auto decel{_ramp.count > 0 ? getRampSteps() : getAccelerationSteps(_speed.now, _speedMin)};
   if (_reverse)
     _position.target = _position.now - decel;
   else
@@ -321,8 +592,8 @@ void V2Stepper::Motor::stopPositioning() {
 void V2Stepper::Motor::stop() {
   switch (_mode) {
     case Mode::Position:
-      _queue = {};
       _timer->disable();
+      clearCommands();
       stopPositioning();
       _timer->enable();
       break;
@@ -348,17 +619,18 @@ void V2Stepper::Motor::home(uint32_t steps, uint32_t start, void (*handler)()) {
         .start{start * (1 << config.microstepsShift)},
         .handler{handler},
       };
-      _speed.target = config.home.speed * (1 << config.microstepsShift);
+      _speed.target = toSpeed(config.home.speed);
       handleMovement(Move::Reverse);
       init(Mode::HomeStall);
       break;
 
     default:
       stop();
-      _queue = {
+      clearCommands();
+      pushCommand({
         .mode{Mode::HomeStall},
         .home{.steps{steps}, .start{start}, .handler{handler}},
-      };
+      });
       break;
   }
 }
@@ -371,15 +643,16 @@ void V2Stepper::Motor::rotate(float speedFraction) {
 
   // Change direction.
   if (_mode == Mode::Rotate && _reverse != reverse) {
-    _queue = {
+    clearCommands();
+    pushCommand({
       .mode{Mode::Rotate},
       .rotate{.speedFraction{speedFraction}, .reverse{reverse}},
-    };
+    });
     _speed.target = 0;
     return;
   }
 
-  _queue = {};
+  clearCommands();
   if (fabs(speedFraction) < 0.00001f)
     _speed.target = 0;
   else
@@ -392,3 +665,77 @@ void V2Stepper::Motor::rotate(float speedFraction) {
     init(Mode::Rotate);
   }
 }
+
+bool V2Stepper::Motor::queuePosition(float position, float speedFraction, void (*handler)()) {
+  if (_mode == Mode::Idle && _queue.count == 0) {
+    setPosition(position, speedFraction, handler);
+    return true;
+  }
+
+  _timer->disable();
+  const bool queued = pushCommand({
+    .mode{Mode::Position},
+    .position{.target{position},
+              .speedFraction{speedFraction},
+              .handler{handler},
+              .steps{uint32_t(position * (float)(1 << config.microstepsShift))},
+              .speed{getMaxSpeed(speedFraction)}},
+  });
+
+  // Extend the deceleration distance; leave the S-curve, continue with a
+  // constant acceleration.
+  if (queued && _mode == Mode::Position) {
+    updateLookahead();
+    _ramp.count = 0;
+    calculateDecelerationSteps();
+  }
+
+  _timer->enable();
+  return queued;
+}
+
+bool V2Stepper::Motor::pushCommand(const Command& command) {
+  if (_queue.count == _nCommands)
+    return false;
+
+  _queue.entries[(_queue.first + _queue.count) % _nCommands] = command;
+  _queue.count++;
+  return true;
+}
+
+bool V2Stepper::Motor::popCommand(Command* command) {
+  if (_queue.count == 0)
+    return false;
+
+  *command     = _queue.entries[_queue.first];
+  _queue.first = (_queue.first + 1) % _nCommands;
+  _queue.count--;
+  return true;
+}
+
+void V2Stepper::Motor::clearCommands() {
+  _queue     = {};
+  _lookahead = 0;
+}
+
+// Sum up the distances of the queued positions which continue the current
+// movement in the same direction.
+void V2Stepper::Motor::updateLookahead() {
+  _lookahead = 0;
+  if (_mode != Mode::Position)
+    return;
+
+  uint32_t position = _position.target;
+  for (uint8_t i = 0; i < _queue.count; i++) {
+    const Command* command = &_queue.entries[(_queue.first + i) % _nCommands];
+    if (command->mode != Mode::Position)
+      break;
+
+    const uint32_t target = command->position.steps;
+    if (target == position || (target < position) != _reverse)
+      break;
+
+    _lookahead += target > position ? target - position : position - target;
+    position = target;
+  }
+}
@@ -7,30 +7,32 @@ void V2Stepper::Power::begin() {
 
 void V2Stepper::Power::reset() {
   Driver::reset();
+  beginWrite();
 
   // Motor coil currents and polarity directly programmed via serial interface.
-  tmc2130_writeField(&_tmc2130, TMC2130_DIRECT_MODE_FIELD, 1);
+  writeField(TMC2130_DIRECT_MODE_FIELD, 1);
 
   // Motor coil current / velocity.
   setCurrentScale(config.ampere);
 
   // Motor standstill current.
-  tmc2130_writeField(&_tmc2130, TMC2130_IHOLD_FIELD, _currentScale);
+  writeField(TMC2130_IHOLD_FIELD, _currentScale);
 
   // Off time and driver enable.
-  tmc2130_writeField(&_tmc2130, TMC2130_TOFF_FIELD, 3);
+  writeField(TMC2130_TOFF_FIELD, 3);
 
   // User defined amplitude.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_GRAD_FIELD, 4);
+  writeField(TMC2130_PWM_GRAD_FIELD, 4);
 
   // PWM automatic amplitude scaling.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_AUTOSCALE_FIELD, 1);
+  writeField(TMC2130_PWM_AUTOSCALE_FIELD, 1);
 
   // User defined PWM amplitude offset.
-  tmc2130_writeField(&_tmc2130, TMC2130_PWM_AMPL_FIELD, 255);
+  writeField(TMC2130_PWM_AMPL_FIELD, 255);
 
   // StealthChop voltage PWM mode enabled.
-  tmc2130_writeField(&_tmc2130, TMC2130_EN_PWM_MODE_FIELD, 1);
+  writeField(TMC2130_EN_PWM_MODE_FIELD, 1);
+  endWrite();
 }
 
 void V2Stepper::Power::scaleVoltage(uint8_t channel, float fraction) {
@@ -39,12 +41,12 @@ void V2Stepper::Power::scaleVoltage(uint8_t channel, float fraction) {
   switch (channel) {
     case 0:
       handleScaleVoltage(0, fraction);
-      tmc2130_writeField(&_tmc2130, TMC2130_DIRECT_CURRENT_A_FIELD, scale >> 7);
+      writeField(TMC2130_DIRECT_CURRENT_A_FIELD, scale >> 7);
       break;
 
     case 1:
       handleScaleVoltage(1, fraction);
-      tmc2130_writeField(&_tmc2130, TMC2130_DIRECT_CURRENT_B_FIELD, scale >> 7);
+      writeField(TMC2130_DIRECT_CURRENT_B_FIELD, scale >> 7);
       break;
   }
 }
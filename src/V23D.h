@@ -1,6 +1,7 @@
 #pragma once
 #include "3D/Attitude.h"
 #include "3D/Euler.h"
+#include "3D/Madgwick.h"
 #include "3D/Quaternion.h"
 #include "3D/Vector3.h"
 #include <numbers>
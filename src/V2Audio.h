@@ -2,3 +2,5 @@
 #include "Audio/Codec.h"
 #include "Audio/Fader.h"
 #include "Audio/Phasor.h"
+#include "Audio/VoicePool.h"
+#include "Audio/Wavetable.h"
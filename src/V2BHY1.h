@@ -6,8 +6,45 @@
 // XYZ – ENU (East-North-Up), right handed.
 class V2BHY1 {
 public:
+  // The virtual sensors.
+  enum class Source { Rotation, GameRotation, Gravity, Gyroscope, _count };
+
+  // A sample with the time of the sensor, in 1/32000 seconds.
+  struct Sample {
+    uint32_t timestamp;
+    union {
+      V23D::Quaternion quaternion;
+      V23D::Vector3    vector;
+    };
+  };
+
   constexpr V2BHY1(TwoWire* i2c, uint8_t pin_interrupt) : _pin_interrupt(pin_interrupt), _i2c(i2c) {}
 
+  // Read the FIFO asynchronously, loop() never waits for the bus. The register
+  // address is written from the interrupt of the SERCOM, the data is read by the
+  // DMA engine. 'i2c' needs to use the SERCOM; no other device on the bus, and none
+  // of the getXxxID() functions, may be used while a FIFO transfer is running.
+  //
+  // The core's Wire.cpp defines the interrupt handlers of the SERCOM of 'Wire', a
+  // dedicated SERCOM and TwoWire instance is needed. Its interrupts need to call
+  // handleInterrupt():
+  //   TwoWire SensorWire(&sercom3, PIN_SENSOR_SDA, PIN_SENSOR_SCL);
+  //   V2BHY1 Sensor(&SensorWire, PIN_SENSOR_INTERRUPT, SERCOM3, SERCOM3_DMAC_ID_RX);
+  //   void SERCOM3_0_Handler() {
+  //     Sensor.handleInterrupt();
+  //   }
+  //   void SERCOM3_1_Handler() {
+  //     Sensor.handleInterrupt();
+  //   }
+  //   void SERCOM3_3_Handler() {
+  //     Sensor.handleInterrupt();
+  //   }
+  constexpr V2BHY1(TwoWire* i2c, uint8_t pin_interrupt, Sercom* sercom, uint8_t trigger) :
+    _pin_interrupt(pin_interrupt),
+    _i2c(i2c),
+    _sercom(sercom),
+    _trigger(trigger) {}
+
   auto begin() -> void;
   auto reset() -> void;
   auto loop() -> void;
@@ -22,7 +59,32 @@ public:
   auto getGravity() -> V23D::Vector3;
   auto getGyroscope() -> V23D::Vector3;
 
+  // The sample rate in Hz and the maximum report latency. The sensor collects the
+  // samples in its FIFO for the latency, which reduces the number of interrupts and
+  // transfers; a rate of 0 disables the virtual sensor. The default is 100 Hz without
+  // latency. It applies when loop() sets up the sensor after begin() or reset().
+  auto setRate(Source source, uint16_t hz, uint16_t latencyMsec = 0) -> void {
+    _rates[(uint8_t)source] = {.hz{hz}, .latencyMsec{latencyMsec}};
+  }
+
+  // The number of recent samples; the quaternion of Rotation and GameRotation, the
+  // vector of Gravity and Gyroscope.
+  auto getSampleCount(Source source) -> uint8_t;
+
+  // The recent samples, 0 is the latest one.
+  auto getSample(Source source, uint8_t index) -> Sample;
+
+  // Called from the interrupts of the SERCOM of the asynchronous FIFO transfer.
+  auto handleInterrupt() -> void;
+
 private:
   uint8_t  _pin_interrupt;
   TwoWire* _i2c;
+  Sercom*  _sercom{};
+  uint8_t  _trigger{};
+
+  struct {
+    uint16_t hz{100};
+    uint16_t latencyMsec{};
+  } _rates[(uint8_t)Source::_count]{};
 };
@@ -10,10 +10,16 @@
 #include "Base/Memory/Firmware.h"
 #include "Base/Memory/Flash.h"
 #include "Base/Memory/RAM.h"
+#include "Base/Memory/Store.h"
 #include "Base/Power/Power.h"
 #include "Base/Text/Base64.h"
+#include "Base/Text/Bits7.h"
 #include "Base/Timer/PWM.h"
 #include "Base/Timer/Periodic.h"
+#include "Base/Timer/Profiler.h"
+#include "Base/Timer/Scheduler.h"
+#include "Base/Timer/Trace.h"
+#include "Base/Timer/Wheel.h"
 #include "Base/USB/Device.h"
 
 namespace V2Base {
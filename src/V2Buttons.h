@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include <initializer_list>
 
 class V2Buttons {
 public:
@@ -61,6 +62,12 @@ public:
 
     // Are we processing or wait for a new interrupt.
     bool _busy{};
+
+    // The PortGroup and the bit of the pin, for scanning.
+    uint8_t  _port{};
+    uint32_t _mask{};
+
+    bool update(bool down);
   };
 
   // Check for pending events.
@@ -68,4 +75,131 @@ public:
   // The pins of the buttons needs to support external interrupts to trigger
   // the measurement.
   static void loop();
+
+  // Read the pins of all buttons from the input registers of the ports once per
+  // loop(), instead of waiting for pin interrupts; the pins do not need to support
+  // external interrupts. The pins are debounced with vertical counters, a change
+  // needs four equal consecutive reads. Needs to be called before the begin() of
+  // the buttons.
+  static void beginScan();
+
+  // A row/column key matrix. The rows are driven low one after the other, the
+  // columns are read with pull-up resistors. Every key needs a diode, to not
+  // ghost the other keys. The keys are debounced with vertical counters.
+  template <uint8_t nRows, uint8_t nColumns> class Matrix {
+    static_assert(nColumns <= 32, "A row is read into 32 bits");
+    static_assert(nRows * nColumns <= 256, "The keys are numbered with 8 bits");
+
+  public:
+    Matrix(std::initializer_list<uint8_t> rows, std::initializer_list<uint8_t> columns) {
+      uint8_t i = 0;
+      for (uint8_t pin : rows)
+        if (i < nRows)
+          _rows[i++] = {.pin{pin}};
+
+      i = 0;
+      for (uint8_t pin : columns)
+        if (i < nColumns)
+          _columns[i++] = {.pin{pin}};
+    }
+
+    void begin() {
+      for (uint8_t i = 0; i < nRows; i++) {
+        _rows[i].port = g_APinDescription[_rows[i].pin].ulPort;
+        _rows[i].mask = 1UL << g_APinDescription[_rows[i].pin].ulPin;
+
+        // Not driven, high-impedance; the output level is low when the row is selected.
+        pinMode(_rows[i].pin, INPUT);
+        PORT->Group[_rows[i].port].OUTCLR.reg = _rows[i].mask;
+      }
+
+      for (uint8_t i = 0; i < nColumns; i++) {
+        _columns[i].port = g_APinDescription[_columns[i].pin].ulPort;
+        _columns[i].mask = 1UL << g_APinDescription[_columns[i].pin].ulPin;
+        pinMode(_columns[i].pin, INPUT_PULLUP);
+      }
+
+      reset();
+    }
+
+    void reset() {
+      for (uint8_t i = 0; i < nRows; i++)
+        _keys[i] = {.count0{UINT32_MAX}, .count1{UINT32_MAX}};
+    }
+
+    void loop() {
+      if ((unsigned long)(micros() - _usec) < 1000)
+        return;
+
+      _usec = micros();
+
+      for (uint8_t row = 0; row < nRows; row++) {
+        PORT->Group[_rows[row].port].DIRSET.reg = _rows[row].mask;
+
+        // Wait for the column lines to follow the row.
+        delayMicroseconds(2);
+
+        uint32_t in[PORT_GROUPS];
+        for (uint8_t i = 0; i < PORT_GROUPS; i++)
+          in[i] = PORT->Group[i].IN.reg;
+
+        PORT->Group[_rows[row].port].DIRCLR.reg = _rows[row].mask;
+
+        // The pressed keys pull their column low.
+        uint32_t sample = 0;
+        for (uint8_t i = 0; i < nColumns; i++)
+          if (!(in[_columns[i].port] & _columns[i].mask))
+            sample |= 1UL << i;
+
+        auto*    keys    = &_keys[row];
+        uint32_t changed = keys->state ^ sample;
+        keys->count0     = ~(keys->count0 & changed);
+        keys->count1     = keys->count0 ^ (keys->count1 & changed);
+        changed &= keys->count0 & keys->count1;
+        keys->state ^= changed;
+
+        for (uint8_t i = 0; changed; i++, changed >>= 1) {
+          if (!(changed & 1))
+            continue;
+
+          if (keys->state & (1UL << i))
+            handleDown((row * nColumns) + i);
+
+          else
+            handleUp((row * nColumns) + i);
+        }
+      }
+    }
+
+    bool isDown(uint8_t key) {
+      return _keys[key / nColumns].state & (1UL << (key % nColumns));
+    }
+
+  protected:
+    // The key number is row * nColumns + column.
+    virtual void handleDown(uint8_t key) {}
+    virtual void handleUp(uint8_t key) {}
+
+  private:
+    struct Pin {
+      uint8_t  pin;
+      uint8_t  port;
+      uint32_t mask;
+    };
+
+    Pin           _rows[nRows]{};
+    Pin           _columns[nColumns]{};
+    unsigned long _usec{};
+
+    // The debounced state of the columns of every row, and the bits of its
+    // vertical counters.
+    struct {
+      uint32_t state;
+      uint32_t count0;
+      uint32_t count1;
+    } _keys[nRows]{};
+  };
+
+private:
+  static void scan();
 };
@@ -25,6 +25,57 @@ public:
     return powf((brightness + 16.f) / 116.f, 3);
   }
 
+  // Hue in degrees, Saturation and Value 0..255. The results are rounded up like
+  // the floating point version.
+  static constexpr void HSVtoRGB8(uint16_t h, uint8_t s, uint8_t v, uint8_t& r, uint8_t& g, uint8_t& b) {
+    if (h >= 360)
+      h = 0;
+
+    const uint8_t  i = h / 60;
+    const uint32_t f = (((h % 60) * 255) + 59) / 60;
+    const uint8_t  p = ((v * (255 - s)) + 254) / 255;
+    const uint8_t  q = ((v * ((255 * 255) - (f * s))) + (255 * 255) - 1) / (255 * 255);
+    const uint8_t  t = ((v * ((255 * 255) - ((255 - f) * s))) + (255 * 255) - 1) / (255 * 255);
+
+    switch (i) {
+      case 0:
+        r = v;
+        g = t;
+        b = p;
+        return;
+
+      case 1:
+        r = q;
+        g = v;
+        b = p;
+        return;
+
+      case 2:
+        r = p;
+        g = v;
+        b = t;
+        return;
+
+      case 3:
+        r = p;
+        g = q;
+        b = v;
+        return;
+
+      case 4:
+        r = t;
+        g = p;
+        b = v;
+        return;
+
+      case 5:
+        r = v;
+        g = p;
+        b = q;
+        return;
+    }
+  }
+
   // Hue, Saturation, Value
   static constexpr void HSVtoRGB(float h, float s, float v, uint8_t& r, uint8_t& g, uint8_t& b) {
     if (h < 0.f || h >= 360.f)
@@ -1,5 +1,7 @@
 #pragma once
+#include <Adafruit_ZeroDMA.h>
 #include <SPI.h>
+#include <initializer_list>
 
 class V2DMX {
 public:
@@ -24,7 +26,122 @@ public:
     return _channels.values[i];
   }
 
+  // The number of slots to transmit; the frame is truncated after the last block
+  // of 8 slots. A short frame increases the frame rate, 24 slots take 1.2
+  // milliseconds. The default 0 sends all channels which have been set.
+  void setSlots(uint16_t n) {
+    _nSlots = n;
+  }
+
+  // Resend the unchanged data after the interval; some devices switch themselves
+  // off after a timeout.
+  void setKeepAliveUsec(uint32_t usec) {
+    _keepAliveUsec = usec;
+  }
+
+  // DMX512 receiver. The data register of the SERCOM UART is read by the DMA engine
+  // into one of two frame buffers. The break is received as a framing error; its
+  // interrupt completes the frame and restarts the DMA with the other buffer. loop()
+  // compares the completed frame with the previous one. The SERCOM must not be used
+  // by a Uart instance; its error interrupt needs to call handleInterrupt():
+  //
+  //   V2DMX::Receiver DMX(PIN_DMX_RX, &sercom2, SERCOM2, SERCOM2_DMAC_ID_RX, PIO_SERCOM, SERCOM_RX_PAD_1);
+  //   void SERCOM2_3_Handler() {
+  //     DMX.handleInterrupt();
+  //   }
+  class Receiver {
+  public:
+    struct Counter {
+      uint32_t frames;
+
+      // Frames with a start code other than '0', e.g. RDM or text packets.
+      uint32_t ignored;
+
+      // Frames dropped because loop() did not process the previous one in time.
+      uint32_t dropped;
+    };
+
+    Receiver(uint8_t pin, SERCOM* sercom, Sercom* regs, uint8_t trigger, EPioType pinFunc, SercomRXPad padRx) :
+      _sercom{.pin{pin}, .sercom{sercom}, .regs{regs}, .trigger{trigger}, .pinFunc{pinFunc}, .padRx{padRx}} {}
+
+    void begin();
+    void reset();
+
+    // Process a received frame, calls handleFrame() if slots have changed.
+    void loop();
+
+    // Called from the error interrupt of the SERCOM.
+    void handleInterrupt();
+
+    // The value of the slot in the last received frame, the slots are numbered 1..512.
+    uint8_t getSlot(uint16_t slot) const {
+      return _frame.slots[slot];
+    }
+
+    // The number of slots of the last received frame, without the start code.
+    uint16_t getSlotCount() const {
+      return _frame.count;
+    }
+
+    // The time of the last received frame.
+    uint32_t getUsec() const {
+      return _frame.usec;
+    }
+
+    static bool isChanged(const uint32_t changed[], uint16_t slot) {
+      return changed[slot / 32] & (1UL << (slot % 32));
+    }
+
+    const Counter& getStatistics() const {
+      return _statistics;
+    }
+
+  protected:
+    // A frame with changed slots; 'slots' is indexed by the slot number 1..count,
+    // 'changed' is a bitmap of 513 bits, indexed by the slot number.
+    virtual void handleFrame(const uint8_t* slots, uint16_t count, const uint32_t changed[]) {}
+
+  private:
+    struct {
+      const uint8_t     pin;
+      SERCOM*           sercom;
+      Sercom*           regs;
+      const uint8_t     trigger;
+      const EPioType    pinFunc;
+      const SercomRXPad padRx;
+    } _sercom;
+
+    Adafruit_ZeroDMA _dma;
+    DmacDescriptor*  _descriptor{};
+
+    // The start code and 512 slots.
+    struct {
+      uint8_t buffers[2][513];
+
+      // The buffer the DMA engine is writing to.
+      uint8_t index;
+
+      // The completed buffer waits for loop().
+      volatile bool     pending;
+      volatile uint16_t count;
+      uint32_t          usec;
+    } _rx{};
+
+    struct {
+      uint8_t  slots[513];
+      uint16_t count;
+      uint32_t usec;
+    } _frame{};
+
+    uint32_t _changed[17]{};
+    Counter  _statistics{};
+
+    void start();
+  };
+
 private:
+  template <uint8_t N> friend class V2DMXUniverses;
+
   union DMABuffer {
     uint8_t bytes[5 + (11 * 64)];
     struct {
@@ -50,7 +167,75 @@ private:
   DMABuffer*    _dmaBuffer{};
   Channels      _channels{};
   uint16_t      _nChannels{};
-  bool          _updateDMA{};
+  uint16_t      _nSlots{};
+  uint32_t      _keepAliveUsec{400 * 1000};
+  uint64_t      _dirty{};
   bool          _transfer{};
   unsigned long _transferUsec{};
+
+  void encode();
+  bool isDue();
+  void send();
+};
+
+// Several universes, every instance of V2DMX is one universe on its own SERCOM.
+// The transfers of all universes are started back to back, the frames of all
+// universes stay aligned.
+template <uint8_t N> class V2DMXUniverses {
+public:
+  V2DMXUniverses(std::initializer_list<V2DMX*> universes) {
+    for (V2DMX* universe : universes)
+      if (_count < N)
+        _universes[_count++] = universe;
+  }
+
+  void loop() {
+    bool due = false;
+    for (uint8_t i = 0; i < _count; i++) {
+      _universes[i]->encode();
+      if (_universes[i]->isDue())
+        due = true;
+    }
+
+    if (!due)
+      return;
+
+    // The frame sync; wait for all universes to finish their transfer.
+    for (uint8_t i = 0; i < _count; i++)
+      if (_universes[i]->_spi->isBusy())
+        return;
+
+    for (uint8_t i = 0; i < _count; i++)
+      _universes[i]->send();
+  }
+
+  // Set channel values, the data continues into the following universes.
+  void setChannels(uint8_t universe, uint16_t i, const uint8_t* data, uint16_t size) {
+    if (i >= 512)
+      return;
+
+    while (size > 0 && universe < _count) {
+      uint16_t n = 512 - i;
+      if (n > size)
+        n = size;
+
+      _universes[universe]->setChannels(i, data, n);
+      data += n;
+      size -= n;
+      i = 0;
+      universe++;
+    }
+  }
+
+  V2DMX* getUniverse(uint8_t universe) {
+    return _universes[universe];
+  }
+
+  uint8_t count() const {
+    return _count;
+  }
+
+private:
+  V2DMX*  _universes[N]{};
+  uint8_t _count{};
 };
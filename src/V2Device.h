@@ -6,6 +6,10 @@
 #include <V2Link.h>
 #include <V2MIDI.h>
 
+namespace V2Audio {
+  class CodecBase;
+};
+
 class V2Device : public V2MIDI::Port {
 public:
   // Device metadata stored in a global variable.
@@ -84,9 +88,19 @@ public:
 
   V2MIDI::SerialDevice* serial{};
 
+  // The audio codec; its render statistics are exported with the system information.
+  V2Audio::CodecBase* audio{};
+
   // Built-in LED.
   V2LED::Basic led;
 
+  // The sections of the main loop, exported with the system statistics. Devices
+  // can add their own sections.
+  V2Base::Timer::Profiler<16> profiler;
+
+  // The periodic tasks of the device, called from loop() before handleLoop().
+  V2Base::Timer::Scheduler<16> scheduler;
+
   // Local device-specific configuration which will be read and written to the EEPROM.
   struct {
     uint16_t version; // A different version calls handleEEPROM() to possibly convert from.
@@ -99,7 +113,11 @@ public:
   //
   // Default USB MIDI port 0.
   constexpr V2Device() : V2Device(16 * 1024) {}
-  constexpr V2Device(uint32_t sysexSize) : Port(0, sysexSize), led(PIN_LED_ONBOARD, &_ledTimer), _ledTimer(3, 1000) {}
+  constexpr V2Device(uint32_t sysexSize) :
+    Port(0, sysexSize),
+    led(PIN_LED_ONBOARD, &_ledTimer),
+    _ledTimer(3, 1000),
+    _cablePool(2, sysexSize) {}
 
   // Read the configuration from the EEPROM, initialize the bootup data which
   // might be carried over to the next reboot.
@@ -113,8 +131,30 @@ public:
 
   // Wait for interrupts, goes into sleep mode IDLE. The system tick will wake it
   // up at least once every millisecond.
+  //
+  // In tickless mode, the sleep lasts until the next task of the scheduler is
+  // due. All periodic work needs to be scheduled or interrupt-driven.
   void sleep() {
-    V2Base::Power::sleep();
+    if (!_tickless || scheduler.count() == 0) {
+      V2Base::Power::sleep();
+      return;
+    }
+
+    // Without an active task, the system tick wakes up the loop.
+    const uint32_t usec = scheduler.getUsecUntilNext();
+    if (usec == UINT32_MAX) {
+      V2Base::Power::sleep();
+      return;
+    }
+
+    if (usec == 0)
+      return;
+
+    V2Base::Power::sleep(usec);
+  }
+
+  void setTickless(bool enable) {
+    _tickless = enable;
   }
 
   // Write the configuration to the EEPROM.
@@ -185,19 +225,134 @@ private:
     } usb;
   } _eeprom;
 
+  struct {
+    uint8_t led;
+    uint8_t systemExclusive;
+    uint8_t scheduler;
+    uint8_t handleLoop;
+  } _profile{};
+
+  // The statistics counters sent periodically to the subscribed transport.
+  struct {
+    V2MIDI::Transport* transport;
+    uint32_t           sequence;
+    uint32_t           usecPeriod;
+    uint32_t           usec;
+    uint8_t            fields;
+    uint32_t           values[16];
+  } _subscription{};
+
+  bool _tickless{};
+
+  // The EEPROM has been written, the data needs to be flushed from loop().
+  bool _eepromFlush{};
+
   struct {
     uint32_t id;
   } _boot{};
 
   struct {
     char hash[41];
+
+    // The hash is calculated incrementally after begin().
+    struct {
+      bool                        active;
+      uint32_t                    position;
+      V2Base::Cryptography::SHA1 sha;
+    } hashing;
+
+    // The hashes of the blocks of both banks, calculated in slices by loop(). The
+    // manifest is sent to 'transport' when all blocks are hashed.
+    struct {
+      V2MIDI::Transport*          transport;
+      uint8_t                     (*digests)[20];
+      uint32_t                    position;
+      V2Base::Cryptography::SHA1 sha;
+    } manifest;
+
+    // The running hash of the blocks of an update, written in order from offset 0.
+    struct {
+      bool                        sequential;
+      uint32_t                    length;
+      V2Base::Cryptography::SHA1 sha;
+    } update;
+
+    // The received blocks of a firmware update, allocated with the first queued block.
+    struct {
+      uint32_t* buffer;
+      struct {
+        uint32_t offset;
+        uint32_t length;
+      } blocks[2];
+      uint8_t tail;
+      uint8_t count;
+
+      // The oldest block is written to the flash in the background.
+      bool writing;
+
+      // A block could not be written, reported with the next reply.
+      bool failed;
+    } queue;
   } _firmware{};
 
+  // The pre-serialized metadata, links, help and settings of the reply; rebuilt
+  // after the configuration or the channel has changed.
+  struct {
+    bool     dirty{true};
+    char*    fragment{};
+    uint32_t length{};
+    char     board[64]{};
+  } _reply;
+
   V2Base::Timer::Periodic _ledTimer;
 
+  // With several USB MIDI ports, the additional cables reassemble their SysEx
+  // messages separately; up to two of them at the same time.
+  V2MIDI::Port::Cable _cables[15]{};
+  V2MIDI::SysExPool   _cablePool;
+
+  void cacheReply();
+  enum class FirmwareStatus : uint8_t { Success, InvalidOffset, InvalidLength, HashMismatch, Verified, WriteFailed };
+
+  // The binary interface, the byte after the SysEx ID; a JSON message starts with '{'.
+  static constexpr uint8_t BinaryVersion{0x01};
+  enum class Binary : uint8_t { Statistics = 0x01, WriteConfiguration = 0x02, WriteFirmware = 0x03, Trace = 0x04 };
+  enum class BinaryStatus : uint8_t {
+    Success,
+    InvalidOffset,
+    InvalidLength,
+    HashMismatch,
+    InvalidVersion,
+    InvalidMethod,
+    WriteFailed,
+  };
+
   void sendReply(V2MIDI::Transport* transport);
   void sendFirmwareStatus(V2MIDI::Transport* transport, const char* status);
+  void beginFirmwareManifest(V2MIDI::Transport* transport);
+  void sendFirmwareManifest(V2MIDI::Transport* transport);
+  void sendConfigurationStatus(V2MIDI::Transport* transport, const char* status);
+  void updateConfiguration(JsonObject config);
   void handleSystemExclusive(V2MIDI::Transport* transport, const uint8_t* buffer, uint32_t len) override;
+  void handleBinary(V2MIDI::Transport* transport, Binary method, const uint8_t* buffer, uint32_t len);
+  void sendBinaryReply(V2MIDI::Transport* transport,
+                       Binary             method,
+                       BinaryStatus       status,
+                       const uint8_t*     data   = nullptr,
+                       uint32_t           length = 0);
+  FirmwareStatus writeFirmwareBlock(uint32_t offset, uint32_t* block, uint32_t length, const char* hash);
+  uint32_t*      reserveFirmwareBlock();
+  FirmwareStatus queueFirmwareBlock(uint32_t offset, uint32_t length);
+  void           writeQueuedFirmwareBlock();
+  bool           beginQueuedFirmwareBlock();
+  void           finishQueuedFirmwareBlock();
+  void           updateFirmwareHash(uint32_t offset, uint32_t length);
+  void           flushFirmwareBlocks();
+  void           activateFirmware();
+  void           flushEEPROM();
+  void           sendTelemetry();
+  void           hashFirmware();
+  void           hashFirmwareManifest();
   bool readEEPROM(bool dryrun = false);
 };
 
@@ -1,5 +1,7 @@
 #pragma once
 #include <Arduino.h>
+#include <V2Base.h>
+#include <utility>
 
 class V2Drum {
 public:
@@ -36,6 +38,10 @@ public:
       // are in the range of 2 to 50 ms.
       uint32_t risingUsec;
 
+      // Emit the hit at the peak, as soon as the measurement falls by 'lag' below
+      // its maximum; 'risingUsec' is the maximum time to wait for the peak.
+      bool peak;
+
       // Minimum time to hold note. The settle time to check for release again,
       // the hardware may bounce to zero, while the note is still held.
       uint32_t holdUsec;
@@ -55,9 +61,12 @@ public:
   };
 
   constexpr V2Drum(const struct Config* config) : _config(config) {}
-  void begin() {}
+  void begin() {
+    initialize();
+  }
 
   void reset() {
+    initialize();
     _now      = {};
     _history  = {};
     _pressure = {};
@@ -72,9 +81,15 @@ public:
     if (V2Base::getUsecSince(_now.usec) < 500)
       return;
 
-    _now.usec = V2Base::getUsec();
+    update(handleMeasurement(), V2Base::getUsec());
+  }
+
+  // Process the measurement taken at 'usec', instead of calling loop(); used if
+  // the measurements of several pads are scanned together.
+  void update(float analog, uint32_t usec) {
+    _now.usec = usec;
 
-    measure();
+    measure(analog);
     sendPressure();
 
     switch (_now.state) {
@@ -82,7 +97,7 @@ public:
         if (_now.step == 0)
           break;
 
-        _rising.usec = V2Base::getUsec();
+        _rising.usec = _now.usec;
         _now.state   = State::Rising;
         break;
 
@@ -96,8 +111,14 @@ public:
         if (_now.fraction > _rising.pressure)
           _rising.pressure = _now.fraction;
 
+        // The signal turned over.
+        if (_config->hit.peak && _rising.pressure > _config->hit.min && _now.fraction + _config->lag < _rising.pressure) {
+          hit();
+          break;
+        }
+
         // Sample timespan.
-        if (V2Base::getUsecSince(_rising.usec) < _config->hit.risingUsec)
+        if (getUsecSince(_rising.usec) < _config->hit.risingUsec)
           break;
 
         // Require minimum rise distance. If we rise too slow, it is not a hit.
@@ -110,34 +131,22 @@ public:
         _now.state = State::Hit;
         break;
 
-      case State::Hit: {
-        // Normalized 0..1 fraction of the min..max range.
-        if (_rising.pressure > _config->hit.max)
-          _rising.pressure = _config->hit.max;
-
-        float fraction = (_rising.pressure - _config->hit.min) / (_config->hit.max - _config->hit.min);
-
-        // Apply exponential correction curve.
-        fraction = powf(fraction, _config->hit.exponent);
-
-        _hit.velocity = ceilf(fraction * (_config->nSteps - 1));
-        _hit.usec     = V2Base::getUsec();
-        _now.state    = State::HitHold;
-        handleHit(_hit.velocity);
-      } break;
+      case State::Hit:
+        hit();
+        break;
 
       case State::HitHold:
         if (_hit.holdUsec == 0) {
-          _hit.holdUsec = V2Base::getUsec();
-          _falling.usec = V2Base::getUsec();
+          _hit.holdUsec = _now.usec;
+          _falling.usec = _now.usec;
         }
 
-        if (V2Base::getUsecSince(_hit.holdUsec) < _config->hit.holdUsec)
+        if (getUsecSince(_hit.holdUsec) < _config->hit.holdUsec)
           break;
 
         // Clear the falling duration whenever the pressure rises again.
         if (_now.step >= _falling.step) {
-          _falling.usec = V2Base::getUsec();
+          _falling.usec = _now.usec;
           _falling.step = _now.step;
         }
 
@@ -148,22 +157,21 @@ public:
         }
 
         // If we stay in 'Hold', enable the pressure events only after the delay timespan.
-        if (V2Base::getUsecSince(_hit.holdUsec) > _config->hit.pressureDelayUsec)
+        if (getUsecSince(_hit.holdUsec) > _config->hit.pressureDelayUsec)
           _pressure.enabled = true;
         break;
 
       case State::HitRelease: {
-        _hit.releaseUsec = V2Base::getUsec();
+        _hit.releaseUsec = _now.usec;
 
         uint32_t duration = _hit.releaseUsec - _falling.usec;
-        if (duration > _config->release.maxUsec)
-          duration = _config->release.maxUsec;
-        else if (duration < _config->release.minUsec)
-          duration = _config->release.minUsec;
+        if (duration > _curve.release.maxUsec)
+          duration = _curve.release.maxUsec;
+        else if (duration < _curve.release.minUsec)
+          duration = _curve.release.minUsec;
 
-        const float range    = _config->release.maxUsec - _config->release.minUsec;
-        const float fraction = ((float)duration - _config->release.minUsec) / range;
-        _falling.velocity    = 127 - (fraction * 126.f);
+        const uint32_t range = _curve.release.maxUsec - _curve.release.minUsec;
+        _falling.velocity    = 127 - (range > 0 ? (duration - _curve.release.minUsec) * 126 / range : 0);
 
         _now.state = State::Release;
         handleRelease(_falling.velocity);
@@ -174,7 +182,7 @@ public:
           break;
 
         // Wait for the release to settle.
-        if (V2Base::getUsecSince(_hit.releaseUsec) < _config->hit.releaseUsec)
+        if (getUsecSince(_hit.releaseUsec) < _config->hit.releaseUsec)
           break;
 
         _now    = {};
@@ -201,6 +209,10 @@ public:
     return _pressure.step;
   }
 
+  bool isIdle() const {
+    return _now.state == State::Idle;
+  }
+
 protected:
   // Normalized 0...1 analog measurement.
   virtual float handleMeasurement() = 0;
@@ -243,6 +255,19 @@ private:
 
   const struct Config* _config;
 
+  // The hit velocities of the normalized 0..1 fraction of the hit min..max range,
+  // with the correction curve applied.
+  static constexpr uint8_t _nVelocities{128};
+  struct {
+    uint8_t velocities[_nVelocities];
+    float   scale;
+
+    struct {
+      uint32_t minUsec;
+      uint32_t maxUsec;
+    } release;
+  } _curve{};
+
   struct {
     State    state;
     uint32_t usec;
@@ -286,8 +311,40 @@ private:
     uint8_t  velocity;
   } _falling{};
 
-  void measure() {
-    _now.analog = handleMeasurement();
+  void initialize() {
+    for (uint8_t i = 0; i < _nVelocities; i++) {
+      const float fraction = powf((float)i / (float)(_nVelocities - 1), _config->hit.exponent);
+      const float velocity = ceilf(fraction * (_config->nSteps - 1));
+
+      // Any pressure above the minimum is at least velocity 1, a velocity of 0
+      // would be a note-off.
+      _curve.velocities[i] = velocity < 1.f ? 1 : velocity < 127.f ? velocity : 127;
+    }
+
+    _curve.scale = (float)(_nVelocities - 1) / (_config->hit.max - _config->hit.min);
+
+    _curve.release.minUsec = _config->release.minUsec;
+    _curve.release.maxUsec = _config->release.maxUsec;
+  }
+
+  void hit() {
+    if (_rising.pressure > _config->hit.max)
+      _rising.pressure = _config->hit.max;
+
+    const float index = (_rising.pressure - _config->hit.min) * _curve.scale + 0.5f;
+    _hit.velocity     = _curve.velocities[index > 0.f ? (uint8_t)index : 0];
+    _hit.usec         = _now.usec;
+    _now.state        = State::HitHold;
+    handleHit(_hit.velocity);
+  }
+
+  // The time since 'usec', at the time of the current measurement.
+  uint32_t getUsecSince(uint32_t usec) const {
+    return _now.usec - usec;
+  }
+
+  void measure(float analog) {
+    _now.analog = analog;
 
     // Low-pass filter, smooth the value.
     _history.analog *= 1 - _config->alpha;
@@ -323,7 +380,7 @@ private:
     if (_pressure.step == _now.step)
       return;
 
-    if (V2Base::getUsecSince(_pressure.usec) < 20 * 1000)
+    if (getUsecSince(_pressure.usec) < 20 * 1000)
       return;
 
     // Reposition the edge of the lag. We follow monotonic changes immediately,
@@ -334,7 +391,7 @@ private:
     else
       _history.lag = _now.fraction + _config->lag;
 
-    _pressure.usec     = V2Base::getUsec();
+    _pressure.usec     = _now.usec;
     _pressure.fraction = _now.fraction;
     _pressure.step     = _now.step;
 
@@ -351,3 +408,172 @@ private:
     handlePressureRaw(_now.fraction, _now.step);
   }
 };
+
+// Several pads, measured together by one scan, e.g. V2Base::Analog::ADC::beginScan();
+// all pads are processed in one pass. A hit masks the weaker hits of neighbouring
+// pads within the crosstalk window, the masked pad emits no events until it is
+// idle again.
+template <uint8_t N> class V2DrumArray {
+public:
+  struct Config {
+    // The configuration of every pad.
+    const V2Drum::Config* pads[N];
+
+    // The interval of the scans.
+    uint32_t periodUsec;
+
+    struct {
+      // The time after a hit, in which the hits of the neighbours are compared to it.
+      uint32_t usec;
+
+      // A hit of pad [j] is masked, if its velocity is lower than the fraction [i][j]
+      // of the velocity of a hit of pad [i]. 0 never masks.
+      float matrix[N][N];
+    } crosstalk;
+  };
+
+  constexpr V2DrumArray(const Config* config) : V2DrumArray(config, std::make_index_sequence<N>()) {}
+
+  void begin() {
+    for (uint8_t i = 0; i < N; i++)
+      _pads[i].begin();
+  }
+
+  void reset() {
+    _usec = 0;
+    _hits = {};
+    for (uint8_t i = 0; i < N; i++)
+      _pads[i].reset();
+  }
+
+  void loop() {
+    if (V2Base::getUsecSince(_usec) < _config->periodUsec)
+      return;
+
+    float analog[N];
+    if (!handleScan(analog))
+      return;
+
+    _usec = V2Base::getUsec();
+
+    for (uint8_t i = 0; i < N; i++) {
+      _hits.pending[i] = 0;
+      _pads[i].update(analog[i], _usec);
+
+      if (_hits.masked[i] && _pads[i].isIdle())
+        _hits.masked[i] = false;
+    }
+
+    // Compare the hits of this pass with each other, and with the recent ones.
+    for (uint8_t i = 0; i < N; i++) {
+      const uint8_t velocity = _hits.pending[i];
+      if (velocity == 0)
+        continue;
+
+      if (isCrosstalk(i, velocity)) {
+        _hits.masked[i] = true;
+        continue;
+      }
+
+      _hits.velocity[i] = velocity;
+      _hits.usec[i]     = _usec;
+      handleHit(i, velocity);
+    }
+  }
+
+  float getFraction(uint8_t pad) {
+    return _pads[pad].getFraction();
+  }
+
+  uint16_t getStep(uint8_t pad) {
+    return _pads[pad].getStep();
+  }
+
+protected:
+  // Read the normalized 0..1 measurements of all pads. Returns false if there is
+  // no new scan.
+  virtual bool handleScan(float analog[N]) = 0;
+
+  virtual void handlePressureRaw(uint8_t pad, float fraction, uint16_t step) {}
+  virtual void handlePressure(uint8_t pad, float fraction, uint16_t step) {}
+  virtual void handleHit(uint8_t pad, uint8_t velocity) {}
+  virtual void handleRelease(uint8_t pad, uint8_t velocity) {}
+
+private:
+  // Forward the events of a pad, the hits are collected and resolved after the pass.
+  class Pad : public V2Drum {
+  public:
+    constexpr Pad(V2DrumArray* array, uint8_t index, const V2Drum::Config* config) :
+      V2Drum(config),
+      _array{array},
+      _index{index} {}
+
+  private:
+    V2DrumArray*  _array;
+    const uint8_t _index;
+
+    float handleMeasurement() override {
+      return 0;
+    }
+
+    void handlePressureRaw(float fraction, uint16_t step) override {
+      if (!_array->_hits.masked[_index])
+        _array->handlePressureRaw(_index, fraction, step);
+    }
+
+    void handlePressure(float fraction, uint16_t step) override {
+      if (!_array->_hits.masked[_index])
+        _array->handlePressure(_index, fraction, step);
+    }
+
+    void handleHit(uint8_t velocity) override {
+      _array->_hits.pending[_index] = velocity;
+    }
+
+    void handleRelease(uint8_t velocity) override {
+      if (!_array->_hits.masked[_index])
+        _array->handleRelease(_index, velocity);
+    }
+  };
+
+  const Config* _config;
+  Pad           _pads[N];
+  uint32_t      _usec{};
+
+  struct {
+    // The hits of the current pass.
+    uint8_t pending[N];
+
+    // The last emitted hits.
+    uint8_t  velocity[N];
+    uint32_t usec[N];
+
+    // The current hit of the pad is crosstalk.
+    bool masked[N];
+  } _hits{};
+
+  template <size_t... I>
+  constexpr V2DrumArray(const Config* config, std::index_sequence<I...>) :
+    _config{config},
+    _pads{Pad(this, I, config->pads[I])...} {}
+
+  bool isCrosstalk(uint8_t pad, uint8_t velocity) {
+    for (uint8_t i = 0; i < N; i++) {
+      if (i == pad)
+        continue;
+
+      const float fraction = _config->crosstalk.matrix[i][pad];
+      if (fraction <= 0.f)
+        continue;
+
+      uint8_t other = _hits.pending[i];
+      if (other == 0 && V2Base::getUsecSince(_hits.usec[i]) < _config->crosstalk.usec)
+        other = _hits.velocity[i];
+
+      if (other > velocity && (float)velocity < fraction * (float)other)
+        return true;
+    }
+
+    return false;
+  }
+};
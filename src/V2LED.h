@@ -1,13 +1,19 @@
 #pragma once
 #include "V2Colour.h"
 #include <SPI.h>
+#include <initializer_list>
 #include <V2Base.h>
 
 namespace V2LED {
-  // Simple digital port driver driven by a timer.
+  // Simple digital port driver driven by a timer, or by the hardware PWM of a TCC
+  // if the pin is connected to one. In PWM mode there are no interrupts; the pin
+  // needs to be switched to the TCC and the PWM started before the LED is used:
+  //   V2Base::Timer::PWM::setupPin(PIN_LED);
+  //   PWM.begin();
   class Basic {
   public:
     constexpr Basic(uint8_t pin, V2Base::Timer::Periodic* timer) : _pin(pin), _timer(timer) {}
+    constexpr Basic(uint8_t pin, V2Base::Timer::PWM* pwm) : _pin(pin), _pwm{.timer{pwm}, .pin{pin}} {}
     auto tick() -> void;
     auto setBrightness(float fraction) -> void;
     auto flash(float seconds, float brightness = 1) -> void;
@@ -16,7 +22,12 @@ namespace V2LED {
 
   private:
     V2Base::GPIO             _pin;
-    V2Base::Timer::Periodic* _timer;
+    V2Base::Timer::Periodic* _timer{};
+
+    struct {
+      V2Base::Timer::PWM* timer;
+      uint8_t             pin;
+    } _pwm{};
 
     struct {
       unsigned long startUsec{};
@@ -54,8 +65,15 @@ namespace V2LED {
       _leds.count = count;
     }
 
+    // Allocate a second DMA buffer; the next frame is encoded while the previous one
+    // is transmitted. Needs to be called before begin().
+    auto setDoubleBuffer(bool enable = true) {
+      _dma.doubleBuffer = enable;
+    }
+
     auto setDirection(bool reverse) {
       _leds.reverse = reverse;
+      setDirty(0, _leds.count - 1);
     }
 
     // The fraction of the brightness to apply. The value is applied with
@@ -109,12 +127,44 @@ namespace V2LED {
       return _rainbow.cycleSteps > 0;
     }
 
+    enum class Easing : uint8_t { Step, Linear, In, Out, InOut };
+
+    // The colour of a segment at the end of a transition, with the duration and
+    // the easing of the transition from the previous keyframe. Hue in degrees,
+    // saturation and brightness 0..255.
+    struct Keyframe {
+      uint16_t h;
+      uint8_t  s;
+      uint8_t  v;
+      uint16_t msec;
+      Easing   easing;
+    };
+
+    // Animate 'count' LEDs from 'start' through the keyframes. The first keyframe
+    // is the colour at the start; when looping, its duration is the transition
+    // from the last keyframe back to the first one. Every following LED is delayed
+    // by 'spreadMsec' to draw a chase. The keyframes are not copied. Returns false
+    // if all slots are in use.
+    auto animate(uint16_t start, uint16_t count, const Keyframe* frames, uint8_t nFrames, bool loop = true, uint16_t spreadMsec = 0)
+      -> bool;
+
+    // Stop all animations; the LEDs keep their current colour.
+    auto stopAnimations() -> void {
+      for (uint8_t i = 0; i < _nAnimations; i++)
+        _animations[i] = {};
+    }
+
   private:
+    template <uint8_t N> friend class WS2812Group;
+
     const uint16_t _nLEDsMax{};
     struct {
       uint16_t count{};
       bool     reverse{};
       float    maxBrightness{1};
+
+      // The lightness table, indexed by the brightness.
+      uint8_t* lightness{};
     } _leds;
 
     struct {
@@ -127,11 +177,22 @@ namespace V2LED {
     SPIClass* _spi{};
 
     struct {
-      uint8_t* buffer{};
+      uint8_t* buffers[2]{};
       uint16_t bufferSize{};
-      bool     update{};
+      bool     doubleBuffer{};
+
+      // The buffer of the last transfer.
+      uint8_t front{};
+      bool    update{};
     } _dma;
 
+    // The range of LEDs to encode into the DMA buffer with the next loop(), for
+    // every buffer.
+    struct {
+      uint16_t first{UINT16_MAX};
+      uint16_t last{};
+    } _dirty[2];
+
     struct PixelRGB {
       uint8_t r{};
       uint8_t g{};
@@ -142,7 +203,7 @@ namespace V2LED {
       uint8_t g[3]{};
       uint8_t r[3]{};
       uint8_t b[3]{};
-    }* _pixelDMA{};
+    };
 
     struct {
       PixelRGB      pixel;
@@ -150,6 +211,9 @@ namespace V2LED {
       uint16_t      count{};
       unsigned long startUsec{};
       unsigned long durationUsec{};
+
+      // The buffers which need the overlay to be encoded.
+      uint8_t dirty{};
     } _splash;
 
     struct {
@@ -162,7 +226,84 @@ namespace V2LED {
       unsigned long lastUsec{};
     } _rainbow{};
 
+    auto setDirty(uint16_t first, uint16_t last) -> void {
+      for (uint8_t i = 0; i < 2; i++) {
+        if (first < _dirty[i].first)
+          _dirty[i].first = first;
+
+        if (last > _dirty[i].last)
+          _dirty[i].last = last;
+      }
+
+      _dma.update = true;
+    }
+
+    static constexpr uint8_t _nAnimations{4};
+
+    struct Animation {
+      const Keyframe* frames;
+      uint8_t         nFrames;
+      bool            loop;
+      uint16_t        start;
+      uint16_t        count;
+      uint16_t        spreadMsec;
+
+      // The duration of one cycle through the keyframes.
+      uint32_t      durationMsec;
+      unsigned long startUsec;
+    } _animations[_nAnimations]{};
+
+    unsigned long _animationUsec{};
+
+    auto drawAnimations() -> void;
+    auto draw() -> void;
+    auto encode() -> bool;
+    auto send() -> void;
+
+    auto isBusy() -> bool {
+      return _spi->isBusy();
+    }
+
+    // The number of brightness steps of the lightness table.
+    static constexpr uint16_t _nLightness{1024};
+
+    auto updateLightness() -> void;
     auto setLED(uint16_t index, float h, float s, float v) -> void;
     auto encodePixel(const struct PixelRGB* rgb, struct PixelDMA* dma) -> void;
   };
+
+  // Several strips, every one connected to its own SERCOM, refreshed as one frame.
+  // The changes of all strips are encoded first, then the DMA transfers are started
+  // back to back, so the strips latch at the same time. The strips are driven by
+  // the group's loop() instead of their own.
+  template <uint8_t N> class WS2812Group {
+  public:
+    WS2812Group(std::initializer_list<WS2812*> strips) {
+      for (WS2812* strip : strips)
+        if (_count < N)
+          _strips[_count++] = strip;
+    }
+
+    auto loop() -> void {
+      for (uint8_t i = 0; i < _count; i++)
+        _strips[i]->draw();
+
+      // The frame sync; wait for all strips to finish their transfer.
+      for (uint8_t i = 0; i < _count; i++)
+        if (_strips[i]->isBusy())
+          return;
+
+      bool ready[N]{};
+      for (uint8_t i = 0; i < _count; i++)
+        ready[i] = _strips[i]->encode();
+
+      for (uint8_t i = 0; i < _count; i++)
+        if (ready[i])
+          _strips[i]->send();
+    }
+
+  private:
+    WS2812* _strips[N]{};
+    uint8_t _count{};
+  };
 };
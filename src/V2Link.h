@@ -4,17 +4,40 @@
 // the children devices. Up to 16 devices can be daisy-chained.
 
 #pragma once
+#include <Adafruit_ZeroDMA.h>
 #include <Arduino.h>
 #include <V2MIDI.h>
+#include <atomic>
 
 class V2Link {
 public:
   // Header:
   //   4 bit: target/child address,
-  //   4 bit: message type
+  //   1 bit: broadcast, MIDI and pulse packets only
+  //   3 bit: message type
+  //
+  // A broadcast packet is delivered to every device on its way to the target/child
+  // address; 0x0f reaches the entire chain with a single frame.
+  //
+  // Burst frame, multiple MIDI packets for the same address and broadcast flag:
+  //   8 bit: header,
+  //   8 bit: number of packets,
+  //   4 bytes per packet
+  //
+  // Credit, flow control between the two ends of a line, it is not forwarded:
+  //   8 bit: number of packets the receiver has taken from its buffer
+  //
+  // Ping, latency probe to a child device, it is answered with a pong:
+  //   8 bit: sequence number
+  //
+  // Pong, the answer to a ping, every hop towards the parent increments the hops:
+  //   8 bit: sequence number
+  //   8 bit: number of hops
+  //   8 bit: highest number of queued packets of the answering device
+  //   8 bit: number of framing errors of the answering device
   class Packet : public V2MIDI::Transport {
   public:
-    enum class Type : uint8_t { MIDI, Pulse };
+    enum class Type : uint8_t { MIDI, Pulse, Burst, Credit, Ping, Pong };
 
     // Solenoid pulse:
     //   12 bit: watts
@@ -29,8 +52,28 @@ public:
       bool    fadeOut;
     };
 
+    struct Probe {
+      uint8_t sequence;
+      uint8_t hops;
+      uint8_t highWater;
+      uint8_t errors;
+    };
+
     Type getType() const {
-      return static_cast<Type>(_data[0] & 0x0f);
+      return static_cast<Type>(_data[0] & 0x07);
+    }
+
+    bool isBroadcast() const {
+      return _data[0] & 0x08;
+    }
+
+    // Set after setPulse()/send(), they reset the header.
+    void setBroadcast(bool broadcast) {
+      if (broadcast)
+        _data[0] |= 0x08;
+
+      else
+        _data[0] &= ~0x08;
     }
 
     uint8_t getAddress() const {
@@ -55,19 +98,8 @@ public:
       pulse->port    = _data[1] & 0x0f;
       pulse->fadeIn  = _data[1] & (1 << 4);
       pulse->fadeOut = _data[1] & (1 << 5);
-
-      {
-        auto map{uint16_t((_data[2] >> 4) << 8)};
-        map |= _data[3];
-        auto fraction{float(map) / 4095.f};
-        pulse->watts = 100.f * powf(fraction, 3);
-      }
-      {
-        auto map{uint16_t((_data[2] & 0x0f) << 8)};
-        map |= _data[4];
-        const float fraction = float(map) / 4095.f;
-        pulse->seconds       = 100.f * powf(fraction, 8);
-      }
+      pulse->watts   = decodeWatts(((_data[2] >> 4) << 8) | _data[3]);
+      pulse->seconds = decodeSeconds(((_data[2] & 0x0f) << 8) | _data[4]);
     }
 
     void setPulse(const Packet::Pulse* pulse) {
@@ -79,30 +111,67 @@ public:
         _data[1] |= 1 << 5;
 
       {
-        auto watts{pulse->watts};
-        if (watts > 100.f)
-          watts = 100;
-
-        auto fraction{watts / 100.f};
-        auto map{uint16_t(powf(fraction, 1.f / 3.f) * 4095.f)};
+        const uint16_t map{encode(pulse->watts, decodeWatts)};
         _data[2] = (map >> 8) << 4;
         _data[3] = map & 0xff;
       }
       {
-        float seconds = pulse->seconds;
-        if (seconds > 100.f)
-          seconds = 100;
-
-        auto fraction{seconds / 100.f};
-        auto map{uint16_t(powf(fraction, 1.f / 8.f) * 4095.f)};
+        const uint16_t map{encode(pulse->seconds, decodeSeconds)};
         _data[2] |= map >> 8;
         _data[4] = map & 0xff;
       }
     }
 
+    // The 12 bit values map to cubic (watts) and 8th power (seconds) curves
+    // from 0 to 100.
+    static constexpr float decodeWatts(uint16_t map) {
+      const float fraction{float(map) / 4095.f};
+      return 100.f * fraction * fraction * fraction;
+    }
+
+    static constexpr float decodeSeconds(uint16_t map) {
+      const float f2{float(map) / 4095.f * float(map) / 4095.f};
+      const float f4{f2 * f2};
+      return 100.f * f4 * f4;
+    }
+
+    void getProbe(Probe* probe) const {
+      probe->sequence  = _data[1];
+      probe->hops      = _data[2];
+      probe->highWater = _data[3];
+      probe->errors    = _data[4];
+    }
+
+    void setPing(uint8_t sequence) {
+      _data[0] = (uint8_t)Packet::Type::Ping;
+      _data[1] = sequence;
+      _data[2] = 0;
+      _data[3] = 0;
+      _data[4] = 0;
+    }
+
+    void setPong(const Probe* probe) {
+      _data[0] = (uint8_t)Packet::Type::Pong;
+      _data[1] = probe->sequence;
+      _data[2] = probe->hops;
+      _data[3] = probe->highWater;
+      _data[4] = probe->errors;
+    }
+
   private:
     friend class V2Link;
     uint8_t _data[5];
+
+    // The largest value which does not decode to more than 'value'; a binary
+    // search over the monotonic curve, 12 steps instead of a root.
+    static constexpr uint16_t encode(float value, float (*decode)(uint16_t)) {
+      uint16_t map{};
+      for (uint16_t bit = 1 << 11; bit > 0; bit >>= 1)
+        if (decode(map | bit) <= value)
+          map |= bit;
+
+      return map;
+    }
   };
 
   class Port : public V2MIDI::Transport {
@@ -110,11 +179,50 @@ public:
     struct {
       uint32_t input{};
       uint32_t output{};
+
+      // The number of sent frames carrying multiple packets.
+      uint32_t burst{};
+
+      // The number of packets dropped because the queue was full.
+      uint32_t dropped{};
+
+      // The maximum number of packets waiting in the queues.
+      uint32_t highWater{};
+
+      // Framed mode, the number of frames with an invalid length or CRC.
+      uint32_t error{};
+
+      // Framed mode, the number of bytes discarded to find the next frame.
+      uint32_t resync{};
     } statistics;
 
     constexpr Port(Uart* uart, uint8_t pinTx = 0) : _uart(uart), _pinTx(pinTx) {}
 
-    void begin() {
+    // Protect the packets with a CRC-8 and delimit them with COBS encoding; a frame
+    // is 8 bytes long. A corrupted frame is dropped, the receiver resynchronizes with
+    // the delimiter of the next frame. Both sides of the line need to use the same mode.
+    void setFramed(bool framed) {
+      _framed = framed;
+      _frame  = {};
+    }
+
+    // Combine consecutive MIDI packets for the same address into a single frame of
+    // up to 8 packets. The packets are queued until flush() is called, V2Link::loop()
+    // flushes the ports. Received burst frames are always accepted, the peer only
+    // needs to support them if bursts are sent.
+    void setBurst(bool burst) {
+      flush();
+      _burst.enabled = burst;
+    }
+
+    // Credit-based flow control; the receiver returns a credit for every packet it has
+    // taken from its buffer, the sender keeps the packets in its queue while it has no
+    // credits. Both sides of the line need to use the same mode.
+    void setFlowControl(bool enable) {
+      _flow = {.enabled = enable, .credits = _flowWindow, .usec = micros()};
+    }
+
+    virtual void begin() {
       _uart->begin(3000000);
       _uart->setTimeout(1);
 
@@ -129,34 +237,37 @@ public:
     }
 
     bool receive(Packet* packet) {
-      if (_uart->available() == 0)
-        return false;
+      // The remaining packets of a received burst frame.
+      if (popBurst(packet))
+        return true;
 
-      _usec = micros();
+      if (available() == 0) {
+        // Drop partial messages which don't complete in time.
+        if (!_framed && _frame.length > 0 && (unsigned long)(micros() - _timeoutUsec) > 100)
+          _frame = {};
 
-      // Drop partial messages which don't complete in time.
-      if (_uart->available() < 5) {
-        if (_timeoutUsec == 0)
-          _timeoutUsec = micros();
+        return false;
+      }
 
-        if ((unsigned long)(micros() - _timeoutUsec) > 100) {
-          while (_uart->available())
-            _uart->read();
+      _usec        = micros();
+      _timeoutUsec = _usec;
 
-          _timeoutUsec = 0;
+      while (available() > 0) {
+        if (_framed ? parseFrame(read(), packet) : collectFrame(read(), packet)) {
+          returnCredits();
+          return true;
         }
-
-        return false;
       }
 
-      _timeoutUsec = 0;
-      _uart->readBytes(packet->_data, 5);
-      statistics.input++;
-
-      return true;
+      returnCredits();
+      return false;
     }
 
+    // Queue the packet and send as many queued packets as possible. Pulse packets
+    // are sent ahead of MIDI packets. Returns false if the queue is full.
     bool send(uint8_t address, Packet* packet) {
+      const Critical critical(_shared);
+
       if (!_active) {
         if (_pinTx > 0)
           digitalWrite(_pinTx, HIGH);
@@ -166,14 +277,82 @@ public:
 
       _usec = micros();
 
-      if (_uart->availableForWrite() < 5)
+      const bool midi = packet->getType() == Packet::Type::MIDI;
+      if (!(midi ? _queue.normal.push(address, packet) : _queue.high.push(address, packet))) {
+        statistics.dropped++;
         return false;
+      }
+
+      const uint32_t count = _queue.high.count() + _queue.normal.count();
+      if (count > statistics.highWater)
+        statistics.highWater = count;
+
+      if (!_burst.enabled)
+        flush();
+
+      return true;
+    }
+
+    // Send the queued packets. Returns false if packets are left in the queue.
+    bool flush() {
+      const Critical critical(_shared);
+
+      // The credits of the peer got lost, start over.
+      if (_flow.enabled && _flow.credits == 0 && (unsigned long)(micros() - _flow.usec) > 100 * 1000)
+        _flow.credits = _flowWindow;
+
+      while (!_queue.high.empty()) {
+        if (_flow.enabled && _flow.credits == 0)
+          return false;
+
+        const Entry* entry = _queue.high.front();
+        if (!writeFrame(entry->address << 4 | (entry->data[0] & 0x0f), entry->data + 1, 4))
+          return false;
+
+        _queue.high.pop(1);
+        useCredits(1);
+        statistics.output++;
+      }
 
-      uint8_t header = address << 4;
-      header |= packet->_data[0] & 0x0f;
-      _uart->write(header);
-      _uart->write(packet->_data + 1, 4);
-      statistics.output++;
+      while (!_queue.normal.empty()) {
+        // Collect the following packets for the same address and broadcast flag.
+        uint8_t       count     = 1;
+        const uint8_t address   = _queue.normal.front()->address;
+        const uint8_t broadcast = _queue.normal.front()->data[0] & 0x08;
+        if (_burst.enabled) {
+          while (count < _burstPackets && count < _queue.normal.count() && _queue.normal.at(count)->address == address &&
+                 (_queue.normal.at(count)->data[0] & 0x08) == broadcast)
+            count++;
+        }
+
+        if (_flow.enabled) {
+          if (_flow.credits == 0)
+            return false;
+
+          if (count > _flow.credits)
+            count = _flow.credits;
+        }
+
+        if (count == 1) {
+          if (!writeFrame(address << 4 | broadcast | (uint8_t)Packet::Type::MIDI, _queue.normal.front()->data + 1, 4))
+            return false;
+
+        } else {
+          uint8_t payload[1 + _burstPackets * 4];
+          payload[0] = count;
+          for (uint8_t i = 0; i < count; i++)
+            memcpy(payload + 1 + i * 4, _queue.normal.at(i)->data + 1, 4);
+
+          if (!writeFrame(address << 4 | broadcast | (uint8_t)Packet::Type::Burst, payload, 1 + count * 4))
+            return false;
+
+          statistics.burst++;
+        }
+
+        _queue.normal.pop(count);
+        useCredits(count);
+        statistics.output += count;
+      }
 
       return true;
     }
@@ -189,15 +368,324 @@ public:
       return send(midi->getPort(), &packet);
     }
 
+  protected:
+    // Access to the bytes of the line.
+    virtual int available() {
+      return _uart->available();
+    }
+
+    virtual uint8_t read() {
+      return _uart->read();
+    }
+
+    virtual bool write(const uint8_t* data, uint8_t length) {
+      if (_uart->availableForWrite() < length)
+        return false;
+
+      _uart->write(data, length);
+      return true;
+    }
+
   private:
     friend class V2Link;
-    Uart*         _uart;
-    const uint8_t _pinTx;
-    bool          _active{};
-    unsigned long _timeoutUsec{};
-    unsigned long _usec{};
+    static constexpr uint8_t _burstPackets{8};
+    static constexpr uint8_t _flowWindow{16};
+    Uart*                    _uart;
+    const uint8_t            _pinTx;
+    bool                     _active{};
+    unsigned long            _timeoutUsec{};
+    unsigned long            _usec{};
+    bool                     _framed{};
+
+    // The port is written from the main loop and the cut-through interrupt.
+    bool _shared{};
+
+    // Disable the interrupts while the port is shared.
+    class Critical {
+    public:
+      Critical(bool enable) : _enabled{enable}, _primask{__get_PRIMASK()} {
+        if (_enabled)
+          __disable_irq();
+      }
+
+      ~Critical() {
+        if (_enabled)
+          __set_PRIMASK(_primask);
+      }
+
+    private:
+      const bool     _enabled;
+      const uint32_t _primask;
+    };
+
+    // The bytes of the current frame; COBS-encoded without the delimiter in framed
+    // mode. The largest frame is a burst: the header, the number of packets, the
+    // packets and the CRC.
+    struct {
+      uint8_t data[2 + _burstPackets * 4 + 1 + 1];
+      uint8_t length;
+      bool    overflow;
+    } _frame{};
+
+    // A packet waiting to be sent.
+    struct Entry {
+      uint8_t address;
+      uint8_t data[5];
+    };
+
+    template <uint8_t N> class Ring {
+    public:
+      bool push(uint8_t address, const Packet* packet) {
+        if (_count == N)
+          return false;
+
+        Entry* entry   = &_entries[(_first + _count) % N];
+        entry->address = address;
+        memcpy(entry->data, packet->_data, 5);
+        _count++;
+        return true;
+      }
+
+      Entry* front() {
+        return &_entries[_first];
+      }
+
+      Entry* at(uint8_t i) {
+        return &_entries[(_first + i) % N];
+      }
+
+      void pop(uint8_t n) {
+        _first = (_first + n) % N;
+        _count -= n;
+      }
+
+      uint8_t count() const {
+        return _count;
+      }
+
+      bool empty() const {
+        return _count == 0;
+      }
+
+    private:
+      Entry   _entries[N]{};
+      uint8_t _first{};
+      uint8_t _count{};
+    };
+
+    // Pulse and MIDI packets.
+    struct {
+      Ring<4>  high;
+      Ring<32> normal;
+    } _queue{};
+
+    struct {
+      bool          enabled;
+      uint8_t       credits;
+      unsigned long usec;
+
+      // The number of received frames not yet announced to the peer.
+      uint8_t received;
+    } _flow{};
+
+    struct {
+      bool enabled;
+
+      // The packets of the last received burst frame.
+      struct {
+        uint8_t header;
+        uint8_t count;
+        uint8_t position;
+        uint8_t data[_burstPackets * 4];
+      } in;
+    } _burst{};
+
+    // CRC-8, polynomial 0x07.
+    static constexpr uint8_t crc8(const uint8_t* data, uint8_t length) {
+      uint8_t crc = 0;
+      for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t b = 0; b < 8; b++)
+          crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+      }
+
+      return crc;
+    }
+
+    // Write the header and the payload. In framed mode, append the CRC, encode
+    // with COBS and terminate the frame with 0.
+    bool writeFrame(uint8_t header, const uint8_t* payload, uint8_t length) {
+      uint8_t raw[sizeof(_frame.data)];
+      raw[0] = header;
+      memcpy(raw + 1, payload, length);
+      length++;
+
+      if (!_framed)
+        return write(raw, length);
+
+      raw[length] = crc8(raw, length);
+      length++;
+
+      uint8_t frame[sizeof(_frame.data) + 1];
+      uint8_t code     = 1;
+      uint8_t index    = 0;
+      uint8_t position = 1;
+      for (uint8_t i = 0; i < length; i++) {
+        if (raw[i] == 0) {
+          frame[index] = code;
+          code         = 1;
+          index        = position++;
+          continue;
+        }
+
+        frame[position++] = raw[i];
+        code++;
+      }
+
+      frame[index]      = code;
+      frame[position++] = 0;
+      return write(frame, position);
+    }
+
+    // The expected length of the frame, 0 if it is not known yet.
+    static uint16_t getFrameLength(const uint8_t* raw, uint8_t length) {
+      if ((raw[0] & 0x07) != (uint8_t)Packet::Type::Burst)
+        return 5;
+
+      if (length < 2)
+        return 0;
+
+      return 2 + raw[1] * 4;
+    }
+
+    // Collect the bytes of an unframed packet.
+    bool collectFrame(uint8_t b, Packet* packet) {
+      _frame.data[_frame.length++] = b;
+
+      const uint16_t length = getFrameLength(_frame.data, _frame.length);
+      if (length > sizeof(_frame.data)) {
+        _frame = {};
+        return false;
+      }
+
+      if (length == 0 || _frame.length < length)
+        return false;
+
+      const bool valid = unpackFrame(_frame.data, length, packet);
+      _frame           = {};
+      return valid;
+    }
+
+    // Collect the bytes of a frame, returns true if a valid packet is complete.
+    bool parseFrame(uint8_t b, Packet* packet) {
+      if (b != 0) {
+        if (_frame.length == sizeof(_frame.data)) {
+          _frame.overflow = true;
+          statistics.resync++;
+          return false;
+        }
+
+        _frame.data[_frame.length++] = b;
+        return false;
+      }
+
+      uint8_t       raw[sizeof(_frame.data)];
+      const uint8_t length = _frame.overflow ? 0 : decodeFrame(raw);
+      _frame               = {};
+      if (length < 2 || crc8(raw, length - 1) != raw[length - 1] || getFrameLength(raw, length) != length - 1) {
+        statistics.error++;
+        return false;
+      }
+
+      return unpackFrame(raw, length - 1, packet);
+    }
+
+    // Decode the COBS-encoded frame, returns the number of bytes, 0 if it is invalid.
+    uint8_t decodeFrame(uint8_t* raw) const {
+      uint8_t n = 0;
+      uint8_t i = 0;
+      while (i < _frame.length) {
+        const uint8_t code = _frame.data[i++];
+        for (uint8_t k = 1; k < code; k++) {
+          if (i == _frame.length)
+            return 0;
+
+          raw[n++] = _frame.data[i++];
+        }
+
+        if (code < 0xff && i < _frame.length)
+          raw[n++] = 0;
+      }
+
+      return n;
+    }
+
+    // Copy a single packet, or store the packets of a burst frame.
+    bool unpackFrame(const uint8_t* raw, uint8_t length, Packet* packet) {
+      switch ((Packet::Type)(raw[0] & 0x07)) {
+        case Packet::Type::Burst:
+          break;
+
+        case Packet::Type::Credit:
+          if (_flow.enabled) {
+            _flow.credits = _flow.credits + raw[1] < _flowWindow ? _flow.credits + raw[1] : _flowWindow;
+            _flow.usec    = micros();
+          }
+          return false;
+
+        default:
+          memcpy(packet->_data, raw, 5);
+          statistics.input++;
+          _flow.received++;
+          return true;
+      }
+
+      const uint8_t count = raw[1];
+      if (count == 0 || count > _burstPackets)
+        return false;
+
+      _burst.in.header   = raw[0] & 0xf8;
+      _burst.in.count    = count;
+      _burst.in.position = 0;
+      memcpy(_burst.in.data, raw + 2, count * 4);
+      return popBurst(packet);
+    }
+
+    bool popBurst(Packet* packet) {
+      if (_burst.in.position == _burst.in.count)
+        return false;
+
+      packet->_data[0] = _burst.in.header | (uint8_t)Packet::Type::MIDI;
+      memcpy(packet->_data + 1, _burst.in.data + _burst.in.position * 4, 4);
+      _burst.in.position++;
+      statistics.input++;
+      _flow.received++;
+      return true;
+    }
+
+    void useCredits(uint8_t n) {
+      if (!_flow.enabled)
+        return;
+
+      _flow.credits -= n;
+      if (_flow.credits == 0)
+        _flow.usec = micros();
+    }
+
+    // Announce the received packets to the peer.
+    void returnCredits() {
+      if (!_flow.enabled || _flow.received < _flowWindow / 2)
+        return;
+
+      const Critical critical(_shared);
+      const uint8_t  payload[4]{_flow.received};
+      if (writeFrame((uint8_t)Packet::Type::Credit, payload, 4))
+        _flow.received = 0;
+    }
 
     void powerDown() {
+      const Critical critical(_shared);
+
       if (!_active)
         return;
 
@@ -212,6 +700,148 @@ public:
     }
   };
 
+  // The SERCOM data register is read and written by the DMA engine. The received
+  // bytes are written into a circular buffer, the frames to send are queued and
+  // transmitted in the background; the CPU only copies complete frames. The
+  // instance needs to be registered with the DMA engine to continue sending:
+  //
+  //   V2Link::DMAPort Socket(&SerialSocket, SERCOM2, SERCOM2_DMAC_ID_RX, SERCOM2_DMAC_ID_TX,
+  //                          [](Adafruit_ZeroDMA* dma) { Socket.handleTransmit(); });
+  class DMAPort : public Port {
+  public:
+    DMAPort(Uart* uart,
+            Sercom* sercom,
+            uint8_t triggerRx,
+            uint8_t triggerTx,
+            void (*dmaCallback)(Adafruit_ZeroDMA* dma),
+            uint8_t pinTx = 0) :
+      Port(uart, pinTx),
+      _sercom{sercom},
+      _triggerRx{triggerRx},
+      _triggerTx{triggerTx},
+      _dmaCallback{dmaCallback} {}
+
+    void begin() override {
+      Port::begin();
+
+      // The data register is read by the DMA engine, not by the UART interrupt handler.
+      _sercom->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_RXC;
+
+      _dmaRx.setTrigger(_triggerRx);
+      _dmaRx.setAction(DMA_TRIGGER_ACTON_BEAT);
+      _dmaRx.allocate();
+      _dmaRx.addDescriptor((void*)&_sercom->USART.DATA.reg, _rx.buffer, sizeof(_rx.buffer), DMA_BEAT_SIZE_BYTE, false, true);
+      _dmaRx.loop(true);
+      _dmaRx.startJob();
+
+      _dmaTx.setTrigger(_triggerTx);
+      _dmaTx.setAction(DMA_TRIGGER_ACTON_BEAT);
+      _dmaTx.allocate();
+      _tx.descriptor = _dmaTx.addDescriptor(_tx.buffer, (void*)&_sercom->USART.DATA.reg, 5, DMA_BEAT_SIZE_BYTE, true, false);
+      _dmaTx.setCallback(_dmaCallback);
+    }
+
+    // Called from the DMA interrupt after a transfer has completed.
+    void handleTransmit() {
+      _tx.tail.store(_tx.tail.load(std::memory_order_relaxed) + _tx.count, std::memory_order_release);
+      _tx.busy = false;
+      startTransmit();
+    }
+
+  protected:
+    int available() override {
+      return (getReceiveHead() - _rx.tail + sizeof(_rx.buffer)) % sizeof(_rx.buffer);
+    }
+
+    uint8_t read() override {
+      const uint8_t b = _rx.buffer[_rx.tail];
+      _rx.tail        = (_rx.tail + 1) % sizeof(_rx.buffer);
+      return b;
+    }
+
+    bool write(const uint8_t* data, uint8_t length) override {
+      const uint32_t head = _tx.head.load(std::memory_order_relaxed);
+      if (head - _tx.tail.load(std::memory_order_acquire) + length > sizeof(_tx.buffer))
+        return false;
+
+      for (uint8_t i = 0; i < length; i++)
+        _tx.buffer[(head + i) % sizeof(_tx.buffer)] = data[i];
+
+      _tx.head.store(head + length, std::memory_order_release);
+
+      // The caller might already run with the interrupts disabled.
+      const uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+      if (!_tx.busy)
+        startTransmit();
+      __set_PRIMASK(primask);
+
+      return true;
+    }
+
+  private:
+    Sercom* const _sercom;
+    const uint8_t _triggerRx;
+    const uint8_t _triggerTx;
+    void (*const _dmaCallback)(Adafruit_ZeroDMA* dma);
+    Adafruit_ZeroDMA _dmaRx;
+    Adafruit_ZeroDMA _dmaTx;
+
+    struct {
+      uint8_t  buffer[256];
+      uint16_t tail;
+    } _rx{};
+
+    struct {
+      uint8_t         buffer[256];
+      DmacDescriptor* descriptor;
+
+      // Free-running indices of the bytes, only write() changes the head, only the
+      // DMA interrupt changes the tail.
+      std::atomic<uint32_t> head;
+      std::atomic<uint32_t> tail;
+
+      // The number of bytes of the current transfer.
+      volatile bool busy;
+      uint16_t      count;
+    } _tx{};
+
+    // The position of the next byte the DMA engine will write. The remaining beat
+    // count is in the active channel register while it transfers, otherwise in the
+    // write-back descriptor.
+    uint16_t getReceiveHead() {
+      const uint8_t channel = _dmaRx.getChannel();
+      uint16_t      remain;
+      if (DMAC->ACTIVE.bit.ABUSY && DMAC->ACTIVE.bit.ID == channel)
+        remain = DMAC->ACTIVE.bit.BTCNT;
+
+      else
+        remain = ((DmacDescriptor*)DMAC->WRBADDR.reg)[channel].BTCNT.reg;
+
+      if (remain == 0)
+        return 0;
+
+      return sizeof(_rx.buffer) - remain;
+    }
+
+    // Start a transfer of the queued bytes up to the end of the buffer.
+    void startTransmit() {
+      const uint32_t tail  = _tx.tail.load(std::memory_order_relaxed);
+      uint32_t       count = _tx.head.load(std::memory_order_acquire) - tail;
+      if (count == 0)
+        return;
+
+      const uint16_t first = tail % sizeof(_tx.buffer);
+      if (first + count > sizeof(_tx.buffer))
+        count = sizeof(_tx.buffer) - first;
+
+      _dmaTx.changeDescriptor(_tx.descriptor, _tx.buffer + first, NULL, count);
+      _tx.count = count;
+      _tx.busy  = true;
+      _dmaTx.startJob();
+    }
+  };
+
   constexpr V2Link(Port* port_, Port* socket_) : plug(port_), socket(socket_) {}
 
   void begin() {
@@ -222,17 +852,105 @@ public:
       socket->begin();
   }
 
+  // Cut-through mode: forward() is called from a Timer::Periodic interrupt handler.
+  // The packets for other devices are forwarded immediately, the packets for this
+  // device are queued and handled by loop(). The ports must not be received from
+  // outside of forward().
+  //
+  //   Timer.begin([]() { Link.forward(); });
+  void setCutThrough(bool enable) {
+    _cutThrough.enabled = enable;
+    if (plug)
+      plug->_shared = enable;
+
+    if (socket)
+      socket->_shared = enable;
+  }
+
+  void forward() {
+    Packet packet;
+
+    if (plug) {
+      while (plug->receive(&packet)) {
+        trace(V2Base::Timer::Trace::Event::Received, &packet);
+        if (packet.getAddress() > 0) {
+          if (socket && socket->send(packet.getAddress() - 1, &packet)) {
+            trace(V2Base::Timer::Trace::Event::Forwarded, &packet);
+            statistics.forwarded++;
+          }
+
+          if (packet.isBroadcast())
+            push(&packet, false);
+
+        } else if (!answerPing(&packet)) {
+          push(&packet, false);
+        }
+      }
+    }
+
+    if (socket) {
+      while (socket->receive(&packet)) {
+        trace(V2Base::Timer::Trace::Event::Received, &packet);
+        countHop(&packet);
+        if (plug && packet.getAddress() < 0x0f && plug->send(packet.getAddress() + 1, &packet)) {
+          trace(V2Base::Timer::Trace::Event::Forwarded, &packet);
+          statistics.forwarded++;
+        }
+
+        if (!receivePong(&packet))
+          push(&packet, true);
+      }
+    }
+
+    if (plug)
+      plug->flush();
+
+    if (socket)
+      socket->flush();
+  }
+
   void loop() {
     Packet packet;
 
+    // The child device did not answer, the end of the chain.
+    if (_probe.active && V2Base::getUsecSince(_probe.usec) > 20 * 1000)
+      _probe.active = false;
+
+    if (_cutThrough.enabled) {
+      bool toSocket;
+      while (pop(&packet, &toSocket)) {
+        if (toSocket)
+          receiveSocket(&packet);
+
+        else
+          receivePlug(&packet);
+      }
+
+      if (plug) {
+        plug->powerDown();
+        plug->flush();
+      }
+
+      if (socket) {
+        socket->powerDown();
+        socket->flush();
+      }
+
+      return;
+    }
+
     if (plug) {
       if (plug->receive(&packet)) {
+        trace(V2Base::Timer::Trace::Event::Received, &packet);
         if (packet.getAddress() > 0) {
           // Forward message from a parent device to a child device.
-          if (socket)
-            socket->send(packet.getAddress() - 1, &packet);
+          if (socket && socket->send(packet.getAddress() - 1, &packet))
+            trace(V2Base::Timer::Trace::Event::Forwarded, &packet);
 
-        } else {
+          if (packet.isBroadcast())
+            receivePlug(&packet);
+
+        } else if (!answerPing(&packet)) {
           receivePlug(&packet);
         }
       }
@@ -242,16 +960,27 @@ public:
 
     if (socket) {
       if (socket->receive(&packet)) {
+        trace(V2Base::Timer::Trace::Event::Received, &packet);
+
         // Forward message from a child device towards the parent device, stop after
         // too many hops.
-        if (plug && packet.getAddress() < 0x0f)
-          plug->send(packet.getAddress() + 1, &packet);
+        countHop(&packet);
+        if (plug && packet.getAddress() < 0x0f && plug->send(packet.getAddress() + 1, &packet))
+          trace(V2Base::Timer::Trace::Event::Forwarded, &packet);
 
-        receiveSocket(&packet);
+        if (!receivePong(&packet))
+          receiveSocket(&packet);
       }
 
       socket->powerDown();
     }
+
+    // Send the queued burst frames.
+    if (plug)
+      plug->flush();
+
+    if (socket)
+      socket->flush();
   }
 
   bool idle() const {
@@ -264,10 +993,174 @@ public:
     return true;
   }
 
+  // The round-trip time to a child device, and the statistics it reported.
+  struct Hop {
+    uint32_t usec;
+    uint8_t  highWater;
+    uint8_t  errors;
+  };
+
+  // Measure the round-trip times to all devices connected to the socket. The
+  // devices are pinged one after the other, starting with the nearest one; the
+  // probe ends with the first device which does not answer.
+  void probe() {
+    if (!socket)
+      return;
+
+    _probe.active = true;
+    _probe.count  = 0;
+    sendPing();
+  }
+
+  bool isProbing() const {
+    return _probe.active;
+  }
+
+  // The number of devices which answered the last probe.
+  uint8_t getHopCount() const {
+    return _probe.count;
+  }
+
+  // The round-trip time to the device at the given distance, the time of the
+  // single hop is the difference to the previous device.
+  const Hop* getHop(uint8_t distance) const {
+    if (distance >= _probe.count)
+      return nullptr;
+
+    return &_probe.hops[distance];
+  }
+
   Port* plug{};
   Port* socket{};
 
+  // Cut-through mode.
+  struct {
+    uint32_t forwarded{};
+
+    // The number of packets for this device dropped because loop() did not keep up.
+    uint32_t overflow{};
+  } statistics;
+
 protected:
   virtual void receivePlug(Packet* packet) {}
   virtual void receiveSocket(Packet* packet) {}
+
+private:
+  struct {
+    volatile bool active;
+    uint8_t       sequence;
+    uint8_t       count;
+    uint32_t      usec;
+    Hop           hops[16];
+  } _probe{};
+
+  void sendPing() {
+    Packet packet;
+    packet.setPing(++_probe.sequence);
+    _probe.usec = V2Base::getUsec();
+    if (!socket->send(_probe.count, &packet))
+      _probe.active = false;
+  }
+
+  static uint8_t saturate(uint32_t value) {
+    return value < 0xff ? value : 0xff;
+  }
+
+  // Answer a ping addressed to this device.
+  bool answerPing(const Packet* packet) {
+    if (packet->getType() != Packet::Type::Ping)
+      return false;
+
+    uint32_t highWater = plug->statistics.highWater;
+    uint32_t errors    = plug->statistics.error;
+    if (socket) {
+      if (socket->statistics.highWater > highWater)
+        highWater = socket->statistics.highWater;
+
+      errors += socket->statistics.error;
+    }
+
+    Packet::Probe probe{.sequence = packet->_data[1], .highWater = saturate(highWater), .errors = saturate(errors)};
+    Packet        pong;
+    pong.setPong(&probe);
+    plug->send(0, &pong);
+    return true;
+  }
+
+  // The bytes following the link header; the data of a MIDI packet, the port and
+  // the flags of a pulse.
+  static void trace(V2Base::Timer::Trace::Event event, const Packet* packet) {
+    V2Base::Timer::Trace::record(event, packet->_data + 1);
+  }
+
+  // Annotate a pong passing through this device on its way to the parent device.
+  static void countHop(Packet* packet) {
+    if (packet->getType() != Packet::Type::Pong)
+      return;
+
+    if (packet->_data[2] < 0xff)
+      packet->_data[2]++;
+  }
+
+  // Record the answer to our ping. The pong of a device at distance N has been
+  // counted N times by the devices in between, which also forward it to our
+  // parent; the pongs are not passed to receiveSocket().
+  bool receivePong(const Packet* packet) {
+    if (packet->getType() != Packet::Type::Pong)
+      return false;
+
+    if (!_probe.active)
+      return true;
+
+    Packet::Probe probe;
+    packet->getProbe(&probe);
+    if (probe.sequence != _probe.sequence || probe.hops != _probe.count + 1)
+      return true;
+
+    _probe.hops[_probe.count] = {.usec      = V2Base::getUsecSince(_probe.usec),
+                                 .highWater = probe.highWater,
+                                 .errors    = probe.errors};
+    _probe.count++;
+    if (_probe.count == V2Base::countof(_probe.hops)) {
+      _probe.active = false;
+      return true;
+    }
+
+    sendPing();
+    return true;
+  }
+
+  // The received packets for loop(), only forward() writes the head, only loop()
+  // writes the tail.
+  struct {
+    bool enabled;
+    struct {
+      Packet packet;
+      bool   toSocket;
+    } packets[16];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+  } _cutThrough{};
+
+  void push(const Packet* packet, bool toSocket) {
+    const uint32_t head = _cutThrough.head.load(std::memory_order_relaxed);
+    if (head - _cutThrough.tail.load(std::memory_order_acquire) == V2Base::countof(_cutThrough.packets)) {
+      statistics.overflow++;
+      return;
+    }
+
+    _cutThrough.packets[head % V2Base::countof(_cutThrough.packets)] = {*packet, toSocket};
+    _cutThrough.head.store(head + 1, std::memory_order_release);
+  }
+
+  bool pop(Packet* packet, bool* toSocket) {
+    const uint32_t tail = _cutThrough.tail.load(std::memory_order_relaxed);
+    if (tail == _cutThrough.head.load(std::memory_order_acquire))
+      return false;
+
+    *packet   = _cutThrough.packets[tail % V2Base::countof(_cutThrough.packets)].packet;
+    *toSocket = _cutThrough.packets[tail % V2Base::countof(_cutThrough.packets)].toSocket;
+    _cutThrough.tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
 };
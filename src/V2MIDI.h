@@ -2,12 +2,20 @@
 #include "MIDI/CC.h"
 #include "MIDI/CCHighResolution.h"
 #include "MIDI/Clock.h"
+#include "MIDI/CoalescingQueue.h"
 #include "MIDI/File.h"
 #include "MIDI/GM.h"
 #include "MIDI/Notes.h"
 #include "MIDI/Packet.h"
 #include "MIDI/Port.h"
+#include "MIDI/Queue.h"
 #include "MIDI/RPN.h"
+#include "MIDI/Router.h"
+#include "MIDI/Scheduler.h"
 #include "MIDI/SerialDevice.h"
+#include "MIDI/StaticPort.h"
+#include "MIDI/SysExPool.h"
 #include "MIDI/Transport.h"
+#include "MIDI/UMP.h"
+#include "MIDI/UMPDevice.h"
 #include "MIDI/USBDevice.h"
@@ -4,44 +4,114 @@
 #include "Music/Scale.h"
 #include "Music/String.h"
 #include <V2MIDI.h>
+#include <array>
+#include <bit>
+#include <cmath>
 
 namespace V2Music {
   class Frequency {
   public:
     static float fromNote(uint8_t note) {
-      return 440.f * powf(2.f, static_cast<float>(note - 69.f) / 12.f);
+      if (note > 127)
+        return 440.f * exp2((static_cast<float>(note) - 69.f) / 12.f);
+
+      return _notes[note];
+    }
+
+    // A note with a fraction, the result of a pitch bend or a fine tuning.
+    static float fromNoteFraction(float note) {
+      if (note < 0.f || note >= 127.f)
+        return 440.f * exp2((note - 69.f) / 12.f);
+
+      const uint8_t index = static_cast<uint8_t>(note);
+      return _notes[index] * exp2((note - static_cast<float>(index)) / 12.f);
     }
 
     // Adjust the given frequency by cents of a note; used for tuning / calibration.
     static float adjustFrequency(float frequency, float cents) {
-      const float noteDistance = cents / 100.f;
-      return frequency * powf(2.f, -noteDistance / 12.f);
+      return frequency * exp2(-cents / 1200.f);
     }
+
+    // Approximation of powf(2, x), the relative error is less than 1e-6.
+    static float exp2(float x) {
+      if (x < -126.f)
+        return 0.f;
+
+      if (x > 127.f)
+        x = 127.f;
+
+      const float   floor    = std::floor(x);
+      const float   f        = x - floor;
+      const int32_t exponent = static_cast<int32_t>(floor);
+      const float   fraction = 0.99999990f + f * (0.69315462f + f * (0.24014077f + f * (0.05586328f + f * (0.00894622f + f * 0.00189511f))));
+      return std::bit_cast<float>(std::bit_cast<int32_t>(fraction) + (exponent << 23));
+    }
+
+  private:
+    // The frequencies of all MIDI notes, from the ratios of the notes of one octave.
+    static constexpr std::array<float, 128> _notes{[] {
+      constexpr double ratios[12]{
+        1.0,
+        1.0594630943592953,
+        1.122462048309373,
+        1.189207115002721,
+        1.2599210498948732,
+        1.3348398541700344,
+        1.4142135623730951,
+        1.4983070768766815,
+        1.5874010519681994,
+        1.681792830507429,
+        1.7817974362806785,
+        1.8877486253633868,
+      };
+
+      // C-1 is five octaves and nine notes below A4.
+      std::array<float, 128> notes{};
+      double                 octave = 440.0 / 32.0 / ratios[9];
+      for (uint8_t i = 0; i < 128; i++) {
+        if (i > 0 && i % 12 == 0)
+          octave *= 2.0;
+
+        notes[i] = static_cast<float>(octave * ratios[i % 12]);
+      }
+
+      return notes;
+    }()};
   };
 
   // A stack of currently playing notes with their velocity. A velocity of 0 will
-  // remove the note.
+  // remove the note. All operations are constant time; a note index and a bitmap
+  // provide the slot, and the lowest and highest note. If the stack is full, the
+  // oldest note is dropped.
   template <uint8_t size> class Playing {
   public:
     void update(uint8_t note, uint8_t velocity) {
-      // Remove note.
-      for (uint8_t i = 0; i < _n; i++) {
-        if (_list[i].note != note)
-          continue;
-
-        for (uint8_t k = i; k < _n - 1; k++)
-          _list[k] = _list[k + 1];
+      note &= 0x7f;
 
-        _n--;
-        break;
-      }
+      // Remove note.
+      if (_index[note] != _none)
+        remove(note);
 
       if (velocity == 0)
         return;
 
-      // Add note.
-      _list[_n].note     = note;
-      _list[_n].velocity = velocity;
+      // The list is full, drop the oldest note.
+      if (_n == size)
+        remove(_slots[_first].note);
+
+      // Add note, at the end of the list.
+      const uint8_t slot = _free;
+      _free              = _slots[slot].next;
+      _slots[slot]       = {.note{note}, .velocity{velocity}, .prev{_last}, .next{_none}};
+      if (_last != _none)
+        _slots[_last].next = slot;
+
+      else
+        _first = slot;
+
+      _last        = slot;
+      _index[note] = slot;
+      _notes[note / 32] |= 1UL << (note % 32);
       _n++;
     }
 
@@ -49,22 +119,106 @@ namespace V2Music {
       if (_n == 0)
         return false;
 
-      note     = _list[_n - 1].note;
-      velocity = _list[_n - 1].velocity;
+      note     = _slots[_last].note;
+      velocity = _slots[_last].velocity;
       return true;
     }
 
+    bool getLowest(uint8_t& note, uint8_t& velocity) {
+      for (uint8_t i = 0; i < 4; i++) {
+        if (_notes[i] == 0)
+          continue;
+
+        note     = (i * 32) + __builtin_ctz(_notes[i]);
+        velocity = _slots[_index[note]].velocity;
+        return true;
+      }
+
+      return false;
+    }
+
+    bool getHighest(uint8_t& note, uint8_t& velocity) {
+      for (uint8_t i = 0; i < 4; i++) {
+        if (_notes[3 - i] == 0)
+          continue;
+
+        note     = ((3 - i) * 32) + 31 - __builtin_clz(_notes[3 - i]);
+        velocity = _slots[_index[note]].velocity;
+        return true;
+      }
+
+      return false;
+    }
+
+    uint8_t count() const {
+      return _n;
+    }
+
     void reset() {
-      _n = 0;
+      _n     = 0;
+      _first = _none;
+      _last  = _none;
+      _free  = 0;
+      for (uint8_t i = 0; i < size; i++)
+        _slots[i].next = i + 1 < size ? i + 1 : _none;
+
+      for (uint8_t i = 0; i < 128; i++)
+        _index[i] = _none;
+
+      for (uint8_t i = 0; i < 4; i++)
+        _notes[i] = 0;
+    }
+
+    Playing() {
+      reset();
     }
 
   private:
+    static constexpr uint8_t _none{0xff};
+    static_assert(size < _none);
+
+    // The notes in the order they were added, a doubly linked list; removed slots
+    // are linked into the list of free slots.
     struct {
       uint8_t note;
       uint8_t velocity;
-    } _list[size]{};
+      uint8_t prev;
+      uint8_t next;
+    } _slots[size]{};
+
+    // The slot of every note.
+    uint8_t _index[128];
+
+    // The bitmap of the playing notes.
+    uint32_t _notes[4];
 
+    uint8_t _first{_none};
+    uint8_t _last{_none};
+    uint8_t _free{};
     uint8_t _n{};
+
+    void remove(uint8_t note) {
+      const uint8_t slot = _index[note];
+      const uint8_t prev = _slots[slot].prev;
+      const uint8_t next = _slots[slot].next;
+      if (prev != _none)
+        _slots[prev].next = next;
+
+      else
+        _first = next;
+
+      if (next != _none)
+        _slots[next].prev = prev;
+
+      else
+        _last = prev;
+
+      _slots[slot].next = _free;
+      _free             = slot;
+      _index[note]      = _none;
+      _notes[note / 32] &= ~(1UL << (note % 32));
+      _n--;
+    }
   };
 
   // A list of values with a priority. The value with the highest prority wins.
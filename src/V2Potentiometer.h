@@ -51,4 +51,102 @@ protected:
 
   // The current step value.
   uint16_t _step{};
+
+public:
+  template <uint8_t N> class Bank;
+};
+
+// The same filter and hysteresis for 'N' potentiometers with a shared
+// configuration, measured from one scan of all channels; the state is kept in
+// packed arrays and processed in one pass.
+template <uint8_t N> class V2Potentiometer::Bank {
+  static_assert(N <= 32, "The changed mask has 32 bits");
+
+public:
+  constexpr Bank(const Config conf) :
+    config(conf),
+    _scale{1.f / (conf.max - conf.min)},
+    _steps{(float)(conf.nSteps - 1)} {}
+
+  const Config config;
+
+  // Normalized 0..1 measurements of all potentiometers. Returns the mask of the
+  // potentiometers which have changed their step value.
+  uint32_t measure(const float analog[N]) {
+    uint32_t changed = 0;
+
+    for (uint8_t i = 0; i < N; i++) {
+      // Low-pass filter, smooth the value.
+      _analog[i] *= 1.f - config.alpha;
+      _analog[i] += analog[i] * config.alpha;
+
+      float    fraction;
+      uint16_t step;
+      if (_analog[i] < config.min) {
+        fraction = 0;
+        step     = 0;
+        _lag[i]  = 0.f - config.lag;
+
+      } else if (_analog[i] > config.max) {
+        fraction = 1;
+        step     = config.nSteps - 1;
+        _lag[i]  = 1.f + config.lag;
+
+      } else {
+        fraction = (_analog[i] - config.min) * _scale;
+
+        // The new measurement is inside the lag, don't update the step value.
+        const float delta = fraction - _lag[i];
+        if (delta < config.lag && delta > -config.lag)
+          continue;
+
+        step = fraction * _steps + 0.5f;
+      }
+
+      if (step == _step[i])
+        continue;
+
+      _step[i] = step;
+      changed |= 1UL << i;
+
+      // Reposition the edge of the lag. We follow monotonic changes immediately,
+      // but apply the lag if the direction changes.
+      if (fraction - _lag[i] > 0.f)
+        _lag[i] = fraction - config.lag;
+
+      else
+        _lag[i] = fraction + config.lag;
+    }
+
+    return changed;
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < N; i++) {
+      _analog[i] = 0;
+      _lag[i]    = 0;
+      _step[i]   = 0;
+    }
+  }
+
+  float getFraction(uint8_t index) {
+    return (float)_step[index] / _steps;
+  }
+
+  uint16_t getStep(uint8_t index) {
+    return _step[index];
+  }
+
+private:
+  const float _scale;
+  const float _steps;
+
+  // The smoothed-out, normalized (0..1) analog measurements.
+  float _analog[N]{};
+
+  // The edges of the lag ranges, set by the previous values.
+  float _lag[N]{};
+
+  // The current step values.
+  uint16_t _step[N]{};
 };
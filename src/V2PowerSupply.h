@@ -1,6 +1,19 @@
 #pragma once
 #include <Arduino.h>
 
+// Interrupt-driven detection with the ADC window monitor of the supply channel:
+//
+// bool handleWindow(bool enable) override {
+//   if (enable)
+//     ADC.setWindow(config.min / range, config.max / range, [](void* p) {
+//       static_cast<Power*>(p)->handleInterrupt();
+//     }, this);
+//
+//   else
+//     ADC.clearWindow();
+//
+//   return true;
+// }
 class V2PowerSupply {
 public:
   const struct Config {
@@ -23,7 +36,17 @@ public:
   }
 
   bool isOn() const {
-    return _state == State::On;
+    return _state == State::On && !_tripped;
+  }
+
+  // Called from the interrupt of the voltage monitor when the voltage left the
+  // range; handleOff() is called immediately, loop() updates the state.
+  void handleInterrupt() {
+    if (_state != State::On || _tripped)
+      return;
+
+    _tripped = true;
+    handleOff();
   }
 
   // The number of power interruptions.
@@ -37,6 +60,13 @@ protected:
   virtual void  handleOff() {}
   virtual void  handleNotify(float voltage) {}
 
+  // Arm or disarm a hardware monitor of the config.min/max range, which calls
+  // handleInterrupt(). Returns false if it is not supported, the voltage is only
+  // checked by loop().
+  virtual bool handleWindow(bool enable) {
+    return false;
+  }
+
 private:
   // The last time 'loop()' did its work.
   unsigned long _usec{};
@@ -58,4 +88,7 @@ private:
 
   // The number of power interruptions.
   uint32_t _n_disconnects{};
+
+  // The monitor detected a voltage outside of the range.
+  volatile bool _tripped{};
 };
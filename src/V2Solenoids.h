@@ -11,14 +11,29 @@
 //
 // The trigger / release of the solenoid power can be ramped up / down to move
 // the solenoids with less noise.
-template <uint8_t nPorts> class V2Solenoids {
+//
+// The pulses are driven by loop(), one step per millisecond. With a tick
+// frequency, the pulses are driven by tick(), which is called from a timer
+// interrupt, independent of the load of the main loop:
+//   V2Base::Timer::Periodic Timer(3, 2000);
+//   Solenoids Solenoids(config, 2000);
+//   Timer.begin<&Solenoids::tick>(&Solenoids);
+//
+// Pulses can be scheduled ahead of time, every port has a queue of 'nQueue'
+// pulses and an offset to compensate for the mechanical latency of the solenoid.
+//
+// With supply compensation, the duty cycles of the active pulses are rescaled
+// at every step to the current supply voltage, the power stays constant when
+// many ports sag the supply.
+template <uint8_t nPorts, uint8_t nQueue = 4> class V2Solenoids {
 public:
   // Example:
   //   static const Configuration config{
   //     .current{.max{3}, .alpha{0.001}},
   //     .resistance{.min{6}, .max{60}},
   //     .fade{.inSec{0.35}, .outSec{0.35}},
-  //     .hold{.peakUsec{100 * 1000}, .fraction{0.5}}
+  //     .hold{.peakUsec{100 * 1000}, .fraction{0.5}},
+  //     .budget{.current{2.5}, .delayUsec{500}, .maxDelayUsec{20 * 1000}}
   //   };
   struct Configuration {
     struct {
@@ -31,7 +46,7 @@ public:
       float max{};
     } resistance;
 
-    // Time to to fade-in/out, adjusted one step per millisecond.
+    // Time to to fade-in/out, adjusted one step per millisecond, or per tick().
     struct {
       float inSec{};
       float outSec{};
@@ -42,9 +57,41 @@ public:
       uint32_t peakUsec{};
       float    fraction{};
     } hold;
+
+    // The current of the pulses is predicted from the measured resistance and the
+    // supply voltage; a pulse which exceeds the budget is delayed until other ports
+    // have reduced their power to hold or have been released. After the maximum
+    // delay, the pulse is started with the remaining budget. A budget of 0 disables
+    // the delay.
+    struct {
+      float    current{};
+      uint32_t delayUsec{};
+      uint32_t maxDelayUsec{};
+    } budget;
+
+    // The resistance measurement of the idle ports. A port accepts pulses after it
+    // has been measured 'cycles' times. With 'curveUsec', the steady voltage is
+    // extrapolated from the samples of readResistanceCurve(), instead of waiting
+    // 'measureUsec' for the magnetic field to be established.
+    struct {
+      uint32_t settleUsec{200 * 1000};
+      uint32_t measureUsec{10 * 1000};
+      uint32_t curveUsec{};
+      uint32_t sleepUsec{1000 * 1000};
+      uint8_t  cycles{10};
+    } probe;
+
+    // Rescale the duty cycles of the active pulses at every step, from the voltage
+    // of readSupplyVoltage(), relative to the readVoltage() at the start of a pulse.
+    struct {
+      bool compensate{};
+    } supply;
   };
 
-  constexpr V2Solenoids(Configuration config) : _config(config) {}
+  constexpr V2Solenoids(Configuration config, uint32_t tickFrequency = 0) :
+    _config(config),
+    _tickFrequency{tickFrequency},
+    _holdFraction{(uint32_t)(config.hold.fraction * (float)_dutyOne)} {}
 
   void reset() {
     setPower(PowerState::Off);
@@ -54,17 +101,33 @@ public:
     _timeoutUsec = V2Base::getUsec();
     _probe       = {};
     _current     = 0;
+    _supply      = {};
+
+    for (uint8_t i = 0; i < nPorts; i++)
+      _queues[i].count = 0;
 
+    noInterrupts();
     for (uint8_t i = 0; i < nPorts; i++) {
       _ports[i] = {.measure{.resistance{-1}, .voltage{-1}}};
       setPWMDuty(i, 0);
-      updateLED(i);
     }
+    interrupts();
+
+    for (uint8_t i = 0; i < nPorts; i++)
+      updateLED(i);
+  }
+
+  // Advance the pulses of all ports, called from a timer interrupt with the
+  // configured tick frequency.
+  void tick() {
+    step();
   }
 
   void loop() {
     bool busy{};
 
+    dispatch();
+
     if (V2Base::getUsecSince(_loopUsec) < 1000)
       return;
 
@@ -78,69 +141,37 @@ public:
         updateLED(i);
     }
 
-    for (uint8_t i = 0; i < nPorts; i++) {
-      if (_ports[i].state == DriverState::Idle)
-        continue;
-
-      busy = true;
+    if (_tickFrequency == 0)
+      step();
 
-      switch (_ports[i].state) {
-        case DriverState::FadeIn:
-          _ports[i].duty += _ports[i].pulse.duty.delta;
-          setPWMDuty(i, _ports[i].duty);
-
-          if (_ports[i].duty >= _ports[i].pulse.duty.target) {
-            _ports[i].pulse.peekUsec = V2Base::getUsec();
-            _ports[i].state          = DriverState::Peak;
-          }
-          break;
-
-        case DriverState::Peak:
-          // Limit the peek/actuation period, reduce to the power to hold.
-          if (V2Base::getUsecSince(_ports[i].pulse.peekUsec) > _config.hold.peakUsec) {
-            _ports[i].duty *= _config.hold.fraction;
-            setPWMDuty(i, _ports[i].duty);
-            _ports[i].state = DriverState::Hold;
-            break;
-          }
-
-          if (V2Base::getUsecSince(_ports[i].pulse.startUsec) < _ports[i].pulse.durationUsec)
-            break;
-
-          if (!fadeOutPort(i))
-            releasePort(i);
-          break;
-
-        case DriverState::Hold:
-          if (V2Base::getUsecSince(_ports[i].pulse.startUsec) < _ports[i].pulse.durationUsec)
-            break;
-
-          if (!fadeOutPort(i))
-            releasePort(i);
-          break;
-
-        case DriverState::FadeOut:
-          _ports[i].duty -= _ports[i].pulse.duty.delta;
-          if (_ports[i].duty <= 0) {
-            releasePort(i);
-            break;
-          }
-
-          setPWMDuty(i, _ports[i].duty);
-          break;
+    for (uint8_t i = 0; i < nPorts; i++) {
+      // The pulse has ended.
+      if (_ports[i].update) {
+        _ports[i].update = false;
+        updateLED(i);
       }
+
+      if (_ports[i].state != DriverState::Idle)
+        busy = true;
     }
 
     measureCurrent();
 
     // Warn about too much load, and reset/switch-off all ports.
     if (_current > _config.current.max) {
+      noInterrupts();
       for (uint8_t i = 0; i < nPorts; i++)
-        releasePort(i);
+        stopPort(i);
+      interrupts();
+
+      for (uint8_t i = 0; i < nPorts; i++)
+        updateLED(i);
 
       // Clear the ready flag and force the resistance measurement, short-circuit
       // ports will be isolated.
       _probe = {};
+      for (uint8_t i = 0; i < nPorts; i++)
+        _ports[i].measure.count = 0;
       setLED(LEDMode::OverCurrent);
       return;
     }
@@ -173,7 +204,7 @@ public:
       case ProbeState::Settle:
         // Delay the measurement to let mechanical movements settle; a moving plunger
         // disturbs the measurement by changing the magnetic field / inducing energy.
-        if (V2Base::getUsecSince(_probe.settleUsec) < 200 * 1000)
+        if (V2Base::getUsecSince(_probe.settleUsec) < _config.probe.settleUsec)
           break;
 
         setPWMDuty(_probe.port, 1);
@@ -181,14 +212,29 @@ public:
         _probe.state       = ProbeState::Measure;
         break;
 
-      case ProbeState::Measure:
-        // Charge the coil; the magnetic field in the solenoid needs to be stable.
-        // A too short measurement span does not measure the coil's resistance, it
-        // measures the current flow to establish the magnetic field.
-        if (V2Base::getUsecSince(_probe.measureUsec) < 10 * 1000)
-          break;
+      case ProbeState::Measure: {
+        float voltage = -1;
+
+        // The voltage follows the rise of the current with the time constant of the
+        // coil; extrapolate it from the sampled curve.
+        if (_config.probe.curveUsec > 0 && V2Base::getUsecSince(_probe.measureUsec) >= _config.probe.curveUsec) {
+          float          samples[24];
+          const uint16_t n = readResistanceCurve(_probe.measureUsec, samples, V2Base::countof(samples));
+          if (n >= 3)
+            voltage = extrapolateVoltage(samples, n);
+        }
 
-        measureResistance();
+        if (voltage < 0.f) {
+          // Charge the coil; the magnetic field in the solenoid needs to be stable.
+          // A too short measurement span does not measure the coil's resistance, it
+          // measures the current flow to establish the magnetic field.
+          if (V2Base::getUsecSince(_probe.measureUsec) < _config.probe.measureUsec)
+            break;
+
+          voltage = readResistanceVoltage();
+        }
+
+        measureResistance(voltage);
         setPWMDuty(_probe.port, 0);
 
         _probe.port++;
@@ -198,7 +244,7 @@ public:
           if (!_probe.ready) {
             _probe.cycle++;
 
-            if (_probe.cycle > 10) {
+            if (_probe.cycle > _config.probe.cycles) {
               _probe.ready = true;
               setLED(LEDMode::Ready);
             }
@@ -214,10 +260,10 @@ public:
 
         setPWMDuty(_probe.port, 1);
         _probe.measureUsec = V2Base::getUsec();
-        break;
+      } break;
 
       case ProbeState::Sleep:
-        if (V2Base::getUsecSince(_probe.sleepUsec) < 1000 * 1000)
+        if (V2Base::getUsecSince(_probe.sleepUsec) < _config.probe.sleepUsec)
           break;
 
         setPWMDuty(_probe.port, 1);
@@ -227,72 +273,57 @@ public:
     }
   }
 
-  void triggerPort(uint8_t port, float watts, float seconds, bool fadeIn = false, bool fadeOut = false) {
-    if (!_probe.ready)
-      return;
-
-    if (watts <= 0 || seconds <= 0) {
-      if (!fadeOut || !fadeOutPort(port))
-        releasePort(port);
+  // The time the solenoid needs to travel; scheduled pulses start earlier by
+  // this amount.
+  void setLatency(uint8_t port, uint32_t usec) {
+    _queues[port].latencyUsec = usec;
+  }
 
-      return;
-    }
+  // Trigger the port at the absolute time 'usec', the time the solenoid should hit.
+  // A pulse which becomes due while the port is active retriggers the port, like
+  // triggerPort(). Pulses which start within a millisecond are merged; the
+  // larger power and the later end are used. Returns false if the queue is full.
+  bool schedulePort(uint32_t usec, uint8_t port, float watts, float seconds, bool fadeIn = false, bool fadeOut = false) {
+    auto* queue = &_queues[port];
+    usec -= queue->latencyUsec;
+
+    for (uint8_t i = 0; i < queue->count; i++) {
+      Pulse* pulse = &queue->pulses[i];
+      if ((uint32_t)(usec - pulse->usec + 1000) > 2000)
+        continue;
 
-    if (_ports[port].measure.state != CoilState::Connected)
-      return;
+      const uint32_t endUsec = pulse->usec + (uint32_t)(pulse->seconds * 1000.f * 1000.f);
+      const uint32_t end     = usec + (uint32_t)(seconds * 1000.f * 1000.f);
+      if (isBefore(usec, pulse->usec))
+        pulse->usec = usec;
 
-    if (_current > _config.current.max)
-      return;
+      pulse->seconds = (float)((isBefore(end, endUsec) ? endUsec : end) - pulse->usec) / (1000.f * 1000.f);
+      if (watts > pulse->watts)
+        pulse->watts = watts;
 
-    // Stop resistance measurement.
-    if (_probe.state != ProbeState::Init) {
-      _probe.state = ProbeState::Init;
-      releasePort(_probe.port);
+      pulse->fadeIn &= fadeIn;
+      pulse->fadeOut |= fadeOut;
+      return true;
     }
 
-    _ports[port].pulse.startUsec    = V2Base::getUsec();
-    _ports[port].pulse.durationUsec = seconds * 1000.f * 1000.f;
-    _ports[port].pulse.fadeIn       = fadeIn;
-    _ports[port].pulse.fadeOut      = fadeOut;
-    _ports[port].pulse.duty.target  = wattsToPWMDuty(port, watts);
-
-    // If the LEDs switched off after a timeout, refresh them.
-    if (_timeoutUsec == 0)
-      for (uint8_t i = 0; i < nPorts; i++)
-        updateLED(i, true);
-
-    _timeoutUsec = V2Base::getUsec();
-
-    if (!setPower(PowerState::On))
-      return;
-
-    // Delay the next measurement/power-off.
-    _powerUsec = V2Base::getUsec();
-
-    if (fadeIn && _ports[port].pulse.duty.target > 0.01f && _ports[port].duty < _ports[port].pulse.duty.target) {
-      // The duty cycle will be adjusted one step / delta per millisecond.
-      float msec = _config.fade.inSec * 1000.f;
-      if (msec > seconds * 1000.f)
-        msec = seconds * 1000.f;
-
-      _ports[port].pulse.duty.delta = _ports[port].pulse.duty.target / msec;
-      _ports[port].state            = DriverState::FadeIn;
-
-    } else {
-      // Immediate switch-on, or fade-in take-over from the current duty cycle.
-      _ports[port].duty = _ports[port].pulse.duty.target;
-      setPWMDuty(port, _ports[port].duty);
-      _ports[port].pulse.peekUsec = V2Base::getUsec();
-      _ports[port].state          = DriverState::Peak;
-    }
+    return deferPulse(
+      port,
+      {.usec{usec}, .watts{watts}, .seconds{seconds}, .fadeIn{fadeIn}, .fadeOut{fadeOut}, .requestUsec{usec}});
+  }
 
-    setLED(LEDMode::Power, port, watts);
+  void triggerPort(uint8_t port, float watts, float seconds, bool fadeIn = false, bool fadeOut = false) {
+    trigger(port, watts, seconds, fadeIn, fadeOut, V2Base::getUsec());
   }
 
   float getCurrent() {
     return _current;
   }
 
+  // The port has been measured and accepts pulses.
+  bool isReady(uint8_t port) {
+    return _ports[port].measure.count >= _config.probe.cycles;
+  }
+
   float getResistance(uint8_t port) {
     switch (_ports[port].measure.state) {
       case CoilState::NotConnected:
@@ -316,12 +347,33 @@ protected:
   virtual float readResistanceVoltage()              = 0;
   virtual void  setPWMDuty(uint8_t port, float duty) = 0;
 
+  // The resistance voltages sampled at a constant rate since the probed port was
+  // switched on at 'usec', e.g. from V2Base::Analog::ADC::readCapture(). Returns
+  // the number of samples, 0 if not supported.
+  virtual uint16_t readResistanceCurve(uint32_t usec, float* samples, uint16_t count) {
+    return 0;
+  }
+
+  // The supply voltage for the compensation, called from tick() or loop() at every
+  // step. It should return a value sampled in the background, e.g. by ADC DMA; it
+  // must not block. The default returns the reference, the duty cycles stay unscaled.
+  virtual float readSupplyVoltage() {
+    return _supply.reference;
+  }
+
   enum class LEDMode { Off, Initialize, Ready, Resistance, Power, ShortCircuit, OverCurrent };
   virtual void setLED(LEDMode state, uint8_t port = 0, float value = -1) {}
 
 private:
   const Configuration _config;
 
+  // The duty cycle in fixed-point, 16 bit fraction.
+  static constexpr uint32_t _dutyOne{1 << 16};
+
+  // The frequency of tick(), 0 if loop() drives the pulses.
+  const uint32_t _tickFrequency;
+  const uint32_t _holdFraction;
+
   // Limit the adjustment frequency.
   uint32_t _loopUsec{};
 
@@ -354,17 +406,45 @@ private:
     bool ready{};
   } _probe;
 
+  struct Pulse {
+    uint32_t usec;
+    float    watts;
+    float    seconds;
+    bool     fadeIn;
+    bool     fadeOut;
+
+    // The time the pulse was requested to start.
+    uint32_t requestUsec;
+  };
+
+  struct {
+    Pulse    pulses[nQueue];
+    uint8_t  count;
+    uint32_t latencyUsec;
+  } _queues[nPorts]{};
+
   // Measured current flow.
   float _current{};
 
+  // The duty cycles of the ports refer to the supply voltage at the time the
+  // first of the active pulses was triggered; the scale of the PWM duty cycle
+  // follows the actual supply voltage.
+  struct {
+    float    reference{};
+    uint32_t scale{_dutyOne};
+  } _supply;
+
   enum class DriverState { Idle, FadeIn, Peak, Hold, FadeOut };
   enum class CoilState { NotConnected, Connected, ShortCircuit };
 
   struct {
     DriverState state;
 
+    // The pulse has ended, the LED needs to be updated.
+    bool update;
+
     // Current duty cycle. May fade-in/out to/from the target duty cycle.
-    float duty;
+    uint32_t duty;
 
     struct {
       CoilState state;
@@ -374,6 +454,9 @@ private:
 
       // Storage of the raw measurement to implements a low-pass filter.
       float voltage;
+
+      // The number of measurements, up to the configured cycles.
+      uint8_t count;
     } measure;
 
     // Current pulse parameters.
@@ -385,13 +468,37 @@ private:
       bool     fadeOut;
 
       struct {
-        float target;
-        float delta;
+        uint32_t target;
+        uint32_t delta;
       } duty;
     } pulse;
   } _ports[nPorts]{};
 
-  void measureResistance() {
+  // The curve approaches the steady voltage exponentially; the means of three
+  // equal spans of the curve form a geometric series, its limit is the steady
+  // voltage (Aitken's extrapolation).
+  static float extrapolateVoltage(const float* samples, uint16_t count) {
+    const uint16_t n = count / 3;
+    float          mean[3]{};
+    for (uint8_t i = 0; i < 3; i++) {
+      for (uint16_t j = 0; j < n; j++)
+        mean[i] += samples[count - ((3 - i) * n) + j];
+
+      mean[i] /= n;
+    }
+
+    const float divisor = mean[0] + mean[2] - (2.f * mean[1]);
+    if (fabsf(divisor) < 0.001f)
+      return mean[2];
+
+    const float voltage = ((mean[0] * mean[2]) - (mean[1] * mean[1])) / divisor;
+    if (voltage < 0.f || voltage > 3.3f)
+      return mean[2];
+
+    return voltage;
+  }
+
+  void measureResistance(float voltage) {
     // When the power supply is switched-off, a single port can be switched-on,
     // and 3.3V are connected to a 100Ω voltage divider. It measures the
     // resistance of the connected load.
@@ -399,8 +506,7 @@ private:
     // Voltage divider R1 = 100Ω, Vin = 3.3V, R2 has a diode with a drop of ~0.3V:
     //   ∞ = Vout 3.3V
     //  0Ω = Vout 0.3V
-    const float voltage = readResistanceVoltage();
-
+    //
     // Start with the current measurement, do not signal a short-circuit after a reset.
     if (_ports[_probe.port].measure.voltage < 0.f)
       _ports[_probe.port].measure.voltage = voltage;
@@ -432,6 +538,9 @@ private:
       state = CoilState::Connected;
     }
 
+    if (_ports[_probe.port].measure.count < _config.probe.cycles)
+      _ports[_probe.port].measure.count++;
+
     // Wakeup the LED display.
     if (state != _ports[_probe.port].measure.state) {
       _ports[_probe.port].measure.state = state;
@@ -456,7 +565,7 @@ private:
   // Convert the watts to a PWM duty cycle, depending on the measured
   // resistance and current voltage.
   float wattsToPWMDuty(uint8_t port, float watts) {
-    const float supply  = readVoltage();
+    const float supply  = getSupplyVoltage();
     float       voltage = sqrtf(watts * _ports[port].measure.resistance);
     if (voltage > supply)
       voltage = supply;
@@ -464,22 +573,307 @@ private:
     return voltage / supply;
   }
 
-  void releasePort(uint8_t port) {
+  // The request time of a pulse is used to limit its delay by the current budget.
+  void trigger(uint8_t port, float watts, float seconds, bool fadeIn, bool fadeOut, uint32_t requestUsec) {
+    if (!isReady(port))
+      return;
+
+    if (watts <= 0 || seconds <= 0) {
+      noInterrupts();
+      const bool fading = fadeOut && fadeOutPort(port);
+      if (!fading)
+        stopPort(port);
+      interrupts();
+
+      if (!fading)
+        updateLED(port);
+
+      return;
+    }
+
+    if (_ports[port].measure.state != CoilState::Connected)
+      return;
+
+    if (_current > _config.current.max)
+      return;
+
+    // A new reference, no active pulse depends on it.
+    if (_config.supply.compensate && isIdle()) {
+      const float reference = readVoltage();
+      noInterrupts();
+      _supply.reference = reference;
+      _supply.scale     = _dutyOne;
+      interrupts();
+    }
+
+    uint32_t target = wattsToPWMDuty(port, watts) * (float)_dutyOne;
+    if (_config.budget.current > 0.f) {
+      const float supply    = getSupplyVoltage();
+      const float available = _config.budget.current - predictCurrent(supply, port);
+      const float current   = (float)target / (float)_dutyOne * supply / _ports[port].measure.resistance;
+      if (current > available) {
+        if (V2Base::getUsecSince(requestUsec) < _config.budget.maxDelayUsec &&
+            deferPulse(port,
+                       {.usec{V2Base::getUsec() + (_config.budget.delayUsec > 0 ? _config.budget.delayUsec : 100)},
+                        .watts{watts},
+                        .seconds{seconds},
+                        .fadeIn{fadeIn},
+                        .fadeOut{fadeOut},
+                        .requestUsec{requestUsec}}))
+          return;
+
+        // Use what is left.
+        if (available <= 0.f)
+          return;
+
+        target = available * _ports[port].measure.resistance / supply * (float)_dutyOne;
+      }
+    }
+
+    // Stop resistance measurement.
+    if (_probe.state != ProbeState::Init) {
+      _probe.state = ProbeState::Init;
+      noInterrupts();
+      stopPort(_probe.port);
+      interrupts();
+      updateLED(_probe.port);
+    }
+
+    // If the LEDs switched off after a timeout, refresh them.
+    if (_timeoutUsec == 0)
+      for (uint8_t i = 0; i < nPorts; i++)
+        updateLED(i, true);
+
+    _timeoutUsec = V2Base::getUsec();
+
+    if (!setPower(PowerState::On))
+      return;
+
+    // Delay the next measurement/power-off.
+    _powerUsec = V2Base::getUsec();
+
+    noInterrupts();
+    _ports[port].update             = false;
+    _ports[port].pulse.startUsec    = V2Base::getUsec();
+    _ports[port].pulse.durationUsec = seconds * 1000.f * 1000.f;
+    _ports[port].pulse.fadeIn       = fadeIn;
+    _ports[port].pulse.fadeOut      = fadeOut;
+    _ports[port].pulse.duty.target  = target;
+
+    if (fadeIn && target > _dutyOne / 100 && _ports[port].duty < target) {
+      // The duty cycle will be adjusted one step / delta per millisecond or tick.
+      float steps = _config.fade.inSec * getStepFrequency();
+      if (steps > seconds * getStepFrequency())
+        steps = seconds * getStepFrequency();
+
+      _ports[port].pulse.duty.delta = getDelta(target, steps);
+      _ports[port].state            = DriverState::FadeIn;
+
+    } else {
+      // Immediate switch-on, or fade-in take-over from the current duty cycle.
+      _ports[port].duty = target;
+      writeDuty(port);
+      _ports[port].pulse.peekUsec = V2Base::getUsec();
+      _ports[port].state          = DriverState::Peak;
+    }
+    interrupts();
+
+    if constexpr (V2Base::Timer::Trace::enabled) {
+      const uint16_t msec = seconds < 65.f ? (uint16_t)(seconds * 1000.f) : UINT16_MAX;
+      V2Base::Timer::Trace::record(V2Base::Timer::Trace::Event::Pulse, port, msec >> 8, msec & 0xff);
+    }
+
+    setLED(LEDMode::Power, port, watts);
+  }
+
+  // The voltage the duty cycles refer to.
+  float getSupplyVoltage() {
+    return _config.supply.compensate ? _supply.reference : readVoltage();
+  }
+
+  bool isIdle() const {
+    for (uint8_t i = 0; i < nPorts; i++)
+      if (_ports[i].state != DriverState::Idle)
+        return false;
+
+    return true;
+  }
+
+  // Set the PWM duty cycle, scaled to the current supply voltage.
+  void writeDuty(uint8_t port) {
+    uint32_t duty = ((uint64_t)_ports[port].duty * _supply.scale) >> 16;
+    if (duty > _dutyOne)
+      duty = _dutyOne;
+
+    setPWMDuty(port, (float)duty / (float)_dutyOne);
+  }
+
+  // The predicted current of all active ports, except the given one.
+  float predictCurrent(float supply, uint8_t except) {
+    float current = 0;
+    for (uint8_t i = 0; i < nPorts; i++) {
+      if (i == except)
+        continue;
+
+      uint32_t duty;
+      switch (_ports[i].state) {
+        case DriverState::Idle:
+          continue;
+
+        case DriverState::FadeIn:
+          duty = _ports[i].pulse.duty.target;
+          break;
+
+        default:
+          duty = _ports[i].duty;
+          break;
+      }
+
+      current += (float)duty / (float)_dutyOne * supply / _ports[i].measure.resistance;
+    }
+
+    return current;
+  }
+
+  // Keep the queue ordered by the start time.
+  bool deferPulse(uint8_t port, Pulse pulse) {
+    auto* queue = &_queues[port];
+    if (queue->count == nQueue)
+      return false;
+
+    uint8_t i = queue->count++;
+    for (; i > 0 && isBefore(pulse.usec, queue->pulses[i - 1].usec); i--)
+      queue->pulses[i] = queue->pulses[i - 1];
+
+    queue->pulses[i] = pulse;
+    return true;
+  }
+
+  // Wrap-around safe comparison.
+  static bool isBefore(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+  }
+
+  // Trigger the due pulses of the queues.
+  void dispatch() {
+    const uint32_t usec = V2Base::getUsec();
+    for (uint8_t i = 0; i < nPorts; i++) {
+      auto* queue = &_queues[i];
+      while (queue->count > 0 && !isBefore(usec, queue->pulses[0].usec)) {
+        const Pulse pulse = queue->pulses[0];
+        queue->count--;
+        for (uint8_t j = 0; j < queue->count; j++)
+          queue->pulses[j] = queue->pulses[j + 1];
+
+        trigger(i, pulse.watts, pulse.seconds, pulse.fadeIn, pulse.fadeOut, pulse.requestUsec);
+      }
+    }
+  }
+
+  float getStepFrequency() const {
+    return _tickFrequency > 0 ? _tickFrequency : 1000;
+  }
+
+  static uint32_t getDelta(uint32_t duty, float steps) {
+    if (steps < 1)
+      return duty;
+
+    const uint32_t delta = (float)duty / steps;
+    return delta > 0 ? delta : 1;
+  }
+
+  // The pulse state machine; called from tick() or from loop(), it must not call
+  // into the LED handlers.
+  void step() {
+    bool compensate = false;
+    if (_config.supply.compensate && !isIdle()) {
+      const float supply = readSupplyVoltage();
+      if (supply > 0.f && _supply.reference > 0.f) {
+        _supply.scale = _supply.reference / supply * (float)_dutyOne;
+        compensate    = true;
+      }
+    }
+
+    for (uint8_t i = 0; i < nPorts; i++) {
+      switch (_ports[i].state) {
+        case DriverState::Idle:
+          break;
+
+        case DriverState::FadeIn:
+          _ports[i].duty += _ports[i].pulse.duty.delta;
+          if (_ports[i].duty >= _ports[i].pulse.duty.target) {
+            _ports[i].duty           = _ports[i].pulse.duty.target;
+            _ports[i].pulse.peekUsec = V2Base::getUsec();
+            _ports[i].state          = DriverState::Peak;
+          }
+
+          writeDuty(i);
+          break;
+
+        case DriverState::Peak:
+          // Limit the peek/actuation period, reduce to the power to hold.
+          if (V2Base::getUsecSince(_ports[i].pulse.peekUsec) > _config.hold.peakUsec) {
+            _ports[i].duty = ((uint64_t)_ports[i].duty * _holdFraction) >> 16;
+            writeDuty(i);
+            _ports[i].state = DriverState::Hold;
+            break;
+          }
+
+          if (V2Base::getUsecSince(_ports[i].pulse.startUsec) < _ports[i].pulse.durationUsec) {
+            if (compensate)
+              writeDuty(i);
+            break;
+          }
+
+          if (!fadeOutPort(i))
+            releasePort(i);
+          break;
+
+        case DriverState::Hold:
+          if (V2Base::getUsecSince(_ports[i].pulse.startUsec) < _ports[i].pulse.durationUsec) {
+            if (compensate)
+              writeDuty(i);
+            break;
+          }
+
+          if (!fadeOutPort(i))
+            releasePort(i);
+          break;
+
+        case DriverState::FadeOut:
+          if (_ports[i].duty <= _ports[i].pulse.duty.delta) {
+            releasePort(i);
+            break;
+          }
+
+          _ports[i].duty -= _ports[i].pulse.duty.delta;
+          writeDuty(i);
+          break;
+      }
+    }
+  }
+
+  void stopPort(uint8_t port) {
     setPWMDuty(port, 0);
     _ports[port].state = DriverState::Idle;
     _ports[port].duty  = 0;
     _ports[port].pulse = {};
-    updateLED(port);
+  }
+
+  // Stop the port, loop() updates the LED.
+  void releasePort(uint8_t port) {
+    stopPort(port);
+    _ports[port].update = true;
   }
 
   bool fadeOutPort(uint8_t port) {
     if (!_ports[port].pulse.fadeOut)
       return false;
 
-    if (_ports[port].duty < 0.01f)
+    if (_ports[port].duty < _dutyOne / 100)
       return false;
 
-    _ports[port].pulse.duty.delta = _ports[port].duty / (_config.fade.outSec * 1000.f);
+    _ports[port].pulse.duty.delta = getDelta(_ports[port].duty, _config.fade.outSec * getStepFrequency());
     _ports[port].state            = DriverState::FadeOut;
     return true;
   }
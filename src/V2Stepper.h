@@ -7,6 +7,7 @@ extern "C" {
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <initializer_list>
 
 namespace V2Stepper {
   class Driver {
@@ -30,6 +31,29 @@ namespace V2Stepper {
     // Calculate the current scale factor. The sense resistor is adjusted according
     // to the configured current.
     void setCurrentScale(float ampere);
+
+    // Write a register field. The other fields of the register are taken from the
+    // shadow copy of the register, it is not read from the device.
+    void writeField(RegisterField field, int32_t value);
+
+    // Collect the field writes and send every changed register only once, all
+    // datagrams within a single SPI transaction.
+    void beginWrite();
+    void endWrite();
+
+    // Read DRV_STATUS into its shadow register. The device replies with the data
+    // requested by the previous datagram; repeated reads send only one datagram and
+    // return the status of the time of the previous read.
+    uint32_t readStatus();
+
+  private:
+    struct {
+      bool     active;
+      uint32_t dirty[TMC2130_REGISTER_COUNT / 32];
+    } _write{};
+
+    // The previous datagram requested DRV_STATUS.
+    bool _statusRequested{};
   };
 
   class Motor : public Driver {
@@ -62,9 +86,45 @@ namespace V2Stepper {
 
         // Acceleration in fullsteps-per-second per second.
         uint16_t accel;
+
+        // The limit of the change of the acceleration in fullsteps-per-second per
+        // second per second. Positioning moves follow an S-curve, 0 uses a constant
+        // acceleration.
+        uint32_t jerk;
       } speed;
+
+      // The timer interrupt fires at the time of the next step, instead of at the
+      // fixed tick frequency. The period of the timer follows the speed, every edge
+      // of the step signal is a step. The timer needs to be created with a frequency
+      // lower than the minimum speed in microsteps. Such a motor cannot be part of
+      // a Group.
+      bool stepTimer;
+
+      // Sample the driver status from loop() at the given interval, 0 disables it.
+      uint32_t statusUsec;
     } config;
 
+    // The sampled driver status. The StallGuard load value is 0..1023, a lower
+    // value is a higher mechanical load; the current is the actual current scale
+    // 0..31 of the coils.
+    struct Status {
+      uint16_t load;
+      uint8_t  current;
+      bool     stall;
+      bool     overTemperatureWarning;
+      bool     overTemperature;
+    };
+
+    struct Telemetry {
+      uint32_t samples;
+      uint16_t loadMin;
+      uint16_t loadMax;
+      uint32_t loadSum;
+      uint32_t currentSum;
+      uint32_t overTemperatureWarning;
+      uint32_t overTemperature;
+    };
+
     constexpr Motor(const Config conf, V2Base::Timer::Periodic* timer, SPIClass* spi, uint8_t pinSelect, uint8_t pinStep) :
       Driver(spi, pinSelect, pinStep),
       _pinStep(pinStep),
@@ -82,7 +142,8 @@ namespace V2Stepper {
     }
 
     // Periodic tick interrupt, expected to be called with a frequency
-    // of 200kHz (_tickFrequency) from a timer interrupt.
+    // of 200kHz (_tickFrequency) from a timer interrupt. With 'stepTimer', it is
+    // called at every step.
     void tick();
 
     // Move to the given position. If microsteps are configured, the actual microstep
@@ -90,6 +151,12 @@ namespace V2Stepper {
     // the movemment is a fraction 0..1 of the configured maximum speed range.
     void setPosition(float position, float speedFraction = 1, void (*handler)() = NULL);
 
+    // Move to the position after the current and the already queued movements. The
+    // queued positions which continue in the direction of the movement are blended
+    // into one movement, it decelerates only before the last one. The handler is
+    // called when the position is passed. Returns false if the queue is full.
+    bool queuePosition(float position, float speedFraction = 1, void (*handler)() = NULL);
+
     // Apply a fraction of the configured current in stand-still mode to hold the motor
     // position. The default after a reset is passively braking with the coils shorted.
     void hold(float fraction = 0.1);
@@ -102,11 +169,11 @@ namespace V2Stepper {
     }
 
     float getSpeed() {
-      return (float)_speed.now / (float)(1 << config.microstepsShift);
+      return (float)_speed.now / (float)(1 << (config.microstepsShift + _speedShift));
     }
 
     float getSpeedTarget() {
-      return (float)_speed.target / (float)(1 << config.microstepsShift);
+      return (float)_speed.target / (float)(1 << (config.microstepsShift + _speedShift));
     }
 
     // Set the current position to the given step value.
@@ -129,12 +196,52 @@ namespace V2Stepper {
     // fraction -1..1 the configured maximum speed range, 0 stops the rotation.
     void rotate(float speedFraction);
 
+    // The recent status samples, 0 is the latest one.
+    uint8_t getStatusCount() {
+      return _status.count;
+    }
+
+    const Status* getStatus(uint8_t index) {
+      if (index >= _status.count)
+        return NULL;
+
+      return &_status.entries[(_status.next + _nStatus - 1 - index) % _nStatus];
+    }
+
+    // The accumulated samples since the last reset.
+    const Telemetry& getTelemetry() {
+      return _status.telemetry;
+    }
+
+    float getLoadAvg() {
+      if (_status.telemetry.samples == 0)
+        return 0;
+
+      return (float)_status.telemetry.loadSum / (float)_status.telemetry.samples;
+    }
+
+    float getCurrentAvg() {
+      if (_status.telemetry.samples == 0)
+        return 0;
+
+      return (float)_status.telemetry.currentSum / (float)_status.telemetry.samples;
+    }
+
+    void resetTelemetry() {
+      _status.telemetry = {.loadMin{UINT16_MAX}};
+    }
+
   protected:
     // Notify of changes, used to drive a status LED.
     enum class Move { Forward, Reverse, Stop };
     virtual void handleMovement(Move move) {}
 
+    // Called for every status sample, e.g. to adapt the current to the load.
+    virtual void handleStatus(const Status& status) {}
+
   private:
+    template <uint8_t N> friend class Group;
+
     V2Base::Timer::Periodic*  _timer;
     V2Base::GPIO              _pinStep;
     static constexpr uint32_t _tickFrequency{200000};
@@ -185,13 +292,32 @@ namespace V2Stepper {
       }
     } _position{};
 
-    const uint32_t _speedAdjust = (float)(config.speed.accel * (1 << config.microstepsShift)) / _adjustmentFrequency;
+    // The speeds are microsteps per second in fixed-point, with an 8 bit fraction.
+    static constexpr uint8_t _speedShift{8};
+    const uint32_t           _speedAdjust =
+      ((uint64_t)config.speed.accel << (config.microstepsShift + _speedShift)) / _adjustmentFrequency;
+
+    // The minimum speed, the start and end speed of the movements.
+    const uint32_t _speedMin = (uint32_t)config.speed.min << (config.microstepsShift + _speedShift);
+
     struct {
-      float    now;
+      uint32_t now;
       uint32_t target;
     } _speed{};
 
+    // The S-curve of a positioning move, the speeds of the acceleration, starting
+    // at the minimum speed. The entries are 'divider' speed adjustments apart, the
+    // speed is interpolated between them; the deceleration walks the table backwards.
+    static constexpr uint8_t _rampSize{64};
     struct {
+      uint32_t speeds[_rampSize];
+      uint8_t  count;
+      uint8_t  divider;
+      uint16_t position;
+    } _ramp{};
+
+    // The pending commands.
+    struct Command {
       Mode mode;
       union {
         struct {
@@ -199,6 +325,11 @@ namespace V2Stepper {
           float speedFraction;
           bool  reverse;
           void (*handler)();
+
+          // The target in microsteps and the speed, to blend the position from
+          // the interrupt handler.
+          uint32_t steps;
+          uint32_t speed;
         } position;
 
         struct {
@@ -213,14 +344,348 @@ namespace V2Stepper {
           void (*handler)();
         } home;
       };
+    };
+
+    static constexpr uint8_t _nCommands{8};
+    struct {
+      Command entries[_nCommands];
+      uint8_t first;
+      uint8_t count;
     } _queue{};
 
+    // The steps of the queued positions which continue in the direction of the
+    // current movement, they extend the distance to decelerate.
+    uint32_t _lookahead{};
+
+    // The handlers of the blended positions, called from loop().
+    struct {
+      void (*handlers[_nCommands])();
+      uint8_t first;
+      uint8_t count;
+    } _passed{};
+
+    static constexpr uint8_t _nStatus{16};
+    struct {
+      Status        entries[_nStatus];
+      uint8_t       next;
+      uint8_t       count;
+      unsigned long usec;
+      Telemetry     telemetry;
+    } _status{};
+
+    bool pushCommand(const Command& command);
+    bool popCommand(Command* command);
+    void clearCommands();
+    void updateLookahead();
+
+    void     tickStep();
+    void     adjustSpeed();
+    bool     advance();
     void     init(Mode mode);
     uint32_t getMaxSpeed(float speedFraction);
+    uint32_t toSpeed(uint32_t fullsteps);
     uint32_t getAccelerationSteps(uint32_t speedFrom, uint32_t speedTo);
     void     calculateDecelerationSteps();
+    uint32_t planRamp(uint32_t speedFrom, uint32_t speedTo, uint32_t distance);
+    uint32_t getRampSteps();
     void     setDirection(bool reverse);
     void     stopPositioning();
+    void     sampleStatus();
+  };
+
+  // Several motors driven from one timer. A coordinated move distributes the steps
+  // of all motors along the steps of the motor with the longest distance; all motors
+  // start and arrive together. The speed and acceleration of the move are limited
+  // to stay within the configuration of every motor. Outside of coordinated moves,
+  // tick() drives the motors individually, e.g. to home them. The motors need to be
+  // created with the timer of the group. Motors with 'stepTimer' reprogram their
+  // timer at every step and use double-edge stepping, they are not added:
+  //   V2Base::Timer::Periodic Timer(2, 200000);
+  //   V2Stepper::Group<2> Axes({&MotorX, &MotorY});
+  //   Timer.begin<&V2Stepper::Group<2>::tick>(&Axes);
+  template <uint8_t N> class Group {
+  public:
+    Group(std::initializer_list<Motor*> motors) {
+      for (Motor* motor : motors)
+        if (_count < N && !motor->config.stepTimer)
+          _motors[_count++] = motor;
+    }
+
+    void loop() {
+      for (uint8_t i = 0; i < _count; i++)
+        _motors[i]->loop();
+
+      if (!_handler || isBusy())
+        return;
+
+      void (*handler)() = _handler;
+      _handler          = NULL;
+      handler();
+    }
+
+    // Periodic tick interrupt, expected to be called with the frequency of
+    // Motor::tick().
+    void tick() {
+      if (!_move.active) {
+        for (uint8_t i = 0; i < _count; i++)
+          _motors[i]->tick();
+        return;
+      }
+
+      // Reset step signals back to logical low.
+      for (uint8_t i = 0; i < _count; i++) {
+        if (_motors[i]->_high) {
+          _motors[i]->_high = false;
+          _motors[i]->_pinStep.low();
+        }
+      }
+
+      // Speed calculation, modulates the pulse frequency.
+      if (_move.adjustCounter == 0) {
+        _move.adjustCounter = Motor::_tickFrequency / Motor::_adjustmentFrequency;
+
+        // Unsigned, clamp before the update.
+        if (_speed.now < _speed.target) {
+          if (_speed.target - _speed.now > _speed.adjust)
+            _speed.now += _speed.adjust;
+
+          else
+            _speed.now = _speed.target;
+
+        } else if (_speed.now > _speed.target) {
+          if (_speed.now - _speed.target > _speed.adjust)
+            _speed.now -= _speed.adjust;
+
+          else
+            _speed.now = _speed.target;
+        }
+
+        // Without a minimum speed, the move starts and ends at zero.
+        const uint32_t speed = _speed.now > _speed.adjust ? _speed.now : _speed.adjust;
+        if (speed >= 1 << Motor::_speedShift)
+          _move.period = (Motor::_tickFrequency << Motor::_speedShift) / speed;
+
+        else
+          _move.period = Motor::_tickFrequency;
+      }
+      _move.adjustCounter--;
+
+      if (_move.counter == 0) {
+        _move.counter = _move.period;
+
+        if (_move.step == _move.steps) {
+          for (uint8_t i = 0; i < _count; i++)
+            if (_motors[i]->_mode == Motor::Mode::Position)
+              _motors[i]->_mode = Motor::Mode::Done;
+
+          _move.active = false;
+          return;
+        }
+
+        if (_move.steps - _move.step == _move.decel)
+          _speed.target = _speed.min;
+
+        _move.step++;
+
+        // Bresenham; step every motor at the fraction of its distance.
+        for (uint8_t i = 0; i < _count; i++) {
+          _move.errors[i] += _move.distances[i];
+          if (_move.errors[i] < _move.steps)
+            continue;
+
+          _move.errors[i] -= _move.steps;
+
+          Motor* motor = _motors[i];
+          if (motor->_reverse)
+            motor->_position.now--;
+
+          else
+            motor->_position.now++;
+
+          motor->_high = true;
+          motor->_pinStep.high();
+        }
+      }
+
+      _move.counter--;
+    }
+
+    bool isBusy() {
+      if (_move.active)
+        return true;
+
+      for (uint8_t i = 0; i < _count; i++)
+        if (_motors[i]->isBusy())
+          return true;
+
+      return false;
+    }
+
+    // Move all motors to the given positions, in fullsteps. The handler is called
+    // when all motors have arrived. Returns false if a motor is busy.
+    bool setPosition(const float positions[], float speedFraction = 1, void (*handler)() = NULL) {
+      if (isBusy())
+        return false;
+
+      uint32_t steps = 0;
+      for (uint8_t i = 0; i < _count; i++) {
+        Motor*         motor  = _motors[i];
+        const uint32_t target = positions[i] * (float)(1 << motor->config.microstepsShift);
+        motor->_position.target  = target;
+        motor->_position.handler = NULL;
+        _move.distances[i]       = motor->_position.getDistance();
+        _move.errors[i]          = 0;
+        if (_move.distances[i] > steps)
+          steps = _move.distances[i];
+      }
+
+      if (steps == 0) {
+        if (handler)
+          handler();
+        return true;
+      }
+
+      // The speed of the longest distance; no motor may exceed its limits.
+      float speedMax = 0;
+      float speedMin = 0;
+      float accel    = 0;
+      for (uint8_t i = 0; i < _count; i++) {
+        if (_move.distances[i] == 0)
+          continue;
+
+        const Motor* motor = _motors[i];
+        const float  scale = (float)steps / (float)_move.distances[i] * (float)(1 << motor->config.microstepsShift);
+        const float  range = motor->config.speed.max - motor->config.speed.min;
+        const float  max   = (motor->config.speed.min + (range * speedFraction)) * scale;
+        if (speedMax == 0 || max < speedMax)
+          speedMax = max;
+
+        if (motor->config.speed.min * scale > speedMin)
+          speedMin = motor->config.speed.min * scale;
+
+        if (accel == 0 || motor->config.speed.accel * scale < accel)
+          accel = motor->config.speed.accel * scale;
+      }
+
+      if (speedMin > speedMax)
+        speedMin = speedMax;
+
+      // The interrupt handler uses the fixed-point speeds.
+      const uint32_t adjust = toSpeed(accel / Motor::_adjustmentFrequency);
+      _speed                = {
+        .now{toSpeed(speedMin)},
+        .target{toSpeed(speedMax)},
+        .min{toSpeed(speedMin)},
+        .adjust{adjust > 0 ? adjust : 1},
+        .accel{accel},
+      };
+
+      _move.steps = steps;
+      _move.decel = getDecelerationSteps(_speed.target);
+
+      // Are we able to reach the full speed?
+      if (2 * _move.decel > steps)
+        _move.decel = steps / 2;
+
+      _move.step          = 0;
+      _move.counter       = 0;
+      _move.adjustCounter = 0;
+      _handler            = handler;
+
+      // The idle motors ignore the ticks while their directions are set.
+      for (uint8_t i = 0; i < _count; i++) {
+        Motor* motor = _motors[i];
+        if (_move.distances[i] == 0)
+          continue;
+
+        motor->_reverse = motor->_position.getReverse(motor->_position.target);
+        motor->setDirection(motor->_reverse);
+        motor->handleMovement(motor->_reverse ? Motor::Move::Reverse : Motor::Move::Forward);
+      }
+
+      // Hand the motors over to the coordinated move at once.
+      noInterrupts();
+      for (uint8_t i = 0; i < _count; i++)
+        if (_move.distances[i] > 0)
+          _motors[i]->_mode = Motor::Mode::Position;
+
+      _move.active = true;
+      interrupts();
+      return true;
+    }
+
+    // Stop the movement; the motors of a coordinated move decelerate together.
+    void stop() {
+      if (!_move.active) {
+        for (uint8_t i = 0; i < _count; i++)
+          _motors[i]->stop();
+        return;
+      }
+
+      noInterrupts();
+      _speed.target         = _speed.min;
+      const uint32_t decel  = getDecelerationSteps(_speed.now);
+      const uint32_t remain = _move.steps - _move.step;
+      if (decel < remain)
+        _move.steps = _move.step + decel;
+
+      _move.decel = 0;
+      interrupts();
+    }
+
+    // Home all motors at the same time, the handler is called when all motors are
+    // idle.
+    void home(uint32_t steps, uint32_t start, void (*handler)() = NULL) {
+      if (isBusy())
+        return;
+
+      for (uint8_t i = 0; i < _count; i++)
+        _motors[i]->home(steps, start);
+
+      _handler = handler;
+    }
+
+    Motor* getMotor(uint8_t index) {
+      return _motors[index];
+    }
+
+  private:
+    Motor*  _motors[N]{};
+    uint8_t _count{};
+    void (*_handler)(){};
+
+    // The speed of the motor with the longest distance, in its microsteps per
+    // second in fixed-point, with the fraction of Motor::_speedShift. The
+    // acceleration is only used outside of the interrupt handler.
+    struct {
+      uint32_t now;
+      uint32_t target;
+      uint32_t min;
+      uint32_t adjust;
+      float    accel;
+    } _speed{};
+
+    struct {
+      bool     active;
+      uint32_t steps;
+      uint32_t step;
+      uint32_t decel;
+      uint32_t counter;
+      uint32_t period;
+      uint32_t adjustCounter;
+      uint32_t distances[N];
+      uint32_t errors[N];
+    } _move{};
+
+    static uint32_t toSpeed(float speed) {
+      return speed * (float)(1 << Motor::_speedShift);
+    }
+
+    uint32_t getDecelerationSteps(uint32_t speed) {
+      const float now = (float)speed / (float)(1 << Motor::_speedShift);
+      const float min = (float)_speed.min / (float)(1 << Motor::_speedShift);
+      return ((now * now) - (min * min)) / (2.f * _speed.accel);
+    }
   };
 
   // Configure the driver as a power supply, 2 channels, PWM voltage scaling. Used e.g. to